@@ -0,0 +1,101 @@
+#include "adc_filter.h"
+
+#include <stddef.h>
+
+#define ADC_FILTER_MAX_SHIFT        12      // keeps (x - y) << 16 >> shift inside int32
+
+/* Integer square root (bitwise, no float) */
+static uint32_t isqrt64(uint64_t v)
+{
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > v)
+        bit >>= 2;
+
+    while (bit != 0) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+
+static void window_reset(adc_filter_t *f)
+{
+    f->count = 0;
+    f->min = UINT16_MAX;
+    f->max = 0;
+    f->sum = 0;
+    f->sum_sq = 0;
+}
+
+bool adc_filter_init(adc_filter_t *f, const adc_filter_config_t *config)
+{
+    if (f == NULL || config == NULL)
+        return false;
+    if (config->stages == 0 || config->stages > ADC_FILTER_MAX_STAGES)
+        return false;
+    if (config->shift == 0 || config->shift > ADC_FILTER_MAX_SHIFT)
+        return false;
+    if (config->decimation == 0)
+        return false;
+
+    f->config = *config;
+    adc_filter_reset(f);
+    return true;
+}
+
+void adc_filter_reset(adc_filter_t *f)
+{
+    for (int i = 0; i < ADC_FILTER_MAX_STAGES; i++)
+        f->state[i] = 0;
+    f->primed = false;
+    window_reset(f);
+}
+
+bool adc_filter_push(adc_filter_t *f, uint16_t raw, adc_filter_result_t *out)
+{
+    int32_t x = (int32_t)raw << ADC_FILTER_FRAC_BITS;
+
+    if (!f->primed) {
+        for (int i = 0; i < f->config.stages; i++)
+            f->state[i] = x;
+        f->primed = true;
+    }
+
+    for (int i = 0; i < f->config.stages; i++) {
+        // arithmetic shift of a negative step rounds towards -inf, fine for a low-pass
+        f->state[i] += (x - f->state[i]) >> f->config.shift;
+        x = f->state[i];
+    }
+
+    if (raw < f->min)
+        f->min = raw;
+    if (raw > f->max)
+        f->max = raw;
+    f->sum += raw;
+    f->sum_sq += (uint64_t)raw * raw;
+
+    if (++f->count < f->config.decimation)
+        return false;
+
+    if (out != NULL) {
+        const int32_t last = f->state[f->config.stages - 1];
+        const int32_t rounded = (last + (1 << (ADC_FILTER_FRAC_BITS - 1))) >> ADC_FILTER_FRAC_BITS;
+
+        out->filtered = (uint16_t)(rounded < 0 ? 0 : rounded);
+        out->min = f->min;
+        out->max = f->max;
+        out->mean = (uint16_t)((f->sum + f->count / 2) / f->count);
+        out->rms = (uint16_t)isqrt64(f->sum_sq / f->count);
+        out->samples = f->count;
+    }
+
+    window_reset(f);
+    return true;
+}
@@ -4,34 +4,33 @@ static QueueHandle_t uart0_queue;
 
 TimerHandle_t connected_leds_timer, misaligned_leds_timer, charging_leds_timer, hw_readings_timer;
 
+/* Dead battery probing - pulse, then hold if a load was seen */
+static TimerHandle_t probe_timer;
+static volatile bool probe_pulsing = false;    // tx_status is rewritten by the peer snapshot on the root
+static volatile bool probe_holding = false;
+static uint32_t probe_count = 0, probe_hits = 0;
+
 static float last_duty_cycle = 0.30;
 
 static const char* TAG = "HARDWARE";
 
-static void parse_received_UART(uint8_t *rx_uart)
+static void STM_command_ack(uint16_t seq);
+static void probe_load_detected(float current);
+
+/* Apply one set of STM32 readings - shared by the binary and the JSON path */
+static void apply_STM_measurement(const stm_measurement_t *m, int64_t rx_us)
 {
-    // Parse json
-    cJSON *root = cJSON_Parse((char*)rx_uart);
-    
-    if (root == NULL) {
-        const char *error_ptr = cJSON_GetErrorPtr();
-        if (error_ptr != NULL) {
-            ESP_LOGE(TAG, "JSON Parse Error before: %s", error_ptr);
-        } else {
-            ESP_LOGE(TAG, "JSON Parse Error: Invalid JSON");
-        }
-        ESP_LOGE(TAG, "Received data: %s", rx_uart);
-        return;  // Don't crash, just skip this packet
-    }
-    
-    // Safely extract values
-    SAFE_GET_DOUBLE(root, "temperature1", self_dynamic_payload.TX.temp1, 0.0);
-    SAFE_GET_DOUBLE(root, "temperature2", self_dynamic_payload.TX.temp2, 0.0);
-    SAFE_GET_DOUBLE(root, "voltage", self_dynamic_payload.TX.voltage, 0.0);
-    SAFE_GET_DOUBLE(root, "current", self_dynamic_payload.TX.current, 0.0);
+    self_dynamic_payload.TX.temp1 = m->temperature1;
+    self_dynamic_payload.TX.temp2 = m->temperature2;
+    self_dynamic_payload.TX.voltage = m->voltage;
+    self_dynamic_payload.TX.current = m->current;
+
+    // a scooter with a dead RX draws current on the probe pulse
+    if (probe_pulsing && m->current > PROBE_LOAD_CURRENT)
+        probe_load_detected(m->current);
     
-    alertType_t alertType = NONE;
-    SAFE_GET_INT(root, "alert", alertType, NONE);
+    alertType_t alertType = (alertType_t)m->alert;
+    const uint8_t previous_flags = self_alert_payload.TX.TX_all_flags;
     
     // Handle alert
     if (alertType == OV)
@@ -49,37 +48,69 @@ static void parse_received_UART(uint8_t *rx_uart)
             write_STM_command(TX_OFF);
     }
 
+    // the STM32 applies the limits itself - wake alert_task on a new flag only
+    if (self_alert_payload.TX.TX_all_flags != previous_flags)
+        self_alert_notify(rx_us);
+
     // Get tuning parameters
-    float duty_cycle = 0.0;
-    SAFE_GET_DOUBLE(root, "duty", duty_cycle, 0.0);
-    self_tuning_params.duty_cycle = duty_cycle;
-    
-    int tuning = 0;
-    SAFE_GET_INT(root, "tuning", tuning, 0);
-    self_tuning_params.tuning = tuning;
-    
-    int low_vds_threshold = 0;
-    SAFE_GET_INT(root, "low_vds_threshold", low_vds_threshold, 0);
-    self_tuning_params.low_vds_threshold = low_vds_threshold;
-    
-    int low_vds = 0;
-    SAFE_GET_INT(root, "low_vds", low_vds, 0);
-    self_tuning_params.low_vds = low_vds;
+    self_tuning_params.duty_cycle = m->duty;
+    self_tuning_params.tuning = m->tuning;
+    self_tuning_params.low_vds_threshold = m->low_vds_threshold;
+    self_tuning_params.low_vds = m->low_vds;
 
     if (fabs(self_tuning_params.duty_cycle - last_duty_cycle) > MIN_DUTY_CYCLE_CHANGE) {
         //send_tuning_message();
         last_duty_cycle = self_tuning_params.duty_cycle;
     }
+}
+
+/* JSON object from the STM32 (fallback format) */
+static void handle_STM_json(const stm_json_parser_t *parser, int64_t rx_us)
+{
+    if (parser->present == 0) {
+        ESP_LOGW(TAG, "Empty JSON packet");
+        return;
+    }
 
-    //print json
-    /*
-    char *out = cJSON_Print(root);
-    ESP_LOGI(TAG, "JSON: %s", out);
-    free(out);
-    */
+    if (parser->present & STM_JSON_ACK)
+        STM_command_ack(parser->ack);
 
-    // Free json
-    cJSON_Delete(root);
+    const uint16_t fields = parser->present & STM_JSON_ALL;
+    if (fields == 0)
+        return;
+
+    // missing keys read as 0, as before
+    if (fields != STM_JSON_ALL)
+        ESP_LOGW(TAG, "Missing JSON fields (present mask 0x%03X)", fields);
+
+    apply_STM_measurement(&parser->m, rx_us);
+}
+
+/* Binary frame from the STM32 */
+static void handle_STM_frame(const stm_frame_parser_t *parser, int64_t rx_us)
+{
+    stm_measurement_t m;
+
+    switch (parser->type)
+    {
+        case STM_FRAME_MEASUREMENT:
+            if (stm_frame_decode_measurement(parser->payload, parser->len, &m))
+                apply_STM_measurement(&m, rx_us);
+            else
+                ESP_LOGW(TAG, "Short measurement frame (%d bytes)", parser->len);
+            break;
+
+        case STM_FRAME_ACK:
+            if (parser->len >= 2)
+                STM_command_ack((uint16_t)(parser->payload[0] | (parser->payload[1] << 8)));
+            else
+                ESP_LOGW(TAG, "Short ack frame (%d bytes)", parser->len);
+            break;
+
+        default:
+            ESP_LOGW(TAG, "Unknown STM frame type 0x%02X", parser->type);
+            break;
+    }
 }
 
 static void uart_event_task(void *pvParameters)
@@ -137,106 +168,296 @@ static void uart_event_task(void *pvParameters)
 
 static void rx_task(void *pvParameters)
 {
-    uint8_t buffer[UART_BUFFER_SIZE];
-    uint16_t rxIndex = 0;
-    uint8_t* data = (uint8_t*) malloc(UART_BUFFER_SIZE/2);
-    bool json = false;
-    
-    if (data == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate rx_task buffer");
-        vTaskDelete(NULL);
-        return;
-    }
+    static uint8_t chunk[UART_RX_CHUNK_SIZE];
+    static stm_frame_parser_t parser;
+    static stm_json_parser_t json_parser;
+    uint32_t reported_errors = 0;
+
+    stm_frame_parser_init(&parser);
+    stm_json_parser_init(&json_parser);
     
     while (1) {
-        const int rxBytes = uart_read_bytes(EX_UART_NUM, data, 1, portMAX_DELAY);
-        if (rxBytes > 0) {
-            switch(data[0])
-            {
-                case '{':
-                    json = true;
-                    rxIndex = 0;
-                    memset(buffer, 0, UART_BUFFER_SIZE);  // Clear buffer
-                    buffer[rxIndex++] = data[0];
-                    break;
-                    
-                case '}':
-                    if (rxIndex < UART_BUFFER_SIZE - 1) {  // Bounds check
-                        buffer[rxIndex++] = data[0];
-                        buffer[rxIndex] = '\0';  // NULL terminate
-
-                        // LOG THE RAW DATA BEFORE PARSING
-                        //ESP_LOGI(TAG, "=== RAW JSON ===");
-                        //ESP_LOGI(TAG, "%s", buffer);
-                        //ESP_LOGI(TAG, "=== END (length: %d) ===", rxIndex);
-                        
-                        if (json && rxIndex > 2) {  // At least "{}"
-                            // Validate it looks like JSON before parsing
-                            ESP_LOGD(TAG, "Received JSON (%d bytes): %s", rxIndex, buffer);
-                            parse_received_UART(buffer);
-                        } else {
-                            ESP_LOGW(TAG, "Invalid JSON packet (length: %d)", rxIndex);
-                        }
-                    } else {
-                        ESP_LOGE(TAG, "Buffer overflow prevented (rxIndex: %d)", rxIndex);
-                    }
-                    
-                    // Reset state
-                    rxIndex = 0;
-                    json = false;
-                    memset(buffer, 0, UART_BUFFER_SIZE);
-                    break;
-                    
-                default:
-                    if (json) {
-                        if (rxIndex < UART_BUFFER_SIZE - 1) {  // Leave room for null terminator
-                            buffer[rxIndex++] = data[0];
-                        } else {
-                            ESP_LOGE(TAG, "Buffer overflow - discarding packet");
-                            rxIndex = 0;
-                            json = false;
-                            memset(buffer, 0, UART_BUFFER_SIZE);
-                        }
-                    }
-                    // Ignore data outside of JSON packets
-                    break;
+        // Block for the first byte, then take everything already buffered by the driver
+        size_t available = 0;
+        uart_get_buffered_data_len(EX_UART_NUM, &available);
+        if (available == 0)
+            available = 1;
+        else if (available > sizeof(chunk))
+            available = sizeof(chunk);
+
+        const int rxBytes = uart_read_bytes(EX_UART_NUM, chunk, available, portMAX_DELAY);
+        const int64_t rx_us = esp_timer_get_time();
+
+        for (int i = 0; i < rxBytes; i++) {
+            // a dropped frame hands its bytes back, so one byte can complete several results
+            stm_feed_result_t result = stm_frame_feed(&parser, chunk[i]);
+            for (; result != STM_FEED_CONSUMED; result = stm_frame_poll(&parser)) {
+                switch (result)
+                {
+                    case STM_FEED_FRAME:
+                        handle_STM_frame(&parser, rx_us);
+                        break;
+
+                    case STM_FEED_UNCLAIMED:
+                        // JSON fallback - tokenized in place, no frame buffer
+                        if (stm_json_feed(&json_parser, parser.byte) == STM_JSON_OBJECT)
+                            handle_STM_json(&json_parser, rx_us);
+                        break;
+
+                    case STM_FEED_ERROR:
+                    default:
+                        break;
+                }
             }
         }
+
+        uint32_t errors = parser.crc_errors + parser.length_errors + json_parser.errors;
+        if (errors != reported_errors) {
+            ESP_LOGW(TAG, "STM frames: %ld ok, %ld CRC errors, %ld length errors - JSON: %ld ok, %ld malformed",
+                     parser.frames, parser.crc_errors, parser.length_errors,
+                     json_parser.objects, json_parser.errors);
+            reported_errors = errors;
+        }
     }
-    free(data);
 }
 
-esp_err_t write_STM_limits()
-{
-    //create json file
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "overcurrent", OVER_CURRENT);
-    cJSON_AddNumberToObject(root, "overvoltage", OVER_VOLTAGE);
-    cJSON_AddNumberToObject(root, "overtemperature", OVER_TEMPERATURE);
+/*******************************************************
+ *                STM32 command channel
+ *******************************************************/
 
-    char *my_json_string = cJSON_Print(root);
-    const uint8_t len = strlen(my_json_string);
+/* Pending work, handed from any task to stm_cmd_task (latest mode wins) */
+static portMUX_TYPE stm_cmd_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t stm_cmd_task_handle = NULL;
+static SemaphoreHandle_t stm_ack_sem = NULL;
 
-    const uint8_t txBytes = uart_write_bytes(EX_UART_NUM, my_json_string, len);
+static bool mode_pending = false;
+static TX_status pending_mode = TX_OFF;
+static bool limits_pending = false;
+static bool mode_in_flight = false;
 
-    cJSON_Delete(root);
-    free(my_json_string);
+/* Last command written, matched against the acknowledgements */
+static uint16_t last_seq = 0;
+static int64_t last_sent_us = 0;
+static bool last_acked = true;
+static bool acks_supported = false;     // set by the first ack - older STM firmware never answers
 
-    if (txBytes > 0)
-        return ESP_OK;
+/* Mode the STM32 is known to run */
+static bool confirmed_valid = false;
+static TX_status confirmed_mode = TX_OFF;
+static int64_t confirmed_us = 0;
+
+static stm_cmd_stats_t stm_cmd_stats;
+
+static const char *mode_to_string(TX_status mode)
+{
+    switch (mode)
+    {
+        case TX_DEPLOY:         return "deploy";
+        case TX_LOCALIZATION:   return "localization";
+        case TX_OFF:            return "off";
+        case TX_PROBE:          return "probe";
+        default:                return NULL;
+    }
+}
+
+/* Called by rx_task for {"ack":seq} or a STM_FRAME_ACK */
+static void STM_command_ack(uint16_t seq)
+{
+    bool matched = false;
+    const int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&stm_cmd_lock);
+    acks_supported = true;
+    if (seq == last_seq && !last_acked)
+    {
+        const uint32_t rtt = (uint32_t)(now - last_sent_us);
+        last_acked = matched = true;
+        stm_cmd_stats.acked++;
+        stm_cmd_stats.rtt_last_us = rtt;
+        if (rtt > stm_cmd_stats.rtt_max_us)
+            stm_cmd_stats.rtt_max_us = rtt;
+        if (stm_cmd_stats.rtt_avg_us == 0)
+            stm_cmd_stats.rtt_avg_us = rtt;
+        else
+            stm_cmd_stats.rtt_avg_us = (uint32_t)((int32_t)stm_cmd_stats.rtt_avg_us + ((int32_t)rtt - (int32_t)stm_cmd_stats.rtt_avg_us) / 8);
+    }
+    taskEXIT_CRITICAL(&stm_cmd_lock);
+
+    if (matched)
+        xSemaphoreGive(stm_ack_sem);
     else
+        ESP_LOGD(TAG, "Stale STM ack %d", seq);
+}
+
+/**
+ * Write one formatted command and wait for its acknowledgement.
+ * Retries reuse the sequence number so a late ack still matches.
+ */
+static void stm_cmd_transmit(const char *cmd, size_t len, uint16_t seq, bool is_mode, TX_status mode)
+{
+    for (int attempt = 0; ; attempt++)
+    {
+        xSemaphoreTake(stm_ack_sem, 0);     // drop a stale give
+
+        taskENTER_CRITICAL(&stm_cmd_lock);
+        last_seq = seq;
+        last_acked = false;
+        last_sent_us = esp_timer_get_time();
+        stm_cmd_stats.sent++;
+        const bool wait_ack = acks_supported;
+        taskEXIT_CRITICAL(&stm_cmd_lock);
+
+        const int txBytes = uart_write_bytes(EX_UART_NUM, cmd, len);
+        if (txBytes != (int)len)
+        {
+            ESP_LOGE(TAG, "STM command write failed (%d of %d bytes)", txBytes, len);
+            return;
+        }
+
+        bool confirmed = !wait_ack;
+        if (wait_ack)
+            confirmed = (xSemaphoreTake(stm_ack_sem, pdMS_TO_TICKS(STM_CMD_ACK_TIMEOUT_MS)) == pdTRUE);
+
+        taskENTER_CRITICAL(&stm_cmd_lock);
+        if (confirmed && is_mode)
+        {
+            confirmed_valid = true;
+            confirmed_mode = mode;
+            confirmed_us = esp_timer_get_time();
+        }
+        else if (!confirmed)
+        {
+            stm_cmd_stats.timeouts++;
+            // the STM32 state is unknown now - never suppress the next command
+            confirmed_valid = false;
+        }
+        // a newer mode supersedes this one, no point retrying it
+        const bool superseded = is_mode && mode_pending;
+        if (!confirmed && !superseded && attempt < STM_CMD_MAX_RETRIES)
+            stm_cmd_stats.retries++;
+        taskEXIT_CRITICAL(&stm_cmd_lock);
+
+        if (confirmed || superseded)
+            return;
+
+        if (attempt >= STM_CMD_MAX_RETRIES)
+        {
+            ESP_LOGE(TAG, "STM command %d not acknowledged after %d retries", seq, STM_CMD_MAX_RETRIES);
+            return;
+        }
+        ESP_LOGW(TAG, "STM command %d not acknowledged - retry %d", seq, attempt + 1);
+    }
+}
+
+static void stm_cmd_log_stats(void)
+{
+    stm_cmd_stats_t stats;
+    STM_get_command_stats(&stats);
+
+    ESP_LOGI(TAG, "STM commands: %ld sent, %ld acked, %ld retries, %ld timeouts, %ld coalesced, %ld suppressed - RTT last %ld us, avg %ld us, max %ld us",
+             stats.sent, stats.acked, stats.retries, stats.timeouts, stats.coalesced, stats.suppressed,
+             stats.rtt_last_us, stats.rtt_avg_us, stats.rtt_max_us);
+}
+
+static void stm_cmd_task(void *pvParameters)
+{
+    // commands are formatted in place, compact and without heap
+    static char cmd_buffer[STM_CMD_BUFFER_SIZE];
+    json_writer_t jw;
+    uint16_t seq = 0;
+    uint32_t logged_at = 0;
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // drain everything queued meanwhile - the mode first, it may be an OFF
+        while (1)
+        {
+            bool send_mode = false, send_limits = false;
+            TX_status mode = TX_OFF;
+
+            taskENTER_CRITICAL(&stm_cmd_lock);
+            if (mode_pending)
+            {
+                send_mode = mode_in_flight = true;
+                mode = pending_mode;
+                mode_pending = false;
+            }
+            else if (limits_pending)
+            {
+                send_limits = true;
+                limits_pending = false;
+            }
+            taskEXIT_CRITICAL(&stm_cmd_lock);
+
+            if (!send_mode && !send_limits)
+                break;
+
+            seq++;
+            json_writer_init(&jw, cmd_buffer, sizeof(cmd_buffer));
+            json_writer_object_begin(&jw, NULL);
+            if (send_mode)
+            {
+                json_writer_string(&jw, "mode", mode_to_string(mode));
+            }
+            else
+            {
+                json_writer_float(&jw, "overcurrent", OVER_CURRENT, 3);
+                json_writer_float(&jw, "overvoltage", OVER_VOLTAGE, 3);
+                json_writer_float(&jw, "overtemperature", OVER_TEMPERATURE, 3);
+            }
+            json_writer_uint(&jw, "seq", seq);
+            json_writer_object_end(&jw);
+
+            if (json_writer_finish(&jw) == NULL)
+                ESP_LOGE(TAG, "STM command does not fit %d bytes", STM_CMD_BUFFER_SIZE);
+            else
+                stm_cmd_transmit(cmd_buffer, jw.len, seq, send_mode, mode);
+
+            taskENTER_CRITICAL(&stm_cmd_lock);
+            mode_in_flight = false;
+            taskEXIT_CRITICAL(&stm_cmd_lock);
+        }
+
+        if (stm_cmd_stats.sent - logged_at >= STM_CMD_STATS_EVERY)
+        {
+            stm_cmd_log_stats();
+            logged_at = stm_cmd_stats.sent;
+        }
+    }
+}
+
+void STM_get_command_stats(stm_cmd_stats_t *stats)
+{
+    taskENTER_CRITICAL(&stm_cmd_lock);
+    *stats = stm_cmd_stats;
+    taskEXIT_CRITICAL(&stm_cmd_lock);
+}
+
+esp_err_t write_STM_limits()
+{
+    if (stm_cmd_task_handle == NULL)
         return ESP_FAIL;
+
+    taskENTER_CRITICAL(&stm_cmd_lock);
+    limits_pending = true;
+    taskEXIT_CRITICAL(&stm_cmd_lock);
+
+    xTaskNotifyGive(stm_cmd_task_handle);
+    return ESP_OK;
 }
 
 esp_err_t write_STM_command(TX_status command)
 {
     if (!internalFWTEST)
     {
-        //create json file
-        cJSON *root = cJSON_CreateObject();
+        if (mode_to_string(command) == NULL)
+            return ESP_ERR_INVALID_ARG;
+
+        // local state follows the request right away
         if (command == TX_DEPLOY)
         {
-            cJSON_AddStringToObject(root, "mode", "deploy");
             self_dynamic_payload.TX.tx_status = TX_DEPLOY;
             strip_misalignment = strip_enable = false;
             strip_charging = true;
@@ -244,31 +465,56 @@ esp_err_t write_STM_command(TX_status command)
         }
         else if (command == TX_LOCALIZATION)
         {
-            cJSON_AddStringToObject(root, "mode", "localization");
             self_dynamic_payload.TX.tx_status = TX_LOCALIZATION;
             ESP_LOGW(TAG, "LOC");
         }
         else if (command == TX_OFF)
         {
-            cJSON_AddStringToObject(root, "mode", "off");
             strip_misalignment = strip_charging = false;
             strip_enable = true;
             self_dynamic_payload.TX.tx_status = TX_OFF;
             ESP_LOGW(TAG, "OFF");
         }
+        else if (command == TX_PROBE)
+        {
+            // no LED change, the pulse is too short to be seen
+            self_dynamic_payload.TX.tx_status = TX_PROBE;
+            ESP_LOGD(TAG, "PROBE");
+        }
+        if (command != TX_LOCALIZATION)
+            probe_holding = false;
+        if (command != TX_PROBE)
+            probe_pulsing = false;
 
-        char *my_json_string = cJSON_Print(root);
-        const uint8_t len = strlen(my_json_string);
+        if (stm_cmd_task_handle == NULL)
+            return ESP_FAIL;
 
-        const uint8_t txBytes = uart_write_bytes(EX_UART_NUM, my_json_string, len);
+        bool notify = true;
+        const int64_t now = esp_timer_get_time();
 
-        cJSON_Delete(root);
-        free(my_json_string);
-        
-        if (txBytes > 0)
-            return ESP_OK;
-        else
-            return ESP_FAIL;
+        taskENTER_CRITICAL(&stm_cmd_lock);
+        if (mode_pending)
+        {
+            // e.g. OFF followed by LOCALIZATION from the baton before the first hit the UART
+            stm_cmd_stats.coalesced++;
+        }
+        else if (!mode_in_flight && confirmed_valid && confirmed_mode == command &&
+                 (now - confirmed_us) < (int64_t)STM_CMD_DEDUP_MS * 1000)
+        {
+            // e.g. the broadcast OFF of reset_the_baton while already OFF
+            stm_cmd_stats.suppressed++;
+            notify = false;
+        }
+        if (notify)
+        {
+            pending_mode = command;
+            mode_pending = true;
+        }
+        taskEXIT_CRITICAL(&stm_cmd_lock);
+
+        if (notify)
+            xTaskNotifyGive(stm_cmd_task_handle);
+        return ESP_OK;
     }
     else
     {
@@ -293,11 +539,72 @@ esp_err_t write_STM_command(TX_status command)
             self_dynamic_payload.TX.tx_status = TX_LOCALIZATION;
             ESP_LOGW(TAG, "LOC");
         }
+        else if (command == TX_PROBE)
+        {
+            gpio_set_level(GPIO_OUTPUT_PIN, 1);
+            self_dynamic_payload.TX.tx_status = TX_PROBE;
+        }
+        if (command != TX_LOCALIZATION)
+            probe_holding = false;
+        if (command != TX_PROBE)
+            probe_pulsing = false;
 
         return ESP_OK;
     }
 }
 
+/*******************************************************
+ *                Dead battery probing
+ *******************************************************/
+
+/* End of the pulse (no load) or of the hold (RX never localized) */
+static void probe_timer_cb(TimerHandle_t timer)
+{
+    if (probe_pulsing)
+    {
+        write_STM_command(TX_OFF);
+    }
+    else if (probe_holding)
+    {
+        ESP_LOGW(TAG, "Probed scooter not localized in %d ms - OFF", PROBE_HOLD_MS);
+        write_STM_command(TX_OFF);
+    }
+}
+
+/* Called by rx_task on a measurement above PROBE_LOAD_CURRENT during the pulse */
+static void probe_load_detected(float current)
+{
+    probe_hits++;
+    ESP_LOGW(TAG, "Probe: load detected (%.3f A) - holding the pad ON (%ld hits / %ld probes)", current, probe_hits, probe_count);
+
+    // keep the scooter powered - its RX boots and broadcasts like any other
+    write_STM_command(TX_LOCALIZATION);
+    probe_holding = true;
+    xTimerChangePeriod(probe_timer, pdMS_TO_TICKS(PROBE_HOLD_MS), 0);
+}
+
+esp_err_t STM_probe(void)
+{
+    if (probe_timer == NULL)
+        return ESP_FAIL;
+    if (self_dynamic_payload.TX.tx_status != TX_OFF)
+        return ESP_ERR_INVALID_STATE;
+
+    probe_count++;
+    esp_err_t err = write_STM_command(TX_PROBE);
+    if (err == ESP_OK)
+    {
+        probe_pulsing = true;
+        xTimerChangePeriod(probe_timer, pdMS_TO_TICKS(PROBE_PULSE_MS), 0);  // (re)starts the one shot
+    }
+    return err;
+}
+
+bool STM_probe_holding(void)
+{
+    return probe_holding;
+}
+
 void uart_init(void) {
     const uart_config_t uart_config = {
         .baud_rate = 115200,
@@ -341,6 +648,10 @@ void TX_init_hw()
     xTimerStart(connected_leds_timer, 10);
     xTimerStart(misaligned_leds_timer, 10);
     xTimerStart(charging_leds_timer, 10);
+
+    probe_timer = xTimerCreate("probe", pdMS_TO_TICKS(PROBE_PULSE_MS), pdFALSE, NULL, probe_timer_cb);
+    if (probe_timer == NULL)
+        ESP_LOGW(TAG, "Probe timer was not created successfully");
     
     
     //*UART CONNECTION TO STM32
@@ -349,6 +660,15 @@ void TX_init_hw()
 	xTaskCreate(uart_event_task, "uart_event_task", UART_TASK_STACK_SIZE, NULL, UART_TASK_PRIORITY, NULL);
     xTaskCreate(rx_task, "uart_rx_task", UART_TASK_STACK_SIZE, NULL, UART_TASK_PRIORITY, NULL);
 
+    // all UART writes go through one task, callers never block on the STM32
+    stm_ack_sem = xSemaphoreCreateBinary();
+    if ((stm_ack_sem == NULL) ||
+        (xTaskCreate(stm_cmd_task, "stm_cmd_task", STM_CMD_TASK_STACK_SIZE, NULL, STM_CMD_TASK_PRIORITY, &stm_cmd_task_handle) != pdPASS))
+    {
+        ESP_LOGE(TAG, "Task stm_cmd_task was not created successfully");
+        stm_cmd_task_handle = NULL;
+    }
+
     // safely switch off
     ESP_ERROR_CHECK(write_STM_command(TX_OFF));
     ESP_ERROR_CHECK(write_STM_limits());
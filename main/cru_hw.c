@@ -9,34 +9,80 @@ static adc_channel_t channel[2] = {ADC_CHANNEL_2, ADC_CHANNEL_3}; //voltage gpio
 #endif
 static adc_atten_t atten[2] = {ADC_ATTEN_DB_12, ADC_ATTEN_DB_6};
 
-static adc_oneshot_unit_handle_t adc_handle = NULL;  // Changed from continuous handle
+#if CONFIG_IDF_TARGET_ESP32
+#define ADC_OUTPUT_TYPE             ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define ADC_GET_CHANNEL(p_data)     ((p_data)->type1.channel)
+#define ADC_GET_DATA(p_data)        ((p_data)->type1.data)
+#else
+#define ADC_OUTPUT_TYPE             ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define ADC_GET_CHANNEL(p_data)     ((p_data)->type2.channel)
+#define ADC_GET_DATA(p_data)        ((p_data)->type2.data)
+#endif
+
+static adc_continuous_handle_t adc_handle = NULL;
 static adc_cali_handle_t adc_cali_handle_1 = NULL, adc_cali_handle_2 = NULL;
+static TaskHandle_t adc_task_handle = NULL;
+static volatile uint32_t adc_pool_overflows = 0;
+static volatile int64_t adc_frame_us = 0;     // completion time of the last DMA frame
+
+/* Alert detectors - samples are pushed, alert_task is only woken on a crossing */
+static threshold_t voltage_threshold, current_threshold, temperature_threshold[2];
 
 static const char* TAG = "RX_HARDWARE";
 
 /* Semaphore used to protect against I2C reading simultaneously */
 static uint8_t counter = 0;
 
+/* DMA frame ready - wake get_adc */
+static bool IRAM_ATTR adc_conv_done_cb(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    BaseType_t mustYield = pdFALSE;
+    adc_frame_us = esp_timer_get_time();
+    if (adc_task_handle != NULL)
+        vTaskNotifyGiveFromISR(adc_task_handle, &mustYield);
+    return (mustYield == pdTRUE);
+}
+
+/* get_adc fell behind and the driver dropped samples */
+static bool IRAM_ATTR adc_pool_ovf_cb(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    adc_pool_overflows++;
+    return false;
+}
+
 static void init_adc(void)
 {   
-    // Initialize oneshot unit
-    adc_oneshot_unit_init_cfg_t init_config = {
-        .unit_id = ADC_UNIT,
+    // Initialize continuous unit, the DMA fills ADC_CONV_FRAME_SIZE frames in the background
+    adc_continuous_handle_cfg_t init_config = {
+        .max_store_buf_size = ADC_POOL_SIZE,
+        .conv_frame_size = ADC_CONV_FRAME_SIZE,
     };
-    ESP_ERROR_CHECK(adc_oneshot_new_unit(&init_config, &adc_handle));
+    ESP_ERROR_CHECK(adc_continuous_new_handle(&init_config, &adc_handle));
 
     // Configure each channel
-    adc_oneshot_chan_cfg_t config_ch0 = {
-        .bitwidth = ADC_BITWIDTH_DEFAULT,
-        .atten = atten[0],  // DB_12
+    adc_digi_pattern_config_t pattern[2];
+    for (int i = 0; i < 2; i++)
+    {
+        pattern[i].atten = atten[i];
+        pattern[i].channel = channel[i] & 0x7;
+        pattern[i].unit = ADC_UNIT;
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+
+    adc_continuous_config_t dig_cfg = {
+        .pattern_num = 2,
+        .adc_pattern = pattern,
+        .sample_freq_hz = ADC_SAMPLE_FREQ_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_OUTPUT_TYPE,
     };
-    adc_oneshot_chan_cfg_t config_ch1 = {
-        .bitwidth = ADC_BITWIDTH_DEFAULT,
-        .atten = atten[1],  // DB_6
+    ESP_ERROR_CHECK(adc_continuous_config(adc_handle, &dig_cfg));
+
+    adc_continuous_evt_cbs_t cbs = {
+        .on_conv_done = adc_conv_done_cb,
+        .on_pool_ovf = adc_pool_ovf_cb,
     };
-    
-    ESP_ERROR_CHECK(adc_oneshot_config_channel(adc_handle, channel[0], &config_ch0));
-    ESP_ERROR_CHECK(adc_oneshot_config_channel(adc_handle, channel[1], &config_ch1));
+    ESP_ERROR_CHECK(adc_continuous_register_event_callbacks(adc_handle, &cbs, NULL));
 
     // ============ MULTI-TARGET CALIBRATION ============
     
@@ -134,85 +180,116 @@ static float i2c_read_temperature_sensor(bool n_temp_sens)
         return value;
 }
 
+/* Latch the alert flag and wake alert_task on a raising crossing */
+static void check_threshold(threshold_t *t, float value, float limit, int64_t sample_us, alertType_t type)
+{
+    if (threshold_update(t, value, limit) != THRESHOLD_RAISED)
+        return;
+
+    if (type == OV)
+        self_alert_payload.RX.RX_internal.overvoltage = 1;
+    else if (type == OC)
+        self_alert_payload.RX.RX_internal.overcurrent = 1;
+    else if (type == OT)
+        self_alert_payload.RX.RX_internal.overtemperature = 1;
+
+    self_alert_notify(sample_us);
+}
+
+/* One filtered window per channel is ready - convert and check the alerts */
+static void update_adc_readings(const adc_filter_result_t *v, const adc_filter_result_t *c, int64_t sample_us)
+{
+    int ch2_voltage_mv, ch3_voltage_mv;
+    esp_err_t err1 = adc_cali_raw_to_voltage(adc_cali_handle_1, v->filtered, &ch2_voltage_mv);
+    esp_err_t err2 = adc_cali_raw_to_voltage(adc_cali_handle_2, c->filtered, &ch3_voltage_mv);
+    
+    if (err1 == ESP_OK && err2 == ESP_OK) {
+        // Update global payload
+        self_dynamic_payload.RX.voltage = (float)(ch2_voltage_mv * 42/1000.00);
+        self_dynamic_payload.RX.current = (float)(ch3_voltage_mv > 450 ? (ch3_voltage_mv - 400)/360.00 : 0);
+        
+        //ESP_LOGI(TAG, "Ch2: %.3fV --> Voltage: %.3f, Ch3: %.3fV --> Current: %.3f", 
+        //   ch2_voltage_mv/1000.0f, self_dynamic_payload.RX.voltage, 
+        //   ch3_voltage_mv/1000.0f, self_dynamic_payload.RX.current);
+    }
+
+    ESP_LOGD(TAG, "ADC window - V raw min %d max %d rms %d, I raw min %d max %d rms %d",
+             v->min, v->max, v->rms, c->min, c->max, c->rms);
+
+    if (self_dynamic_payload.RX.voltage > MIN_RX_VOLTAGE && !rxLocalized) {
+        xEventGroupSetBits(eventGroupHandle, LOCALIZEDBIT);
+    }
+
+    //Alerts check
+    check_threshold(&voltage_threshold, self_dynamic_payload.RX.voltage, OVER_VOLTAGE, sample_us, OV);
+    check_threshold(&current_threshold, self_dynamic_payload.RX.current, OVER_CURRENT, sample_us, OC);
+    
+    //todo fully charged check
+}
+
 //read dynamic parameters from ADC sensors
 static void get_adc(void *pvParameters)
 {
-    //ESP_LOGI(TAG, "ADC oneshot task started");
+    static uint8_t result[ADC_CONV_FRAME_SIZE];
+    static adc_filter_t filter[2];
+    adc_filter_result_t window[2];
+    bool window_ready[2] = {false, false};
+    uint32_t reported_overflows = 0;
+
+    const adc_filter_config_t filter_config = {
+        .stages = ADC_FILTER_STAGES,
+        .shift = ADC_FILTER_SHIFT,
+        .decimation = ADC_FILTER_DECIMATION,
+    };
+    for (int i = 0; i < 2; i++)
+        adc_filter_init(&filter[i], &filter_config);
 
-    // Averaging variables
-    uint32_t ch2_sum = 0, ch3_sum = 0;
-    uint32_t read_success = 0, read_errors = 0;
+    // started from here so the conversion callback always finds this task
+    adc_task_handle = xTaskGetCurrentTaskHandle();
+    ESP_ERROR_CHECK(adc_continuous_start(adc_handle));
 
     while (1) 
     {
-        int ch2_raw, ch3_raw;
-        
-        // Read both channels
-        esp_err_t ret1 = adc_oneshot_read(adc_handle, channel[0], &ch2_raw);
-        esp_err_t ret2 = adc_oneshot_read(adc_handle, channel[1], &ch3_raw);
-        
-        if (ret1 == ESP_OK && ret2 == ESP_OK) {
-            read_success++;
-            
-            // Accumulate samples
-            ch2_sum += ch2_raw;
-            ch3_sum += ch3_raw;
-            
-            // Average every 20 samples
-            if (read_success >= 20) {
-                int ch2_avg = ch2_sum / read_success;
-                int ch3_avg = ch3_sum / read_success;
-                
-                int ch2_voltage_mv, ch3_voltage_mv;
-                esp_err_t err1 = adc_cali_raw_to_voltage(adc_cali_handle_1, ch2_avg, &ch2_voltage_mv);
-                esp_err_t err2 = adc_cali_raw_to_voltage(adc_cali_handle_2, ch3_avg, &ch3_voltage_mv);
-                
-                if (err1 == ESP_OK && err2 == ESP_OK) {
-                    // Update global payload
-                    self_dynamic_payload.RX.voltage = (float)(ch2_voltage_mv * 42/1000.00);
-                    self_dynamic_payload.RX.current = (float)(ch3_voltage_mv > 450 ? (ch3_voltage_mv - 400)/360.00 : 0);
-                    
-                    //ESP_LOGI(TAG, "Ch2: %.3fV --> Voltage: %.3f, Ch3: %.3fV --> Current: %.3f", 
-                    //   ch2_voltage_mv/1000.0f, self_dynamic_payload.RX.voltage, 
-                    //   ch3_voltage_mv/1000.0f, self_dynamic_payload.RX.current);
-                }
+        // one wakeup per DMA frame instead of one per sample
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const int64_t frame_us = adc_frame_us;
 
-                if (self_dynamic_payload.RX.voltage > MIN_RX_VOLTAGE && !rxLocalized) {
-                    xEventGroupSetBits(eventGroupHandle, LOCALIZEDBIT);
+        while (1)
+        {
+            uint32_t ret_num = 0;
+            esp_err_t ret = adc_continuous_read(adc_handle, result, sizeof(result), &ret_num, 0);
+            if (ret != ESP_OK)
+                break;  // ESP_ERR_TIMEOUT: frame pool drained
+
+            for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= ret_num; i += SOC_ADC_DIGI_RESULT_BYTES)
+            {
+                adc_digi_output_data_t *p = (adc_digi_output_data_t *)&result[i];
+                const uint32_t chan = ADC_GET_CHANNEL(p);
+                const int idx = (chan == (channel[0] & 0x7)) ? 0 : (chan == (channel[1] & 0x7)) ? 1 : -1;
+                if (idx < 0)
+                    continue;
+
+                if (adc_filter_push(&filter[idx], (uint16_t)ADC_GET_DATA(p), &window[idx]))
+                    window_ready[idx] = true;
+
+                if (window_ready[0] && window_ready[1])
+                {
+                    update_adc_readings(&window[0], &window[1], frame_us);
+                    window_ready[0] = window_ready[1] = false;
                 }
-                
-                // Log stats every 1000 cycles (~100 seconds at 1kHz effective)
-                //if (read_success % 1000 == 0) {
-                //    ESP_LOGI(TAG, "ADC stats - Success: %lu, Errors: %lu, Heap: %lu", 
-                //             read_success, read_errors, esp_get_free_heap_size());
-                //}
-                
-                // Reset counters
-                ch2_sum = ch3_sum = read_success = 0;
             }
-        } else {
-            read_errors++;
-            ESP_LOGW(TAG, "ADC read failed: ch0=%d, ch1=%d", ret1, ret2);
         }
 
-        //Alerts check
-        if (self_dynamic_payload.RX.voltage > OVER_VOLTAGE) 
-            self_alert_payload.RX.RX_internal.overvoltage = 1;
-
-        if (self_dynamic_payload.RX.current > OVER_CURRENT)
-            self_alert_payload.RX.RX_internal.overcurrent = 1;
-
-        if (self_dynamic_payload.RX.temp1 > OVER_TEMPERATURE || self_dynamic_payload.RX.temp2 > OVER_TEMPERATURE)
-            self_alert_payload.RX.RX_internal.overtemperature = 1;
-        
-        //todo fully charged check
-        
-        // Sample at ~1kHz (1ms delay) for equivalent to 5kHz/2 channels in continuous mode
-        vTaskDelay(pdMS_TO_TICKS(1));
+        if (adc_pool_overflows != reported_overflows)
+        {
+            reported_overflows = adc_pool_overflows;
+            ESP_LOGW(TAG, "ADC pool overflow (%ld frames dropped so far)", reported_overflows);
+        }
     }
 
     // Cleanup (unreachable but good practice)
-    adc_oneshot_del_unit(adc_handle);
+    adc_continuous_stop(adc_handle);
+    adc_continuous_deinit(adc_handle);
     vTaskDelete(NULL); 
 }
 
@@ -230,14 +307,20 @@ static void get_temp(void *pvParameters)
                     counter++;
                     t1 = i2c_read_temperature_sensor(0);
                     if (t1 != -1)
+                    {
                         self_dynamic_payload.RX.temp1 = t1;
+                        check_threshold(&temperature_threshold[0], t1, OVER_TEMPERATURE, esp_timer_get_time(), OT);
+                    }
                     break;
 
                 case 1:
                     counter = 0;
                     t2 = i2c_read_temperature_sensor(1);
                     if (t2 != -1)
+                    {
                         self_dynamic_payload.RX.temp2= t2;
+                        check_threshold(&temperature_threshold[1], t2, OVER_TEMPERATURE, esp_timer_get_time(), OT);
+                    }
                     break;
                 default:
                     xSemaphoreGive(i2c_sem);
@@ -254,7 +337,13 @@ void RX_init_hw(void)
 {
     /* Init adc */
     init_adc();
-    ESP_LOGI(TAG, "ADC oneshot initialized");
+    ESP_LOGI(TAG, "ADC continuous initialized (%d Hz)", ADC_SAMPLE_FREQ_HZ);
+
+    /* Alert detectors */
+    threshold_init(&voltage_threshold, ALERT_HYSTERESIS_VOLTAGE, ALERT_DEBOUNCE_ADC);
+    threshold_init(&current_threshold, ALERT_HYSTERESIS_CURRENT, ALERT_DEBOUNCE_ADC);
+    threshold_init(&temperature_threshold[0], ALERT_HYSTERESIS_TEMPERATURE, ALERT_DEBOUNCE_TEMPERATURE);
+    threshold_init(&temperature_threshold[1], ALERT_HYSTERESIS_TEMPERATURE, ALERT_DEBOUNCE_TEMPERATURE);
 
     /* init I2C*/
     i2c_sem = xSemaphoreCreateBinary();
@@ -0,0 +1,192 @@
+#include "espnow_window.h"
+
+#include <string.h>
+
+/* Sequence order, wrap-around safe */
+static inline bool seq_before(uint16_t a, uint16_t b)
+{
+    return (int16_t)(a - b) < 0;
+}
+
+void espnow_window_init(espnow_window_t *w, const espnow_window_config_t *config)
+{
+    memset(w, 0, sizeof(*w));
+    w->config = *config;
+    if (w->config.slots > ESPNOW_WINDOW_MAX_SLOTS)
+        w->config.slots = ESPNOW_WINDOW_MAX_SLOTS;
+}
+
+int espnow_window_acquire(espnow_window_t *w, const uint8_t *mac, int64_t now_us)
+{
+    int slot = -1;
+    int window = 0;
+
+    for (int i = 0; i < w->config.slots; i++) {
+        if (!w->slot[i].used)
+            slot = (slot < 0) ? i : slot;
+        else if (memcmp(w->slot[i].mac, mac, ESPNOW_WINDOW_MAC_LEN) == 0)
+            window++;
+    }
+    if (slot < 0 || window >= w->config.peer_window) {
+        w->stats.window_waits++;
+        return -1;
+    }
+
+    espnow_window_slot_t *s = &w->slot[slot];
+    s->used = true;
+    s->failed = false;
+    s->retries = 0;
+    s->seq = w->seq++;
+    s->sent_us = now_us;
+    memcpy(s->mac, mac, ESPNOW_WINDOW_MAC_LEN);
+    return slot;
+}
+
+void espnow_window_sent(espnow_window_t *w, int slot, int64_t now_us)
+{
+    w->slot[slot].sent_us = now_us;
+}
+
+void espnow_window_release(espnow_window_t *w, int slot)
+{
+    w->slot[slot].used = false;
+}
+
+/* Callbacks come back in send order: the orphans sent before the frame just called back lost theirs */
+static void orphans_prune(espnow_window_t *w, uint16_t seq)
+{
+    for (int i = 0; i < ESPNOW_WINDOW_MAX_ORPHANS; i++) {
+        if (w->orphan[i].used && seq_before(w->orphan[i].seq, seq)) {
+            w->orphan[i].used = false;
+            w->stats.lost_callbacks++;
+        }
+    }
+}
+
+espnow_window_callback_t espnow_window_callback(espnow_window_t *w, const uint8_t *mac, bool ok, int64_t now_us,
+                                                int *slot, uint16_t *seq)
+{
+    int oldest = -1;
+    int orphan = -1;
+
+    *slot = -1;
+    *seq = 0;
+
+    // callbacks come back in send order, so the oldest in-flight frame to this peer is the one completed...
+    for (int i = 0; i < w->config.slots; i++) {
+        const espnow_window_slot_t *s = &w->slot[i];
+        if (!s->used || s->failed || memcmp(s->mac, mac, ESPNOW_WINDOW_MAC_LEN) != 0)
+            continue;
+        if (oldest < 0 || seq_before(s->seq, w->slot[oldest].seq))
+            oldest = i;
+    }
+    // ...unless a frame reclaimed as stale is older still: then this is its late callback
+    for (int i = 0; i < ESPNOW_WINDOW_MAX_ORPHANS; i++) {
+        const espnow_window_orphan_t *o = &w->orphan[i];
+        if (!o->used || now_us - o->reclaimed_us > w->config.orphan_timeout_us ||
+            memcmp(o->mac, mac, ESPNOW_WINDOW_MAC_LEN) != 0)
+            continue;
+        if (orphan < 0 || seq_before(o->seq, w->orphan[orphan].seq))
+            orphan = i;
+    }
+    if (orphan >= 0 && (oldest < 0 || seq_before(w->orphan[orphan].seq, w->slot[oldest].seq))) {
+        w->orphan[orphan].used = false;
+        w->stats.late_callbacks++;
+        orphans_prune(w, w->orphan[orphan].seq);
+        return ESPNOW_WINDOW_LATE;
+    }
+    if (oldest < 0)
+        return ESPNOW_WINDOW_UNMATCHED;
+
+    *slot = oldest;
+    *seq = w->slot[oldest].seq;
+    orphans_prune(w, *seq);
+    if (ok) {
+        w->slot[oldest].used = false;
+        return ESPNOW_WINDOW_ACKED;
+    }
+    w->slot[oldest].failed = true;
+    return ESPNOW_WINDOW_FAILED;
+}
+
+/* The failed slot named by a callback is still that frame's - it may have been reclaimed and reused since */
+static bool owned_by(const espnow_window_t *w, int slot, uint16_t seq)
+{
+    const espnow_window_slot_t *s = &w->slot[slot];
+    return s->used && s->failed && s->seq == seq;
+}
+
+espnow_window_retry_t espnow_window_retry(espnow_window_t *w, int slot, uint16_t seq, int64_t now_us)
+{
+    espnow_window_slot_t *s = &w->slot[slot];
+
+    if (!owned_by(w, slot, seq)) {
+        w->stats.stale_events++;
+        return ESPNOW_WINDOW_STALE;
+    }
+    if (s->retries >= w->config.max_retries) {
+        s->used = false;
+        w->stats.given_up++;
+        return ESPNOW_WINDOW_GIVE_UP;
+    }
+    s->retries++;
+    s->failed = false;
+    s->seq = w->seq++;          // keeps callback matching in actual send order
+    s->sent_us = now_us;        // not stale while it is resent
+    w->stats.retransmissions++;
+    return ESPNOW_WINDOW_RESEND;
+}
+
+bool espnow_window_drop_failed(espnow_window_t *w, int slot, uint16_t seq)
+{
+    if (!owned_by(w, slot, seq)) {
+        w->stats.stale_events++;
+        return false;
+    }
+    w->slot[slot].used = false;
+    return true;
+}
+
+/* Remember a frame reclaimed without its callback. False if every entry is still expected */
+static bool orphan_add(espnow_window_t *w, const espnow_window_slot_t *s, int64_t now_us)
+{
+    for (int i = 0; i < ESPNOW_WINDOW_MAX_ORPHANS; i++) {
+        espnow_window_orphan_t *o = &w->orphan[i];
+        if (o->used && now_us - o->reclaimed_us <= w->config.orphan_timeout_us)
+            continue;
+        o->used = true;
+        memcpy(o->mac, s->mac, ESPNOW_WINDOW_MAC_LEN);
+        o->seq = s->seq;
+        o->reclaimed_us = now_us;
+        return true;
+    }
+    return false;
+}
+
+int espnow_window_reclaim_stale(espnow_window_t *w, int64_t now_us)
+{
+    int reclaimed = 0;
+
+    for (int i = 0; i < w->config.slots; i++) {
+        espnow_window_slot_t *s = &w->slot[i];
+        if (!s->used || now_us - s->sent_us <= w->config.slot_timeout_us)
+            continue;
+        // a failed frame's callback already came, its pending event is told apart by seq. Without room
+        // to remember the frame its late callback would complete the next one: keep the slot for now
+        if (!s->failed && !orphan_add(w, s, now_us))
+            continue;
+        s->used = false;
+        reclaimed++;
+    }
+    w->stats.stale_reclaimed += reclaimed;
+    return reclaimed;
+}
+
+int espnow_window_in_flight(const espnow_window_t *w, const uint8_t *mac)
+{
+    int n = 0;
+
+    for (int i = 0; i < w->config.slots; i++)
+        n += w->slot[i].used && (mac == NULL || memcmp(w->slot[i].mac, mac, ESPNOW_WINDOW_MAC_LEN) == 0);
+    return n;
+}
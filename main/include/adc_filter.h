@@ -0,0 +1,68 @@
+#ifndef ADC_FILTER_H
+#define ADC_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Decimating fixed-point low-pass filter for raw ADC samples.
+ *
+ * Every sample goes through a cascade of single-pole IIR stages
+ *   y += (x - y) / 2^shift        (state in Q16, no floats, no division)
+ * and every `decimation` samples a window result is produced: the filtered
+ * value plus min / max / mean / RMS of the raw samples of that window.
+ * Pure C, no ESP-IDF dependency.
+ */
+
+#define ADC_FILTER_MAX_STAGES       4
+#define ADC_FILTER_FRAC_BITS        16
+
+typedef struct {
+    uint8_t     stages;         // IIR stages in cascade, 1..ADC_FILTER_MAX_STAGES
+    uint8_t     shift;          // alpha = 1 / 2^shift per stage, 1..12
+    uint16_t    decimation;     // raw samples per output window, >= 1
+} adc_filter_config_t;
+
+typedef struct {
+    uint16_t    filtered;       // low-pass output at the end of the window (raw units)
+    uint16_t    min;
+    uint16_t    max;
+    uint16_t    mean;
+    uint16_t    rms;
+    uint16_t    samples;
+} adc_filter_result_t;
+
+typedef struct {
+    adc_filter_config_t config;
+    int32_t     state[ADC_FILTER_MAX_STAGES];   // Q16
+    bool        primed;                         // first sample seeds the stages (no start-up ramp)
+
+    /* current window */
+    uint16_t    count;
+    uint16_t    min;
+    uint16_t    max;
+    uint32_t    sum;
+    uint64_t    sum_sq;
+} adc_filter_t;
+
+/**
+ * @brief Initialize a filter
+ *
+ * @return bool false if the configuration is out of range
+ */
+bool adc_filter_init(adc_filter_t *f, const adc_filter_config_t *config);
+
+/**
+ * @brief Restart from scratch (next sample re-seeds the filter)
+ */
+void adc_filter_reset(adc_filter_t *f);
+
+/**
+ * @brief Push one raw sample
+ *
+ * @param out Filled when a window completes
+ * @return bool true if out holds a new window result
+ */
+bool adc_filter_push(adc_filter_t *f, uint16_t raw, adc_filter_result_t *out);
+
+#endif /* ADC_FILTER_H */
@@ -6,13 +6,17 @@
 
 #include "driver/gpio.h"
 #include "leds.h"
-#include "cJSON.h"
 #include "driver/uart.h"
+#include "freertos/semphr.h"
+#include "json_writer.h"
+#include "stm_frame.h"
+#include "stm_json.h"
 
 /** Simulate POWER */
 #define GPIO_OUTPUT_PIN    GPIO_NUM_16
 
 #define UART_BUFFER_SIZE                1024
+#define UART_RX_CHUNK_SIZE              128     // bulk read size of rx_task
 
 #define TXD_PIN                         (GPIO_NUM_4)
 #define RXD_PIN                         (GPIO_NUM_5)
@@ -23,28 +27,14 @@
 
 #define MIN_DUTY_CYCLE_CHANGE           0.005
 
-// Helper macro to safely get JSON values
-#define SAFE_GET_DOUBLE(obj, key, dest, default_val) \
-    do { \
-        cJSON *item = cJSON_GetObjectItem(obj, key); \
-        if (item != NULL && cJSON_IsNumber(item)) { \
-            dest = item->valuedouble; \
-        } else { \
-            ESP_LOGW(TAG, "Missing or invalid JSON field: %s", key); \
-            dest = default_val; \
-        } \
-    } while(0)
-
-#define SAFE_GET_INT(obj, key, dest, default_val) \
-    do { \
-        cJSON *item = cJSON_GetObjectItem(obj, key); \
-        if (item != NULL && cJSON_IsNumber(item)) { \
-            dest = item->valueint; \
-        } else { \
-            ESP_LOGW(TAG, "Missing or invalid JSON field: %s", key); \
-            dest = default_val; \
-        } \
-    } while(0)
+/** STM32 command channel */
+#define STM_CMD_TASK_STACK_SIZE         4096
+#define STM_CMD_TASK_PRIORITY           4
+#define STM_CMD_BUFFER_SIZE             128     // longest compact command
+#define STM_CMD_ACK_TIMEOUT_MS          100     // wait for {"ack":seq} before retrying
+#define STM_CMD_MAX_RETRIES             2
+#define STM_CMD_DEDUP_MS                1000    // repeat of the last confirmed mode within this window is dropped
+#define STM_CMD_STATS_EVERY             50      // log the channel statistics every N commands
 
 typedef enum 
 {
@@ -56,19 +46,57 @@ typedef enum
     DC,
 } alertType_t;
 
+typedef struct {
+    uint32_t sent;          // commands written to the UART (retries included)
+    uint32_t acked;
+    uint32_t retries;
+    uint32_t timeouts;
+    uint32_t coalesced;     // pending mode replaced by a newer one before it was sent
+    uint32_t suppressed;    // repeat of the mode the STM32 already confirmed
+    uint32_t rtt_last_us;
+    uint32_t rtt_max_us;
+    uint32_t rtt_avg_us;    // moving average
+} stm_cmd_stats_t;
+
 /**
  * @brief Initialize the hardware
 */
 void TX_init_hw();
 
 /**
- * @brief Send switch ON command to the STM32
+ * @brief Switch the STM32 mode
+ *
+ * The local state (tx_status, LED strip) is updated immediately, the UART write is
+ * queued to the STM command task - the latest requested mode wins.
+ *
+ * @return esp_err_t ESP_OK if queued, ESP_FAIL if the command task is not running
 */
 esp_err_t write_STM_command(TX_status command);
 
 /**
- * @brief Send the ALERTS limits to the STM32
+ * @brief Queue the ALERTS limits for the STM32
 */
 esp_err_t write_STM_limits();
 
+/**
+ * @brief Probe the pad for a scooter with a dead RX battery
+ *
+ * PROBE for PROBE_PULSE_MS, then back OFF. If the TX current crosses
+ * PROBE_LOAD_CURRENT meanwhile the pad switches to LOCALIZATION and holds it
+ * for PROBE_HOLD_MS, so the RX can boot and broadcast.
+ *
+ * @return esp_err_t ESP_ERR_INVALID_STATE if the pad is not OFF
+*/
+esp_err_t STM_probe(void);
+
+/**
+ * @brief True while the pad keeps a probed scooter powered (broadcast OFF is ignored)
+*/
+bool STM_probe_holding(void);
+
+/**
+ * @brief Copy the STM command channel statistics
+*/
+void STM_get_command_stats(stm_cmd_stats_t *stats);
+
 #endif
\ No newline at end of file
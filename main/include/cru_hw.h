@@ -4,13 +4,25 @@
 #include "util.h"
 #include "peer.h"
 
-#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_continuous.h"
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
+#include "adc_filter.h"
+#include "threshold.h"
 
 #define FULLY_CHARGED_MIN_VOLTAGE       50
 #define FULLY_CHARGED_MAX_CURRENT       0.2
 
+/** ADC continuous (DMA) acquisition */
+#define ADC_SAMPLE_FREQ_HZ              20000   // total, shared by the two channels (ESP32 minimum is 20 kHz)
+#define ADC_CONV_FRAME_SIZE             1024    // bytes per DMA frame - one task wakeup per frame
+#define ADC_POOL_SIZE                   (ADC_CONV_FRAME_SIZE * 4)
+
+/** Per channel filter: 2 IIR stages, alpha 1/32, one result every 250 samples (40 Hz at 10 kHz per channel) */
+#define ADC_FILTER_STAGES               2
+#define ADC_FILTER_SHIFT                5
+#define ADC_FILTER_DECIMATION           250
+
 /**
  * @brief Init I2C bus and sensors
  * 
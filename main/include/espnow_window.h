@@ -0,0 +1,155 @@
+#ifndef ESPNOW_WINDOW_H
+#define ESPNOW_WINDOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Send window of the ESP-NOW unicast path (slots, sequence and orphans).
+ *
+ * A frame holds a slot from its send until its send callback reports it
+ * acked, or until it is given up after max_retries retransmissions. At most
+ * `slots` frames are in flight, and at most `peer_window` towards one peer.
+ * ESP-NOW calls back in send order, so a callback completes the oldest frame
+ * in flight towards its peer; the sequence number (local, wrapping) orders
+ * them, and is renewed on each retransmission so it follows the actual send
+ * order.
+ *
+ * A slot whose callback does not come back within slot_timeout_us is
+ * reclaimed and remembered as an orphan for orphan_timeout_us: if its late
+ * callback comes, it completes the orphan rather than a newer frame that may
+ * have reused the slot. A slot is only reclaimed while there is room for its
+ * orphan, so a long stall holds the window instead of forgetting frames.
+ * The callback of a frame sent after an orphan means the orphan's callback
+ * was lost: it is dropped then, before it can take a newer frame's callback.
+ * A failed slot is identified by (slot, seq), so an event handled after the
+ * slot was reclaimed and reused is recognised as stale.
+ *
+ * Not thread-safe: the caller holds its send lock around every call.
+ * Pure C, no ESP-IDF dependency.
+ */
+
+#define ESPNOW_WINDOW_MAX_SLOTS     8
+#define ESPNOW_WINDOW_MAX_ORPHANS   (2 * ESPNOW_WINDOW_MAX_SLOTS)
+#define ESPNOW_WINDOW_MAC_LEN       6
+
+typedef struct {
+    uint8_t     slots;              // global in-flight limit, 1 .. ESPNOW_WINDOW_MAX_SLOTS
+    uint8_t     peer_window;        // in-flight limit towards one peer
+    uint8_t     max_retries;        // retransmissions of one frame before giving up
+    int64_t     slot_timeout_us;    // slot reclaimed if its send callback never comes
+    int64_t     orphan_timeout_us;  // a reclaimed frame's late callback is no longer expected after this
+} espnow_window_config_t;
+
+typedef struct {
+    bool        used;
+    bool        failed;             // NACKed, waiting to be retransmitted or given up
+    uint8_t     mac[ESPNOW_WINDOW_MAC_LEN];
+    uint16_t    seq;
+    uint8_t     retries;
+    int64_t     sent_us;
+} espnow_window_slot_t;
+
+typedef struct {
+    bool        used;
+    uint8_t     mac[ESPNOW_WINDOW_MAC_LEN];
+    uint16_t    seq;
+    int64_t     reclaimed_us;
+} espnow_window_orphan_t;
+
+typedef struct {
+    uint32_t    retransmissions;    // failed frames sent again
+    uint32_t    given_up;           // frames dropped after max_retries
+    uint32_t    window_waits;       // acquires refused because the peer window (or every slot) was full
+    uint32_t    stale_reclaimed;    // slots reclaimed after slot_timeout_us
+    uint32_t    late_callbacks;     // callbacks of reclaimed frames, matched to them instead of a newer frame
+    uint32_t    lost_callbacks;     // reclaimed frames whose callback never came (a later frame's came first)
+    uint32_t    stale_events;       // failed-slot events whose slot was reclaimed before they were handled
+} espnow_window_stats_t;
+
+typedef struct {
+    espnow_window_config_t  config;
+    espnow_window_slot_t    slot[ESPNOW_WINDOW_MAX_SLOTS];
+    espnow_window_orphan_t  orphan[ESPNOW_WINDOW_MAX_ORPHANS];
+    uint16_t                seq;    // next sequence number
+    espnow_window_stats_t   stats;
+} espnow_window_t;
+
+/* What a send callback did to the window */
+typedef enum {
+    ESPNOW_WINDOW_UNMATCHED = 0,    // no frame in flight towards the peer
+    ESPNOW_WINDOW_LATE,             // late callback of a reclaimed frame, no slot touched
+    ESPNOW_WINDOW_ACKED,            // the slot was freed
+    ESPNOW_WINDOW_FAILED,           // the slot is kept for espnow_window_retry()
+} espnow_window_callback_t;
+
+/* What to do with a failed slot */
+typedef enum {
+    ESPNOW_WINDOW_STALE = 0,        // reclaimed (and maybe reused) since its callback, leave it alone
+    ESPNOW_WINDOW_RESEND,           // send the slot's frame again
+    ESPNOW_WINDOW_GIVE_UP,          // retries exhausted, the slot was freed
+} espnow_window_retry_t;
+
+/**
+ * @brief Empty the window
+ */
+void espnow_window_init(espnow_window_t *w, const espnow_window_config_t *config);
+
+/**
+ * @brief Take a slot towards mac, within the peer window
+ *
+ * @return int Slot index, -1 if every slot or the peer window is full
+ */
+int espnow_window_acquire(espnow_window_t *w, const uint8_t *mac, int64_t now_us);
+
+/**
+ * @brief The frame of a slot was (re)sent now
+ */
+void espnow_window_sent(espnow_window_t *w, int slot, int64_t now_us);
+
+/**
+ * @brief Free a slot whose frame could not be handed to the radio
+ */
+void espnow_window_release(espnow_window_t *w, int slot);
+
+/**
+ * @brief Match a send callback to the oldest frame in flight towards mac
+ *
+ * @param ok Acked (a broadcast, which has no ack, counts as acked)
+ * @param[out] slot Slot completed or failed, -1 otherwise
+ * @param[out] seq Its sequence number, to pass to espnow_window_retry()
+ */
+espnow_window_callback_t espnow_window_callback(espnow_window_t *w, const uint8_t *mac, bool ok, int64_t now_us,
+                                                int *slot, uint16_t *seq);
+
+/**
+ * @brief Retransmit or give up a failed slot
+ *
+ * A resend renews the slot's sequence number and send time.
+ *
+ * @param seq Sequence number the callback reported for the slot
+ */
+espnow_window_retry_t espnow_window_retry(espnow_window_t *w, int slot, uint16_t seq, int64_t now_us);
+
+/**
+ * @brief Free a failed slot that will not be retransmitted
+ *
+ * @return bool false if the slot was reclaimed since its callback (nothing freed)
+ */
+bool espnow_window_drop_failed(espnow_window_t *w, int slot, uint16_t seq);
+
+/**
+ * @brief Reclaim the slots whose callback never came back, or whose failure was never handled
+ *
+ * A slot waiting for its callback stays taken while the orphan table is full of callbacks still expected.
+ *
+ * @return int Slots freed
+ */
+int espnow_window_reclaim_stale(espnow_window_t *w, int64_t now_us);
+
+/**
+ * @brief Frames in flight, towards mac or in total (mac NULL)
+ */
+int espnow_window_in_flight(const espnow_window_t *w, const uint8_t *mac);
+
+#endif /* ESPNOW_WINDOW_H */
@@ -0,0 +1,65 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Streaming JSON writer - formats straight into a caller-owned buffer.
+ * No heap allocation (newlib's printf("%f") allocates through dtoa, so floats
+ * use a fixed-point formatter). On overflow the writer stops writing and
+ * json_writer_finish() returns NULL.
+ */
+
+#define JSON_WRITER_MAX_DEPTH       16
+
+typedef struct {
+    char        *buf;
+    size_t      cap;
+    size_t      len;
+    bool        overflow;
+    uint8_t     depth;
+    uint16_t    has_items;      // bit n: container at depth n already holds an item (needs a comma)
+} json_writer_t;
+
+/**
+ * @brief Start writing into buf (the output is always NUL terminated)
+ */
+void json_writer_init(json_writer_t *jw, char *buf, size_t cap);
+
+/**
+ * @brief Open an object / array. key is NULL at top level and inside arrays
+ */
+void json_writer_object_begin(json_writer_t *jw, const char *key);
+void json_writer_object_end(json_writer_t *jw);
+void json_writer_array_begin(json_writer_t *jw, const char *key);
+void json_writer_array_end(json_writer_t *jw);
+
+/**
+ * @brief Add a member (key != NULL) or an array element (key == NULL)
+ */
+void json_writer_uint(json_writer_t *jw, const char *key, uint32_t value);
+void json_writer_int(json_writer_t *jw, const char *key, int32_t value);
+void json_writer_bool(json_writer_t *jw, const char *key, bool value);
+void json_writer_string(json_writer_t *jw, const char *key, const char *value);
+void json_writer_null(json_writer_t *jw, const char *key);
+
+/**
+ * @brief Add a float with a fixed number of decimals (max 6), NaN/Inf are written as null
+ */
+void json_writer_float(json_writer_t *jw, const char *key, float value, uint8_t decimals);
+
+/**
+ * @brief Add a MAC address as "AA:BB:CC:DD:EE:FF"
+ */
+void json_writer_mac(json_writer_t *jw, const char *key, const uint8_t *mac);
+
+/**
+ * @brief Finish the document
+ *
+ * @return const char* The JSON string (inside the caller buffer), NULL if it did not fit
+ */
+const char *json_writer_finish(json_writer_t *jw);
+
+#endif /* JSON_WRITER_H */
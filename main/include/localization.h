@@ -0,0 +1,129 @@
+#ifndef LOCALIZATION_H
+#define LOCALIZATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Parallel localization scheduler (root only).
+ *
+ * Instead of energizing one pad per step, the free pads are split into groups
+ * of mutually non-adjacent pads and a whole group is switched to LOCALIZATION
+ * at once. A scooter can only couple with one pad of a group, but every
+ * energized pad hears its ESP-NOW broadcast, so each of them sends a claim
+ * with the RSSI it measured and the root keeps the strongest one. Claims that
+ * are too close to call are retried with the candidate pads energized alone.
+ *
+ * The same claim table also collects RSSI reports from the pads that are not
+ * energized: when they rank one pad clearly ahead for an RX, that pad is tried
+ * alone before any sweep.
+ * Pure C, no ESP-IDF dependency.
+ */
+
+#define LOCALIZATION_MAX_PADS           64      // candidate pads considered per sweep
+#define LOCALIZATION_MAX_CLAIMS         48      // claims kept per claim window (the weakest is evicted when full)
+
+/* Explicitly adjacent pad positions (in addition to the distance rule) */
+typedef struct {
+    int8_t a;
+    int8_t b;
+} loc_adjacency_t;
+
+typedef struct {
+    uint8_t                 distance;       // positions with |a - b| <= distance are adjacent, 0 = explicit pairs only
+    const loc_adjacency_t   *pairs;
+    size_t                  pair_count;
+    uint8_t                 group_max;      // pads energized together, >= 1
+    uint8_t                 rssi_margin;    // dB the best claim must lead the second one by
+} loc_config_t;
+
+typedef struct {
+    loc_config_t    config;
+    uint8_t         next_group;                         // round robin over the groups of the sweep
+    int8_t          retry[LOCALIZATION_MAX_PADS];       // pads to energize alone (ambiguous claims)
+    uint8_t         retry_count;
+} loc_scheduler_t;
+
+typedef struct {
+    uint8_t rx_mac[6];
+    int8_t  position;       // pad that heard the broadcast
+    int8_t  rssi;
+} loc_claim_t;
+
+typedef struct {
+    loc_claim_t claims[LOCALIZATION_MAX_CLAIMS];
+    uint8_t     count;
+    uint32_t    dropped;    // weakest claims evicted because the table was full
+} loc_claims_t;
+
+typedef struct {
+    uint8_t rx_mac[6];
+    int8_t  position;
+} loc_assignment_t;
+
+/**
+ * @brief Initialize the scheduler
+ */
+void loc_scheduler_init(loc_scheduler_t *s, const loc_config_t *config);
+
+/**
+ * @brief True if the two pad positions may couple with the same scooter
+ */
+bool loc_adjacent(const loc_config_t *config, int8_t a, int8_t b);
+
+/**
+ * @brief Pick the pads to energize in the next step
+ *
+ * Pending retries go first, one pad at a time. Otherwise the candidates are
+ * greedily split into non-adjacent groups (in position order) and the groups
+ * are served round robin.
+ *
+ * @param candidates Positions of the pads free for localization
+ * @param count Number of candidates
+ * @param group Output positions, at least config.group_max entries
+ * @return uint8_t Pads in the group, 0 if there is no candidate
+ */
+uint8_t loc_next_group(loc_scheduler_t *s, const int8_t *candidates, uint8_t count, int8_t *group);
+
+/**
+ * @brief Start a new claim window
+ */
+void loc_claims_reset(loc_claims_t *c);
+
+/**
+ * @brief Record a claim (the strongest RSSI is kept for a repeated RX/pad pair)
+ *
+ * @return bool false if the table is full and the claim is weaker than all the others
+ */
+bool loc_claims_add(loc_claims_t *c, const uint8_t *rx_mac, int8_t position, int8_t rssi);
+
+/**
+ * @brief Drop every claim of an RX
+ */
+void loc_claims_forget(loc_claims_t *c, const uint8_t *rx_mac);
+
+/**
+ * @brief Most likely pad for an RX, from the RSSI reports
+ *
+ * Only pads among the candidates are ranked. An RX qualifies if its best pad
+ * leads the next one by rssi_margin (or is the only pad that heard it); among
+ * those, the RX with the largest lead is returned.
+ *
+ * @return bool false if no RX is ranked with enough confidence
+ */
+bool loc_claims_rank(const loc_claims_t *c, const int8_t *candidates, uint8_t count,
+                     uint8_t rssi_margin, loc_assignment_t *hint);
+
+/**
+ * @brief Turn the claims of a window into RX -> pad assignments
+ *
+ * Each RX gets the pad with the strongest RSSI if it leads the next pad by
+ * rssi_margin, and a pad gets at most one RX. The pads of an ambiguous RX are
+ * queued in the scheduler to be energized alone.
+ *
+ * @return uint8_t Number of assignments written
+ */
+uint8_t loc_claims_resolve(const loc_claims_t *c, loc_scheduler_t *s, loc_assignment_t *out, uint8_t max_out);
+
+#endif /* LOCALIZATION_H */
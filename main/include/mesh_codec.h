@@ -0,0 +1,143 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include "util.h"
+#include "peer.h"
+
+/*
+ * Versioned binary encoding of the mesh-lite raw payloads (dynamic, alert).
+ *
+ * Frame layout (little-endian):
+ *   [0]     version         major << 4 | minor, MESH_CODEC_VERSION
+ *   [1]     kind            mesh_codec_kind_t
+ *   [2..3]  field mask      bit n set = field n of the schema is present
+ *   [4..9]  TX MAC          key of the peer, always present
+ *   [10]    seq             frame sequence number, per sender and kind
+ *   [11]    base            seq of the frame a delta applies on, == seq for a full frame
+ *   [...]   present fields, in schema order
+ *
+ * Floats travel as int16 fixed point (value * scale). Fields are only ever
+ * appended to a schema (minor bump), so a decoder stops after the fields it
+ * knows and ignores the tail written by newer firmware. Anything else that
+ * changes the layout bumps the major, and frames of another major are
+ * rejected.
+ *
+ * A delta is only applied on the frame it was computed against: the root
+ * rejects a delta whose base is not the last frame it applied from that TX
+ * and answers MESH_CODEC_ACK_RESYNC, so the child sends the next frame in full.
+ */
+
+#define MESH_CODEC_VERSION_MAJOR        1       // header layout
+#define MESH_CODEC_VERSION_MINOR        0       // schema appends
+#define MESH_CODEC_VERSION              ((MESH_CODEC_VERSION_MAJOR << 4) | MESH_CODEC_VERSION_MINOR)
+#define MESH_CODEC_MAJOR(version)       ((uint8_t)(version) >> 4)
+#define MESH_CODEC_LEGACY_VERSION       1       // raw C structs (major 0, like the pre-split binary version 2)
+#define MESH_CODEC_HEADER_LEN           12
+#define MESH_CODEC_FULL_INTERVAL        8       // every Nth dynamic frame is sent in full (delta resync)
+
+/* One byte answer of the root to a binary dynamic frame */
+#define MESH_CODEC_ACK_OK               0
+#define MESH_CODEC_ACK_RESYNC           1       // delta base not seen, send the next frame in full
+
+typedef enum {
+    MESH_CODEC_KIND_DYNAMIC = 1,
+    MESH_CODEC_KIND_ALERT   = 2,
+} mesh_codec_kind_t;
+
+/* Schemas: X(name, type, member, scale) - append only! */
+#define MESH_DYNAMIC_SCHEMA(X)                      \
+    X(TX_ID,        U8,     TX.id,          1)      \
+    X(TX_STATUS,    U8,     TX.tx_status,   1)      \
+    X(TX_VOLTAGE,   FIX16,  TX.voltage,     100)    \
+    X(TX_CURRENT,   FIX16,  TX.current,     1000)   \
+    X(TX_TEMP1,     FIX16,  TX.temp1,       100)    \
+    X(TX_TEMP2,     FIX16,  TX.temp2,       100)    \
+    X(RX_MAC,       MAC,    RX.macAddr,     1)      \
+    X(RX_ID,        U8,     RX.id,          1)      \
+    X(RX_STATUS,    U8,     RX.rx_status,   1)      \
+    X(RX_VOLTAGE,   FIX16,  RX.voltage,     100)    \
+    X(RX_CURRENT,   FIX16,  RX.current,     1000)   \
+    X(RX_TEMP1,     FIX16,  RX.temp1,       100)    \
+    X(RX_TEMP2,     FIX16,  RX.temp2,       100)
+
+#define MESH_ALERT_SCHEMA(X)                        \
+    X(TX_ID,        U8,     TX.id,          1)      \
+    X(TX_FLAGS,     U8,     TX.TX_all_flags, 1)     \
+    X(RX_MAC,       MAC,    RX.macAddr,     1)      \
+    X(RX_ID,        U8,     RX.id,          1)      \
+    X(RX_FLAGS,     U8,     RX.RX_all_flags, 1)
+
+/* Decoder counters */
+typedef struct {
+    uint32_t bad_major;                 // frames of an unknown major version
+    uint32_t bad_kind;                  // frames of another kind than expected
+    uint32_t truncated;                 // frames shorter than their header or field mask
+    uint32_t out_of_sync;               // deltas rejected because their base was not applied
+    uint32_t duplicates;                // frames already applied (mesh-lite retries), ignored
+} mesh_codec_stats_t;
+
+/* Encoded size of each field type */
+#define MESH_CODEC_SIZE_U8              1
+#define MESH_CODEC_SIZE_FIX16           2
+#define MESH_CODEC_SIZE_MAC             ETH_HWADDR_LEN
+
+#define MESH_CODEC_FIELD_SIZE(name, type, member, scale)    + MESH_CODEC_SIZE_##type
+
+#define MESH_CODEC_DYNAMIC_MAX_LEN      (MESH_CODEC_HEADER_LEN MESH_DYNAMIC_SCHEMA(MESH_CODEC_FIELD_SIZE))
+#define MESH_CODEC_ALERT_MAX_LEN        (MESH_CODEC_HEADER_LEN MESH_ALERT_SCHEMA(MESH_CODEC_FIELD_SIZE))
+
+/**
+ * @brief Encode a dynamic payload
+ *
+ * @param cur Payload to send
+ * @param prev Payload of the previous frame (seq - 1), only changed fields are encoded. NULL for a full frame
+ * @param seq Sequence number of this frame
+ * @param buf Output buffer, at least MESH_CODEC_DYNAMIC_MAX_LEN bytes
+ * @param buf_len Output buffer size
+ * @return size_t Encoded length, 0 on error
+ */
+size_t mesh_codec_encode_dynamic(const mesh_dynamic_payload_t *cur, const mesh_dynamic_payload_t *prev,
+                                 uint8_t seq, uint8_t *buf, size_t buf_len);
+
+/**
+ * @brief Encode an alert payload (always a full frame)
+ *
+ * @return size_t Encoded length, 0 on error
+ */
+size_t mesh_codec_encode_alert(const mesh_alert_payload_t *cur, uint8_t seq, uint8_t *buf, size_t buf_len);
+
+/**
+ * @brief Validate a frame header and return the TX MAC it is keyed on
+ *
+ * @param buf Received frame
+ * @param len Frame length
+ * @param kind Expected kind
+ * @return const uint8_t* TX MAC inside buf, NULL if the frame is not acceptable
+ */
+const uint8_t *mesh_codec_frame_key(const uint8_t *buf, size_t len, mesh_codec_kind_t kind);
+
+/**
+ * @brief Apply the fields present in a dynamic frame on top of dst
+ *
+ * @param rx Sequence state of the sender's stream, updated. NULL applies the frame unchecked
+ * @return esp_err_t ESP_OK (also for a duplicate delta, left unapplied), ESP_ERR_INVALID_STATE if a delta's
+ *         base was not applied (dst untouched, ask for a full frame), ESP_ERR_INVALID_SIZE if truncated,
+ *         ESP_ERR_INVALID_VERSION / ESP_ERR_INVALID_ARG on bad header
+ */
+esp_err_t mesh_codec_decode_dynamic(const uint8_t *buf, size_t len, mesh_dynamic_payload_t *dst, mesh_codec_rx_t *rx);
+
+/**
+ * @brief Apply the fields present in an alert frame on top of dst
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t mesh_codec_decode_alert(const uint8_t *buf, size_t len, mesh_alert_payload_t *dst);
+
+/**
+ * @brief Get the decoder counters
+ *
+ * @param stats Output counters
+ */
+void mesh_codec_get_stats(mesh_codec_stats_t *stats);
+
+#endif /* MESH_CODEC_H */
@@ -4,6 +4,9 @@
 #include "util.h"
 #include "peer.h"
 #include "cJSON.h"
+#include "json_writer.h"
+#include "msgpack_writer.h"
+#include "telemetry_log.h"
 #include "wifiMesh.h"
 #include "ota_manager.h"
 
@@ -17,6 +20,27 @@
 #define MQTT_MIN_PUBLISH_INTERVAL_MS    30000                // 30s
 #define MQTT_RECONNECT_INTERVAL_MS      10000                // 20s
 
+/* Dynamic upload mode */
+/* Opt-in: the Node-RED dashboard flow only subscribes to bumblebee/+/dynamic, Telegraf reads both */
+#define MQTT_DYNAMIC_BATCH_MODE         0                    // 1: one bumblebee/<root>/dynamic_batch message per tick, 0: per-peer bumblebee/<id>/dynamic topics
+#define MQTT_BATCH_MAX_PEERS            10                   // peers per batch message (keeps it within the 4 kB out buffer)
+
+/* Payload encoding of the dynamic / alert topics */
+#define MQTT_ENCODING_JSON              0                    // bumblebee/<id>/dynamic
+#define MQTT_ENCODING_MSGPACK           1                    // bumblebee/<id>/dynamic/msgpack (metered backhaul)
+#define MQTT_PAYLOAD_ENCODING           MQTT_ENCODING_JSON
+
+/* Store-and-forward of dynamic samples while the broker is unreachable (root) */
+#define MQTT_TELEMETRY_PARTITION        "telemetry"          // data partition of the log (partitions.csv)
+#define MQTT_REPLAY_RECORDS_PER_TICK    12                   // replay rate limit: records per message (fits the buffer), one message per second
+#define MQTT_TELEMETRY_STATS_INTERVAL_MS 10000               // bumblebee/<root>/telemetry_log while a backlog exists
+#define MQTT_REPLAY_CLOCK_WAIT_MS       60000                // replay holds records of earlier boots this long after connecting, until SNTP sets the clock
+#define MQTT_SNTP_SERVER                "pool.ntp.org"       // wall clock of the stored samples (ROOT)
+#define MQTT_CLOCK_VALID_AFTER_S        1704067200           // 2024-01-01: an earlier clock was never set
+
+#define MQTT_PAYLOAD_BUFFER_SIZE        4096                 // largest message (a full batch)
+#define MQTT_JSON_FLOAT_DECIMALS        3                    // fixed float precision (mA / mV / m°C resolution)
+
 /**
  * @brief Initialize MQTT client and start publishing task (root node only)
  * 
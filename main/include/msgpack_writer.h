@@ -0,0 +1,56 @@
+#ifndef MSGPACK_WRITER_H
+#define MSGPACK_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Minimal MessagePack writer - encodes straight into a caller-owned buffer,
+ * no heap allocation. Maps and arrays take their element count up front
+ * (a map of n pairs is followed by n key/value writes). On overflow the
+ * writer stops writing and msgpack_writer_finish() returns NULL.
+ */
+
+typedef struct {
+    uint8_t     *buf;
+    size_t      cap;
+    size_t      len;
+    bool        overflow;
+} msgpack_writer_t;
+
+/**
+ * @brief Start writing into buf
+ */
+void msgpack_writer_init(msgpack_writer_t *mp, uint8_t *buf, size_t cap);
+
+/**
+ * @brief Container headers (count = number of key/value pairs / elements that follow)
+ */
+void msgpack_writer_map(msgpack_writer_t *mp, uint32_t count);
+void msgpack_writer_array(msgpack_writer_t *mp, uint32_t count);
+
+/**
+ * @brief Scalars, using the smallest encoding for the value
+ */
+void msgpack_writer_uint(msgpack_writer_t *mp, uint32_t value);
+void msgpack_writer_int(msgpack_writer_t *mp, int32_t value);
+void msgpack_writer_float(msgpack_writer_t *mp, float value);
+void msgpack_writer_bool(msgpack_writer_t *mp, bool value);
+void msgpack_writer_nil(msgpack_writer_t *mp);
+void msgpack_writer_str(msgpack_writer_t *mp, const char *value);
+
+/**
+ * @brief MAC address as "AA:BB:CC:DD:EE:FF" (same text as the JSON encoding)
+ */
+void msgpack_writer_mac(msgpack_writer_t *mp, const uint8_t *mac);
+
+/**
+ * @brief Finish the document
+ *
+ * @param[out] len Encoded length
+ * @return const uint8_t* Encoded data (inside the caller buffer), NULL if it did not fit
+ */
+const uint8_t *msgpack_writer_finish(msgpack_writer_t *mp, size_t *len);
+
+#endif /* MSGPACK_WRITER_H */
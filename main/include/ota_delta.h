@@ -0,0 +1,92 @@
+#ifndef OTA_DELTA_H
+#define OTA_DELTA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Streaming decoder of the delta OTA patch format (generated by ota_delta.py).
+ *
+ * A patch rebuilds the new image from the image of the running partition:
+ * a header identifying both images, then a list of operations applied in
+ * order to produce the new image front to back.
+ *
+ *   header  "BBD1", format version, header length, source size + SHA256,
+ *           target size + SHA256, target firmware version
+ *   COPY    source offset, length - bytes taken from the running image
+ *   INSERT  length, then the bytes - new bytes carried by the patch
+ *   END     the target is complete, nothing may follow
+ *
+ * All integers are little endian. The patch is fed in arbitrary pieces as it
+ * arrives from the network; the output goes to callbacks, so neither image
+ * has to fit in RAM.
+ * Pure C, no ESP-IDF dependency.
+ */
+
+#define OTA_DELTA_MAGIC             "BBD1"
+#define OTA_DELTA_FORMAT_VERSION    1
+#define OTA_DELTA_HEADER_LEN        112
+#define OTA_DELTA_OP_LEN            9       // opcode + 2 x uint32
+
+typedef enum {
+    OTA_DELTA_OP_END = 0,
+    OTA_DELTA_OP_COPY = 1,          // arg = source offset, len = bytes
+    OTA_DELTA_OP_INSERT = 2,        // arg = 0, len = bytes that follow
+} ota_delta_op_t;
+
+typedef struct {
+    uint32_t    source_size;
+    uint8_t     source_sha256[32];  // image the patch applies to
+    uint32_t    target_size;
+    uint8_t     target_sha256[32];  // image it produces
+    char        target_version[33];
+} ota_delta_header_t;
+
+typedef enum {
+    OTA_DELTA_MORE = 0,             // fed bytes consumed, the patch continues
+    OTA_DELTA_DONE,                 // END reached with the whole target written
+    OTA_DELTA_ERR_FORMAT,           // bad magic / version / opcode, bytes after END
+    OTA_DELTA_ERR_RANGE,            // copy outside the source or output beyond the target size
+    OTA_DELTA_ERR_REJECTED,         // the header callback refused the patch
+    OTA_DELTA_ERR_IO,               // a write or copy callback failed
+} ota_delta_status_t;
+
+/* Output of the decoder - each callback returns false to abort */
+typedef struct {
+    bool (*header)(void *ctx, const ota_delta_header_t *header);
+    bool (*write)(void *ctx, const uint8_t *data, uint32_t len);
+    bool (*copy)(void *ctx, uint32_t source_offset, uint32_t len);
+} ota_delta_io_t;
+
+typedef struct {
+    ota_delta_io_t      io;
+    void                *ctx;
+    ota_delta_header_t  header;
+    ota_delta_status_t  status;         // sticky once not MORE
+    uint8_t             buf[OTA_DELTA_HEADER_LEN];   // header or op being assembled
+    uint32_t            buf_len;
+    bool                header_done;
+    uint32_t            insert_left;    // INSERT bytes still to pass through
+    uint32_t            out;            // target bytes produced
+    uint32_t            copied;         // of which taken from the source
+} ota_delta_t;
+
+/**
+ * @brief Start decoding a patch
+ */
+void ota_delta_init(ota_delta_t *d, const ota_delta_io_t *io, void *ctx);
+
+/**
+ * @brief Decode the next bytes of the patch
+ *
+ * @return ota_delta_status_t MORE until END, then DONE; errors are final
+ */
+ota_delta_status_t ota_delta_feed(ota_delta_t *d, const uint8_t *data, size_t len);
+
+/**
+ * @brief True once the patch ended and produced the whole target
+ */
+bool ota_delta_done(const ota_delta_t *d);
+
+#endif /* OTA_DELTA_H */
@@ -8,6 +8,9 @@
  * Features:
  * - HTTPS download with TLS (reuses MQTT CA certificate)
  * - SHA256 integrity verification
+ * - Resumable download (HTTP Range + progress checkpoint in NVS)
+ * - Pipelined download: network reads overlap the flash writes
+ * - Delta updates: patch against the running image, full image as fallback
  * - Progress reporting
  * - Automatic rollback support
  * - Non-blocking download task
@@ -27,6 +30,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 
 #include "esp_log.h"
 #include "esp_ota_ops.h"
@@ -34,9 +38,12 @@
 #include "esp_https_ota.h"
 #include "esp_app_format.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "mbedtls/sha256.h"
+#include "nvs.h"
 
 #include "util.h"
+#include "ota_delta.h"
 
 // ============================================================================
 // CONFIGURATION
@@ -55,6 +62,19 @@
 /** Download buffer size (bytes) */
 #define OTA_BUF_SIZE            4096
 
+/** Download buffers (>= 2): the HTTP reader fills one while the writer task flashes the others */
+#define OTA_PIPELINE_BUFFERS    2
+
+/** Flash writer task */
+#define OTA_WRITER_STACK_SIZE   4096
+#define OTA_WRITER_PRIORITY     5
+
+/** Delta updates: ask for a patch against the running version before the full image */
+#define OTA_DELTA_ENABLED       1
+
+/** Patches are served as <prefix><running version>.patch (generated by ota_delta.py) */
+#define OTA_PATCH_URL_PREFIX    "http://15.188.29.195:8080/ota/patch/"
+
 /** HTTP timeout (milliseconds) */
 #define OTA_HTTP_TIMEOUT_MS     60000
 
@@ -64,6 +84,20 @@
 /** SHA256 hash length in hex characters */
 #define OTA_SHA256_HEX_LEN      64
 
+/** Download attempts per update - each one resumes where the previous stopped */
+#define OTA_MAX_ATTEMPTS        8
+
+/** Delay before the first retry (milliseconds), doubled at each attempt */
+#define OTA_RETRY_DELAY_MS      2000
+#define OTA_RETRY_DELAY_MAX_MS  30000
+
+/** Progress checkpoint saved to NVS every N bytes written (bounds NVS wear) */
+#define OTA_CHECKPOINT_BYTES    (64 * 1024)
+
+/** NVS namespace / key of the progress checkpoint */
+#define OTA_NVS_NAMESPACE       "ota"
+#define OTA_NVS_CHECKPOINT_KEY  "ckpt"
+
 // ============================================================================
 // STATUS & PROGRESS
 // ============================================================================
@@ -96,9 +130,26 @@ typedef enum {
     OTA_ERR_PARTITION,             /**< Partition error */
     OTA_ERR_IMAGE_INVALID,         /**< Invalid firmware image */
     OTA_ERR_NO_MEMORY,             /**< Memory allocation failed */
-    OTA_ERR_TIMEOUT                /**< Operation timeout */
+    OTA_ERR_TIMEOUT,               /**< Operation timeout */
+    OTA_ERR_PATCH_INVALID          /**< Delta patch unusable (the full image is downloaded instead) */
 } ota_error_t;
 
+/**
+ * @brief Time spent by each stage of the download pipeline (milliseconds)
+ * 
+ * The reader and the writer run concurrently: with the overlap working,
+ * elapsed_ms is close to the larger of network_ms and flash_ms + hash_ms,
+ * and the wait of one side shows which stage is the bottleneck.
+ */
+typedef struct {
+    uint32_t network_ms;           /**< Reader: esp_http_client_read */
+    uint32_t network_wait_ms;      /**< Reader: waiting for a free buffer (flash bound) */
+    uint32_t flash_ms;             /**< Writer: esp_ota_write (erase + program) */
+    uint32_t hash_ms;              /**< Writer: SHA256 update */
+    uint32_t flash_wait_ms;        /**< Writer: waiting for data (network bound) */
+    uint32_t elapsed_ms;           /**< Since the update started */
+} ota_timing_t;
+
 /**
  * @brief OTA progress information
  */
@@ -108,7 +159,11 @@ typedef struct {
     uint32_t bytes_downloaded;     /**< Bytes downloaded so far */
     uint32_t total_bytes;          /**< Total firmware size (0 if unknown) */
     uint8_t progress_percent;      /**< Download progress (0-100) */
+    uint32_t resumed_from;         /**< Offset the last attempt resumed from (0 = full download) */
+    uint8_t attempts;              /**< HTTP requests made for this update */
+    bool delta;                    /**< Downloading a delta patch (bytes count patch bytes) */
     char version[32];              /**< New firmware version (if available) */
+    ota_timing_t timing;           /**< Download pipeline stage times */
 } ota_progress_t;
 
 /**
@@ -116,6 +171,15 @@ typedef struct {
  */
 typedef void (*ota_completion_cb_t)(bool success, ota_error_t error);
 
+/**
+ * @brief Image written by the last successful update (boot partition set, not running yet)
+ */
+typedef struct {
+    const esp_partition_t *partition;  /**< Update partition holding the image */
+    uint32_t size;                     /**< Image bytes */
+    uint8_t sha256[32];                /**< SHA256 of the image bytes */
+} ota_staged_image_t;
+
 // ============================================================================
 // PUBLIC API
 // ============================================================================
@@ -136,6 +200,15 @@ esp_err_t ota_manager_init(void);
  * Begins non-blocking firmware download and update process.
  * Progress can be monitored via ota_get_progress().
  * 
+ * When the expected SHA256 is given, a patch against the running version is
+ * tried first (OTA_PATCH_URL_PREFIX); without one, or if it does not apply to
+ * the running image, the full image is downloaded.
+ * 
+ * A download interrupted by a network error is retried with an HTTP Range
+ * request from the last byte written. The progress (bytes written, running
+ * SHA256 state) is also checkpointed in NVS, so a later ota_start_update()
+ * for the same SHA256 - even after a reboot - continues where it stopped.
+ * 
  * @param expected_sha256 Expected SHA256 hash (64 hex chars), or NULL to skip verification
  * @return ESP_OK if update started, ESP_ERR_INVALID_STATE if already running
  */
@@ -177,6 +250,25 @@ esp_err_t ota_mark_valid(void);
  */
 void ota_register_completion_callback(ota_completion_cb_t callback);
 
+/**
+ * @brief Keep a successful update staged instead of rebooting into it
+ * 
+ * Used by the mesh relay: the root serves the staged image to the mesh
+ * first and the rollout boots it. The boot partition is not set while the
+ * hold is on.
+ * 
+ * @param hold true to skip the automatic reboot
+ */
+void ota_set_reboot_hold(bool hold);
+
+/**
+ * @brief Get the image of the last successful update
+ * 
+ * @param[out] image Staged image
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if no update completed since boot
+ */
+esp_err_t ota_get_staged_image(ota_staged_image_t *image);
+
 /**
  * @brief Get string representation of OTA status
  * 
@@ -229,6 +321,7 @@ typedef struct {
 │  3. ESP32 OTA Manager                                           │
 │     └─> Receive MQTT trigger                                   │
 │         └─> Download: GET /ota/firmware.bin                     │
+│             └─> Retry / resume: Range: bytes=<written>-         │
 │             └─> Auth: Basic admin:bumblebee2025               │
 │                 └─> Verify SHA256                              │
 │                     └─> Flash & Reboot                         │
@@ -0,0 +1,191 @@
+/**
+ * @file ota_mesh.h
+ * @brief Mesh-wide distribution of an OTA image
+ *
+ * The root downloads the image once (ota_manager) and keeps it staged instead
+ * of rebooting. It offers the image to its children over mesh-lite raw
+ * messages and broadcasts it in chunks, each carrying its own SHA256, with
+ * the sliding-window flow control of ota_relay. A child writes the chunks to
+ * its update partition, verifies the SHA256 of the whole image, then serves
+ * that partition to its own children the same way. The image crosses the
+ * uplink once and every hop once, whatever the size of the mesh.
+ *
+ * A node only stages the image: once it verified it and served its children,
+ * it keeps running the old firmware until the root activates it. The root
+ * drives the activation with ota_rollout - canary nodes first, then a few
+ * nodes at a time, halting on failures - by broadcasting a beacon listing
+ * the nodes to activate, which every node answers with its state. Progress is
+ * published on bumblebee/<id>/ota/rollout. The root reboots last, once the
+ * rollout is complete; a halted rollout leaves it and the other staged nodes
+ * on the old firmware.
+ */
+
+#ifndef OTA_MESH_H
+#define OTA_MESH_H
+
+#include <stddef.h>
+
+#include "util.h"
+#include "ota_manager.h"
+#include "ota_relay.h"
+#include "ota_rollout.h"
+
+// ============================================================================
+// CONFIGURATION
+// ============================================================================
+
+/** Image bytes per chunk message (header + chunk must fit one mesh-lite frame) */
+#define OTA_MESH_CHUNK_SIZE         1024
+
+/** Chunks in flight per hop - also the depth of the child write queue */
+#define OTA_MESH_WINDOW             8
+
+/** Chunks written to flash per progress ack */
+#define OTA_MESH_ACK_EVERY          4
+
+/** No progress for this long: the parent resends from the slowest child (milliseconds) */
+#define OTA_MESH_RTO_MS             400
+
+/** A child silent for this long is dropped from the session (milliseconds) */
+#define OTA_MESH_CHILD_TIMEOUT_MS   15000
+
+/** Offer period while serving (milliseconds) */
+#define OTA_MESH_OFFER_PERIOD_MS    500
+
+/** Offers sent before the first chunk, so the children can join (milliseconds) */
+#define OTA_MESH_JOIN_WINDOW_MS     3000
+
+/** A receiving child gives up if no chunk arrives for this long (milliseconds) */
+#define OTA_MESH_RX_TIMEOUT_MS      30000
+
+/** Nodes activated first, alone (0 = no canary) - default of the MQTT "canary" field */
+#define OTA_MESH_CANARY_NODES       1
+
+/** Nodes rebooting into the new firmware at once after the canary - "concurrent" field */
+#define OTA_MESH_CONCURRENT         2
+
+/** Failed nodes tolerated before the rollout halts - "max_failures" field */
+#define OTA_MESH_MAX_FAILURES       0
+
+/** Canaries run the new firmware this long before the other nodes start (milliseconds) */
+#define OTA_MESH_CANARY_SOAK_MS     60000
+
+/** An activated node must report the new firmware within this time (milliseconds) */
+#define OTA_MESH_CONFIRM_TIMEOUT_MS 120000
+
+/** A canary silent for this long during the soak is failed (milliseconds) */
+#define OTA_MESH_SILENCE_MS         30000
+
+/** A node without the image after this long is skipped (milliseconds) */
+#define OTA_MESH_STAGE_TIMEOUT_MS   300000
+
+/** Nodes have this long to answer the first beacons before the rollout can complete (milliseconds) */
+#define OTA_MESH_DISCOVERY_MS       10000
+
+/** Rollout beacon period (milliseconds) */
+#define OTA_MESH_BEACON_PERIOD_MS   1000
+
+/** Rollout status period on MQTT, phase changes are published at once (milliseconds) */
+#define OTA_MESH_STATUS_PERIOD_MS   10000
+
+// ============================================================================
+// MESSAGES
+// ============================================================================
+
+/**
+ * @brief Image offer (parent -> children, repeated while serving)
+ */
+typedef struct {
+    uint32_t session;                   /**< Chosen by the parent, echoed in the acks */
+    uint32_t image_size;
+    uint32_t chunk_count;
+    uint16_t chunk_size;
+    uint8_t  sha256[32];                /**< SHA256 of the image bytes */
+    uint8_t  app_elf_sha256[32];        /**< Build identity - a child already running it does not join */
+    char     version[32];
+} __attribute__((packed)) ota_mesh_offer_t;
+
+/**
+ * @brief Image chunk (parent -> children)
+ */
+typedef struct {
+    uint32_t session;
+    uint32_t index;
+    uint16_t len;
+    uint8_t  sha256[32];                /**< SHA256 of data[0..len) */
+    uint8_t  data[OTA_MESH_CHUNK_SIZE];
+} __attribute__((packed)) ota_mesh_chunk_t;
+
+#define OTA_MESH_CHUNK_HEADER_LEN   offsetof(ota_mesh_chunk_t, data)
+
+/**
+ * @brief Acknowledgement (child -> parent), the first one also joins the session
+ */
+typedef struct {
+    uint32_t session;
+    uint8_t  macAddr[ETH_HWADDR_LEN];   /**< MAC Address of the child */
+    uint32_t next;                      /**< See ota_relay_ack_t */
+    uint8_t  ack;                       /**< ota_relay_ack_t */
+} __attribute__((packed)) ota_mesh_ack_t;
+
+/**
+ * @brief Rollout beacon (root -> every node, forwarded down by each parent)
+ */
+typedef struct {
+    uint32_t session;                   /**< Session of the root offer, echoed in the reports */
+    uint8_t  sha256[32];                /**< SHA256 of the staged image */
+    uint8_t  app_elf_sha256[32];        /**< Build identity - a node running it is updated */
+    uint8_t  count;                     /**< Nodes to activate */
+    uint8_t  activate[OTA_ROLLOUT_MAX_ACTIVE][ETH_HWADDR_LEN];
+} __attribute__((packed)) ota_mesh_rollout_t;
+
+/**
+ * @brief Answer to a rollout beacon (node -> root)
+ */
+typedef struct {
+    uint32_t session;
+    uint8_t  macAddr[ETH_HWADDR_LEN];   /**< MAC Address of the node */
+    uint8_t  report;                    /**< ota_rollout_report_t */
+} __attribute__((packed)) ota_mesh_report_t;
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+/**
+ * @brief Register the relay messages and hold the ota_manager reboot
+ *
+ * Called once by every node, after the mesh-lite raw actions are registered.
+ * When an update downloaded by ota_manager completes, the staged image is
+ * served to the children, then rolled out.
+ */
+void ota_mesh_init(void);
+
+/**
+ * @brief Serve an image written in a partition to the direct children
+ *
+ * Non-blocking. Once the session is over the root starts the rollout; another
+ * node reboots if the root already activated it, or waits for its turn.
+ *
+ * @param partition Partition holding the image
+ * @param size Image bytes
+ * @param sha256 SHA256 of the image bytes
+ * @return ESP_OK if serving started, ESP_ERR_INVALID_STATE if a session is running
+ */
+esp_err_t ota_mesh_serve(const esp_partition_t *partition, uint32_t size, const uint8_t *sha256);
+
+/**
+ * @brief Rollout settings of the next update (root)
+ *
+ * @param canary Nodes activated first, alone (0 = no canary)
+ * @param concurrent Nodes rebooting at once after the canary (1..OTA_ROLLOUT_MAX_ACTIVE)
+ * @param max_failures Failed nodes tolerated before the rollout halts
+ */
+void ota_mesh_set_rollout(uint8_t canary, uint8_t concurrent, uint8_t max_failures);
+
+/**
+ * @brief True while the node receives or serves an image, or the root runs a rollout
+ */
+bool ota_mesh_is_busy(void);
+
+#endif /* OTA_MESH_H */
@@ -0,0 +1,170 @@
+#ifndef OTA_RELAY_H
+#define OTA_RELAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Chunk protocol of the mesh OTA relay (one parent -> its direct children).
+ *
+ * The parent broadcasts the image in fixed-size chunks, so one transmission
+ * serves every child of the hop. Each child acknowledges the chunks it has
+ * written to flash (cumulative ack); the parent keeps at most `window` chunks
+ * in flight past the slowest active child (go-back-N), so a child whose write
+ * queue holds `window` chunks never has to drop one because flash is slow.
+ * A child that sees a hole (lost or corrupt chunk) asks for it once, and the
+ * parent also rewinds to the slowest child when nothing advanced for rto_ms.
+ * A child that stays silent for child_timeout_ms is dropped so it cannot
+ * stall its siblings.
+ * Pure C, no ESP-IDF dependency.
+ */
+
+#define OTA_RELAY_MAX_CHILDREN      16      // children served per hop
+
+/* Child -> parent acknowledgement */
+typedef enum {
+    OTA_RELAY_ACK_PROGRESS = 0,     // next = chunks written to flash
+    OTA_RELAY_ACK_GAP,              // next = first chunk missing, a later one arrived: resend from there
+    OTA_RELAY_ACK_DONE,             // image received and verified
+    OTA_RELAY_ACK_FAILED,           // verification or flash write failed, gave up
+} ota_relay_ack_t;
+
+typedef enum {
+    OTA_RELAY_CHILD_ACTIVE = 0,
+    OTA_RELAY_CHILD_DONE,
+    OTA_RELAY_CHILD_FAILED,
+    OTA_RELAY_CHILD_LOST,           // stopped acknowledging
+} ota_relay_child_state_t;
+
+typedef struct {
+    uint32_t    chunk_count;
+    uint8_t     window;             // chunks in flight past the slowest child, >= 1
+    uint32_t    rto_ms;             // no progress for this long: resend from the slowest child
+    uint32_t    child_timeout_ms;   // no ack for this long: the child is dropped
+} ota_relay_config_t;
+
+typedef struct {
+    uint8_t                 mac[6];
+    uint32_t                next;           // chunks the child has written
+    uint32_t                last_ack_ms;
+    ota_relay_child_state_t state;
+} ota_relay_child_t;
+
+/* Parent side */
+typedef struct {
+    ota_relay_config_t  config;
+    ota_relay_child_t   children[OTA_RELAY_MAX_CHILDREN];
+    uint8_t             child_count;
+    uint32_t            next_send;      // next chunk to broadcast
+    uint32_t            high_water;     // chunks below were broadcast at least once
+    uint32_t            progress_ms;    // last time the slowest child advanced (or a rewind)
+    uint32_t            sent;           // chunk broadcasts, resends included
+    uint32_t            resent;
+    uint32_t            rewinds;        // timeouts that restarted the window
+} ota_relay_tx_t;
+
+/* Child side */
+typedef struct {
+    uint32_t    chunk_count;
+    uint32_t    next;               // next chunk expected
+    uint32_t    written;            // chunks stored in flash (next - written are queued)
+    uint8_t     ack_every;          // in-order chunks per progress ack, >= 1
+    uint32_t    last_index;         // last chunk seen, a lower index starts a new pass
+    bool        reported;           // the current hole / duplicate run was already acked
+    uint32_t    duplicates;
+    uint32_t    gaps;
+    uint32_t    corrupt;
+} ota_relay_rx_t;
+
+typedef enum {
+    OTA_RELAY_RX_ACCEPT = 0,        // the expected chunk - queue it, then ota_relay_rx_commit()
+    OTA_RELAY_RX_DUPLICATE,         // already written
+    OTA_RELAY_RX_GAP,               // a chunk before it is missing
+    OTA_RELAY_RX_CORRUPT,           // per-chunk hash mismatch
+} ota_relay_rx_result_t;
+
+/**
+ * @brief Start serving an image
+ */
+void ota_relay_tx_init(ota_relay_tx_t *tx, const ota_relay_config_t *config, uint32_t now_ms);
+
+/**
+ * @brief Add a child that answered the offer (a repeated join is ignored)
+ *
+ * @return bool false if the child table is full
+ */
+bool ota_relay_tx_join(ota_relay_tx_t *tx, const uint8_t *mac, uint32_t now_ms);
+
+/**
+ * @brief Process an acknowledgement
+ *
+ * A progress or gap ack from a child that is not in the table joins it (its
+ * answer to the offer was lost).
+ *
+ * @return bool false if the child is unknown and could not join
+ */
+bool ota_relay_tx_ack(ota_relay_tx_t *tx, const uint8_t *mac, uint32_t next, ota_relay_ack_t ack, uint32_t now_ms);
+
+/**
+ * @brief First chunk missing at the slowest active child (chunk_count if none is active)
+ */
+uint32_t ota_relay_tx_base(const ota_relay_tx_t *tx);
+
+/**
+ * @brief Next chunk to broadcast now
+ *
+ * Also drops the silent children and rewinds the window after rto_ms without
+ * progress. Call it until it returns false, then wait for an ack or the RTO.
+ *
+ * @return bool false if the window is full or every chunk was acknowledged
+ */
+bool ota_relay_tx_next(ota_relay_tx_t *tx, uint32_t now_ms, uint32_t *index);
+
+/**
+ * @brief True once no child is active (all done, failed or lost)
+ */
+bool ota_relay_tx_finished(const ota_relay_tx_t *tx);
+
+/**
+ * @brief Start receiving an image
+ */
+void ota_relay_rx_init(ota_relay_rx_t *rx, uint32_t chunk_count, uint8_t ack_every);
+
+/**
+ * @brief Classify a received chunk (does not advance)
+ *
+ * @param intact The per-chunk hash matched
+ */
+ota_relay_rx_result_t ota_relay_rx_check(ota_relay_rx_t *rx, uint32_t index, bool intact);
+
+/**
+ * @brief The accepted chunk was queued for writing, expect the next one
+ */
+void ota_relay_rx_commit(ota_relay_rx_t *rx);
+
+/**
+ * @brief Whether the parent must be told about a chunk that was not accepted
+ *
+ * A hole or a duplicate run is acked once per pass, so a lost window costs
+ * one ack per child.
+ *
+ * @param[out] ack Kind of acknowledgement to send
+ * @param[out] next Position to send with it
+ */
+bool ota_relay_rx_ack_due(ota_relay_rx_t *rx, ota_relay_rx_result_t result, ota_relay_ack_t *ack, uint32_t *next);
+
+/**
+ * @brief A queued chunk reached flash
+ *
+ * @param[out] next Position to send with a progress ack
+ * @return bool true every ack_every chunks and at the last one
+ */
+bool ota_relay_rx_written(ota_relay_rx_t *rx, uint32_t *next);
+
+/**
+ * @brief True once every chunk was written
+ */
+bool ota_relay_rx_complete(const ota_relay_rx_t *rx);
+
+#endif /* OTA_RELAY_H */
@@ -0,0 +1,130 @@
+#ifndef OTA_ROLLOUT_H
+#define OTA_ROLLOUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Staged activation of an image the mesh relay already distributed (root side).
+ *
+ * Every node stages the image (written and verified, boot partition not set)
+ * and waits. The root tells nodes when to boot it: first `canary` nodes
+ * alone, which must then run the new build for canary_soak_ms without going
+ * silent for silence_ms, then the others with at most `concurrent` nodes
+ * rebooting at a time. A node is updated once it reports running the new
+ * build. A node that fails to stage, comes back on
+ * the old build (rollback) or stays silent for confirm_timeout_ms after its
+ * activation is failed, and more than max_failures failures halt the rollout:
+ * no other node is activated. Nodes still without the image after
+ * stage_timeout_ms are skipped, they do not count as failures.
+ *
+ * Nodes are discovered from their reports; the rollout cannot complete before
+ * discovery_ms so that every node had time to answer.
+ * Pure C, no ESP-IDF dependency.
+ */
+
+#define OTA_ROLLOUT_MAX_NODES       32      // nodes tracked per rollout
+#define OTA_ROLLOUT_MAX_ACTIVE      8       // nodes activating at once (canary and concurrent are capped to it)
+
+typedef enum {
+    OTA_ROLLOUT_CANARY = 0,         // only the canary nodes may be activated
+    OTA_ROLLOUT_SOAK,               // canaries updated, watching them for canary_soak_ms
+    OTA_ROLLOUT_ROLLING,            // the other nodes, `concurrent` at a time
+    OTA_ROLLOUT_COMPLETE,           // no node left to activate
+    OTA_ROLLOUT_HALTED,             // too many failures, nothing more is activated
+} ota_rollout_phase_t;
+
+/* Node -> root report, answer to every rollout beacon */
+typedef enum {
+    OTA_ROLLOUT_REPORT_WAITING = 0, // no verified image (not received yet, or gone after a reboot)
+    OTA_ROLLOUT_REPORT_STAGED,      // image verified, waiting for activation
+    OTA_ROLLOUT_REPORT_FAILED,      // receiving or verifying the image failed
+    OTA_ROLLOUT_REPORT_RUNNING,     // running the new build
+} ota_rollout_report_t;
+
+typedef enum {
+    OTA_ROLLOUT_NODE_PENDING = 0,   // known, image not staged yet
+    OTA_ROLLOUT_NODE_STAGED,        // waiting for its turn
+    OTA_ROLLOUT_NODE_ACTIVATING,    // told to boot the new image, not back yet
+    OTA_ROLLOUT_NODE_UPDATED,
+    OTA_ROLLOUT_NODE_FAILED,
+    OTA_ROLLOUT_NODE_SKIPPED,       // never staged the image
+    OTA_ROLLOUT_NODE_STATES
+} ota_rollout_node_state_t;
+
+typedef struct {
+    uint8_t     canary;             // nodes activated first, alone (0: no canary phase)
+    uint8_t     concurrent;         // nodes activating at once after the canary, >= 1
+    uint8_t     max_failures;       // failures tolerated, one more halts
+    uint32_t    canary_soak_ms;     // canaries run the new build this long before the others start
+    uint32_t    confirm_timeout_ms; // activated node must report the new build within this time
+    uint32_t    silence_ms;         // canary without a report for this long during the soak is failed
+    uint32_t    stage_timeout_ms;   // node without the image after this long is skipped
+    uint32_t    discovery_ms;       // no completion before this long after the start
+} ota_rollout_config_t;
+
+typedef struct {
+    uint8_t                     mac[6];
+    ota_rollout_node_state_t    state;
+    bool                        canary;
+    uint32_t                    since_ms;   // entered the state
+    uint32_t                    last_report_ms;
+} ota_rollout_node_t;
+
+typedef struct {
+    ota_rollout_config_t    config;
+    ota_rollout_node_t      nodes[OTA_ROLLOUT_MAX_NODES];
+    uint8_t                 node_count;
+    ota_rollout_phase_t     phase;
+    uint32_t                start_ms;
+    uint32_t                phase_ms;       // entered the phase
+    uint8_t                 canaries;       // canary nodes activated so far
+    uint8_t                 failures;
+    uint8_t                 last_failed[6]; // node of the last failure
+} ota_rollout_t;
+
+/**
+ * @brief Start a rollout with no known node
+ */
+void ota_rollout_init(ota_rollout_t *r, const ota_rollout_config_t *config, uint32_t now_ms);
+
+/**
+ * @brief Process the report of a node (an unknown node is added)
+ *
+ * @return bool false if the node is unknown and the table is full
+ */
+bool ota_rollout_report(ota_rollout_t *r, const uint8_t *mac, ota_rollout_report_t report, uint32_t now_ms);
+
+/**
+ * @brief Apply the timeouts, activate the next nodes and advance the phase
+ *
+ * Call it periodically and after reports.
+ *
+ * @return ota_rollout_phase_t Current phase
+ */
+ota_rollout_phase_t ota_rollout_step(ota_rollout_t *r, uint32_t now_ms);
+
+/**
+ * @brief Nodes told to boot the new image and not back yet
+ *
+ * @param[out] macs Up to max MAC addresses
+ * @return uint8_t Number of MAC addresses written
+ */
+uint8_t ota_rollout_activating(const ota_rollout_t *r, uint8_t (*macs)[6], uint8_t max);
+
+/**
+ * @brief Number of nodes in each ota_rollout_node_state_t
+ */
+void ota_rollout_count(const ota_rollout_t *r, uint8_t counts[OTA_ROLLOUT_NODE_STATES]);
+
+/**
+ * @brief True once the phase is COMPLETE or HALTED
+ */
+bool ota_rollout_finished(const ota_rollout_t *r);
+
+/**
+ * @brief Name of a phase, as published on MQTT
+ */
+const char *ota_rollout_phase_to_string(ota_rollout_phase_t phase);
+
+#endif /* OTA_ROLLOUT_H */
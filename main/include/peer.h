@@ -4,12 +4,17 @@
 #include "util.h"
 #include "aux_ctu_hw.h"
 #include "cru_hw.h"
+#include "telemetry_agg.h"
 
 // Delta on sensor-values for sending updates
 #define DELTA_VOLTAGE 10.0
 #define DELTA_CURRENT 1
 #define DELTA_TEMPERATURE 1.0
 
+// Per-peer summary of the dynamic samples (root side, bumblebee/<id>/summary)
+#define PEER_SUMMARY_WINDOW_MS      30000                           // one summary per peer and window
+#define PEER_SUMMARY_MAX_GAP_MS     (2 * PEER_DYNAMIC_TIMER * 1000) // a longer silence is not integrated into energy
+
 typedef enum {
     TX,        //TX UNIT
     RX         //RX UNIT
@@ -69,6 +74,16 @@ typedef struct
     } RX;
 } mesh_dynamic_payload_t;
 
+/**
+ * @brief Receiver state of one TX's binary dynamic frame stream (see mesh_codec.h)
+ * 
+ */
+typedef struct
+{
+    uint8_t          seq;                       /* Seq of the last frame applied */
+    bool             synced;                    /* A full frame was applied and no delta was missed since */
+} mesh_codec_rx_t;
+
 /**
  * @brief Alert characteristic structure. This contains elements necessary for alert payload.
  *        The union structure allows to check only all_flags instead of each alert separately
@@ -126,6 +141,41 @@ typedef struct
     uint8_t          position;                  /* Position of the RX peer */
 } mesh_localization_payload_t;
 
+/**
+ * @brief Payload for parallel localization: pads to switch to LOCALIZATION (root -> children)
+ * 
+ */
+typedef struct
+{
+    uint8_t          count;
+    uint8_t          macAddr[LOCALIZATION_GROUP_MAX][ETH_HWADDR_LEN];
+} mesh_loc_group_payload_t;
+
+/**
+ * @brief Payload for parallel localization: an energized pad heard an RX broadcast (pad -> root)
+ *        Also used for the RSSI reports of the pads that are not energized
+ * 
+ */
+typedef struct
+{
+    uint8_t          macAddr[ETH_HWADDR_LEN];   /**< MAC Address of the RX */
+    uint8_t          position;                  /* Position of the pad */
+    int8_t           rssi;                      /* RSSI of the RX broadcast at the pad */
+} mesh_loc_claim_payload_t;
+
+/**
+ * @brief Payload for parallel localization: pads that won an RX (root -> children)
+ * 
+ */
+typedef struct
+{
+    uint8_t          count;
+    struct {
+        uint8_t      padMac[ETH_HWADDR_LEN];
+        uint8_t      rxMac[ETH_HWADDR_LEN];
+    } grant[LOCALIZATION_GROUP_MAX];
+} mesh_loc_grant_payload_t;
+
 
 /**
  * @brief Tuning params structure for TX transitor waveforms
@@ -157,7 +207,7 @@ struct TX_peer
     /* MAC ADDRESS OF THE TX */
     uint8_t MACaddress[6];
 
-    /** Peripheral payloads. */
+    /** Peripheral payloads. Point into storage below, or at the self_* globals for the self peer */
     mesh_static_payload_t *static_payload;
     mesh_dynamic_payload_t *dynamic_payload, *previous_dynamic_payload; // previous is used for comparison for sending logic
     mesh_alert_payload_t  *alert_payload, *previous_alert_payload; // previous is used for comparison for sending logic
@@ -165,6 +215,20 @@ struct TX_peer
 
     /* Time variable */
     uint32_t lastDynamicPublished;
+
+    /* Binary codec delta stream from this TX (root side) */
+    mesh_codec_rx_t codec_rx;
+
+    /* Aggregated dynamic samples (under TX_peers_mutex) */
+    telemetry_agg_t summary;
+
+    /* Inline payload storage - the whole record lives in the static peer pool */
+    struct {
+        mesh_static_payload_t static_payload;
+        mesh_dynamic_payload_t dynamic_payload, previous_dynamic_payload;
+        mesh_alert_payload_t alert_payload, previous_alert_payload;
+        mesh_tuning_params_t tuning_params;
+    } storage;
 };
 
 /**
@@ -188,6 +252,48 @@ struct RX_peer
     RX_status RX_status;
 };
 
+/**
+ * @brief Usage statistics of a static peer pool
+ * 
+ */
+typedef struct
+{
+    uint16_t capacity;          /* Number of slots in the pool */
+    uint16_t in_use;            /* Slots currently allocated */
+    uint16_t high_water;        /* Maximum slots ever allocated at once */
+    uint32_t alloc_count;       /* Successful allocations */
+    uint32_t free_count;        /* Slots returned */
+    uint32_t alloc_failures;    /* Allocations refused because the pool was empty */
+    size_t   heap_free;         /* Free 8-bit heap at the time of the query */
+    size_t   heap_largest_block;/* Largest free 8-bit heap block (fragmentation indicator) */
+} peer_pool_stats_t;
+
+/**
+ * @brief Copy of the publishable state of one TX peer, taken under TX_peers_mutex
+ * 
+ */
+typedef struct
+{
+    int8_t id;
+    uint8_t MACaddress[6];
+    mesh_dynamic_payload_t dynamic_payload, previous_dynamic_payload;
+    mesh_alert_payload_t alert_payload, previous_alert_payload;
+    uint32_t lastDynamicPublished;
+    bool summary_ready;                 /* summary holds a closed window to publish */
+    telemetry_agg_window_t summary;
+} TX_peer_snapshot_t;
+
+/**
+ * @brief Immutable view of the TX peer table at a given epoch
+ * 
+ */
+typedef struct
+{
+    uint32_t epoch;             /* TX table epoch (bumped on every add/delete) */
+    uint16_t count;
+    TX_peer_snapshot_t peers[MESH_LITE_MAXIMUM_NODE_NUMBER];
+} TX_peers_snapshot_t;
+
 SLIST_HEAD(RX_peer_list, RX_peer);
 SLIST_HEAD(TX_peer_list, TX_peer);
 
@@ -300,6 +406,14 @@ struct TX_peer* TX_peer_find_by_position(uint8_t position);
 */
 struct RX_peer* RX_peer_find_by_position(int8_t position);
 
+/**
+ * @brief Set the position of a RX_peer, keeping the position index in sync
+ * 
+ * @param peer RX peer to update
+ * @param position New position (0 = not localized)
+ */
+void RX_peer_set_position(struct RX_peer *peer, int8_t position);
+
 /**
  * @brief Delete a peer from the peer list
  * 
@@ -328,11 +442,31 @@ void allLocalizationTxPeersOFF();
 struct RX_peer* findRXpeerWPosition(uint8_t pos);
 
 /**
- * @brief Find the next TX peer for localization
- * @param previousTX_pos Position of the previous TX peer used for localization
- * @return struct TX_peer* Pointer to the next TX peer for localization
+ * @brief Collect the positions of the TX peers available for localization (OFF or LOCALIZATION)
+ * 
+ * @param positions Output positions
+ * @param max Size of positions
+ * @return uint8_t Number of positions written
  */
-struct TX_peer* find_next_TX_for_localization(int8_t previousTX_pos);
+uint8_t TX_peers_localization_candidates(int8_t *positions, uint8_t max);
+
+/**
+ * @brief Positions of the idle TX peers (OFF), probed for scooters with a dead RX battery
+ * 
+ * @param positions Output positions
+ * @param max Size of positions
+ * @return uint8_t Number of positions written
+ */
+uint8_t TX_peers_probe_candidates(int8_t *positions, uint8_t max);
+
+/**
+ * @brief Mark the TX peer at a position as LOCALIZATION
+ * 
+ * @param position Pad position
+ * @param mac Output MAC address of the pad
+ * @return true if the peer exists
+ */
+bool TX_peer_start_localization(int8_t position, uint8_t *mac);
 
  /**
  * @brief  Detect dynamic payload changes
@@ -346,6 +480,39 @@ bool dynamic_payload_changed(mesh_dynamic_payload_t *current,
 bool alert_payload_changed(mesh_alert_payload_t *current, 
                             mesh_alert_payload_t *previous);
 
+/* Alert notification counters */
+typedef struct {
+    uint32_t notifications;         // self_alert_notify calls
+    uint32_t last_latency_us;       // sample to alert_task wake-up
+    uint32_t max_latency_us;        // worst case since boot
+} self_alert_stats_t;
+
+/**
+ * @brief Register the task woken by self_alert_notify (alert_task)
+ */
+void self_alert_register_task(TaskHandle_t task);
+
+/**
+ * @brief Wake the alert task after setting a flag in self_alert_payload
+ * 
+ * @param sample_us esp_timer time the triggering sample was taken, for the latency measurement
+ */
+void self_alert_notify(int64_t sample_us);
+
+/**
+ * @brief Block the alert task until a notification or the timeout
+ * 
+ * @param timeout Ticks to wait
+ * @param latency_us Output: oldest pending sample to now, only set when notified
+ * @return true if a producer notified since the last call
+ */
+bool self_alert_wait(TickType_t timeout, uint32_t *latency_us);
+
+/**
+ * @brief Get the alert notification counters
+ */
+void self_alert_get_stats(self_alert_stats_t *stats);
+
 /**
  * @brief Init payloads self-structures
  * 
@@ -358,6 +525,90 @@ void init_payloads();
  */
 void update_status(struct TX_peer *peer);
 
+/**
+ * @brief Get usage statistics of the TX or RX peer pool
+ * 
+ * @param type TX or RX pool
+ * @param stats Output statistics
+ */
+void peer_pool_get_stats(peer_type type, peer_pool_stats_t *stats);
+
+/**
+ * @brief Refresh the status of every TX peer and copy the table into a snapshot
+ *        The lock is only held for the copy, readers work on the snapshot afterwards
+ * 
+ * @param snap Output snapshot
+ * @return uint16_t Number of peers copied
+ */
+uint16_t TX_peers_snapshot(TX_peers_snapshot_t *snap);
+
+/**
+ * @brief Write back what was published from a snapshot entry (matched by MAC)
+ * 
+ * @param peer Snapshot entry that was published
+ * @param dynamic_published Dynamic payload was published
+ * @param alert_published Alert payload was published
+ */
+void TX_peer_commit_published(const TX_peer_snapshot_t *peer, bool dynamic_published, bool alert_published);
+
+/**
+ * @brief Add the current dynamic payload of a TX peer to its summary window
+ * 
+ * @param mac MAC address of the TX peer
+ */
+void TX_peer_aggregate_dynamic(const uint8_t *mac);
+
+/**
+ * @brief Store a received dynamic payload in a TX peer and add it to its summary window, under TX_peers_mutex
+ * 
+ * @param mac MAC address of the TX peer
+ * @param payload Received payload
+ * @return true if the peer is known
+ */
+bool TX_peer_store_dynamic(const uint8_t *mac, const mesh_dynamic_payload_t *payload);
+
+/**
+ * @brief Apply a binary dynamic frame (mesh_codec.h) on a TX peer and add it to its summary window, under TX_peers_mutex
+ * 
+ * @param mac MAC address of the TX peer (the frame key)
+ * @param frame Received frame
+ * @param len Frame length
+ * @return esp_err_t ESP_ERR_NOT_FOUND if the peer is unknown, else as mesh_codec_decode_dynamic
+ */
+esp_err_t TX_peer_decode_dynamic(const uint8_t *mac, const uint8_t *frame, uint32_t len);
+
+/**
+ * @brief Store a received alert payload in a TX peer, under TX_peers_mutex
+ * 
+ * @param mac MAC address of the TX peer
+ * @param payload Received payload
+ * @return true if the peer is known
+ */
+bool TX_peer_store_alert(const uint8_t *mac, const mesh_alert_payload_t *payload);
+
+/**
+ * @brief Apply a binary alert frame (mesh_codec.h) on a TX peer, under TX_peers_mutex
+ * 
+ * @param mac MAC address of the TX peer (the frame key)
+ * @param frame Received frame
+ * @param len Frame length
+ * @return esp_err_t ESP_ERR_NOT_FOUND if the peer is unknown, else as mesh_codec_decode_alert
+ */
+esp_err_t TX_peer_decode_alert(const uint8_t *mac, const uint8_t *frame, uint32_t len);
+
+/**
+ * @brief Release the summary window of a snapshot entry once it is published (matched by MAC)
+ * 
+ * @param peer Snapshot entry whose summary was published
+ */
+void TX_peer_commit_summary(const TX_peer_snapshot_t *peer);
+
+/**
+ * @brief Longest time TX_peers_mutex was held by snapshot/commit (us)
+ * 
+ */
+uint32_t TX_peers_snapshot_max_hold_us(void);
+
 /**
  * @brief Remove a TX peer from the relative TX list based on its position
  * 
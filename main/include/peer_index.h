@@ -0,0 +1,63 @@
+#ifndef PEER_INDEX_H
+#define PEER_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Open-addressing hash index of peers keyed by MAC address.
+ *
+ * FNV-1a over the 6 MAC bytes, linear probing, backward-shift deletion (no
+ * tombstones, so a lookup stops at the first free slot). The table does not
+ * own the keys: each entry points at the MAC stored in the peer record, which
+ * must stay valid while the peer is indexed.
+ *
+ * Not thread-safe: the caller holds the lock of the peer list.
+ * Pure C, no ESP-IDF dependency.
+ */
+
+#define PEER_INDEX_MAC_LEN      6
+
+typedef struct {
+    const uint8_t   *mac;       // points at the peer's own MAC, NULL when free
+    void            *peer;
+} peer_index_entry_t;
+
+typedef struct {
+    peer_index_entry_t  *slots;
+    uint32_t            mask;   // slot count - 1
+} peer_index_t;
+
+/**
+ * @brief Attach an index to its slot array and clear it
+ *
+ * @param size Slot count, a power of two (keep it at least twice the peer count)
+ */
+void peer_index_init(peer_index_t *index, peer_index_entry_t *slots, uint32_t size);
+
+/**
+ * @brief Remove every entry
+ */
+void peer_index_clear(peer_index_t *index);
+
+/**
+ * @brief Find the peer with a MAC
+ *
+ * @return void* NULL if not indexed
+ */
+void *peer_index_find(const peer_index_t *index, const uint8_t *mac);
+
+/**
+ * @brief Index a peer (the MAC must not be indexed yet)
+ *
+ * @param mac MAC stored in the peer record
+ * @return bool false if the table is full
+ */
+bool peer_index_insert(peer_index_t *index, const uint8_t *mac, void *peer);
+
+/**
+ * @brief Remove the peer with a MAC, if indexed
+ */
+void peer_index_remove(peer_index_t *index, const uint8_t *mac);
+
+#endif /* PEER_INDEX_H */
@@ -0,0 +1,133 @@
+#ifndef STM_FRAME_H
+#define STM_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary framing of the STM32 -> ESP32 UART stream
+ *
+ *   [SOF 0xA5][type][len][payload (len bytes)][CRC16 LE]
+ *
+ * CRC16-CCITT (poly 0x1021, init 0xFFFF) over type, len and payload.
+ * JSON text never contains 0xA5, so both formats can share the line: bytes
+ * outside a frame are handed back to the caller (JSON fallback).
+ *
+ * A stray 0xA5 starts a false frame that fails its length or CRC check. The
+ * bytes it swallowed are then parsed again, so an SOF among them still starts
+ * the next frame and the other bytes go back to the JSON fallback.
+ * Pure C, no heap - the parser keeps the frame being assembled inline.
+ */
+
+#define STM_FRAME_SOF                   0xA5
+#define STM_FRAME_MAX_PAYLOAD           64
+#define STM_FRAME_OVERHEAD              5       // SOF + type + len + CRC16
+
+typedef enum {
+    STM_FRAME_MEASUREMENT   = 0x01,
+    STM_FRAME_ACK           = 0x02,     // payload: uint16 LE sequence number of the acknowledged command
+} stm_frame_type_t;
+
+/*
+ * STM_FRAME_MEASUREMENT payload (little-endian, fixed point)
+ *   int16  temperature1   x100  [°C]
+ *   int16  temperature2   x100  [°C]
+ *   int16  voltage        x100  [V]
+ *   int16  current        x1000 [A]
+ *   uint8  alert          alertType_t
+ *   uint16 duty           x10000
+ *   uint8  tuning
+ *   uint8  low_vds_threshold
+ *   uint8  low_vds
+ */
+#define STM_MEASUREMENT_PAYLOAD_LEN     14
+
+/**
+ * @brief One set of STM32 readings - shared by the binary and the JSON path
+ */
+typedef struct {
+    float       temperature1;
+    float       temperature2;
+    float       voltage;
+    float       current;
+    uint8_t     alert;
+    float       duty;
+    uint8_t     tuning;
+    uint8_t     low_vds_threshold;
+    uint8_t     low_vds;
+} stm_measurement_t;
+
+typedef enum {
+    STM_FEED_CONSUMED,          // every byte fed so far is handled (a frame may still be being assembled)
+    STM_FEED_FRAME,             // a valid frame is ready in parser->type / payload / len
+    STM_FEED_UNCLAIMED,         // parser->byte is outside any frame (JSON fallback)
+    STM_FEED_ERROR,             // frame dropped (bad CRC or length), its bytes are parsed again
+} stm_feed_result_t;
+
+#define STM_FRAME_REPLAY_SIZE           (STM_FRAME_MAX_PAYLOAD + 4)     // type + len + payload + CRC16
+
+typedef struct {
+    uint8_t     state;
+    uint8_t     type;
+    uint8_t     len;
+    uint8_t     idx;
+    uint16_t    crc;
+    uint16_t    rx_crc;
+    uint8_t     payload[STM_FRAME_MAX_PAYLOAD];
+    uint8_t     byte;                               // the byte of STM_FEED_UNCLAIMED
+
+    /* bytes of a dropped frame, parsed again after its SOF */
+    uint8_t     replay[STM_FRAME_REPLAY_SIZE];
+    uint8_t     replay_head;
+    uint8_t     replay_len;
+
+    /* statistics */
+    uint32_t    frames;
+    uint32_t    crc_errors;
+    uint32_t    length_errors;
+} stm_frame_parser_t;
+
+/**
+ * @brief Reset the parser (statistics included)
+ */
+void stm_frame_parser_init(stm_frame_parser_t *parser);
+
+/**
+ * @brief Feed one received byte
+ *
+ * Call stm_frame_poll() after any other result than STM_FEED_CONSUMED, until
+ * it returns STM_FEED_CONSUMED, before feeding the next byte: a dropped frame
+ * hands back up to STM_FRAME_REPLAY_SIZE bytes.
+ *
+ * @return stm_feed_result_t see stm_feed_result_t
+ */
+stm_feed_result_t stm_frame_feed(stm_frame_parser_t *parser, uint8_t byte);
+
+/**
+ * @brief Parse the bytes a dropped frame handed back
+ *
+ * @return stm_feed_result_t STM_FEED_CONSUMED once none is left
+ */
+stm_feed_result_t stm_frame_poll(stm_frame_parser_t *parser);
+
+/**
+ * @brief Decode a STM_FRAME_MEASUREMENT payload
+ *
+ * @return true if the payload has the expected length
+ */
+bool stm_frame_decode_measurement(const uint8_t *payload, uint8_t len, stm_measurement_t *m);
+
+/**
+ * @brief Build a frame (used by tests and by the ESP32 -> STM32 direction)
+ *
+ * @return size_t Frame length, 0 if out is too small or payload too long
+ */
+size_t stm_frame_encode(uint8_t type, const uint8_t *payload, uint8_t len, uint8_t *out, size_t out_len);
+
+/**
+ * @brief CRC16-CCITT (poly 0x1021, init 0xFFFF) update
+ */
+uint16_t stm_frame_crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+#endif /* STM_FRAME_H */
@@ -0,0 +1,75 @@
+#ifndef STM_JSON_H
+#define STM_JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stm_frame.h"
+
+/*
+ * Incremental tokenizer for the JSON readings sent by the STM32, e.g.
+ *   {"temperature1":25.3,"temperature2":26.1,"voltage":12.0,"current":0.5,
+ *    "alert":0,"duty":0.3,"tuning":1,"low_vds_threshold":2,"low_vds":0}
+ *
+ * Bytes are fed as they arrive - no frame buffer, no tree, no heap. Only the
+ * known keys of stm_measurement_t (and "ack") are kept; unknown keys and
+ * nested values are skipped.
+ */
+
+#define STM_JSON_MAX_TOKEN              24      // longest key / number kept
+
+/* Bits of stm_json_parser_t.present */
+typedef enum {
+    STM_JSON_TEMPERATURE1       = 1 << 0,
+    STM_JSON_TEMPERATURE2       = 1 << 1,
+    STM_JSON_VOLTAGE            = 1 << 2,
+    STM_JSON_CURRENT            = 1 << 3,
+    STM_JSON_ALERT              = 1 << 4,
+    STM_JSON_DUTY               = 1 << 5,
+    STM_JSON_TUNING             = 1 << 6,
+    STM_JSON_LOW_VDS_THRESHOLD  = 1 << 7,
+    STM_JSON_LOW_VDS            = 1 << 8,
+    STM_JSON_ALL                = (1 << 9) - 1,     // all measurement keys
+    STM_JSON_ACK                = 1 << 9,           // {"ack":<seq>} command acknowledgement
+} stm_json_key_t;
+
+typedef enum {
+    STM_JSON_PENDING,           // object not complete yet (or no object started)
+    STM_JSON_OBJECT,            // object complete - result in parser->m / present
+    STM_JSON_ERROR,             // malformed input, parser waits for the next '{'
+} stm_json_result_t;
+
+typedef struct {
+    uint8_t             state;
+    uint8_t             nested;         // depth inside a skipped value
+    bool                escape;
+    bool                in_string;      // inside a string of a skipped value
+    uint8_t             key_len;
+    char                key[STM_JSON_MAX_TOKEN];
+    uint8_t             num_len;
+    char                num[STM_JSON_MAX_TOKEN];
+    int8_t              field;          // index of the current key, -1 if unknown
+
+    stm_measurement_t   m;              // missing keys read as 0
+    uint16_t            ack;            // valid if present & STM_JSON_ACK
+    uint16_t            present;        // stm_json_key_t bits
+
+    /* statistics */
+    uint32_t            objects;
+    uint32_t            errors;
+} stm_json_parser_t;
+
+/**
+ * @brief Reset the tokenizer (statistics included)
+ */
+void stm_json_parser_init(stm_json_parser_t *parser);
+
+/**
+ * @brief Feed one received byte
+ *
+ * @return stm_json_result_t STM_JSON_OBJECT when a complete object has been read
+ */
+stm_json_result_t stm_json_feed(stm_json_parser_t *parser, uint8_t c);
+
+#endif /* STM_JSON_H */
@@ -0,0 +1,99 @@
+#ifndef TELEMETRY_AGG_H
+#define TELEMETRY_AGG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Per-peer aggregation of the dynamic samples into fixed time windows.
+ *
+ * Every sample updates min / max / sum / last of each TX and RX value in the
+ * current window and integrates the power V*I into energy (Wh, trapezoidal
+ * rule between consecutive samples). An interval longer than max_gap_ms is a
+ * hole in the data and is not integrated.
+ *
+ * telemetry_agg_close moves the current window into the closed one once it
+ * is window_ms old. A closed window that was not released yet (uplink down)
+ * absorbs the next one, so nothing is lost, only the resolution drops.
+ *
+ * Not thread-safe: the caller serializes add / close / release.
+ * Pure C, no ESP-IDF dependency.
+ */
+
+typedef enum {
+    TELEMETRY_AGG_VOLTAGE = 0,
+    TELEMETRY_AGG_CURRENT,
+    TELEMETRY_AGG_TEMP1,
+    TELEMETRY_AGG_TEMP2,
+    TELEMETRY_AGG_FIELDS
+} telemetry_agg_field_t;
+
+typedef struct {
+    float       tx[TELEMETRY_AGG_FIELDS];
+    float       rx[TELEMETRY_AGG_FIELDS];
+} telemetry_agg_sample_t;
+
+typedef struct {
+    float       min;
+    float       max;
+    float       sum;
+    float       last;
+    uint32_t    count;          // samples of this value (NaN ones are skipped)
+} telemetry_agg_stat_t;
+
+typedef struct {
+    uint32_t                start_ms;       // first sample
+    uint32_t                end_ms;         // last sample
+    uint32_t                samples;
+    telemetry_agg_stat_t    tx[TELEMETRY_AGG_FIELDS];
+    telemetry_agg_stat_t    rx[TELEMETRY_AGG_FIELDS];
+    float                   tx_wh;          // energy over the window
+    float                   rx_wh;
+} telemetry_agg_window_t;
+
+typedef struct {
+    uint32_t                window_ms;
+    uint32_t                max_gap_ms;
+    telemetry_agg_window_t  current;
+    telemetry_agg_window_t  closed;
+    bool                    closed_ready;   // closed holds data not released yet
+    uint32_t                merged;         // windows absorbed by an unreleased closed window
+
+    /* integration state, carried across windows */
+    bool                    has_last;
+    uint32_t                last_ms;
+    float                   tx_w;           // power of the last sample
+    float                   rx_w;
+} telemetry_agg_t;
+
+/**
+ * @brief Initialize an aggregator
+ *
+ * @param window_ms Window length
+ * @param max_gap_ms Longest interval between two samples that is integrated
+ */
+void telemetry_agg_init(telemetry_agg_t *a, uint32_t window_ms, uint32_t max_gap_ms);
+
+/**
+ * @brief Add one sample to the current window
+ */
+void telemetry_agg_add(telemetry_agg_t *a, const telemetry_agg_sample_t *s, uint32_t now_ms);
+
+/**
+ * @brief Close the current window if it is window_ms old
+ *
+ * @return bool true if a closed window is waiting to be released
+ */
+bool telemetry_agg_close(telemetry_agg_t *a, uint32_t now_ms);
+
+/**
+ * @brief Drop the closed window once it has been published
+ */
+void telemetry_agg_release(telemetry_agg_t *a);
+
+/**
+ * @brief Mean of a value over a window (NaN without samples)
+ */
+float telemetry_agg_mean(const telemetry_agg_stat_t *st);
+
+#endif /* TELEMETRY_AGG_H */
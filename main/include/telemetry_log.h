@@ -0,0 +1,158 @@
+#ifndef TELEMETRY_LOG_H
+#define TELEMETRY_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Store-and-forward log of telemetry samples in a flash partition (root side).
+ *
+ * Fixed 40-byte records are appended in a circular log of 4 KB sectors. A
+ * sector is erased only when the write position enters it again, so every
+ * sector is erased once per lap of the log: the erases are spread evenly
+ * over the whole partition without a separate wear-levelling layer. When the
+ * log is full, the oldest sector is erased and its unsent records are dropped.
+ *
+ * Records are replayed oldest first. A replayed record is marked by clearing
+ * its `state` byte in place (1 -> 0 bits need no erase), so after a reboot
+ * the log resumes with the first record that was not replayed. A record torn
+ * by a power loss fails its CRC and is skipped.
+ *
+ * A record carries the wall clock of the sample once the clock is set (SNTP)
+ * and the uptime of the boot it was taken in, so the replay can tell its age
+ * even after a reboot; a record of an earlier boot taken before the clock was
+ * set cannot be dated.
+ *
+ * Not thread-safe: one task owns the log. Flash access goes through callbacks.
+ * Pure C, no ESP-IDF dependency.
+ */
+
+#define TELEMETRY_LOG_SECTOR_SIZE   4096
+#define TELEMETRY_LOG_RECORD_SIZE   40
+#define TELEMETRY_LOG_SLOTS         (TELEMETRY_LOG_SECTOR_SIZE / TELEMETRY_LOG_RECORD_SIZE)   // 102, the last 16 bytes unused
+
+/* Fixed-point units of the record values */
+#define TELEMETRY_VOLTAGE_UNIT      0.01f   // 10 mV
+#define TELEMETRY_CURRENT_UNIT      0.001f  // 1 mA
+#define TELEMETRY_TEMP_UNIT         0.01f   // 0.01 °C
+
+#define TELEMETRY_STATE_PENDING     0xFF    // erased value
+#define TELEMETRY_STATE_REPLAYED    0x00
+
+typedef struct {
+    int16_t     voltage;
+    int16_t     current;
+    int16_t     temp1;
+    int16_t     temp2;
+} __attribute__((packed)) telemetry_values_t;
+
+typedef struct {
+    uint32_t            seq;            // log sequence (set by telemetry_log_append)
+    uint32_t            uptime_ms;      // sample time since boot
+    uint64_t            epoch_ms;       // sample wall clock (Unix ms), 0 if the clock was not set
+    uint8_t             boot;           // boot the sample was taken in (set by telemetry_log_append)
+    uint8_t             tx_id;
+    uint8_t             tx_status;
+    uint8_t             rx_id;
+    uint8_t             rx_status;
+    telemetry_values_t  tx;
+    telemetry_values_t  rx;
+    uint8_t             state;          // TELEMETRY_STATE_*, cleared in place once replayed
+    uint16_t            crc;            // CRC16-CCITT of the bytes before `state`
+} __attribute__((packed)) telemetry_record_t;
+
+_Static_assert(sizeof(telemetry_record_t) == TELEMETRY_LOG_RECORD_SIZE, "telemetry record size");
+
+/* Whether a record can be dated (telemetry_log_age) */
+typedef enum {
+    TELEMETRY_AGE_KNOWN = 0,
+    TELEMETRY_AGE_NO_CLOCK,         // stamped with the wall clock, which is not set (yet) now
+    TELEMETRY_AGE_UNKNOWN,          // earlier boot, taken before the clock was set
+} telemetry_age_t;
+
+/* Flash access - offsets are relative to the partition, each callback returns false on error */
+typedef struct {
+    bool (*read)(void *ctx, uint32_t offset, void *data, uint32_t len);
+    bool (*write)(void *ctx, uint32_t offset, const void *data, uint32_t len);
+    bool (*erase)(void *ctx, uint32_t offset, uint32_t len);   // whole sectors
+} telemetry_log_io_t;
+
+typedef struct {
+    uint32_t    recorded;       // records appended
+    uint32_t    replayed;       // records consumed by the replay
+    uint32_t    dropped;        // unsent records overwritten when the log was full
+    uint32_t    corrupt;        // records skipped on a bad CRC
+    uint32_t    io_errors;
+} telemetry_log_stats_t;
+
+typedef struct {
+    telemetry_log_io_t      io;
+    void                    *ctx;
+    uint32_t                slots;      // record slots in the partition
+    uint32_t                head;       // next slot written
+    uint32_t                tail;       // oldest slot not replayed
+    uint32_t                pending;    // slots between tail and head (backlog depth)
+    uint32_t                next_seq;
+    uint8_t                 boot;
+    telemetry_log_stats_t   stats;
+} telemetry_log_t;
+
+/**
+ * @brief Recover the log from the partition
+ *
+ * Finds the newest record, the first record not replayed, and starts a new
+ * boot number.
+ *
+ * @param size Partition bytes (at least two sectors are used)
+ * @return bool false if the partition is too small or cannot be read
+ */
+bool telemetry_log_mount(telemetry_log_t *log, const telemetry_log_io_t *io, void *ctx, uint32_t size);
+
+/**
+ * @brief Append a record (seq, boot, state and crc are filled in)
+ *
+ * @return bool false on a flash error
+ */
+bool telemetry_log_append(telemetry_log_t *log, const telemetry_record_t *record);
+
+/**
+ * @brief Read the oldest records not replayed yet, without consuming them
+ *
+ * @param[out] records Up to max records, oldest first
+ * @param[out] slots Slots covered (to pass to telemetry_log_consume), corrupt ones included
+ * @return uint32_t Number of records written
+ */
+uint32_t telemetry_log_peek(telemetry_log_t *log, telemetry_record_t *records, uint32_t max, uint32_t *slots);
+
+/**
+ * @brief Mark the slots returned by telemetry_log_peek as replayed
+ *
+ * @param slots Slots returned by telemetry_log_peek
+ * @param count Records returned by telemetry_log_peek (the other slots were corrupt)
+ */
+void telemetry_log_consume(telemetry_log_t *log, uint32_t slots, uint32_t count);
+
+/**
+ * @brief Records waiting for replay
+ */
+uint32_t telemetry_log_backlog(const telemetry_log_t *log);
+
+/**
+ * @brief Age of a record, for the replay to date it
+ *
+ * The uptime is used for records of the current boot (it never jumps), the
+ * wall clock for the others.
+ *
+ * @param now_ms Current uptime
+ * @param epoch_ms Current wall clock (Unix ms), 0 if not set
+ * @param[out] age_ms Sample age when TELEMETRY_AGE_KNOWN
+ */
+telemetry_age_t telemetry_log_age(const telemetry_log_t *log, const telemetry_record_t *record,
+                                  uint32_t now_ms, uint64_t epoch_ms, uint32_t *age_ms);
+
+/**
+ * @brief Convert a value to a record fixed-point field (saturated)
+ */
+int16_t telemetry_log_fixed(float value, float unit);
+
+#endif /* TELEMETRY_LOG_H */
@@ -0,0 +1,45 @@
+#ifndef THRESHOLD_H
+#define THRESHOLD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Upper-limit crossing detector with hysteresis and debounce.
+ *
+ * The alarm is raised after `debounce` consecutive samples above the limit and
+ * cleared after `debounce` consecutive samples below (limit - hysteresis).
+ * Producers push every sample, only the two transitions are reported - so the
+ * consumer is woken on a crossing instead of polling the value. The limit is
+ * passed on every update because the root can change it at runtime.
+ * Pure C, no ESP-IDF dependency.
+ */
+
+typedef enum {
+    THRESHOLD_NO_CHANGE = 0,
+    THRESHOLD_RAISED,
+    THRESHOLD_CLEARED,
+} threshold_event_t;
+
+typedef struct {
+    float       hysteresis;
+    uint8_t     debounce;       // consecutive samples needed, >= 1
+    bool        active;         // alarm currently raised
+    uint8_t     count;          // consecutive samples against the current state
+} threshold_t;
+
+/**
+ * @brief Initialize a detector (alarm not active)
+ */
+void threshold_init(threshold_t *t, float hysteresis, uint8_t debounce);
+
+/**
+ * @brief Push one sample
+ *
+ * @param value Sample (NaN is ignored and breaks the debounce run)
+ * @param limit Current upper limit
+ * @return threshold_event_t THRESHOLD_RAISED / THRESHOLD_CLEARED on a transition
+ */
+threshold_event_t threshold_update(threshold_t *t, float value, float limit);
+
+#endif /* THRESHOLD_H */
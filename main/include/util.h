@@ -24,6 +24,7 @@
 #include "esp_mac.h"
 #include "esp_now.h"
 #include "esp_crc.h"
+#include "esp_heap_caps.h"
 
 #include "mqtt_client.h"
 
@@ -52,9 +53,31 @@
 #define OVERTEMPERATURE_RX                  60
 #define MIN_RX_VOLTAGE                      40  //60
 
+/* ALERTS DETECTION - hysteresis below the limit to clear, consecutive samples to raise/clear */
+#define ALERT_HYSTERESIS_VOLTAGE            2.0
+#define ALERT_HYSTERESIS_CURRENT            0.1
+#define ALERT_HYSTERESIS_TEMPERATURE        2.0
+#define ALERT_DEBOUNCE_ADC                  2   // filtered ADC windows (25 ms each)
+#define ALERT_DEBOUNCE_TEMPERATURE          2   // readings of the same sensor
+#define ALERT_POLL_FALLBACK_MS              1000    // alert_task also re-checks the flags this often
+
 /* LOC TIMING */
 #define LOCALIZATION_TIME_MS                500     //milliseconds
 
+/* PARALLEL LOCALIZATION (see localization.h) */
+#define LOCALIZATION_GROUP_MAX              8       // pads energized in the same step
+#define LOCALIZATION_ADJACENT_DISTANCE      1       // pads whose positions differ by up to this can couple with one scooter
+#define LOCALIZATION_ADJACENT_PAIRS         { {0, 0} }  // extra adjacent pads {a, b}, e.g. facing rows (0 = none)
+#define LOCALIZATION_RSSI_MARGIN_DB         6       // lead of the best claim, otherwise the pads are retried alone
+#define LOCALIZATION_HINT_TIME_MS           300     // max wait for the claim of a pad ranked from the RSSI reports
+
+/* DEAD BATTERY PROBING - idle pads pulse to find scooters that cannot broadcast */
+#define PROBE_PERIOD_MS                     1000    // root probes a group of idle pads this often (0 = disabled)
+#define PROBE_GROUP_MAX                     4       // non-adjacent pads probed together (<= LOCALIZATION_GROUP_MAX)
+#define PROBE_PULSE_MS                      100     // pulse length, covers a few STM32 measurements
+#define PROBE_LOAD_CURRENT                  0.15    // A - TX current that means a scooter is coupled
+#define PROBE_HOLD_MS                       20000   // pad stays ON for the RX to boot, join and be localized
+
 /* DYNAMIC PAYLOAD MAX TIMING */
 #define PEER_DYNAMIC_TIMER                  15      //15s
 
@@ -88,6 +111,7 @@
 
 #define MESH_FORMEDBIT                      BIT0
 #define LOCALIZEDBIT                        BIT1
+#define LOC_CLAIMBIT                        BIT2
 
 //*Unit ID
 extern uint8_t UNIT_ID;
@@ -123,16 +147,14 @@ extern EventGroupHandle_t eventGroupHandle;
 //Self-MAC address
 extern uint8_t self_mac[ETH_HWADDR_LEN];
 
-// Localization variable
-extern int8_t previousTX_pos;
-
 /** Status variable */
 typedef enum {
     TX_OFF,                //when the pad is off
     TX_LOCALIZATION,       //when the pad is active for localization (soft duty cycle thresholds) 
     TX_DEPLOY,             //when the pad is active on deploy (hard duty cycle thresholds)
     TX_FULLY_CHARGED,      //when the pad is off but a fully charged scooter is still present on it
-    TX_ALERT               //when the pad sent an alert (overcurrent, overvoltage, overtemperature, FOD)
+    TX_ALERT,              //when the pad sent an alert (overcurrent, overvoltage, overtemperature, FOD)
+    TX_PROBE               //when the pad sends a short low duty pulse to detect a scooter with a dead RX battery
 } TX_status;
 
 /**
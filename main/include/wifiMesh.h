@@ -4,6 +4,9 @@
 #include "util.h"
 #include "peer.h"
 #include "mqtt_client_manager.h"
+#include "mesh_codec.h"
+#include "localization.h"
+#include "ota_mesh.h"
 
 /* Mesh-LITE*/
 #define TO_ROOT_STATIC_MSG_ID               0x100
@@ -21,10 +24,53 @@
 #define TO_CHILD_CONTROL_MSG_ID             0x108
 #define TO_CHILD_CONTROL_MSG_ID_RESP        0x109
 
+/* Binary codec (see mesh_codec.h) - legacy struct IDs above stay accepted by the root */
+#define TO_ROOT_CAPS_MSG_ID                 0x10A
+#define TO_ROOT_CAPS_MSG_ID_RESP            0x10B
+
+#define TO_ROOT_DYNAMIC_V2_MSG_ID           0x10C
+#define TO_ROOT_DYNAMIC_V2_MSG_ID_RESP      0x10D
+
+#define TO_ROOT_ALERT_V2_MSG_ID             0x10E
+#define TO_ROOT_ALERT_V2_MSG_ID_RESP        0x10F
+
+/* Parallel localization (see localization.h) */
+#define TO_CHILD_LOC_GROUP_MSG_ID           0x110
+#define TO_CHILD_LOC_GROUP_MSG_ID_RESP      0x111
+
+#define TO_ROOT_LOC_CLAIM_MSG_ID            0x112
+#define TO_ROOT_LOC_CLAIM_MSG_ID_RESP       0x113
+
+#define TO_CHILD_LOC_GRANT_MSG_ID           0x114
+#define TO_CHILD_LOC_GRANT_MSG_ID_RESP      0x115
+
+#define TO_ROOT_LOC_REPORT_MSG_ID           0x116
+#define TO_ROOT_LOC_REPORT_MSG_ID_RESP      0x117
+
+/* Dead battery probing */
+#define TO_CHILD_PROBE_MSG_ID               0x118
+#define TO_CHILD_PROBE_MSG_ID_RESP          0x119
+
+/* Mesh OTA relay and rollout - sent once, ota_relay retransmits / the beacon repeats (no response IDs) */
+#define TO_CHILD_OTA_OFFER_MSG_ID           0x11A
+#define TO_CHILD_OTA_CHUNK_MSG_ID           0x11B
+#define TO_PARENT_OTA_ACK_MSG_ID            0x11C
+#define TO_CHILD_OTA_ROLLOUT_MSG_ID         0x11D
+#define TO_ROOT_OTA_REPORT_MSG_ID           0x11E
+
 /* ESP-NOW*/
 #define ESPNOW_QUEUE_MAXDELAY               10000 //10 seconds
 #define MAX_COMMS_ERROR                     10
 #define ESPNOW_QUEUE_SIZE                   5
+#define ESPNOW_RX_RING_SIZE                 16    // power of two, per lane
+#define ESPNOW_LATENCY_BUCKETS              12    // log2 buckets from 64 us up to ~65 ms
+#define ESPNOW_MAX_IN_FLIGHT                4     // global limit of unacknowledged frames
+#define ESPNOW_PEER_WINDOW                  2     // unacknowledged frames towards one peer
+#define ESPNOW_MAX_RETRIES                  3     // retransmissions of one frame before giving up
+#define ESPNOW_TX_SLOT_TIMEOUT_MS           500   // slot reclaimed if its send callback never comes
+#define ESPNOW_TX_ORPHAN_TIMEOUT_MS         5000  // a reclaimed frame's late callback is no longer expected after this
+#define ESPNOW_DEFERRED_MAX                 4     // sends espnow_task queued instead of waiting for a slot
+#define ESPNOW_HANDSHAKE_ENCRYPT_MS         500   // RX gets DATA_ASK_DYNAMIC in clear, TX encrypts the peer after this
 
 #define ESPNOW_PMK                          "pmk1234567890999" // ESP-NOW primary master key
 #define ESPNOW_LMK                          "lmk1234567890999" // ESP-NOW local master key
@@ -52,31 +98,94 @@ typedef struct {
 /* ESP-NOW structs */
 typedef enum {
     ID_ESPNOW_SEND_CB,
-    ID_ESPNOW_RECV_CB,
+    ID_ESPNOW_LOC_HANDSHAKE,            // pad won an RX: lock it on ESP-NOW (posted by the localization handlers)
 } espnow_event_id_t;
 
 typedef struct {
     uint8_t mac_addr[ESP_NOW_ETH_ALEN];
     esp_now_send_status_t status;
+    int8_t slot;                        // send slot to retransmit, -1 if already released
+    uint16_t seq;                       // slot seq at the callback - tells a reclaimed and reused slot apart
 } espnow_event_send_cb_t;
 
 typedef struct {
-    uint8_t mac_addr[ESP_NOW_ETH_ALEN];
-    uint8_t *data;
-    int data_len;
-} espnow_event_recv_cb_t;
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN]; // RX to lock
+} espnow_event_handshake_t;
 
 typedef union {
     espnow_event_send_cb_t send_cb;
-    espnow_event_recv_cb_t recv_cb;
+    espnow_event_handshake_t handshake;
 } espnow_event_info_t;
 
-/* When ESPNOW sending or receiving callback function is called, post event to ESPNOW task. */
+/* When ESPNOW sending callback function is called, post event to ESPNOW task. */
 typedef struct {
     espnow_event_id_t id;
+    int64_t enqueue_us;                 // esp_timer time the callback posted it
     espnow_event_info_t info;
 } espnow_event_t;
 
+/* ESP-NOW processing lanes, high is always served first */
+typedef enum {
+    ESPNOW_LANE_HIGH,                   // DATA_ALERT, DATA_RX_LEFT
+    ESPNOW_LANE_NORMAL,                 // Everything else, including send-callback events
+    ESPNOW_LANE_MAX
+} espnow_lane_t;
+
+/* Callback-to-handler latency histogram of one lane */
+typedef struct {
+    uint32_t bucket[ESPNOW_LATENCY_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+} espnow_latency_hist_t;
+
+/* Received ESP-NOW frame, copied by value into the receive ring */
+typedef struct {
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN];
+    espnow_data_t data;
+    int data_len;
+    int8_t rssi;
+    int64_t enqueue_us;                 // esp_timer time the callback stored it
+} espnow_rx_frame_t;
+
+/* ESP-NOW receive path counters and per-lane latency */
+typedef struct {
+    uint32_t rx_frames;             // Frames stored in the ring
+    uint32_t dropped_full[ESPNOW_LANE_MAX]; // Frames dropped because the lane ring was full
+    uint32_t dropped_bad_len;       // Frames dropped because of unexpected size
+    uint32_t queue_overruns;        // Send-callback events lost because the queue was full
+    uint32_t normal_item_max_us;    // Longest normal lane item - bounds how long a high lane frame waits
+    espnow_latency_hist_t latency[ESPNOW_LANE_MAX];
+} espnow_rx_stats_t;
+
+/**
+ * @brief Get ESP-NOW receive path counters
+ * 
+ * @param stats Output counters
+ */
+void espnow_get_rx_stats(espnow_rx_stats_t *stats);
+
+/* ESP-NOW send path counters */
+typedef struct {
+    uint32_t sent;                  // Frames handed to ESP-NOW (first transmission)
+    uint8_t in_flight;              // Slots currently waiting for a send callback or retransmission
+    uint32_t retransmissions;       // Failed frames sent again
+    uint32_t given_up;              // Frames dropped after ESPNOW_MAX_RETRIES
+    uint32_t window_waits;          // Times a sender waited for its peer window
+    uint32_t stale_reclaimed;       // Slots reclaimed after ESPNOW_TX_SLOT_TIMEOUT_MS
+    uint32_t late_callbacks;        // Callbacks of reclaimed frames, matched to them instead of a newer frame
+    uint32_t lost_callbacks;        // Reclaimed frames whose callback never came (a later frame's came first)
+    uint32_t stale_events;          // Send-callback events whose slot was reclaimed before espnow_task got to them
+    uint32_t deferred;              // Sends espnow_task queued because no slot was free
+    uint32_t deferred_dropped;      // Sends lost because the deferred queue was full
+} espnow_tx_stats_t;
+
+/**
+ * @brief Get ESP-NOW send path counters
+ * 
+ * @param stats Output counters
+ */
+void espnow_get_tx_stats(espnow_tx_stats_t *stats);
+
 /**
  * @brief Initialize the Wi-Fi mesh network.
  * 
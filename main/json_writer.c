@@ -0,0 +1,227 @@
+#include "json_writer.h"
+
+#include <math.h>
+#include <string.h>
+
+static const uint32_t pow10_table[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+/*******************************************************
+ *                Raw output
+ *******************************************************/
+
+static void put_char(json_writer_t *jw, char c)
+{
+    if (jw->overflow || jw->len + 1 >= jw->cap) {
+        jw->overflow = true;
+        return;
+    }
+    jw->buf[jw->len++] = c;
+}
+
+static void put_raw(json_writer_t *jw, const char *s, size_t n)
+{
+    if (jw->overflow || jw->len + n >= jw->cap) {
+        jw->overflow = true;
+        return;
+    }
+    memcpy(&jw->buf[jw->len], s, n);
+    jw->len += n;
+}
+
+static void put_u64(json_writer_t *jw, uint64_t v)
+{
+    char tmp[20];
+    int i = sizeof(tmp);
+
+    do {
+        tmp[--i] = (char)('0' + (v % 10));
+        v /= 10;
+    } while (v != 0);
+
+    put_raw(jw, &tmp[i], sizeof(tmp) - i);
+}
+
+static void put_escaped(json_writer_t *jw, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    put_char(jw, '"');
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            put_char(jw, '\\');
+            put_char(jw, (char)c);
+        } else if (c < 0x20) {
+            char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+            put_raw(jw, esc, sizeof(esc));
+        } else {
+            put_char(jw, (char)c);
+        }
+    }
+    put_char(jw, '"');
+}
+
+/* Comma (if needed) and "key": in front of every value */
+static void put_prefix(json_writer_t *jw, const char *key)
+{
+    uint16_t bit = (uint16_t)(1u << jw->depth);
+
+    if (jw->has_items & bit)
+        put_char(jw, ',');
+    jw->has_items |= bit;
+
+    if (key) {
+        put_escaped(jw, key);
+        put_char(jw, ':');
+    }
+}
+
+static void container_begin(json_writer_t *jw, const char *key, char open)
+{
+    put_prefix(jw, key);
+    put_char(jw, open);
+
+    if (jw->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        jw->overflow = true;
+        return;
+    }
+    jw->depth++;
+    jw->has_items &= (uint16_t)~(1u << jw->depth);
+}
+
+static void container_end(json_writer_t *jw, char close)
+{
+    if (jw->depth > 0)
+        jw->depth--;
+    put_char(jw, close);
+}
+
+/*******************************************************
+ *                Public API
+ *******************************************************/
+
+void json_writer_init(json_writer_t *jw, char *buf, size_t cap)
+{
+    jw->buf = buf;
+    jw->cap = cap;
+    jw->len = 0;
+    jw->overflow = (buf == NULL || cap == 0);
+    jw->depth = 0;
+    jw->has_items = 0;
+}
+
+void json_writer_object_begin(json_writer_t *jw, const char *key)
+{
+    container_begin(jw, key, '{');
+}
+
+void json_writer_object_end(json_writer_t *jw)
+{
+    container_end(jw, '}');
+}
+
+void json_writer_array_begin(json_writer_t *jw, const char *key)
+{
+    container_begin(jw, key, '[');
+}
+
+void json_writer_array_end(json_writer_t *jw)
+{
+    container_end(jw, ']');
+}
+
+void json_writer_uint(json_writer_t *jw, const char *key, uint32_t value)
+{
+    put_prefix(jw, key);
+    put_u64(jw, value);
+}
+
+void json_writer_int(json_writer_t *jw, const char *key, int32_t value)
+{
+    put_prefix(jw, key);
+    if (value < 0) {
+        put_char(jw, '-');
+        put_u64(jw, (uint64_t)(-(int64_t)value));
+    } else {
+        put_u64(jw, (uint64_t)value);
+    }
+}
+
+void json_writer_bool(json_writer_t *jw, const char *key, bool value)
+{
+    put_prefix(jw, key);
+    if (value)
+        put_raw(jw, "true", 4);
+    else
+        put_raw(jw, "false", 5);
+}
+
+void json_writer_string(json_writer_t *jw, const char *key, const char *value)
+{
+    put_prefix(jw, key);
+    put_escaped(jw, value ? value : "");
+}
+
+void json_writer_null(json_writer_t *jw, const char *key)
+{
+    put_prefix(jw, key);
+    put_raw(jw, "null", 4);
+}
+
+void json_writer_float(json_writer_t *jw, const char *key, float value, uint8_t decimals)
+{
+    put_prefix(jw, key);
+
+    // same as cJSON for values JSON cannot represent
+    if (isnan(value) || isinf(value) || fabsf(value) >= 1e12f) {
+        put_raw(jw, "null", 4);
+        return;
+    }
+
+    if (decimals > 6)
+        decimals = 6;
+    const uint32_t scale = pow10_table[decimals];
+
+    double a = fabs((double)value);
+    uint64_t fixed = (uint64_t)(a * scale + 0.5);
+    uint64_t int_part = fixed / scale;
+    uint32_t frac_part = (uint32_t)(fixed % scale);
+
+    if (value < 0 && fixed != 0)
+        put_char(jw, '-');
+    put_u64(jw, int_part);
+
+    if (decimals) {
+        put_char(jw, '.');
+        for (uint32_t div = scale / 10; div > 0; div /= 10) {
+            put_char(jw, (char)('0' + (frac_part / div) % 10));
+        }
+    }
+}
+
+void json_writer_mac(json_writer_t *jw, const char *key, const uint8_t *mac)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char str[17];
+
+    for (int i = 0; i < 6; i++) {
+        str[i * 3] = hex[mac[i] >> 4];
+        str[i * 3 + 1] = hex[mac[i] & 0xF];
+        if (i < 5)
+            str[i * 3 + 2] = ':';
+    }
+
+    put_prefix(jw, key);
+    put_char(jw, '"');
+    put_raw(jw, str, sizeof(str));
+    put_char(jw, '"');
+}
+
+const char *json_writer_finish(json_writer_t *jw)
+{
+    if (jw->overflow || jw->depth != 0)
+        return NULL;
+
+    jw->buf[jw->len] = '\0';
+    return jw->buf;
+}
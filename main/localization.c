@@ -0,0 +1,263 @@
+#include "localization.h"
+
+#include <string.h>
+
+void loc_scheduler_init(loc_scheduler_t *s, const loc_config_t *config)
+{
+    memset(s, 0, sizeof(*s));
+    s->config = *config;
+    if (s->config.group_max == 0)
+        s->config.group_max = 1;
+}
+
+bool loc_adjacent(const loc_config_t *config, int8_t a, int8_t b)
+{
+    if (a == b)
+        return true;
+
+    int diff = a > b ? a - b : b - a;
+    if (config->distance && diff <= config->distance)
+        return true;
+
+    for (size_t i = 0; i < config->pair_count; i++) {
+        if ((config->pairs[i].a == a && config->pairs[i].b == b) ||
+            (config->pairs[i].a == b && config->pairs[i].b == a))
+            return true;
+    }
+    return false;
+}
+
+static bool contains(const int8_t *list, uint8_t count, int8_t pos)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        if (list[i] == pos)
+            return true;
+    }
+    return false;
+}
+
+static void retry_push(loc_scheduler_t *s, int8_t pos)
+{
+    if (s->retry_count < LOCALIZATION_MAX_PADS && !contains(s->retry, s->retry_count, pos))
+        s->retry[s->retry_count++] = pos;
+}
+
+static int8_t retry_pop(loc_scheduler_t *s)
+{
+    int8_t pos = s->retry[0];
+    s->retry_count--;
+    memmove(&s->retry[0], &s->retry[1], s->retry_count);
+    return pos;
+}
+
+uint8_t loc_next_group(loc_scheduler_t *s, const int8_t *candidates, uint8_t count, int8_t *group)
+{
+    if (count > LOCALIZATION_MAX_PADS)
+        count = LOCALIZATION_MAX_PADS;
+    if (count == 0)
+        return 0;
+
+    // ambiguous pads are resolved one at a time, like the old baton
+    while (s->retry_count) {
+        int8_t pos = retry_pop(s);
+        if (contains(candidates, count, pos)) {
+            group[0] = pos;
+            return 1;
+        }
+    }
+
+    // sorted copy, so the groups do not depend on the peer list order
+    int8_t sorted[LOCALIZATION_MAX_PADS];
+    memcpy(sorted, candidates, count);
+    for (uint8_t i = 1; i < count; i++) {
+        int8_t v = sorted[i];
+        int j = i - 1;
+        while (j >= 0 && sorted[j] > v) {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = v;
+    }
+
+    // greedy colouring: first group without an adjacent pad and with room
+    uint8_t color[LOCALIZATION_MAX_PADS];
+    uint8_t size[LOCALIZATION_MAX_PADS] = {0};
+    uint8_t groups = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t g;
+        for (g = 0; g < groups; g++) {
+            if (size[g] >= s->config.group_max)
+                continue;
+            bool clash = false;
+            for (uint8_t j = 0; j < i && !clash; j++)
+                clash = (color[j] == g) && loc_adjacent(&s->config, sorted[i], sorted[j]);
+            if (!clash)
+                break;
+        }
+        if (g == groups)
+            groups++;
+        color[i] = g;
+        size[g]++;
+    }
+
+    uint8_t pick = s->next_group % groups;
+    s->next_group = (uint8_t)((pick + 1) % groups);
+
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (color[i] == pick)
+            group[n++] = sorted[i];
+    }
+    return n;
+}
+
+void loc_claims_reset(loc_claims_t *c)
+{
+    c->count = 0;
+}
+
+bool loc_claims_add(loc_claims_t *c, const uint8_t *rx_mac, int8_t position, int8_t rssi)
+{
+    for (uint8_t i = 0; i < c->count; i++) {
+        loc_claim_t *cl = &c->claims[i];
+        if (cl->position == position && memcmp(cl->rx_mac, rx_mac, 6) == 0) {
+            if (rssi > cl->rssi)
+                cl->rssi = rssi;
+            return true;
+        }
+    }
+
+    loc_claim_t *cl;
+    if (c->count < LOCALIZATION_MAX_CLAIMS) {
+        cl = &c->claims[c->count++];
+    } else {
+        // full: the weakest claim goes, the pad under a scooter is always among the strongest
+        cl = &c->claims[0];
+        for (uint8_t i = 1; i < c->count; i++) {
+            if (c->claims[i].rssi < cl->rssi)
+                cl = &c->claims[i];
+        }
+        c->dropped++;
+        if (rssi <= cl->rssi)
+            return false;
+    }
+
+    memcpy(cl->rx_mac, rx_mac, 6);
+    cl->position = position;
+    cl->rssi = rssi;
+    return true;
+}
+
+void loc_claims_forget(loc_claims_t *c, const uint8_t *rx_mac)
+{
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < c->count; i++) {
+        if (memcmp(c->claims[i].rx_mac, rx_mac, 6) != 0)
+            c->claims[n++] = c->claims[i];
+    }
+    c->count = n;
+}
+
+bool loc_claims_rank(const loc_claims_t *c, const int8_t *candidates, uint8_t count,
+                     uint8_t rssi_margin, loc_assignment_t *hint)
+{
+    int best_lead = -1;
+
+    for (uint8_t i = 0; i < c->count; i++) {
+        const loc_claim_t *first = &c->claims[i];
+        if (!contains(candidates, count, first->position))
+            continue;
+
+        // each RX is ranked once, from its first candidate claim
+        bool seen = false;
+        for (uint8_t j = 0; j < i && !seen; j++)
+            seen = memcmp(c->claims[j].rx_mac, first->rx_mac, 6) == 0 &&
+                   contains(candidates, count, c->claims[j].position);
+        if (seen)
+            continue;
+
+        const loc_claim_t *best = NULL;
+        const loc_claim_t *second = NULL;
+        for (uint8_t j = i; j < c->count; j++) {
+            const loc_claim_t *cl = &c->claims[j];
+            if (memcmp(cl->rx_mac, first->rx_mac, 6) != 0 || !contains(candidates, count, cl->position))
+                continue;
+            if (best == NULL || cl->rssi > best->rssi) {
+                second = best;
+                best = cl;
+            } else if (second == NULL || cl->rssi > second->rssi) {
+                second = cl;
+            }
+        }
+
+        // a single report leads by definition
+        int lead = second ? best->rssi - second->rssi : INT8_MAX - INT8_MIN;
+        if (lead < rssi_margin || lead <= best_lead)
+            continue;
+
+        best_lead = lead;
+        memcpy(hint->rx_mac, best->rx_mac, 6);
+        hint->position = best->position;
+    }
+
+    return best_lead >= 0;
+}
+
+uint8_t loc_claims_resolve(const loc_claims_t *c, loc_scheduler_t *s, loc_assignment_t *out, uint8_t max_out)
+{
+    // claim indexes by decreasing RSSI
+    uint8_t order[LOCALIZATION_MAX_CLAIMS];
+    for (uint8_t i = 0; i < c->count; i++) {
+        uint8_t j = i;
+        while (j > 0 && c->claims[order[j - 1]].rssi < c->claims[i].rssi) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    bool done[LOCALIZATION_MAX_CLAIMS] = {false};
+    uint8_t n = 0;
+
+    // strongest claim first: each RX is decided by its best two pads
+    for (uint8_t i = 0; i < c->count; i++) {
+        if (done[i])
+            continue;
+
+        const loc_claim_t *best = &c->claims[order[i]];
+        const loc_claim_t *second = NULL;
+
+        for (uint8_t j = i; j < c->count; j++) {
+            const loc_claim_t *cl = &c->claims[order[j]];
+            if (memcmp(cl->rx_mac, best->rx_mac, 6) != 0)
+                continue;
+            done[j] = true;
+            if (second == NULL && cl->position != best->position && j != i)
+                second = cl;
+        }
+
+        if (second != NULL && best->rssi - second->rssi < s->config.rssi_margin) {
+            // too close to call - every pad within the margin is retried alone
+            for (uint8_t j = i; j < c->count; j++) {
+                const loc_claim_t *cl = &c->claims[order[j]];
+                if (memcmp(cl->rx_mac, best->rx_mac, 6) == 0 && best->rssi - cl->rssi < s->config.rssi_margin)
+                    retry_push(s, cl->position);
+            }
+            continue;
+        }
+
+        // a pad charges one scooter - a weaker RX on a taken pad waits for a later sweep
+        bool taken = false;
+        for (uint8_t k = 0; k < n && !taken; k++)
+            taken = (out[k].position == best->position);
+        if (taken || n >= max_out)
+            continue;
+
+        memcpy(out[n].rx_mac, best->rx_mac, 6);
+        out[n].position = best->position;
+        n++;
+    }
+
+    return n;
+}
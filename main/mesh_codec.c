@@ -0,0 +1,233 @@
+#include "mesh_codec.h"
+
+static const char *TAG = "MESH_CODEC";
+
+static mesh_codec_stats_t codec_stats;
+
+/* Field indexes, generated from the schemas */
+#define MESH_CODEC_FIELD_ENUM(name, type, member, scale)    DYN_##name,
+enum { MESH_DYNAMIC_SCHEMA(MESH_CODEC_FIELD_ENUM) DYN_FIELD_COUNT };
+#undef MESH_CODEC_FIELD_ENUM
+
+#define MESH_CODEC_FIELD_ENUM(name, type, member, scale)    ALR_##name,
+enum { MESH_ALERT_SCHEMA(MESH_CODEC_FIELD_ENUM) ALR_FIELD_COUNT };
+#undef MESH_CODEC_FIELD_ENUM
+
+_Static_assert(DYN_FIELD_COUNT <= 16, "dynamic schema exceeds the 16-bit field mask");
+_Static_assert(ALR_FIELD_COUNT <= 16, "alert schema exceeds the 16-bit field mask");
+
+/* ---------------------------------------------------------------------------
+ *  Primitive writers / readers
+ * ------------------------------------------------------------------------- */
+
+static inline int16_t fix16_from_float(float v, int scale)
+{
+    float s = v * (float)scale;
+    if (s >= 32767.0f) return INT16_MAX;
+    if (s <= -32768.0f) return INT16_MIN;
+    return (int16_t)(s < 0 ? s - 0.5f : s + 0.5f);
+}
+
+static inline float fix16_to_float(int16_t v, int scale)
+{
+    return (float)v / (float)scale;
+}
+
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/* Encode one field of type T from src into p */
+#define ENC_U8(p, src, scale)       do { *(p) = (uint8_t)(src); } while (0)
+#define ENC_FIX16(p, src, scale)    put_u16((p), (uint16_t)fix16_from_float((src), (scale)))
+#define ENC_MAC(p, src, scale)      memcpy((p), (src), ETH_HWADDR_LEN)
+
+/* Decode one field of type T from p into dst */
+#define DEC_U8(p, dst, scale)       do { (dst) = (__typeof__(dst))*(p); } while (0)
+#define DEC_FIX16(p, dst, scale)    do { (dst) = fix16_to_float((int16_t)get_u16(p), (scale)); } while (0)
+#define DEC_MAC(p, dst, scale)      memcpy((dst), (p), ETH_HWADDR_LEN)
+
+/* True when the field differs once quantized (what the root would see) */
+#define NEQ_U8(a, b, scale)         ((uint8_t)(a) != (uint8_t)(b))
+#define NEQ_FIX16(a, b, scale)      (fix16_from_float((a), (scale)) != fix16_from_float((b), (scale)))
+#define NEQ_MAC(a, b, scale)        (memcmp((a), (b), ETH_HWADDR_LEN) != 0)
+
+static size_t write_header(uint8_t *buf, mesh_codec_kind_t kind, uint16_t mask, const uint8_t *mac,
+                           uint8_t seq, uint8_t base)
+{
+    buf[0] = MESH_CODEC_VERSION;
+    buf[1] = (uint8_t)kind;
+    put_u16(&buf[2], mask);
+    memcpy(&buf[4], mac, ETH_HWADDR_LEN);
+    buf[10] = seq;
+    buf[11] = base;
+    return MESH_CODEC_HEADER_LEN;
+}
+
+/* ---------------------------------------------------------------------------
+ *  Encoders
+ * ------------------------------------------------------------------------- */
+
+size_t mesh_codec_encode_dynamic(const mesh_dynamic_payload_t *cur, const mesh_dynamic_payload_t *prev,
+                                 uint8_t seq, uint8_t *buf, size_t buf_len)
+{
+    if (cur == NULL || buf == NULL || buf_len < MESH_CODEC_DYNAMIC_MAX_LEN)
+        return 0;
+
+    uint16_t mask = 0;
+    uint8_t *p = buf + MESH_CODEC_HEADER_LEN;
+
+#define X(name, type, member, scale)                                            \
+    if (prev == NULL || NEQ_##type(cur->member, prev->member, scale)) {         \
+        ENC_##type(p, cur->member, scale);                                      \
+        p += MESH_CODEC_SIZE_##type;                                            \
+        mask |= (uint16_t)(1u << DYN_##name);                                   \
+    }
+    MESH_DYNAMIC_SCHEMA(X)
+#undef X
+
+    write_header(buf, MESH_CODEC_KIND_DYNAMIC, mask, cur->TX.macAddr, seq, prev ? (uint8_t)(seq - 1) : seq);
+    return (size_t)(p - buf);
+}
+
+size_t mesh_codec_encode_alert(const mesh_alert_payload_t *cur, uint8_t seq, uint8_t *buf, size_t buf_len)
+{
+    if (cur == NULL || buf == NULL || buf_len < MESH_CODEC_ALERT_MAX_LEN)
+        return 0;
+
+    uint16_t mask = 0;
+    uint8_t *p = buf + MESH_CODEC_HEADER_LEN;
+
+#define X(name, type, member, scale)                                            \
+    ENC_##type(p, cur->member, scale);                                          \
+    p += MESH_CODEC_SIZE_##type;                                                \
+    mask |= (uint16_t)(1u << ALR_##name);
+    MESH_ALERT_SCHEMA(X)
+#undef X
+
+    write_header(buf, MESH_CODEC_KIND_ALERT, mask, cur->TX.macAddr, seq, seq);
+    return (size_t)(p - buf);
+}
+
+/* ---------------------------------------------------------------------------
+ *  Decoders
+ * ------------------------------------------------------------------------- */
+
+static esp_err_t check_header(const uint8_t *buf, size_t len, mesh_codec_kind_t kind)
+{
+    if (buf == NULL || len < MESH_CODEC_HEADER_LEN) {
+        codec_stats.truncated++;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // any minor of our major only appends fields; another major has another layout
+    if (MESH_CODEC_MAJOR(buf[0]) != MESH_CODEC_VERSION_MAJOR) {
+        codec_stats.bad_major++;
+        ESP_LOGW(TAG, "Rejected frame of codec version %d.%d", MESH_CODEC_MAJOR(buf[0]), buf[0] & 0x0F);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (buf[1] != (uint8_t)kind) {
+        codec_stats.bad_kind++;
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+const uint8_t *mesh_codec_frame_key(const uint8_t *buf, size_t len, mesh_codec_kind_t kind)
+{
+    if (check_header(buf, len, kind) != ESP_OK)
+        return NULL;
+    return &buf[4];
+}
+
+esp_err_t mesh_codec_decode_dynamic(const uint8_t *buf, size_t len, mesh_dynamic_payload_t *dst, mesh_codec_rx_t *rx)
+{
+    esp_err_t err = check_header(buf, len, MESH_CODEC_KIND_DYNAMIC);
+    if (err != ESP_OK)
+        return err;
+
+    const uint8_t seq = buf[10];
+    const uint8_t base = buf[11];
+    // a full frame always applies (a rebooted child restarts its seq), a delta only on top of
+    // the very frame it was computed against
+    if (rx != NULL && base != seq) {
+        if (rx->synced && seq == rx->seq) {
+            codec_stats.duplicates++;
+            return ESP_OK;
+        }
+        if (!rx->synced || base != rx->seq) {
+            codec_stats.out_of_sync++;
+            rx->synced = false;
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+
+    const uint16_t mask = get_u16(&buf[2]);
+    const uint8_t *p = buf + MESH_CODEC_HEADER_LEN;
+    const uint8_t *end = buf + len;
+
+    // decode into a copy so a truncated frame leaves dst untouched
+    mesh_dynamic_payload_t tmp = *dst;
+    memcpy(tmp.TX.macAddr, &buf[4], ETH_HWADDR_LEN);
+
+#define X(name, type, member, scale)                                            \
+    if (mask & (1u << DYN_##name)) {                                            \
+        if (end - p < MESH_CODEC_SIZE_##type) {                                 \
+            ESP_LOGW(TAG, "Truncated dynamic frame (%u bytes)", (unsigned)len); \
+            codec_stats.truncated++;                                            \
+            return ESP_ERR_INVALID_SIZE;                                        \
+        }                                                                       \
+        DEC_##type(p, tmp.member, scale);                                       \
+        p += MESH_CODEC_SIZE_##type;                                            \
+    }
+    MESH_DYNAMIC_SCHEMA(X)
+#undef X
+
+    *dst = tmp;
+    if (rx != NULL) {
+        rx->seq = seq;
+        rx->synced = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mesh_codec_decode_alert(const uint8_t *buf, size_t len, mesh_alert_payload_t *dst)
+{
+    esp_err_t err = check_header(buf, len, MESH_CODEC_KIND_ALERT);
+    if (err != ESP_OK)
+        return err;
+
+    const uint16_t mask = get_u16(&buf[2]);
+    const uint8_t *p = buf + MESH_CODEC_HEADER_LEN;
+    const uint8_t *end = buf + len;
+
+    mesh_alert_payload_t tmp = *dst;
+    memcpy(tmp.TX.macAddr, &buf[4], ETH_HWADDR_LEN);
+
+#define X(name, type, member, scale)                                            \
+    if (mask & (1u << ALR_##name)) {                                            \
+        if (end - p < MESH_CODEC_SIZE_##type) {                                 \
+            ESP_LOGW(TAG, "Truncated alert frame (%u bytes)", (unsigned)len);   \
+            codec_stats.truncated++;                                            \
+            return ESP_ERR_INVALID_SIZE;                                        \
+        }                                                                       \
+        DEC_##type(p, tmp.member, scale);                                       \
+        p += MESH_CODEC_SIZE_##type;                                            \
+    }
+    MESH_ALERT_SCHEMA(X)
+#undef X
+
+    *dst = tmp;
+    return ESP_OK;
+}
+
+void mesh_codec_get_stats(mesh_codec_stats_t *stats)
+{
+    *stats = codec_stats;
+}
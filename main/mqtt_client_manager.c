@@ -1,4 +1,5 @@
 #include "mqtt_client_manager.h"
+#include "esp_sntp.h"
 
 static const char *TAG = "MQTT_CLIENT";
 
@@ -38,7 +39,16 @@ static TaskHandle_t mqtt_publish_task_handle = NULL;
 /* Topics */
 static const char *baseTopic = "bumblebee";
 static const char *dynamicTopic = "dynamic";
+static const char *dynamicBatchTopic = "dynamic_batch";
+static const char *dynamicReplayTopic = "dynamic_replay";
+static const char *telemetryLogTopic = "telemetry_log";
+static const char *summaryTopic = "summary";
 static const char *alertTopic = "alerts";
+#if MQTT_PAYLOAD_ENCODING == MQTT_ENCODING_MSGPACK
+static const char *encodingSuffix = "/msgpack";   // content type, consumers subscribe per encoding
+#else
+static const char *encodingSuffix = "";
+#endif
 static const char *controlTopic = "bumblebee/control";
 
 //OTA MQTT TOPIC
@@ -48,19 +58,19 @@ static const char *otaTopic = "bumblebee/ota/start";
  *                JSON Helper Functions
  *******************************************************/
 
-/**
- * @brief Convert MAC address to string format
- */
-static void mac_to_string(const uint8_t *mac, char *str, size_t len)
-{
-    snprintf(str, len, "%02X:%02X:%02X:%02X:%02X:%02X",
-             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-}
+/* Output buffer of the payload encoders - only used from mqtt_publish_task */
+static uint8_t payload_buffer[MQTT_PAYLOAD_BUFFER_SIZE];
+
+/* Store-and-forward log - owned by mqtt_publish_task once mounted */
+static telemetry_log_t telemetry_log;
+static bool telemetry_log_mounted = false;
 
 /**
  * @brief Handle OTA command from MQTT
  * 
  * Expected JSON format: {"sha256":"64-character-hex-string"}
+ * Optional rollout fields: "canary", "concurrent", "max_failures"
+ * (defaults OTA_MESH_CANARY_NODES, OTA_MESH_CONCURRENT, OTA_MESH_MAX_FAILURES)
  * 
  * @param data Pointer to received data
  * @param data_len Length of received data
@@ -69,6 +79,11 @@ static void handle_ota_command(const char *data, int data_len)
 {
     ESP_LOGW(TAG, "OTA UPDATE COMMAND RECEIVED!");
     
+    if (ota_mesh_is_busy()) {
+        ESP_LOGW(TAG, "Mesh OTA relay or rollout in progress - ignoring command");
+        return;
+    }
+    
     // Parse JSON to extract SHA256
     cJSON *root = cJSON_ParseWithLength(data, data_len);
     if (!root) {
@@ -93,14 +108,23 @@ static void handle_ota_command(const char *data, int data_len)
         ESP_LOGW(TAG, "No SHA256 in OTA command - update will proceed without verification");
     }
 
-    //TODO:
-    // Let childs download first
-    // Send MAC - SHA256 to one child per time (from peer struct)
-    // wait for child to confirm/timeout
-    // repeat for all childs
-    // Master download at last
-    
-    // Start OTA update
+    int canary = OTA_MESH_CANARY_NODES;
+    int concurrent = OTA_MESH_CONCURRENT;
+    int max_failures = OTA_MESH_MAX_FAILURES;
+    cJSON *item = cJSON_GetObjectItem(root, "canary");
+    if (cJSON_IsNumber(item) && item->valueint >= 0 && item->valueint <= OTA_ROLLOUT_MAX_ACTIVE)
+        canary = item->valueint;
+    item = cJSON_GetObjectItem(root, "concurrent");
+    if (cJSON_IsNumber(item) && item->valueint >= 1 && item->valueint <= OTA_ROLLOUT_MAX_ACTIVE)
+        concurrent = item->valueint;
+    item = cJSON_GetObjectItem(root, "max_failures");
+    if (cJSON_IsNumber(item) && item->valueint >= 0 && item->valueint <= UINT8_MAX)
+        max_failures = item->valueint;
+    ota_mesh_set_rollout(canary, concurrent, max_failures);
+    ESP_LOGI(TAG, "OTA rollout: %d canary, %d at a time, %d failures tolerated", canary, concurrent, max_failures);
+
+    // Start OTA update - the root downloads once, ota_mesh relays the staged
+    // image hop by hop, then activates it node by node (ota_rollout)
     esp_err_t err = ota_start_update(sha256);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to start OTA: %s", esp_err_to_name(err));
@@ -109,140 +133,477 @@ static void handle_ota_command(const char *data, int data_len)
     cJSON_Delete(root);
 }
 
+#if MQTT_PAYLOAD_ENCODING == MQTT_ENCODING_JSON
 /**
- * @brief Create JSON string from dynamic payload
+ * @brief Write dynamic payload as a JSON object
  * 
+ * @param jw JSON writer (object is added at top level or as array element)
  * @param payload Pointer to dynamic payload struct
  * @param node_id Unit ID to include in JSON
- * @return char* JSON string (must be freed by caller), NULL on error
  */
-static char* dynamic_payload_to_json(const mesh_dynamic_payload_t *payload, uint8_t node_id)
+static void dynamic_payload_to_json(json_writer_t *jw, const mesh_dynamic_payload_t *payload, uint8_t node_id)
 {
-    if (!payload) {
-        ESP_LOGE(TAG, "Null payload pointer");
-        return NULL;
-    }
+    json_writer_object_begin(jw, NULL);
 
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
-        ESP_LOGE(TAG, "Failed to create JSON root");
-        return NULL;
-    }
+    // Add unit ID
+    json_writer_uint(jw, "unit_id", node_id);
+
+    // TX object
+    json_writer_object_begin(jw, "tx");
+    json_writer_mac(jw, "mac", payload->TX.macAddr);
+    json_writer_uint(jw, "id", payload->TX.id);
+    json_writer_uint(jw, "status", payload->TX.tx_status);
+    json_writer_float(jw, "voltage", payload->TX.voltage, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "current", payload->TX.current, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "temp1", payload->TX.temp1, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "temp2", payload->TX.temp2, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_object_end(jw);
+
+    // RX object
+    json_writer_object_begin(jw, "rx");
+    json_writer_mac(jw, "mac", payload->RX.macAddr);
+    json_writer_uint(jw, "id", payload->RX.id);
+    json_writer_uint(jw, "status", payload->RX.rx_status);
+    json_writer_float(jw, "voltage", payload->RX.voltage, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "current", payload->RX.current, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "temp1", payload->RX.temp1, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "temp2", payload->RX.temp2, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_object_end(jw);
+
+    json_writer_object_end(jw);
+}
+
+/**
+ * @brief Write alert payload as a JSON object
+ * 
+ * @param jw JSON writer
+ * @param payload Pointer to alert payload struct
+ * @param node_id Unit ID to include in JSON
+ */
+static void alert_payload_to_json(json_writer_t *jw, const mesh_alert_payload_t *payload, uint8_t node_id)
+{
+    json_writer_object_begin(jw, NULL);
 
     // Add unit ID
-    cJSON_AddNumberToObject(root, "unit_id", node_id);
+    json_writer_uint(jw, "unit_id", node_id);
 
-    // Create TX object
-    cJSON *tx_obj = cJSON_CreateObject();
-    if (tx_obj) {
-        char mac_str[18];
-        mac_to_string(payload->TX.macAddr, mac_str, sizeof(mac_str));
-        
-        cJSON_AddStringToObject(tx_obj, "mac", mac_str);
-        cJSON_AddNumberToObject(tx_obj, "id", payload->TX.id);
-        cJSON_AddNumberToObject(tx_obj, "status", payload->TX.tx_status);
-        cJSON_AddNumberToObject(tx_obj, "voltage", payload->TX.voltage);
-        cJSON_AddNumberToObject(tx_obj, "current", payload->TX.current);
-        cJSON_AddNumberToObject(tx_obj, "temp1", payload->TX.temp1);
-        cJSON_AddNumberToObject(tx_obj, "temp2", payload->TX.temp2);
-        
-        cJSON_AddItemToObject(root, "tx", tx_obj);
-    }
+    // TX alerts object
+    json_writer_object_begin(jw, "tx");
+    json_writer_mac(jw, "mac", payload->TX.macAddr);
+    json_writer_uint(jw, "id", payload->TX.id);
+    json_writer_bool(jw, "overtemperature", payload->TX.TX_internal.overtemperature);
+    json_writer_bool(jw, "overcurrent", payload->TX.TX_internal.overcurrent);
+    json_writer_bool(jw, "overvoltage", payload->TX.TX_internal.overvoltage);
+    json_writer_bool(jw, "fod", payload->TX.TX_internal.FOD);
+    json_writer_object_end(jw);
 
-    // Create RX object
-    cJSON *rx_obj = cJSON_CreateObject();
-    if (rx_obj) {
-        char mac_str[18];
-        mac_to_string(payload->RX.macAddr, mac_str, sizeof(mac_str));
-        
-        cJSON_AddStringToObject(rx_obj, "mac", mac_str);
-        cJSON_AddNumberToObject(rx_obj, "id", payload->RX.id);
-        cJSON_AddNumberToObject(rx_obj, "status", payload->RX.rx_status);
-        cJSON_AddNumberToObject(rx_obj, "voltage", payload->RX.voltage);
-        cJSON_AddNumberToObject(rx_obj, "current", payload->RX.current);
-        cJSON_AddNumberToObject(rx_obj, "temp1", payload->RX.temp1);
-        cJSON_AddNumberToObject(rx_obj, "temp2", payload->RX.temp2);
-        
-        cJSON_AddItemToObject(root, "rx", rx_obj);
+    // RX alerts object
+    json_writer_object_begin(jw, "rx");
+    json_writer_mac(jw, "mac", payload->RX.macAddr);
+    json_writer_uint(jw, "id", payload->RX.id);
+    json_writer_bool(jw, "overtemperature", payload->RX.RX_internal.overtemperature);
+    json_writer_bool(jw, "overcurrent", payload->RX.RX_internal.overcurrent);
+    json_writer_bool(jw, "overvoltage", payload->RX.RX_internal.overvoltage);
+    json_writer_bool(jw, "fully_charged", payload->RX.RX_internal.FullyCharged);
+    json_writer_object_end(jw);
+
+    json_writer_object_end(jw);
+}
+
+/**
+ * @brief Write a stored telemetry record as a JSON object
+ * 
+ * @param jw JSON writer
+ * @param r Record read from the telemetry log
+ * @param age_ms Sample age at replay (telemetry_log_age)
+ */
+static void telemetry_record_to_json(json_writer_t *jw, const telemetry_record_t *r, uint32_t age_ms)
+{
+    json_writer_object_begin(jw, NULL);
+
+    json_writer_uint(jw, "unit_id", r->tx_id);
+    json_writer_uint(jw, "seq", r->seq);
+    json_writer_uint(jw, "boot", r->boot);
+    json_writer_uint(jw, "uptime_ms", r->uptime_ms);
+    json_writer_uint(jw, "age_ms", age_ms);
+
+    json_writer_object_begin(jw, "tx");
+    json_writer_uint(jw, "id", r->tx_id);
+    json_writer_uint(jw, "status", r->tx_status);
+    json_writer_float(jw, "voltage", r->tx.voltage * TELEMETRY_VOLTAGE_UNIT, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "current", r->tx.current * TELEMETRY_CURRENT_UNIT, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "temp1", r->tx.temp1 * TELEMETRY_TEMP_UNIT, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "temp2", r->tx.temp2 * TELEMETRY_TEMP_UNIT, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_object_end(jw);
+
+    json_writer_object_begin(jw, "rx");
+    json_writer_uint(jw, "id", r->rx_id);
+    json_writer_uint(jw, "status", r->rx_status);
+    json_writer_float(jw, "voltage", r->rx.voltage * TELEMETRY_VOLTAGE_UNIT, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "current", r->rx.current * TELEMETRY_CURRENT_UNIT, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "temp1", r->rx.temp1 * TELEMETRY_TEMP_UNIT, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "temp2", r->rx.temp2 * TELEMETRY_TEMP_UNIT, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_object_end(jw);
+
+    json_writer_object_end(jw);
+}
+
+/**
+ * @brief Write the statistics of one value as {"min","max","mean","last"} (null without samples)
+ */
+static void summary_stat_to_json(json_writer_t *jw, const char *key, const telemetry_agg_stat_t *st)
+{
+    if (st->count == 0) {
+        json_writer_null(jw, key);
+        return;
     }
 
-    // Convert to string
-    char *json_string = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    
-    if (!json_string) {
-        ESP_LOGE(TAG, "Failed to print JSON");
-        return NULL;
+    json_writer_object_begin(jw, key);
+    json_writer_float(jw, "min", st->min, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "max", st->max, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "mean", telemetry_agg_mean(st), MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_float(jw, "last", st->last, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_object_end(jw);
+}
+
+/**
+ * @brief Write the summary window of a peer as a JSON object
+ * 
+ * @param jw JSON writer
+ * @param peer Snapshot entry holding a closed summary window
+ * @param now Current uptime (ms)
+ */
+static void summary_to_json(json_writer_t *jw, const TX_peer_snapshot_t *peer, uint32_t now)
+{
+    const telemetry_agg_window_t *w = &peer->summary;
+    const mesh_dynamic_payload_t *payload = &peer->dynamic_payload;
+
+    json_writer_object_begin(jw, NULL);
+
+    json_writer_uint(jw, "unit_id", peer->id);
+    json_writer_uint(jw, "span_ms", w->end_ms - w->start_ms);
+    json_writer_uint(jw, "age_ms", now - w->end_ms);
+    json_writer_uint(jw, "samples", w->samples);
+
+    json_writer_object_begin(jw, "tx");
+    json_writer_uint(jw, "id", payload->TX.id);
+    json_writer_uint(jw, "status", payload->TX.tx_status);
+    summary_stat_to_json(jw, "voltage", &w->tx[TELEMETRY_AGG_VOLTAGE]);
+    summary_stat_to_json(jw, "current", &w->tx[TELEMETRY_AGG_CURRENT]);
+    summary_stat_to_json(jw, "temp1", &w->tx[TELEMETRY_AGG_TEMP1]);
+    summary_stat_to_json(jw, "temp2", &w->tx[TELEMETRY_AGG_TEMP2]);
+    json_writer_float(jw, "energy_wh", w->tx_wh, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_object_end(jw);
+
+    json_writer_object_begin(jw, "rx");
+    json_writer_uint(jw, "id", payload->RX.id);
+    json_writer_uint(jw, "status", payload->RX.rx_status);
+    summary_stat_to_json(jw, "voltage", &w->rx[TELEMETRY_AGG_VOLTAGE]);
+    summary_stat_to_json(jw, "current", &w->rx[TELEMETRY_AGG_CURRENT]);
+    summary_stat_to_json(jw, "temp1", &w->rx[TELEMETRY_AGG_TEMP1]);
+    summary_stat_to_json(jw, "temp2", &w->rx[TELEMETRY_AGG_TEMP2]);
+    json_writer_float(jw, "energy_wh", w->rx_wh, MQTT_JSON_FLOAT_DECIMALS);
+    json_writer_object_end(jw);
+
+    json_writer_object_end(jw);
+}
+
+#endif /* MQTT_ENCODING_JSON */
+
+#if MQTT_PAYLOAD_ENCODING == MQTT_ENCODING_MSGPACK
+/*
+ * MessagePack encoding - same structure as the JSON with short keys:
+ *   dynamic  {"u":id,"t":{"m","i","s","v","c","t1","t2"},"r":{...}}
+ *   alert    {"u":id,"t":{"m","i","ot","oc","ov","fod"},"r":{"m","i","ot","oc","ov","fc"}}
+ *   batch    {"u":root,"p":[<dynamic>, ...]}
+ *   replay   {"u":root,"n":backlog,"p":[{"u","q","b","ms","a","t":{"i","s","v","c","t1","t2"},"r":{...}}, ...]}
+ *   summary  {"u":id,"ms":span,"a":age,"n":samples,"t":{"i","s","v","c","t1","t2","e"},"r":{...}}
+ *            with [min,max,mean,last] (nil without samples) for "v".."t2" and Wh in "e"
+ * Floats are float32, MACs the same "AA:BB:.." text as in JSON.
+ */
+
+/**
+ * @brief Write dynamic payload as a MessagePack map
+ */
+static void dynamic_payload_to_msgpack(msgpack_writer_t *mp, const mesh_dynamic_payload_t *payload, uint8_t node_id)
+{
+    msgpack_writer_map(mp, 3);
+    msgpack_writer_str(mp, "u");
+    msgpack_writer_uint(mp, node_id);
+
+    msgpack_writer_str(mp, "t");
+    msgpack_writer_map(mp, 7);
+    msgpack_writer_str(mp, "m");    msgpack_writer_mac(mp, payload->TX.macAddr);
+    msgpack_writer_str(mp, "i");    msgpack_writer_uint(mp, payload->TX.id);
+    msgpack_writer_str(mp, "s");    msgpack_writer_uint(mp, payload->TX.tx_status);
+    msgpack_writer_str(mp, "v");    msgpack_writer_float(mp, payload->TX.voltage);
+    msgpack_writer_str(mp, "c");    msgpack_writer_float(mp, payload->TX.current);
+    msgpack_writer_str(mp, "t1");   msgpack_writer_float(mp, payload->TX.temp1);
+    msgpack_writer_str(mp, "t2");   msgpack_writer_float(mp, payload->TX.temp2);
+
+    msgpack_writer_str(mp, "r");
+    msgpack_writer_map(mp, 7);
+    msgpack_writer_str(mp, "m");    msgpack_writer_mac(mp, payload->RX.macAddr);
+    msgpack_writer_str(mp, "i");    msgpack_writer_uint(mp, payload->RX.id);
+    msgpack_writer_str(mp, "s");    msgpack_writer_uint(mp, payload->RX.rx_status);
+    msgpack_writer_str(mp, "v");    msgpack_writer_float(mp, payload->RX.voltage);
+    msgpack_writer_str(mp, "c");    msgpack_writer_float(mp, payload->RX.current);
+    msgpack_writer_str(mp, "t1");   msgpack_writer_float(mp, payload->RX.temp1);
+    msgpack_writer_str(mp, "t2");   msgpack_writer_float(mp, payload->RX.temp2);
+}
+
+/**
+ * @brief Write alert payload as a MessagePack map
+ */
+static void alert_payload_to_msgpack(msgpack_writer_t *mp, const mesh_alert_payload_t *payload, uint8_t node_id)
+{
+    msgpack_writer_map(mp, 3);
+    msgpack_writer_str(mp, "u");
+    msgpack_writer_uint(mp, node_id);
+
+    msgpack_writer_str(mp, "t");
+    msgpack_writer_map(mp, 6);
+    msgpack_writer_str(mp, "m");    msgpack_writer_mac(mp, payload->TX.macAddr);
+    msgpack_writer_str(mp, "i");    msgpack_writer_uint(mp, payload->TX.id);
+    msgpack_writer_str(mp, "ot");   msgpack_writer_bool(mp, payload->TX.TX_internal.overtemperature);
+    msgpack_writer_str(mp, "oc");   msgpack_writer_bool(mp, payload->TX.TX_internal.overcurrent);
+    msgpack_writer_str(mp, "ov");   msgpack_writer_bool(mp, payload->TX.TX_internal.overvoltage);
+    msgpack_writer_str(mp, "fod");  msgpack_writer_bool(mp, payload->TX.TX_internal.FOD);
+
+    msgpack_writer_str(mp, "r");
+    msgpack_writer_map(mp, 6);
+    msgpack_writer_str(mp, "m");    msgpack_writer_mac(mp, payload->RX.macAddr);
+    msgpack_writer_str(mp, "i");    msgpack_writer_uint(mp, payload->RX.id);
+    msgpack_writer_str(mp, "ot");   msgpack_writer_bool(mp, payload->RX.RX_internal.overtemperature);
+    msgpack_writer_str(mp, "oc");   msgpack_writer_bool(mp, payload->RX.RX_internal.overcurrent);
+    msgpack_writer_str(mp, "ov");   msgpack_writer_bool(mp, payload->RX.RX_internal.overvoltage);
+    msgpack_writer_str(mp, "fc");   msgpack_writer_bool(mp, payload->RX.RX_internal.FullyCharged);
+}
+
+/**
+ * @brief Write a stored telemetry record as a MessagePack map
+ */
+static void telemetry_record_to_msgpack(msgpack_writer_t *mp, const telemetry_record_t *r, uint32_t age_ms)
+{
+    msgpack_writer_map(mp, 7);
+    msgpack_writer_str(mp, "u");    msgpack_writer_uint(mp, r->tx_id);
+    msgpack_writer_str(mp, "q");    msgpack_writer_uint(mp, r->seq);
+    msgpack_writer_str(mp, "b");    msgpack_writer_uint(mp, r->boot);
+    msgpack_writer_str(mp, "ms");   msgpack_writer_uint(mp, r->uptime_ms);
+    msgpack_writer_str(mp, "a");    msgpack_writer_uint(mp, age_ms);
+
+    msgpack_writer_str(mp, "t");
+    msgpack_writer_map(mp, 6);
+    msgpack_writer_str(mp, "i");    msgpack_writer_uint(mp, r->tx_id);
+    msgpack_writer_str(mp, "s");    msgpack_writer_uint(mp, r->tx_status);
+    msgpack_writer_str(mp, "v");    msgpack_writer_float(mp, r->tx.voltage * TELEMETRY_VOLTAGE_UNIT);
+    msgpack_writer_str(mp, "c");    msgpack_writer_float(mp, r->tx.current * TELEMETRY_CURRENT_UNIT);
+    msgpack_writer_str(mp, "t1");   msgpack_writer_float(mp, r->tx.temp1 * TELEMETRY_TEMP_UNIT);
+    msgpack_writer_str(mp, "t2");   msgpack_writer_float(mp, r->tx.temp2 * TELEMETRY_TEMP_UNIT);
+
+    msgpack_writer_str(mp, "r");
+    msgpack_writer_map(mp, 6);
+    msgpack_writer_str(mp, "i");    msgpack_writer_uint(mp, r->rx_id);
+    msgpack_writer_str(mp, "s");    msgpack_writer_uint(mp, r->rx_status);
+    msgpack_writer_str(mp, "v");    msgpack_writer_float(mp, r->rx.voltage * TELEMETRY_VOLTAGE_UNIT);
+    msgpack_writer_str(mp, "c");    msgpack_writer_float(mp, r->rx.current * TELEMETRY_CURRENT_UNIT);
+    msgpack_writer_str(mp, "t1");   msgpack_writer_float(mp, r->rx.temp1 * TELEMETRY_TEMP_UNIT);
+    msgpack_writer_str(mp, "t2");   msgpack_writer_float(mp, r->rx.temp2 * TELEMETRY_TEMP_UNIT);
+}
+
+/**
+ * @brief Write the statistics of one value as [min,max,mean,last] (nil without samples)
+ */
+static void summary_stat_to_msgpack(msgpack_writer_t *mp, const telemetry_agg_stat_t *st)
+{
+    if (st->count == 0) {
+        msgpack_writer_nil(mp);
+        return;
     }
 
-    return json_string;
+    msgpack_writer_array(mp, 4);
+    msgpack_writer_float(mp, st->min);
+    msgpack_writer_float(mp, st->max);
+    msgpack_writer_float(mp, telemetry_agg_mean(st));
+    msgpack_writer_float(mp, st->last);
+}
+
+/**
+ * @brief Write the summary window of a peer as a MessagePack map
+ */
+static void summary_to_msgpack(msgpack_writer_t *mp, const TX_peer_snapshot_t *peer, uint32_t now)
+{
+    const telemetry_agg_window_t *w = &peer->summary;
+    const mesh_dynamic_payload_t *payload = &peer->dynamic_payload;
+
+    msgpack_writer_map(mp, 6);
+    msgpack_writer_str(mp, "u");    msgpack_writer_uint(mp, peer->id);
+    msgpack_writer_str(mp, "ms");   msgpack_writer_uint(mp, w->end_ms - w->start_ms);
+    msgpack_writer_str(mp, "a");    msgpack_writer_uint(mp, now - w->end_ms);
+    msgpack_writer_str(mp, "n");    msgpack_writer_uint(mp, w->samples);
+
+    msgpack_writer_str(mp, "t");
+    msgpack_writer_map(mp, 7);
+    msgpack_writer_str(mp, "i");    msgpack_writer_uint(mp, payload->TX.id);
+    msgpack_writer_str(mp, "s");    msgpack_writer_uint(mp, payload->TX.tx_status);
+    msgpack_writer_str(mp, "v");    summary_stat_to_msgpack(mp, &w->tx[TELEMETRY_AGG_VOLTAGE]);
+    msgpack_writer_str(mp, "c");    summary_stat_to_msgpack(mp, &w->tx[TELEMETRY_AGG_CURRENT]);
+    msgpack_writer_str(mp, "t1");   summary_stat_to_msgpack(mp, &w->tx[TELEMETRY_AGG_TEMP1]);
+    msgpack_writer_str(mp, "t2");   summary_stat_to_msgpack(mp, &w->tx[TELEMETRY_AGG_TEMP2]);
+    msgpack_writer_str(mp, "e");    msgpack_writer_float(mp, w->tx_wh);
+
+    msgpack_writer_str(mp, "r");
+    msgpack_writer_map(mp, 7);
+    msgpack_writer_str(mp, "i");    msgpack_writer_uint(mp, payload->RX.id);
+    msgpack_writer_str(mp, "s");    msgpack_writer_uint(mp, payload->RX.rx_status);
+    msgpack_writer_str(mp, "v");    summary_stat_to_msgpack(mp, &w->rx[TELEMETRY_AGG_VOLTAGE]);
+    msgpack_writer_str(mp, "c");    summary_stat_to_msgpack(mp, &w->rx[TELEMETRY_AGG_CURRENT]);
+    msgpack_writer_str(mp, "t1");   summary_stat_to_msgpack(mp, &w->rx[TELEMETRY_AGG_TEMP1]);
+    msgpack_writer_str(mp, "t2");   summary_stat_to_msgpack(mp, &w->rx[TELEMETRY_AGG_TEMP2]);
+    msgpack_writer_str(mp, "e");    msgpack_writer_float(mp, w->rx_wh);
 }
 
+#endif /* MQTT_ENCODING_MSGPACK */
+
+/*******************************************************
+ *                Payload Encoding
+ *******************************************************/
+
 /**
- * @brief Create JSON string from alert payload
+ * @brief Encode the dynamic payload of n peers into payload_buffer
  * 
- * @param payload Pointer to alert payload struct
- * @param node_id Unit ID to include in JSON
- * @return char* JSON string (must be freed by caller), NULL on error
+ * @param peers Peers to encode
+ * @param n Number of peers (1 when not batched)
+ * @param batch Wrap the peers into a batch message
+ * @return size_t Encoded length, 0 if it does not fit the buffer
  */
-static char* alert_payload_to_json(const mesh_alert_payload_t *payload, uint8_t node_id)
+static size_t encode_dynamic(TX_peer_snapshot_t **peers, uint16_t n, bool batch)
 {
-    if (!payload) {
-        ESP_LOGE(TAG, "Null payload pointer");
-        return NULL;
+#if MQTT_PAYLOAD_ENCODING == MQTT_ENCODING_MSGPACK
+    msgpack_writer_t mp;
+    size_t len = 0;
+
+    msgpack_writer_init(&mp, payload_buffer, sizeof(payload_buffer));
+    if (batch) {
+        msgpack_writer_map(&mp, 2);
+        msgpack_writer_str(&mp, "u");
+        msgpack_writer_uint(&mp, UNIT_ID);
+        msgpack_writer_str(&mp, "p");
+        msgpack_writer_array(&mp, n);
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        dynamic_payload_to_msgpack(&mp, &peers[i]->dynamic_payload, peers[i]->id);
     }
+    return msgpack_writer_finish(&mp, &len) ? len : 0;
+#else
+    json_writer_t jw;
 
-    cJSON *root = cJSON_CreateObject();
-    if (!root) {
-        ESP_LOGE(TAG, "Failed to create JSON root");
-        return NULL;
+    json_writer_init(&jw, (char *)payload_buffer, sizeof(payload_buffer));
+    if (batch) {
+        json_writer_object_begin(&jw, NULL);
+        json_writer_uint(&jw, "unit_id", UNIT_ID);
+        json_writer_array_begin(&jw, "peers");
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        dynamic_payload_to_json(&jw, &peers[i]->dynamic_payload, peers[i]->id);
+    }
+    if (batch) {
+        json_writer_array_end(&jw);
+        json_writer_object_end(&jw);
     }
+    return json_writer_finish(&jw) ? jw.len : 0;
+#endif
+}
 
-    // Add unit ID
-    cJSON_AddNumberToObject(root, "unit_id", node_id);
+/**
+ * @brief Encode the alert payload of a peer into payload_buffer
+ * 
+ * @return size_t Encoded length, 0 if it does not fit the buffer
+ */
+static size_t encode_alert(TX_peer_snapshot_t *peer)
+{
+#if MQTT_PAYLOAD_ENCODING == MQTT_ENCODING_MSGPACK
+    msgpack_writer_t mp;
+    size_t len = 0;
 
-    // Create TX alerts object
-    cJSON *tx_obj = cJSON_CreateObject();
-    if (tx_obj) {
-        char mac_str[18];
-        mac_to_string(payload->TX.macAddr, mac_str, sizeof(mac_str));
-        
-        cJSON_AddStringToObject(tx_obj, "mac", mac_str);
-        cJSON_AddNumberToObject(tx_obj, "id", payload->TX.id);
-        cJSON_AddBoolToObject(tx_obj, "overtemperature", payload->TX.TX_internal.overtemperature);
-        cJSON_AddBoolToObject(tx_obj, "overcurrent", payload->TX.TX_internal.overcurrent);
-        cJSON_AddBoolToObject(tx_obj, "overvoltage", payload->TX.TX_internal.overvoltage);
-        cJSON_AddBoolToObject(tx_obj, "fod", payload->TX.TX_internal.FOD);
-        
-        cJSON_AddItemToObject(root, "tx", tx_obj);
-    }
+    msgpack_writer_init(&mp, payload_buffer, sizeof(payload_buffer));
+    alert_payload_to_msgpack(&mp, &peer->alert_payload, peer->id);
+    return msgpack_writer_finish(&mp, &len) ? len : 0;
+#else
+    json_writer_t jw;
 
-    // Create RX alerts object
-    cJSON *rx_obj = cJSON_CreateObject();
-    if (rx_obj) {
-        char mac_str[18];
-        mac_to_string(payload->RX.macAddr, mac_str, sizeof(mac_str));
-        
-        cJSON_AddStringToObject(rx_obj, "mac", mac_str);
-        cJSON_AddNumberToObject(rx_obj, "id", payload->RX.id);
-        cJSON_AddBoolToObject(rx_obj, "overtemperature", payload->RX.RX_internal.overtemperature);
-        cJSON_AddBoolToObject(rx_obj, "overcurrent", payload->RX.RX_internal.overcurrent);
-        cJSON_AddBoolToObject(rx_obj, "overvoltage", payload->RX.RX_internal.overvoltage);
-        cJSON_AddBoolToObject(rx_obj, "fully_charged", payload->RX.RX_internal.FullyCharged);
-        
-        cJSON_AddItemToObject(root, "rx", rx_obj);
+    json_writer_init(&jw, (char *)payload_buffer, sizeof(payload_buffer));
+    alert_payload_to_json(&jw, &peer->alert_payload, peer->id);
+    return json_writer_finish(&jw) ? jw.len : 0;
+#endif
+}
+
+/**
+ * @brief Encode stored records into payload_buffer
+ * 
+ * Format: {"unit_id":<root>,"backlog":<records left>,"records":[<record>, ...]}
+ * 
+ * @param ages Sample age of each record at replay (ms)
+ * @return size_t Encoded length, 0 if it does not fit the buffer
+ */
+static size_t encode_replay(const telemetry_record_t *records, const uint32_t *ages, uint32_t n, uint32_t backlog)
+{
+#if MQTT_PAYLOAD_ENCODING == MQTT_ENCODING_MSGPACK
+    msgpack_writer_t mp;
+    size_t len = 0;
+
+    msgpack_writer_init(&mp, payload_buffer, sizeof(payload_buffer));
+    msgpack_writer_map(&mp, 3);
+    msgpack_writer_str(&mp, "u");
+    msgpack_writer_uint(&mp, UNIT_ID);
+    msgpack_writer_str(&mp, "n");
+    msgpack_writer_uint(&mp, backlog);
+    msgpack_writer_str(&mp, "p");
+    msgpack_writer_array(&mp, n);
+    for (uint32_t i = 0; i < n; i++) {
+        telemetry_record_to_msgpack(&mp, &records[i], ages[i]);
     }
+    return msgpack_writer_finish(&mp, &len) ? len : 0;
+#else
+    json_writer_t jw;
 
-    // Convert to string
-    char *json_string = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    
-    if (!json_string) {
-        ESP_LOGE(TAG, "Failed to print JSON");
-        return NULL;
+    json_writer_init(&jw, (char *)payload_buffer, sizeof(payload_buffer));
+    json_writer_object_begin(&jw, NULL);
+    json_writer_uint(&jw, "unit_id", UNIT_ID);
+    json_writer_uint(&jw, "backlog", backlog);
+    json_writer_array_begin(&jw, "records");
+    for (uint32_t i = 0; i < n; i++) {
+        telemetry_record_to_json(&jw, &records[i], ages[i]);
     }
+    json_writer_array_end(&jw);
+    json_writer_object_end(&jw);
+    return json_writer_finish(&jw) ? jw.len : 0;
+#endif
+}
 
-    return json_string;
+/**
+ * @brief Encode the summary window of a peer into payload_buffer
+ * 
+ * @return size_t Encoded length, 0 if it does not fit the buffer
+ */
+static size_t encode_summary(const TX_peer_snapshot_t *peer)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+#if MQTT_PAYLOAD_ENCODING == MQTT_ENCODING_MSGPACK
+    msgpack_writer_t mp;
+    size_t len = 0;
+
+    msgpack_writer_init(&mp, payload_buffer, sizeof(payload_buffer));
+    summary_to_msgpack(&mp, peer, now);
+    return msgpack_writer_finish(&mp, &len) ? len : 0;
+#else
+    json_writer_t jw;
+
+    json_writer_init(&jw, (char *)payload_buffer, sizeof(payload_buffer));
+    summary_to_json(&jw, peer, now);
+    return json_writer_finish(&jw) ? jw.len : 0;
+#endif
 }
 
 /*******************************************************
@@ -255,8 +616,8 @@ static char* alert_payload_to_json(const mesh_alert_payload_t *payload, uint8_t
 static void build_topic(char *topic_buf, size_t buf_len, 
                        uint8_t node_id, const char *data_type)
 {
-    snprintf(topic_buf, buf_len, "%s/%d/%s", 
-             baseTopic, node_id, data_type);
+    snprintf(topic_buf, buf_len, "%s/%d/%s%s", 
+             baseTopic, node_id, data_type, encodingSuffix);
 }
 
 /**
@@ -271,21 +632,16 @@ static bool should_publish_by_time(uint32_t last_publish_time)
 }
 
 /**
- * @brief Publish JSON data to MQTT topic
+ * @brief Publish encoded data (JSON or binary) to MQTT topic
  */
-static esp_err_t publish_json_data(const char *topic, const char *json_string)
+static esp_err_t publish_data(const char *topic, const uint8_t *data, size_t len)
 {
     if (!mqtt_connected || mqtt_client == NULL) {
         return ESP_FAIL;
     }
     
-    if (!json_string) {
-        ESP_LOGE(TAG, "Null JSON string");
-        return ESP_FAIL;
-    }
-    
     int msg_id = esp_mqtt_client_publish(mqtt_client, topic, 
-                                         json_string, 0,  // 0 = auto-calculate length
+                                         (const char *)data, len,
                                          1, 0);            // QoS 1, not retained
     
     if (msg_id == -1) {
@@ -293,76 +649,427 @@ static esp_err_t publish_json_data(const char *topic, const char *json_string)
         return ESP_FAIL;
     }
     
-    //ESP_LOGD(TAG, "Published to %s (msg_id=%d)", topic, msg_id);
     return ESP_OK;
 }
 
+/**
+ * @brief Publish JSON data to MQTT topic
+ */
+static esp_err_t publish_json_data(const char *topic, const char *json_string)
+{
+    if (!json_string) {
+        ESP_LOGE(TAG, "Null JSON string");
+        return ESP_FAIL;
+    }
+    
+    return publish_data(topic, (const uint8_t *)json_string, strlen(json_string));
+}
+
 /*******************************************************
  *                TX Peer Publishing
  *******************************************************/
-static void publish_peer_data(struct TX_peer *peer)
+/**
+ * @brief Check if the dynamic payload of a peer has to be published
+ */
+static bool dynamic_publish_due(TX_peer_snapshot_t *peer)
+{
+    return dynamic_payload_changed(&peer->dynamic_payload, &peer->previous_dynamic_payload) ||
+           should_publish_by_time(peer->lastDynamicPublished);
+}
+
+/* Works on a snapshot entry - runs without TX_peers_mutex held.
+ * with_dynamic == false leaves the dynamic payload to the batch publisher */
+static void publish_peer_data(TX_peer_snapshot_t *peer, bool with_dynamic)
 {
     char topic[128];
+    size_t len;
     uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    bool dynamic_published = false;
+    bool alert_published = false;
     
     // Publish DYNAMIC payload
-    if (dynamic_payload_changed(peer->dynamic_payload, peer->previous_dynamic_payload) ||
-        should_publish_by_time(peer->lastDynamicPublished))
+    if (with_dynamic && dynamic_publish_due(peer))
     {
-        char *json_string = dynamic_payload_to_json(peer->dynamic_payload, peer->id);
-        if (json_string) {
+        len = encode_dynamic(&peer, 1, false);
+        if (len) {
             build_topic(topic, sizeof(topic), peer->id, dynamicTopic);
             
-            if (publish_json_data(topic, json_string) == ESP_OK) 
+            if (publish_data(topic, payload_buffer, len) == ESP_OK) 
             {
-                *peer->previous_dynamic_payload = *peer->dynamic_payload;
                 peer->lastDynamicPublished = current_time;
-                ESP_LOGI(TAG, "Published TX-%d dynamic: %s", peer->id, json_string);
+                dynamic_published = true;
+                ESP_LOGI(TAG, "Published TX-%d dynamic (%d bytes)", peer->id, len);
             }
-            
-            cJSON_free(json_string);  // Free the JSON string
+        } else {
+            ESP_LOGE(TAG, "TX-%d dynamic payload does not fit the buffer", peer->id);
         }
     }
     
     // Publish ALERT payload (only when alerts are active)
-    if (alert_payload_changed(peer->alert_payload, peer->previous_alert_payload))
+    if (alert_payload_changed(&peer->alert_payload, &peer->previous_alert_payload))
     {
-        char *json_string = alert_payload_to_json(peer->alert_payload, peer->id);
-        if (json_string) {
+        len = encode_alert(peer);
+        if (len) {
             build_topic(topic, sizeof(topic), peer->id, alertTopic);
             
-            if (publish_json_data(topic, json_string) == ESP_OK) 
+            if (publish_data(topic, payload_buffer, len) == ESP_OK) 
             {
-                *peer->previous_alert_payload = *peer->alert_payload;
-                ESP_LOGW(TAG, "Published TX-%d ALERT: %s", peer->id, json_string);
+                alert_published = true;
+                ESP_LOGW(TAG, "Published TX-%d ALERT (%d bytes)", peer->id, len);
             }
-            
-            cJSON_free(json_string);  // Free the JSON string
+        } else {
+            ESP_LOGE(TAG, "TX-%d alert payload does not fit the buffer", peer->id);
+        }
+    }
+
+    // Previous payloads become what was actually sent
+    TX_peer_commit_published(peer, dynamic_published, alert_published);
+}
+
+/**
+ * @brief Publish one batch message with the given peers
+ * 
+ * Format: {"unit_id":<root>,"peers":[<dynamic JSON of each peer>]}
+ */
+static void publish_dynamic_chunk(TX_peer_snapshot_t **peers, uint16_t n)
+{
+    char topic[128];
+    uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    size_t len = encode_dynamic(peers, n, true);
+    if (len == 0) {
+        ESP_LOGE(TAG, "Dynamic batch (%d peers) does not fit the buffer", n);
+        return;
+    }
+
+    build_topic(topic, sizeof(topic), UNIT_ID, dynamicBatchTopic);
+    if (publish_data(topic, payload_buffer, len) == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Published dynamic batch: %d peers, %d bytes", n, len);
+        for (uint16_t i = 0; i < n; i++) {
+            peers[i]->lastDynamicPublished = current_time;
+            TX_peer_commit_published(peers[i], true, false);
+        }
+    }
+}
+
+/**
+ * @brief Pack the dynamic payload of every peer that is due into batch messages
+ */
+static void publish_dynamic_batch(TX_peers_snapshot_t *snapshot, uint16_t count)
+{
+    TX_peer_snapshot_t *due[MQTT_BATCH_MAX_PEERS];
+    uint16_t n = 0;
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (!dynamic_publish_due(&snapshot->peers[i]))
+            continue;
+
+        due[n++] = &snapshot->peers[i];
+        if (n == MQTT_BATCH_MAX_PEERS) {
+            publish_dynamic_chunk(due, n);
+            n = 0;
+        }
+    }
+
+    if (n > 0)
+        publish_dynamic_chunk(due, n);
+}
+
+/**
+ * @brief Publish the closed summary window of a peer, if any
+ * 
+ * Kept on the peer until published: windows closed meanwhile are merged into it
+ */
+static void publish_summary(TX_peer_snapshot_t *peer)
+{
+    char topic[128];
+
+    if (!peer->summary_ready)
+        return;
+
+    size_t len = encode_summary(peer);
+    if (len == 0) {
+        ESP_LOGE(TAG, "TX-%d summary does not fit the buffer", peer->id);
+        return;
+    }
+
+    build_topic(topic, sizeof(topic), peer->id, summaryTopic);
+    if (publish_data(topic, payload_buffer, len) == ESP_OK)
+    {
+        TX_peer_commit_summary(peer);
+        ESP_LOGI(TAG, "Published TX-%d summary: %lu samples, %d bytes", peer->id, peer->summary.samples, len);
+    }
+}
+
+/*******************************************************
+ *                Store and Forward
+ *******************************************************/
+
+/* Replay statistics (telemetry_log.stats holds the totals) */
+static uint32_t replay_start_ms = 0;        // first replayed message of the current backlog
+static uint32_t replay_session = 0;         // records replayed since replay_start_ms
+static uint32_t last_stats_ms = 0;
+static bool stats_due = false;              // the backlog changed since the last stats message
+static uint32_t replay_undated = 0;         // records dropped by the replay, no way to date them
+static uint32_t connected_ms = 0;           // last MQTT_EVENT_CONNECTED
+
+/**
+ * @brief Wall clock in Unix ms, 0 until SNTP has set it
+ */
+static uint64_t wall_clock_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    if (tv.tv_sec < MQTT_CLOCK_VALID_AFTER_S)
+        return 0;
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/**
+ * @brief Set the wall clock from SNTP, so stored samples can be dated after a reboot
+ */
+static void wall_clock_init(void)
+{
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, MQTT_SNTP_SERVER);
+    esp_sntp_init();
+}
+
+static bool telemetry_flash_read(void *ctx, uint32_t offset, void *data, uint32_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, offset, data, len) == ESP_OK;
+}
+
+static bool telemetry_flash_write(void *ctx, uint32_t offset, const void *data, uint32_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, offset, data, len) == ESP_OK;
+}
+
+static bool telemetry_flash_erase(void *ctx, uint32_t offset, uint32_t len)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, len) == ESP_OK;
+}
+
+/**
+ * @brief Mount the telemetry log partition
+ */
+static void telemetry_store_init(void)
+{
+    static const telemetry_log_io_t io = {
+        .read = telemetry_flash_read,
+        .write = telemetry_flash_write,
+        .erase = telemetry_flash_erase,
+    };
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                                MQTT_TELEMETRY_PARTITION);
+    if (partition == NULL) {
+        ESP_LOGW(TAG, "No \"%s\" partition - samples are lost while MQTT is down", MQTT_TELEMETRY_PARTITION);
+        return;
+    }
+
+    telemetry_log_mounted = telemetry_log_mount(&telemetry_log, &io, (void *)partition, partition->size);
+    if (!telemetry_log_mounted) {
+        ESP_LOGE(TAG, "Cannot mount the telemetry log");
+        return;
+    }
+
+    ESP_LOGI(TAG, "Telemetry log: %lu/%lu records to replay (boot %d)",
+             telemetry_log_backlog(&telemetry_log), telemetry_log.slots, telemetry_log.boot);
+    stats_due = telemetry_log_backlog(&telemetry_log) > 0;
+}
+
+/**
+ * @brief Store the dynamic payload of every peer that is due (broker unreachable)
+ * 
+ * Same cadence as the live upload: on a change or every MQTT_MIN_PUBLISH_INTERVAL_MS
+ */
+static void record_dynamic(TX_peers_snapshot_t *snapshot, uint16_t count)
+{
+    uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    for (uint16_t i = 0; i < count; i++) {
+        TX_peer_snapshot_t *peer = &snapshot->peers[i];
+        if (!dynamic_publish_due(peer))
+            continue;
+
+        const mesh_dynamic_payload_t *p = &peer->dynamic_payload;
+        telemetry_record_t record = {
+            .uptime_ms = current_time,
+            .epoch_ms = wall_clock_ms(),
+            .tx_id = p->TX.id,
+            .tx_status = (uint8_t)p->TX.tx_status,
+            .rx_id = p->RX.id,
+            .rx_status = (uint8_t)p->RX.rx_status,
+            .tx = {
+                .voltage = telemetry_log_fixed(p->TX.voltage, TELEMETRY_VOLTAGE_UNIT),
+                .current = telemetry_log_fixed(p->TX.current, TELEMETRY_CURRENT_UNIT),
+                .temp1 = telemetry_log_fixed(p->TX.temp1, TELEMETRY_TEMP_UNIT),
+                .temp2 = telemetry_log_fixed(p->TX.temp2, TELEMETRY_TEMP_UNIT),
+            },
+            .rx = {
+                .voltage = telemetry_log_fixed(p->RX.voltage, TELEMETRY_VOLTAGE_UNIT),
+                .current = telemetry_log_fixed(p->RX.current, TELEMETRY_CURRENT_UNIT),
+                .temp1 = telemetry_log_fixed(p->RX.temp1, TELEMETRY_TEMP_UNIT),
+                .temp2 = telemetry_log_fixed(p->RX.temp2, TELEMETRY_TEMP_UNIT),
+            },
+        };
+
+        if (!telemetry_log_append(&telemetry_log, &record)) {
+            ESP_LOGE(TAG, "TX-%d sample not stored (flash error)", peer->id);
+            continue;
         }
-    }    
+        peer->lastDynamicPublished = current_time;
+        TX_peer_commit_published(peer, true, false);
+        stats_due = true;
+    }
+}
+
+/**
+ * @brief Publish the telemetry log metrics
+ * 
+ * Format: {"unit_id","backlog","capacity","recorded","replayed","dropped","corrupt","io_errors","undated","replay_rate"}
+ * replay_rate is records/s of the current (or last) replay, undated records were replayed but not sent
+ */
+static void publish_telemetry_stats(void)
+{
+    char topic[128];
+    char payload[256];
+    const telemetry_log_stats_t *st = &telemetry_log.stats;
+    uint32_t elapsed = xTaskGetTickCount() * portTICK_PERIOD_MS - replay_start_ms;
+    uint32_t rate = (replay_session && elapsed) ? (uint32_t)((uint64_t)replay_session * 1000 / elapsed) : 0;
+
+    snprintf(topic, sizeof(topic), "%s/%d/%s", baseTopic, UNIT_ID, telemetryLogTopic);
+    snprintf(payload, sizeof(payload),
+        "{\"unit_id\":%d,\"backlog\":%lu,\"capacity\":%lu,\"recorded\":%lu,\"replayed\":%lu,"
+        "\"dropped\":%lu,\"corrupt\":%lu,\"io_errors\":%lu,\"undated\":%lu,\"replay_rate\":%lu}",
+        UNIT_ID, telemetry_log_backlog(&telemetry_log), telemetry_log.slots, st->recorded, st->replayed,
+        st->dropped, st->corrupt, st->io_errors, replay_undated, rate);
+
+    publish_json_data(topic, payload);
+}
+
+/**
+ * @brief Keep the records that can be dated, with their age
+ * 
+ * @param[out] undated Records that can never be dated
+ * @return int Records kept (moved to the front), -1 to wait for the clock
+ */
+static int date_records(telemetry_record_t *records, uint32_t n, uint32_t *ages, uint32_t *undated)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint64_t epoch = wall_clock_ms();
+    uint32_t kept = 0;
+
+    *undated = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        telemetry_age_t age = telemetry_log_age(&telemetry_log, &records[i], now, epoch, &ages[kept]);
+        if (age == TELEMETRY_AGE_NO_CLOCK && now - connected_ms < MQTT_REPLAY_CLOCK_WAIT_MS)
+            return -1;
+        if (age == TELEMETRY_AGE_KNOWN)
+            records[kept++] = records[i];
+        else
+            (*undated)++;
+    }
+    return (int)kept;
+}
+
+/**
+ * @brief Replay the oldest stored records, at most one message per call
+ * 
+ * Records are sent with their age; those that cannot be dated are consumed
+ * without being sent and counted as undated.
+ */
+static void replay_backlog(void)
+{
+    static telemetry_record_t records[MQTT_REPLAY_RECORDS_PER_TICK];
+    static uint32_t ages[MQTT_REPLAY_RECORDS_PER_TICK];
+    char topic[128];
+    uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t slots = 0, undated = 0;
+
+    if (telemetry_log_backlog(&telemetry_log) > 0) {
+        uint32_t n = telemetry_log_peek(&telemetry_log, records, MQTT_REPLAY_RECORDS_PER_TICK, &slots);
+        uint32_t left = telemetry_log_backlog(&telemetry_log) - slots;
+        int dated = date_records(records, n, ages, &undated);
+        size_t len = dated > 0 ? encode_replay(records, ages, (uint32_t)dated, left) : 0;
+
+        if (dated < 0) {
+            ESP_LOGD(TAG, "Replay waits for the clock");
+        } else if (dated && len == 0) {
+            ESP_LOGE(TAG, "Replay of %d records does not fit the buffer", dated);
+        } else {
+            build_topic(topic, sizeof(topic), UNIT_ID, dynamicReplayTopic);
+            if (dated == 0 || publish_data(topic, payload_buffer, len) == ESP_OK) {
+                if (replay_session == 0)
+                    replay_start_ms = current_time;
+                telemetry_log_consume(&telemetry_log, slots, n);
+                replay_session += n;
+                replay_undated += undated;
+                stats_due = true;
+                ESP_LOGI(TAG, "Replayed %d stored records (%lu undated dropped), %lu left", dated, undated, left);
+            }
+        }
+    }
+
+    bool done = telemetry_log_backlog(&telemetry_log) == 0;
+    if (stats_due && (done || current_time - last_stats_ms >= MQTT_TELEMETRY_STATS_INTERVAL_MS)) {
+        publish_telemetry_stats();
+        last_stats_ms = current_time;
+        stats_due = !done;
+        if (done)
+            replay_session = 0;
+    }
 }
 
 /*******************************************************
  *                MQTT Publishing Task
  *******************************************************/
 
+/* Static - too large for the task stack */
+static TX_peers_snapshot_t publish_snapshot;
+
 static void mqtt_publish_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "MQTT publish task started");
+    uint32_t last_epoch = 0;
     
     while (1)
     {
+        // the root pad has no mesh message to hook: sample it at the task rate
+        if (is_root_node)
+            TX_peer_aggregate_dynamic(self_mac);
+
         if (mqtt_connected && is_root_node)
         {
-            // Iterate through all TX peers
-            struct TX_peer *tx_peer;
+            // Copy the TX peers and release the lock before any JSON/network work
+            uint16_t count = TX_peers_snapshot(&publish_snapshot);
 
-            WITH_TX_PEERS_LOCKED {
-                SLIST_FOREACH(tx_peer, &TX_peers, next) {
-                    update_status(tx_peer);
-                    publish_peer_data(tx_peer);
-                }
+            if (publish_snapshot.epoch != last_epoch) {
+                ESP_LOGI(TAG, "TX peer table changed (epoch %ld, %d peers)", publish_snapshot.epoch, count);
+                last_epoch = publish_snapshot.epoch;
             }
+
+            for (uint16_t i = 0; i < count; i++) {
+                publish_peer_data(&publish_snapshot.peers[i], !MQTT_DYNAMIC_BATCH_MODE);
+                publish_summary(&publish_snapshot.peers[i]);
+            }
+
+#if MQTT_DYNAMIC_BATCH_MODE
+            publish_dynamic_batch(&publish_snapshot, count);
+#endif
+
+            // samples stored during an outage, rate limited next to the live data
+            if (telemetry_log_mounted)
+                replay_backlog();
+        }
+        else if (is_root_node && telemetry_log_mounted)
+        {
+            // broker unreachable: store the samples instead of dropping them
+            uint16_t count = TX_peers_snapshot(&publish_snapshot);
+            record_dynamic(&publish_snapshot, count);
         }
         //todo diconnect other nodes if root changes
 
@@ -387,6 +1094,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
             mqtt_connected = true;
+            connected_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
             esp_mqtt_client_subscribe(mqtt_client, controlTopic, 1); 
             esp_mqtt_client_subscribe(mqtt_client, otaTopic, 1);
             //publish_json_data(controlTopic, "0"); // reset control button
@@ -504,6 +1212,10 @@ esp_err_t mqtt_client_manager_init(void)
     // Start MQTT client
     ESP_ERROR_CHECK(esp_mqtt_client_start(mqtt_client));
     
+    // Mount the store-and-forward log before the publishing task uses it
+    telemetry_store_init();
+    wall_clock_init();
+    
     // Create publishing task
     BaseType_t ret = xTaskCreate(mqtt_publish_task, "mqtt_publish", 
                                  20000, NULL, 5, &mqtt_publish_task_handle);
@@ -0,0 +1,151 @@
+#include "msgpack_writer.h"
+
+#include <string.h>
+
+/*******************************************************
+ *                Raw output (big-endian)
+ *******************************************************/
+
+static void put_bytes(msgpack_writer_t *mp, const void *data, size_t n)
+{
+    if (mp->overflow || mp->len + n > mp->cap) {
+        mp->overflow = true;
+        return;
+    }
+    memcpy(&mp->buf[mp->len], data, n);
+    mp->len += n;
+}
+
+static void put_u8(msgpack_writer_t *mp, uint8_t v)
+{
+    put_bytes(mp, &v, 1);
+}
+
+static void put_tagged_be(msgpack_writer_t *mp, uint8_t tag, uint32_t v, uint8_t width)
+{
+    uint8_t out[5];
+
+    out[0] = tag;
+    for (uint8_t i = 0; i < width; i++) {
+        out[1 + i] = (uint8_t)(v >> (8 * (width - 1 - i)));
+    }
+    put_bytes(mp, out, 1 + width);
+}
+
+/*******************************************************
+ *                Public API
+ *******************************************************/
+
+void msgpack_writer_init(msgpack_writer_t *mp, uint8_t *buf, size_t cap)
+{
+    mp->buf = buf;
+    mp->cap = cap;
+    mp->len = 0;
+    mp->overflow = (buf == NULL);
+}
+
+void msgpack_writer_map(msgpack_writer_t *mp, uint32_t count)
+{
+    if (count < 16)
+        put_u8(mp, (uint8_t)(0x80 | count));            // fixmap
+    else if (count <= UINT16_MAX)
+        put_tagged_be(mp, 0xDE, count, 2);              // map 16
+    else
+        put_tagged_be(mp, 0xDF, count, 4);              // map 32
+}
+
+void msgpack_writer_array(msgpack_writer_t *mp, uint32_t count)
+{
+    if (count < 16)
+        put_u8(mp, (uint8_t)(0x90 | count));            // fixarray
+    else if (count <= UINT16_MAX)
+        put_tagged_be(mp, 0xDC, count, 2);              // array 16
+    else
+        put_tagged_be(mp, 0xDD, count, 4);              // array 32
+}
+
+void msgpack_writer_uint(msgpack_writer_t *mp, uint32_t value)
+{
+    if (value < 0x80)
+        put_u8(mp, (uint8_t)value);                     // positive fixint
+    else if (value <= UINT8_MAX)
+        put_tagged_be(mp, 0xCC, value, 1);
+    else if (value <= UINT16_MAX)
+        put_tagged_be(mp, 0xCD, value, 2);
+    else
+        put_tagged_be(mp, 0xCE, value, 4);
+}
+
+void msgpack_writer_int(msgpack_writer_t *mp, int32_t value)
+{
+    if (value >= 0)
+        msgpack_writer_uint(mp, (uint32_t)value);
+    else if (value >= -32)
+        put_u8(mp, (uint8_t)(int8_t)value);             // negative fixint
+    else if (value >= INT8_MIN)
+        put_tagged_be(mp, 0xD0, (uint8_t)(int8_t)value, 1);
+    else if (value >= INT16_MIN)
+        put_tagged_be(mp, 0xD1, (uint16_t)(int16_t)value, 2);
+    else
+        put_tagged_be(mp, 0xD2, (uint32_t)value, 4);
+}
+
+void msgpack_writer_float(msgpack_writer_t *mp, float value)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    put_tagged_be(mp, 0xCA, bits, 4);                   // float 32
+}
+
+void msgpack_writer_bool(msgpack_writer_t *mp, bool value)
+{
+    put_u8(mp, value ? 0xC3 : 0xC2);
+}
+
+void msgpack_writer_nil(msgpack_writer_t *mp)
+{
+    put_u8(mp, 0xC0);
+}
+
+void msgpack_writer_str(msgpack_writer_t *mp, const char *value)
+{
+    size_t n = value ? strlen(value) : 0;
+
+    if (n < 32)
+        put_u8(mp, (uint8_t)(0xA0 | n));                // fixstr
+    else if (n <= UINT8_MAX)
+        put_tagged_be(mp, 0xD9, (uint32_t)n, 1);
+    else if (n <= UINT16_MAX)
+        put_tagged_be(mp, 0xDA, (uint32_t)n, 2);
+    else
+        put_tagged_be(mp, 0xDB, (uint32_t)n, 4);
+
+    if (n)
+        put_bytes(mp, value, n);
+}
+
+void msgpack_writer_mac(msgpack_writer_t *mp, const uint8_t *mac)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char str[18];
+
+    for (int i = 0; i < 6; i++) {
+        str[i * 3] = hex[mac[i] >> 4];
+        str[i * 3 + 1] = hex[mac[i] & 0xF];
+        str[i * 3 + 2] = ':';
+    }
+    str[17] = '\0';
+
+    msgpack_writer_str(mp, str);
+}
+
+const uint8_t *msgpack_writer_finish(msgpack_writer_t *mp, size_t *len)
+{
+    if (mp->overflow)
+        return NULL;
+
+    if (len)
+        *len = mp->len;
+    return mp->buf;
+}
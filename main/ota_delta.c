@@ -0,0 +1,120 @@
+#include "ota_delta.h"
+
+#include <string.h>
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+void ota_delta_init(ota_delta_t *d, const ota_delta_io_t *io, void *ctx)
+{
+    memset(d, 0, sizeof(*d));
+    d->io = *io;
+    d->ctx = ctx;
+    d->status = OTA_DELTA_MORE;
+}
+
+static ota_delta_status_t parse_header(ota_delta_t *d)
+{
+    const uint8_t *p = d->buf;
+    ota_delta_header_t *h = &d->header;
+
+    if (memcmp(p, OTA_DELTA_MAGIC, 4) != 0 || get_u16(p + 4) != OTA_DELTA_FORMAT_VERSION ||
+        get_u16(p + 6) != OTA_DELTA_HEADER_LEN)
+        return OTA_DELTA_ERR_FORMAT;
+
+    h->source_size = get_u32(p + 8);
+    memcpy(h->source_sha256, p + 12, 32);
+    h->target_size = get_u32(p + 44);
+    memcpy(h->target_sha256, p + 48, 32);
+    memcpy(h->target_version, p + 80, 32);
+    h->target_version[32] = '\0';
+
+    if (d->io.header && !d->io.header(d->ctx, h))
+        return OTA_DELTA_ERR_REJECTED;
+    return OTA_DELTA_MORE;
+}
+
+static ota_delta_status_t run_op(ota_delta_t *d)
+{
+    uint8_t op = d->buf[0];
+    uint32_t arg = get_u32(d->buf + 1);
+    uint32_t len = get_u32(d->buf + 5);
+    uint32_t target = d->header.target_size;
+
+    switch (op) {
+        case OTA_DELTA_OP_END:
+            return d->out == target ? OTA_DELTA_DONE : OTA_DELTA_ERR_RANGE;
+        case OTA_DELTA_OP_COPY:
+            // written this way so a huge offset or length cannot wrap around
+            if (len > target - d->out || arg > d->header.source_size || len > d->header.source_size - arg)
+                return OTA_DELTA_ERR_RANGE;
+            if (len && !d->io.copy(d->ctx, arg, len))
+                return OTA_DELTA_ERR_IO;
+            d->out += len;
+            d->copied += len;
+            return OTA_DELTA_MORE;
+        case OTA_DELTA_OP_INSERT:
+            if (len > target - d->out)
+                return OTA_DELTA_ERR_RANGE;
+            d->insert_left = len;
+            return OTA_DELTA_MORE;
+        default:
+            return OTA_DELTA_ERR_FORMAT;
+    }
+}
+
+ota_delta_status_t ota_delta_feed(ota_delta_t *d, const uint8_t *data, size_t len)
+{
+    while (len && d->status == OTA_DELTA_MORE) {
+        if (d->insert_left) {
+            // literal bytes go straight from the network buffer to the output
+            uint32_t n = len < d->insert_left ? (uint32_t)len : d->insert_left;
+            if (!d->io.write(d->ctx, data, n)) {
+                d->status = OTA_DELTA_ERR_IO;
+                break;
+            }
+            d->insert_left -= n;
+            d->out += n;
+            data += n;
+            len -= n;
+            continue;
+        }
+
+        // header or op bytes may be split across feeds
+        uint32_t want = d->header_done ? OTA_DELTA_OP_LEN : OTA_DELTA_HEADER_LEN;
+        uint32_t n = want - d->buf_len;
+        if (n > len)
+            n = (uint32_t)len;
+        memcpy(d->buf + d->buf_len, data, n);
+        d->buf_len += n;
+        data += n;
+        len -= n;
+        if (d->buf_len < want)
+            break;
+
+        d->buf_len = 0;
+        if (!d->header_done) {
+            d->header_done = true;
+            d->status = parse_header(d);
+        } else {
+            d->status = run_op(d);
+        }
+    }
+
+    // nothing may follow END
+    if (d->status == OTA_DELTA_DONE && len)
+        d->status = OTA_DELTA_ERR_FORMAT;
+    return d->status;
+}
+
+bool ota_delta_done(const ota_delta_t *d)
+{
+    return d->status == OTA_DELTA_DONE;
+}
@@ -17,6 +17,8 @@ static ota_progress_t s_progress = {0};
 static SemaphoreHandle_t s_progress_mutex = NULL;
 static TaskHandle_t s_ota_task_handle = NULL;
 static ota_completion_cb_t s_completion_callback = NULL;
+static bool s_reboot_hold = false;
+static ota_staged_image_t s_staged = {0};
 static char s_expected_sha256[OTA_SHA256_HEX_LEN + 1] = {0};
 static bool s_initialized = false;
 
@@ -27,12 +29,24 @@ static bool s_initialized = false;
 static void ota_publish_status(const char* status, int progress, int bytes_written, int total_size)
 {
     char topic[64];
-    char payload[256];
+    char payload[384];
+    ota_timing_t timing = {0};
+    bool delta = false;
+    
+    if (s_progress_mutex && xSemaphoreTake(s_progress_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        timing = s_progress.timing;
+        delta = s_progress.delta;
+        xSemaphoreGive(s_progress_mutex);
+    }
     
     snprintf(topic, sizeof(topic), "bumblebee/%d/ota/status", UNIT_ID);
     snprintf(payload, sizeof(payload), 
-        "{\"unit_id\":%d,\"status\":\"%s\",\"progress\":%d,\"bytes\":%d,\"total\":%d}",
-        UNIT_ID, status, progress, bytes_written, total_size);
+        "{\"unit_id\":%d,\"status\":\"%s\",\"progress\":%d,\"bytes\":%d,\"total\":%d,\"delta\":%s,"
+        "\"timing\":{\"network_ms\":%lu,\"network_wait_ms\":%lu,\"flash_ms\":%lu,"
+        "\"hash_ms\":%lu,\"flash_wait_ms\":%lu,\"elapsed_ms\":%lu}}",
+        UNIT_ID, status, progress, bytes_written, total_size, delta ? "true" : "false",
+        timing.network_ms, timing.network_wait_ms, timing.flash_ms,
+        timing.hash_ms, timing.flash_wait_ms, timing.elapsed_ms);
 
         ESP_LOGI(TAG, "Publishing OTA status: %s", payload);
     
@@ -104,60 +118,580 @@ static bool sha256_compare(const char *hash1, const char *hash2)
 }
 
 // ============================================================================
-// OTA DOWNLOAD TASK
+// RESUMABLE DOWNLOAD
 // ============================================================================
 
-static void ota_download_task(void *pvParameters)
+/** Layout version of ota_checkpoint_t - bump when it changes */
+#define OTA_CHECKPOINT_VERSION  1
+
+/**
+ * @brief Progress checkpoint persisted in NVS
+ * 
+ * Only saved once the bytes are written to flash, so the partition always
+ * holds at least bytes_written valid bytes of the image.
+ */
+typedef struct {
+    uint32_t version;                       /**< OTA_CHECKPOINT_VERSION */
+    uint32_t sha_ctx_size;                  /**< sizeof(mbedtls_sha256_context) of the writer */
+    uint32_t partition_address;             /**< Update partition being written */
+    uint32_t bytes_written;                 /**< Image bytes already in flash */
+    uint32_t total_bytes;                   /**< Image size (0 if unknown) */
+    char sha256[OTA_SHA256_HEX_LEN + 1];    /**< Expected SHA256 of the image */
+    char version_str[32];                   /**< Firmware version read from the header */
+    mbedtls_sha256_context sha_ctx;         /**< Running hash of bytes_written (software state) */
+} ota_checkpoint_t;
+
+/**
+ * @brief Download buffer passed from the HTTP reader to the flash writer
+ */
+typedef struct {
+    int len;
+    char data[OTA_BUF_SIZE];
+} ota_buffer_t;
+
+/**
+ * @brief State of one update, kept across the HTTP attempts
+ * 
+ * The download task reads the HTTP response into free buffers and queues
+ * them; the writer task writes and hashes them in order, then frees them.
+ * offset and the SHA256 context belong to the writer while buffers are in
+ * flight - the reader only uses them after ota_pipeline_flush().
+ * 
+ * offset counts bytes of the HTTP resource, image_bytes the bytes written to
+ * the partition: they differ only when a delta patch is being applied.
+ */
+typedef struct {
+    const esp_partition_t *partition;
+    esp_ota_handle_t ota_handle;
+    bool ota_open;
+    mbedtls_sha256_context sha_ctx;
+    uint32_t offset;                /**< Bytes of the download processed by the writer */
+    uint32_t received;              /**< Bytes read from the network (offset + queued) */
+    uint32_t image_bytes;           /**< Image bytes written and hashed */
+    uint32_t total;                 /**< Image size (0 if unknown) */
+    uint32_t checkpoint_at;         /**< Offset of the last checkpoint saved */
+    bool header_checked;
+    int last_progress_log;
+    // Content-Range of the current response
+    bool range_valid;
+    uint32_t range_start;
+    uint32_t range_total;
+    // delta update: the download is a patch against the running image
+    bool delta;
+    char patch_url[128];
+    ota_delta_t patch;
+    const esp_partition_t *running;
+    uint8_t *copy_buf;              /**< Running image bytes being copied */
+    // download pipeline
+    ota_buffer_t *buffers;
+    QueueHandle_t free_buffers;
+    QueueHandle_t full_buffers;
+    TaskHandle_t reader_task;
+    TaskHandle_t writer_task;
+    volatile ota_error_t write_error;
+    // stage times (microseconds), each written by one task only
+    int64_t started_us;
+    int64_t network_us;
+    int64_t network_wait_us;
+    int64_t flash_us;
+    int64_t hash_us;
+    int64_t flash_wait_us;
+} ota_session_t;
+
+static ota_checkpoint_t s_checkpoint;   // static: holds a SHA256 context, keep it off the task stack
+
+static void ota_checkpoint_clear(void)
 {
-    ESP_LOGI(TAG, "OTA Download Task Started");
-    ESP_LOGI(TAG, "URL: %s", OTA_FIRMWARE_URL);
-    
-    esp_err_t err;
-    esp_ota_handle_t ota_handle = 0;
-    const esp_partition_t *update_partition = NULL;
-    
-    // SHA256 context for streaming calculation
-    mbedtls_sha256_context sha256_ctx;
-    uint8_t sha256_result[32];
-    char sha256_hex[65];
-    
-    // Download buffer
-    char *buffer = malloc(OTA_BUF_SIZE);
-    if (!buffer) {
-        ESP_LOGE(TAG, "Failed to allocate download buffer");
-        update_progress(OTA_STATUS_FAILED, OTA_ERR_NO_MEMORY, 0, 0);
-        ota_publish_status("failed", 0, 0, 0);
-        goto cleanup;
+    nvs_handle_t nvs;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_key(nvs, OTA_NVS_CHECKPOINT_KEY);
+        nvs_commit(nvs);
+        nvs_close(nvs);
     }
-    
-    // Initialize SHA256
-    mbedtls_sha256_init(&sha256_ctx);
-    mbedtls_sha256_starts(&sha256_ctx, 0);  // 0 = SHA256 (not SHA224)
-    
-    update_progress(OTA_STATUS_STARTING, OTA_ERR_NONE, 0, 0);
-    ota_publish_status("starting", 0, 0, 0);
-    
-    // ========================================================================
-    // STEP 1: Find update partition
-    // ========================================================================
-    
-    update_partition = esp_ota_get_next_update_partition(NULL);
-    if (update_partition == NULL) {
-        ESP_LOGE(TAG, "No OTA partition found");
-        update_progress(OTA_STATUS_FAILED, OTA_ERR_PARTITION, 0, 0);
-        ota_publish_status("failed", 0, 0, 0);
-        goto cleanup;
+}
+
+static void ota_checkpoint_save(ota_session_t *s)
+{
+    // nothing to resume without a hash to tie the bytes to the image; the patch
+    // decoder state is not saved, an interrupted patch is downloaded again
+    if (s->delta || strlen(s_expected_sha256) != OTA_SHA256_HEX_LEN || s->offset == s->checkpoint_at) {
+        return;
+    }
+
+    memset(&s_checkpoint, 0, sizeof(s_checkpoint));
+    s_checkpoint.version = OTA_CHECKPOINT_VERSION;
+    s_checkpoint.sha_ctx_size = sizeof(mbedtls_sha256_context);
+    s_checkpoint.partition_address = s->partition->address;
+    s_checkpoint.bytes_written = s->offset;
+    s_checkpoint.total_bytes = s->total;
+    strncpy(s_checkpoint.sha256, s_expected_sha256, OTA_SHA256_HEX_LEN);
+    if (xSemaphoreTake(s_progress_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        strncpy(s_checkpoint.version_str, s_progress.version, sizeof(s_checkpoint.version_str) - 1);
+        xSemaphoreGive(s_progress_mutex);
+    }
+    // clone moves a hardware-held digest into the context, so the bytes are self-contained
+    mbedtls_sha256_init(&s_checkpoint.sha_ctx);
+    mbedtls_sha256_clone(&s_checkpoint.sha_ctx, &s->sha_ctx);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(OTA_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, OTA_NVS_CHECKPOINT_KEY, &s_checkpoint, sizeof(s_checkpoint));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    mbedtls_sha256_free(&s_checkpoint.sha_ctx);
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Checkpoint not saved: %s", esp_err_to_name(err));
+        return;
+    }
+    s->checkpoint_at = s->offset;
+    ESP_LOGD(TAG, "Checkpoint saved at %lu bytes", s->offset);
+}
+
+/**
+ * @brief Load the checkpoint of the image being requested
+ * 
+ * @return true if s_checkpoint holds a usable checkpoint for this partition and SHA256
+ */
+static bool ota_checkpoint_load(const esp_partition_t *partition)
+{
+    if (strlen(s_expected_sha256) != OTA_SHA256_HEX_LEN) {
+        return false;
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open(OTA_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(s_checkpoint);
+    esp_err_t err = nvs_get_blob(nvs, OTA_NVS_CHECKPOINT_KEY, &s_checkpoint, &len);
+    nvs_close(nvs);
+
+    if (err != ESP_OK || len != sizeof(s_checkpoint)) {
+        return false;
+    }
+    if (s_checkpoint.version != OTA_CHECKPOINT_VERSION ||
+        s_checkpoint.sha_ctx_size != sizeof(mbedtls_sha256_context) ||
+        s_checkpoint.partition_address != partition->address ||
+        !sha256_compare(s_checkpoint.sha256, s_expected_sha256)) {
+        ESP_LOGI(TAG, "Checkpoint belongs to another image - full download");
+        return false;
+    }
+    if (s_checkpoint.bytes_written == 0 || s_checkpoint.bytes_written > partition->size ||
+        (s_checkpoint.total_bytes && s_checkpoint.bytes_written >= s_checkpoint.total_bytes)) {
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// DELTA UPDATE
+// ============================================================================
+
+/**
+ * @brief Write and hash image bytes (writer task)
+ */
+static bool ota_image_write(ota_session_t *s, const void *data, uint32_t len)
+{
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_ota_write(s->ota_handle, data, len);
+    int64_t t1 = esp_timer_get_time();
+    s->flash_us += t1 - t0;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(err));
+        s->write_error = OTA_ERR_FLASH_WRITE;
+        return false;
+    }
+
+    // Update SHA256 hash (only bytes that made it to flash, the checkpoint relies on it)
+    mbedtls_sha256_update(&s->sha_ctx, (const unsigned char *)data, len);
+    s->hash_us += esp_timer_get_time() - t1;
+    s->image_bytes += len;
+    return true;
+}
+
+/**
+ * @brief SHA256 of the first size bytes of a partition
+ */
+static bool partition_sha256(const esp_partition_t *partition, uint32_t size, uint8_t *buf, uint8_t *digest)
+{
+    mbedtls_sha256_context ctx;
+    esp_err_t err = ESP_OK;
+
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    for (uint32_t pos = 0; pos < size && err == ESP_OK; pos += OTA_BUF_SIZE) {
+        uint32_t n = size - pos < OTA_BUF_SIZE ? size - pos : OTA_BUF_SIZE;
+        err = esp_partition_read(partition, pos, buf, n);
+        if (err == ESP_OK) {
+            mbedtls_sha256_update(&ctx, buf, n);
+        }
+    }
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+    return err == ESP_OK;
+}
+
+static bool delta_header(void *ctx, const ota_delta_header_t *header)
+{
+    ota_session_t *s = (ota_session_t *)ctx;
+    uint8_t digest[32];
+    char hex[OTA_SHA256_HEX_LEN + 1];
+
+    sha256_to_hex(header->target_sha256, hex);
+    if (!sha256_compare(hex, s_expected_sha256)) {
+        ESP_LOGW(TAG, "Patch builds %s, not the requested image", hex);
+        return false;
+    }
+    if (header->target_size > s->partition->size || header->source_size > s->running->size) {
+        ESP_LOGW(TAG, "Patch does not fit the partitions");
+        return false;
+    }
+    // a patch only applies to the exact bytes it was made from
+    if (!partition_sha256(s->running, header->source_size, s->copy_buf, digest) ||
+        memcmp(digest, header->source_sha256, sizeof(digest)) != 0) {
+        ESP_LOGW(TAG, "Running image is not the one the patch was made from");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Applying delta patch: %lu image bytes, new version %s",
+             header->target_size, header->target_version);
+    if (xSemaphoreTake(s_progress_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        strncpy(s_progress.version, header->target_version, sizeof(s_progress.version) - 1);
+        xSemaphoreGive(s_progress_mutex);
+    }
+    return true;
+}
+
+static bool delta_write(void *ctx, const uint8_t *data, uint32_t len)
+{
+    return ota_image_write((ota_session_t *)ctx, data, len);
+}
+
+static bool delta_copy(void *ctx, uint32_t source_offset, uint32_t len)
+{
+    ota_session_t *s = (ota_session_t *)ctx;
+
+    while (len) {
+        uint32_t n = len < OTA_BUF_SIZE ? len : OTA_BUF_SIZE;
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t err = esp_partition_read(s->running, source_offset, s->copy_buf, n);
+        s->flash_us += esp_timer_get_time() - t0;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Reading the running image failed: %s", esp_err_to_name(err));
+            return false;
+        }
+        if (!ota_image_write(s, s->copy_buf, n)) {
+            return false;
+        }
+        source_offset += n;
+        len -= n;
+    }
+    return true;
+}
+
+static const ota_delta_io_t s_delta_io = {
+    .header = delta_header,
+    .write = delta_write,
+    .copy = delta_copy,
+};
+
+/**
+ * @brief Ask for a patch against the running version instead of the full image
+ * 
+ * The rebuilt image can only be trusted with the expected SHA256, so a
+ * request without one always downloads the full image.
+ */
+static void ota_delta_begin(ota_session_t *s)
+{
+    s->delta = false;
+    if (!OTA_DELTA_ENABLED || strlen(s_expected_sha256) != OTA_SHA256_HEX_LEN) {
+        return;
+    }
+
+    // same file name rule as ota_delta.py
+    const esp_app_desc_t *app = esp_app_get_description();
+    int n = snprintf(s->patch_url, sizeof(s->patch_url), "%s", OTA_PATCH_URL_PREFIX);
+    for (const char *c = app->version; *c && n < (int)sizeof(s->patch_url) - 7; c++) {
+        s->patch_url[n++] = (isalnum((unsigned char)*c) || *c == '.' || *c == '-' || *c == '_') ? *c : '_';
+    }
+    snprintf(s->patch_url + n, sizeof(s->patch_url) - n, ".patch");
+
+    s->running = esp_ota_get_running_partition();
+    if (s->copy_buf == NULL) {
+        s->copy_buf = malloc(OTA_BUF_SIZE);
+    }
+    if (s->running == NULL || s->copy_buf == NULL) {
+        return;
+    }
+
+    s->delta = true;
+    if (xSemaphoreTake(s_progress_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        s_progress.delta = true;
+        xSemaphoreGive(s_progress_mutex);
+    }
+    ESP_LOGI(TAG, "Trying a delta update from %s: %s", app->version, s->patch_url);
+}
+
+/**
+ * @brief (Re)start the image from byte zero
+ */
+static esp_err_t ota_session_restart(ota_session_t *s)
+{
+    if (s->ota_open) {
+        esp_ota_abort(s->ota_handle);
+        s->ota_open = false;
+    }
+
+    mbedtls_sha256_free(&s->sha_ctx);
+    mbedtls_sha256_init(&s->sha_ctx);
+    mbedtls_sha256_starts(&s->sha_ctx, 0);  // 0 = SHA256 (not SHA224)
+    s->offset = 0;
+    s->received = 0;
+    s->image_bytes = 0;
+    s->checkpoint_at = 0;
+    s->header_checked = false;
+    s->write_error = OTA_ERR_NONE;
+    s->last_progress_log = -1;
+    if (s->delta) {
+        ota_delta_init(&s->patch, &s_delta_io, s);
+    }
+
+    esp_err_t err = esp_ota_begin(s->partition, OTA_WITH_SEQUENTIAL_WRITES, &s->ota_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    s->ota_open = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Reopen the partition after the bytes of s_checkpoint
+ */
+static esp_err_t ota_session_resume(ota_session_t *s)
+{
+    esp_err_t err = esp_ota_resume(s->partition, OTA_WITH_SEQUENTIAL_WRITES,
+                                   s_checkpoint.bytes_written, &s->ota_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "esp_ota_resume failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    s->ota_open = true;
+
+    mbedtls_sha256_free(&s->sha_ctx);
+    memcpy(&s->sha_ctx, &s_checkpoint.sha_ctx, sizeof(s->sha_ctx));
+    s->offset = s->received = s->image_bytes = s->checkpoint_at = s_checkpoint.bytes_written;
+    s->total = s_checkpoint.total_bytes;
+    s->header_checked = true;
+    s->last_progress_log = s->total ? (int)(((uint64_t)s->offset * 100) / s->total) : -1;
+
+    if (xSemaphoreTake(s_progress_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        strncpy(s_progress.version, s_checkpoint.version_str, sizeof(s_progress.version) - 1);
+        xSemaphoreGive(s_progress_mutex);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Parse "bytes <start>-<end>/<total>" (total may be "*")
+ */
+static bool parse_content_range(const char *value, uint32_t *start, uint32_t *total)
+{
+    unsigned long first, last;
+    char total_str[16] = {0};
+
+    if (sscanf(value, "bytes %lu-%lu/%15s", &first, &last, total_str) != 3 || last < first) {
+        return false;
+    }
+    *start = (uint32_t)first;
+    *total = (total_str[0] == '*') ? 0 : (uint32_t)strtoul(total_str, NULL, 10);
+    return true;
+}
+
+static esp_err_t ota_http_event_handler(esp_http_client_event_t *evt)
+{
+    ota_session_t *s = (ota_session_t *)evt->user_data;
+
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && s != NULL &&
+        strcasecmp(evt->header_key, "Content-Range") == 0) {
+        s->range_valid = parse_content_range(evt->header_value, &s->range_start, &s->range_total);
+    }
+    return ESP_OK;
+}
+
+// ============================================================================
+// DOWNLOAD PIPELINE
+// ============================================================================
+
+/**
+ * @brief Publish the stage times of one side of the pipeline
+ */
+static void ota_timing_sync(ota_session_t *s, bool writer)
+{
+    if (xSemaphoreTake(s_progress_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        ota_timing_t *t = &s_progress.timing;
+        if (writer) {
+            t->flash_ms = (uint32_t)(s->flash_us / 1000);
+            t->hash_ms = (uint32_t)(s->hash_us / 1000);
+            t->flash_wait_ms = (uint32_t)(s->flash_wait_us / 1000);
+        } else {
+            t->network_ms = (uint32_t)(s->network_us / 1000);
+            t->network_wait_ms = (uint32_t)(s->network_wait_us / 1000);
+        }
+        t->elapsed_ms = (uint32_t)((esp_timer_get_time() - s->started_us) / 1000);
+        xSemaphoreGive(s_progress_mutex);
+    }
+}
+
+/**
+ * @brief Write one buffer of the image, or apply one buffer of the patch (writer task)
+ */
+static void ota_write_buffer(ota_session_t *s, const ota_buffer_t *buf)
+{
+    if (s->delta) {
+        ota_delta_status_t status = ota_delta_feed(&s->patch, (const uint8_t *)buf->data, buf->len);
+        if (status != OTA_DELTA_MORE && status != OTA_DELTA_DONE) {
+            ESP_LOGE(TAG, "Delta patch rejected (status %d) at %lu patch bytes", status, s->offset);
+            // a flash write error was already reported by the callback
+            if (s->write_error == OTA_ERR_NONE) {
+                s->write_error = OTA_ERR_PATCH_INVALID;
+            }
+            return;
+        }
+    } else if (!ota_image_write(s, buf->data, buf->len)) {
+        return;
+    }
+    s->offset += buf->len;
+
+    if (s->offset - s->checkpoint_at >= OTA_CHECKPOINT_BYTES) {
+        ota_checkpoint_save(s);
     }
     
-    ESP_LOGI(TAG, "Writing to partition: %s (offset 0x%08lx)",
-             update_partition->label, update_partition->address);
-    
-    // ========================================================================
-    // STEP 2: Setup HTTP client with TLS
-    // ========================================================================
-    
+    // Update progress
+    update_progress(OTA_STATUS_DOWNLOADING, OTA_ERR_NONE, s->offset, s->total);
+    ota_timing_sync(s, true);
+    
+    // Log progress every 10%
+    if (s->total > 0) {
+        int current_progress = (int)(((uint64_t)s->offset * 100) / s->total);
+        if (current_progress / 10 > s->last_progress_log / 10) {
+            ESP_LOGI(TAG, "Download progress: %d%% (%lu / %lu bytes)",
+                    current_progress, s->offset, s->total);
+            ota_publish_status("downloading", current_progress, s->offset, s->total);
+            s->last_progress_log = current_progress;
+        }
+    }
+}
+
+/**
+ * @brief Flash writer: takes the buffers in order until the stop marker (NULL)
+ */
+static void ota_writer_task(void *pvParameters)
+{
+    ota_session_t *s = (ota_session_t *)pvParameters;
+    ota_buffer_t *buf;
+
+    while (1) {
+        int64_t t0 = esp_timer_get_time();
+        xQueueReceive(s->full_buffers, &buf, portMAX_DELAY);
+        s->flash_wait_us += esp_timer_get_time() - t0;
+        if (buf == NULL) {
+            break;
+        }
+
+        // after a write error the rest is dropped, the reader stops at its next buffer
+        if (s->write_error == OTA_ERR_NONE) {
+            ota_write_buffer(s, buf);
+        }
+        xQueueSend(s->free_buffers, &buf, portMAX_DELAY);
+    }
+
+    xTaskNotifyGive(s->reader_task);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Wait until every queued buffer is written - s->offset is final afterwards
+ */
+static void ota_pipeline_flush(ota_session_t *s)
+{
+    ota_buffer_t *held[OTA_PIPELINE_BUFFERS];
+    int64_t t0 = esp_timer_get_time();
+
+    for (int i = 0; i < OTA_PIPELINE_BUFFERS; i++) {
+        xQueueReceive(s->free_buffers, &held[i], portMAX_DELAY);
+    }
+    for (int i = 0; i < OTA_PIPELINE_BUFFERS; i++) {
+        xQueueSend(s->free_buffers, &held[i], 0);
+    }
+    s->network_wait_us += esp_timer_get_time() - t0;
+}
+
+static void ota_pipeline_stop(ota_session_t *s)
+{
+    if (s->writer_task) {
+        // queued after the pending buffers, so they are written first
+        ota_buffer_t *stop = NULL;
+        xQueueSend(s->full_buffers, &stop, portMAX_DELAY);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        s->writer_task = NULL;
+    }
+    if (s->free_buffers) {
+        vQueueDelete(s->free_buffers);
+        s->free_buffers = NULL;
+    }
+    if (s->full_buffers) {
+        vQueueDelete(s->full_buffers);
+        s->full_buffers = NULL;
+    }
+    free(s->buffers);
+    s->buffers = NULL;
+}
+
+static esp_err_t ota_pipeline_start(ota_session_t *s)
+{
+    s->buffers = malloc(OTA_PIPELINE_BUFFERS * sizeof(ota_buffer_t));
+    s->free_buffers = xQueueCreate(OTA_PIPELINE_BUFFERS, sizeof(ota_buffer_t *));
+    s->full_buffers = xQueueCreate(OTA_PIPELINE_BUFFERS + 1, sizeof(ota_buffer_t *));  // + stop marker
+    if (!s->buffers || !s->free_buffers || !s->full_buffers) {
+        ota_pipeline_stop(s);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < OTA_PIPELINE_BUFFERS; i++) {
+        ota_buffer_t *buf = &s->buffers[i];
+        xQueueSend(s->free_buffers, &buf, 0);
+    }
+
+    s->reader_task = xTaskGetCurrentTaskHandle();
+    if (xTaskCreate(ota_writer_task, "ota_writer", OTA_WRITER_STACK_SIZE, s,
+                    OTA_WRITER_PRIORITY, &s->writer_task) != pdPASS) {
+        s->writer_task = NULL;
+        ota_pipeline_stop(s);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief One HTTP request: download from s->offset to the end of the image
+ * 
+ * @param[out] retry true if the error is worth another attempt (network, server)
+ * @return OTA_ERR_NONE once the whole image is written
+ */
+static ota_error_t ota_download_attempt(ota_session_t *s, bool *retry)
+{
+    ota_error_t result = OTA_ERR_NONE;
+    esp_err_t err;
+    *retry = false;
+
     esp_http_client_config_t config = {
-        .url = OTA_FIRMWARE_URL,
+        .url = s->delta ? s->patch_url : OTA_FIRMWARE_URL,
         .cert_pem = NULL,  // Set to NULL for HTTP, or keep for HTTPS
         .timeout_ms = OTA_HTTP_TIMEOUT_MS,
         .buffer_size = OTA_BUF_SIZE,
@@ -165,27 +699,30 @@ static void ota_download_task(void *pvParameters)
         .username = OTA_HTTP_USERNAME,     
         .password = OTA_HTTP_PASSWORD,     
         .auth_type = HTTP_AUTH_TYPE_BASIC, 
+        .event_handler = ota_http_event_handler,
+        .user_data = s,
     };
     
     esp_http_client_handle_t http_client = esp_http_client_init(&config);
     if (!http_client) {
         ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        update_progress(OTA_STATUS_FAILED, OTA_ERR_HTTP_CONNECT, 0, 0);
-        ota_publish_status("failed", 0, 0, 0);
-        goto cleanup;
+        return OTA_ERR_HTTP_CONNECT;
     }
 
-    ota_publish_status("connecting", 0, 0, 0);
-    
-    // ========================================================================
-    // STEP 3: Open HTTP connection
-    // ========================================================================
-    
+    // continue after the bytes already in flash
+    char range[32];
+    if (s->offset > 0) {
+        snprintf(range, sizeof(range), "bytes=%lu-", s->offset);
+        esp_http_client_set_header(http_client, "Range", range);
+        ESP_LOGI(TAG, "Resuming download at %lu bytes", s->offset);
+    }
+    s->range_valid = false;
+
     err = esp_http_client_open(http_client, 0);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "HTTP connection failed: %s", esp_err_to_name(err));
-        update_progress(OTA_STATUS_FAILED, OTA_ERR_HTTP_CONNECT, 0, 0);
-        ota_publish_status("failed", 0, 0, 0);
+        *retry = true;
+        result = OTA_ERR_HTTP_CONNECT;
         goto cleanup_http;
     }
     
@@ -194,71 +731,89 @@ static void ota_download_task(void *pvParameters)
     
     ESP_LOGI(TAG, "HTTP Status: %d, Content-Length: %d", status_code, content_length);
     
-    if (status_code != 200) {
+    if (status_code == 206 && s->range_valid && s->range_start == s->offset) {
+        // the rest of the image
+        if (s->range_total) {
+            s->total = s->range_total;
+        }
+    } else if (status_code == 200) {
+        if (s->offset > 0) {
+            // Range not supported (or the image changed) - the whole image again
+            ESP_LOGW(TAG, "Server sent the full image - restarting from byte 0");
+            if (ota_session_restart(s) != ESP_OK) {
+                result = OTA_ERR_PARTITION;
+                goto cleanup_http;
+            }
+        }
+        s->total = content_length > 0 ? (uint32_t)content_length : 0;
+        if (content_length <= 0) {
+            ESP_LOGW(TAG, "Content-Length unknown, proceeding anyway");
+        }
+    } else {
         ESP_LOGE(TAG, "HTTP error: %d", status_code);
-        update_progress(OTA_STATUS_FAILED, OTA_ERR_HTTP_RESPONSE, 0, 0);
-        ota_publish_status("failed", 0, 0, 0);
+        // 416: the checkpoint does not fit this image, start over on the next attempt
+        if (status_code == 416 && ota_session_restart(s) != ESP_OK) {
+            result = OTA_ERR_PARTITION;
+            goto cleanup_http;
+        }
+        *retry = (status_code == 206 || status_code == 416 || status_code >= 500);
+        result = OTA_ERR_HTTP_RESPONSE;
         goto cleanup_http;
     }
-    
-    if (content_length <= 0) {
-        ESP_LOGW(TAG, "Content-Length unknown, proceeding anyway");
-        content_length = 0;  // Will show 0% progress
-    }
 
-    ota_publish_status("connecting", 0, 0, content_length);
-    
-    // ========================================================================
-    // STEP 4: Begin OTA
-    // ========================================================================
-    
-    err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(err));
-        update_progress(OTA_STATUS_FAILED, OTA_ERR_PARTITION, 0, 0);
-        ota_publish_status("failed", 0, 0, 0);
+    if (s->total > s->partition->size) {
+        ESP_LOGE(TAG, "Image (%lu bytes) larger than the partition", s->total);
+        result = OTA_ERR_PARTITION;
         goto cleanup_http;
     }
-    
-    update_progress(OTA_STATUS_DOWNLOADING, OTA_ERR_NONE, 0, content_length);
-    
-    // ========================================================================
-    // STEP 5: Download and write firmware
-    // ========================================================================
-    
-    uint32_t bytes_downloaded = 0;
-    int bytes_read = 0;
-    bool header_checked = false;
-    int last_progress_log = -1;
-    
-    while (1) {
-        bytes_read = esp_http_client_read(http_client, buffer, OTA_BUF_SIZE);
+
+    s->received = s->offset;
+    update_progress(OTA_STATUS_DOWNLOADING, OTA_ERR_NONE, s->offset, s->total);
+    ota_publish_status(s->offset ? "resuming" : "downloading",
+                       s->total ? (int)(((uint64_t)s->offset * 100) / s->total) : 0, s->offset, s->total);
+
+    // read into free buffers, the writer task flashes them meanwhile
+    ota_buffer_t *buf = NULL;
+    while (s->write_error == OTA_ERR_NONE) {
+        int64_t t0 = esp_timer_get_time();
+        if (buf == NULL) {
+            xQueueReceive(s->free_buffers, &buf, portMAX_DELAY);
+        }
+        int64_t t1 = esp_timer_get_time();
+        int bytes_read = esp_http_client_read(http_client, buf->data, OTA_BUF_SIZE);
+        s->network_wait_us += t1 - t0;
+        s->network_us += esp_timer_get_time() - t1;
+        ota_timing_sync(s, false);
         
         if (bytes_read < 0) {
             ESP_LOGE(TAG, "HTTP read error");
-            update_progress(OTA_STATUS_FAILED, OTA_ERR_DOWNLOAD, bytes_downloaded, content_length);
-            ota_publish_status("failed", 0, bytes_downloaded, content_length);
-            esp_ota_abort(ota_handle);
-            goto cleanup_http;
+            *retry = true;
+            result = OTA_ERR_DOWNLOAD;
+            break;
         }
         
         if (bytes_read == 0) {
             // Download complete
-            if (esp_http_client_is_complete_data_received(http_client)) {
-                ESP_LOGI(TAG, "Download complete: %lu bytes", bytes_downloaded);
+            if (esp_http_client_is_complete_data_received(http_client) && (s->total == 0 || s->received == s->total)) {
+                ESP_LOGI(TAG, "Download complete: %lu bytes", s->received);
                 break;
             }
             // Connection closed prematurely
-            ESP_LOGE(TAG, "Connection closed unexpectedly");
-            update_progress(OTA_STATUS_FAILED, OTA_ERR_DOWNLOAD, bytes_downloaded, content_length);
-            ota_publish_status("failed", 0, bytes_downloaded, content_length);
-            esp_ota_abort(ota_handle);
-            goto cleanup_http;
+            ESP_LOGE(TAG, "Connection closed unexpectedly at %lu bytes", s->received);
+            *retry = true;
+            result = OTA_ERR_DOWNLOAD;
+            break;
+        }
+
+        if (s->total && s->received + bytes_read > s->total) {
+            ESP_LOGE(TAG, "Server sent more than %lu bytes", s->total);
+            result = OTA_ERR_DOWNLOAD;
+            break;
         }
         
         // Check firmware header on first chunk
-        if (!header_checked && bytes_read > sizeof(esp_image_header_t)) {
-            esp_app_desc_t *app_desc = (esp_app_desc_t *)(buffer + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t));
+        if (!s->delta && !s->header_checked && s->received == 0 && bytes_read > sizeof(esp_image_header_t)) {
+            esp_app_desc_t *app_desc = (esp_app_desc_t *)(buf->data + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t));
             
             // Basic sanity check
             if (app_desc->magic_word == ESP_APP_DESC_MAGIC_WORD) {
@@ -271,53 +826,183 @@ static void ota_download_task(void *pvParameters)
                     xSemaphoreGive(s_progress_mutex);
                 }
             }
-            header_checked = true;
+            s->header_checked = true;
         }
         
-        // Update SHA256 hash
-        mbedtls_sha256_update(&sha256_ctx, (const unsigned char *)buffer, bytes_read);
-        
-        // Write to flash
-        err = esp_ota_write(ota_handle, buffer, bytes_read);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(err));
-            update_progress(OTA_STATUS_FAILED, OTA_ERR_FLASH_WRITE, bytes_downloaded, content_length);
-            ota_publish_status("failed", 0, bytes_downloaded, content_length);
-            esp_ota_abort(ota_handle);
-            goto cleanup_http;
+        // Hand over to the writer (blocking on the free queue also yields to other tasks)
+        buf->len = bytes_read;
+        s->received += bytes_read;
+        xQueueSend(s->full_buffers, &buf, portMAX_DELAY);
+        buf = NULL;
+    }
+
+    if (buf) {
+        xQueueSend(s->free_buffers, &buf, portMAX_DELAY);
+    }
+    ota_pipeline_flush(s);
+
+    if (s->write_error != OTA_ERR_NONE) {
+        *retry = false;
+        result = s->write_error;
+    } else if (result == OTA_ERR_NONE && s->delta && !ota_delta_done(&s->patch)) {
+        ESP_LOGE(TAG, "Delta patch ended before the image was complete");
+        result = OTA_ERR_PATCH_INVALID;
+    }
+
+    // keep what made it to flash for the next attempt (or the next update request)
+    if (*retry) {
+        ota_checkpoint_save(s);
+    }
+
+cleanup_http:
+    esp_http_client_close(http_client);
+    esp_http_client_cleanup(http_client);
+    return result;
+}
+
+// ============================================================================
+// OTA DOWNLOAD TASK
+// ============================================================================
+
+static void ota_download_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "OTA Download Task Started");
+    ESP_LOGI(TAG, "URL: %s", OTA_FIRMWARE_URL);
+    
+    esp_err_t err;
+    static ota_session_t session;   // holds a SHA256 context, keep it off the task stack
+    ota_session_t *s = &session;
+    ota_error_t result = OTA_ERR_NONE;
+    
+    uint8_t sha256_result[32];
+    char sha256_hex[65];
+
+    memset(s, 0, sizeof(*s));
+    mbedtls_sha256_init(&s->sha_ctx);
+    s->started_us = esp_timer_get_time();
+    
+    if (xSemaphoreTake(s_progress_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        memset(&s_progress.timing, 0, sizeof(s_progress.timing));
+        s_progress.delta = false;
+        xSemaphoreGive(s_progress_mutex);
+    }
+    
+    // Download buffers and flash writer task
+    if (ota_pipeline_start(s) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the download pipeline");
+        update_progress(OTA_STATUS_FAILED, OTA_ERR_NO_MEMORY, 0, 0);
+        ota_publish_status("failed", 0, 0, 0);
+        goto cleanup;
+    }
+    
+    update_progress(OTA_STATUS_STARTING, OTA_ERR_NONE, 0, 0);
+    ota_publish_status("starting", 0, 0, 0);
+    
+    // ========================================================================
+    // STEP 1: Find update partition
+    // ========================================================================
+    
+    s->partition = esp_ota_get_next_update_partition(NULL);
+    if (s->partition == NULL) {
+        ESP_LOGE(TAG, "No OTA partition found");
+        update_progress(OTA_STATUS_FAILED, OTA_ERR_PARTITION, 0, 0);
+        ota_publish_status("failed", 0, 0, 0);
+        goto cleanup;
+    }
+    
+    ESP_LOGI(TAG, "Writing to partition: %s (offset 0x%08lx)",
+             s->partition->label, s->partition->address);
+    
+    // ========================================================================
+    // STEP 2: Resume a previous download of the same image, or begin OTA
+    // ========================================================================
+    
+    if (ota_checkpoint_load(s->partition) && ota_session_resume(s) == ESP_OK) {
+        ESP_LOGI(TAG, "Resuming from checkpoint: %lu / %lu bytes", s->offset, s->total);
+    } else {
+        ota_checkpoint_clear();
+        ota_delta_begin(s);
+        if (ota_session_restart(s) != ESP_OK) {
+            update_progress(OTA_STATUS_FAILED, OTA_ERR_PARTITION, 0, 0);
+            ota_publish_status("failed", 0, 0, 0);
+            goto cleanup;
         }
-        
-        bytes_downloaded += bytes_read;
-        
-        // Update progress
-        update_progress(OTA_STATUS_DOWNLOADING, OTA_ERR_NONE, bytes_downloaded, content_length);
-        
-        // Log progress every 10%
-        if (content_length > 0) {
-            int current_progress = (bytes_downloaded * 100) / content_length;
-            if (current_progress / 10 > last_progress_log / 10) {
-                ESP_LOGI(TAG, "Download progress: %d%% (%lu / %d bytes)",
-                        current_progress, bytes_downloaded, content_length);
-                ota_publish_status("downloading", current_progress, bytes_downloaded, content_length);
-                last_progress_log = current_progress;
+    }
+
+    ota_publish_status("connecting", 0, s->offset, s->total);
+    
+    // ========================================================================
+    // STEP 3: Download and write firmware, resuming after network errors
+    // ========================================================================
+    
+    uint32_t retry_delay = OTA_RETRY_DELAY_MS;
+    for (int attempt = 1; ; attempt++) {
+        bool retry = false;
+        uint32_t resumed_from = s->offset;
+
+        if (xSemaphoreTake(s_progress_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+            s_progress.attempts = attempt;
+            s_progress.resumed_from = resumed_from;
+            xSemaphoreGive(s_progress_mutex);
+        }
+
+        result = ota_download_attempt(s, &retry);
+        if (result == OTA_ERR_NONE) {
+            break;
+        }
+        if (s->delta && result != OTA_ERR_FLASH_WRITE && (!retry || attempt >= OTA_MAX_ATTEMPTS)) {
+            // no patch for this version, or it does not apply: full image, fresh attempts
+            ESP_LOGW(TAG, "Delta update failed (%s) - downloading the full image", ota_error_to_string(result));
+            s->delta = false;
+            if (xSemaphoreTake(s_progress_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+                s_progress.delta = false;
+                xSemaphoreGive(s_progress_mutex);
+            }
+            if (ota_session_restart(s) != ESP_OK) {
+                update_progress(OTA_STATUS_FAILED, OTA_ERR_PARTITION, 0, 0);
+                ota_publish_status("failed", 0, 0, 0);
+                goto cleanup;
             }
+            attempt = 0;
+            retry_delay = OTA_RETRY_DELAY_MS;
+            continue;
         }
-        
-        // Yield to other tasks
-        vTaskDelay(pdMS_TO_TICKS(1));
+        if (!retry || attempt >= OTA_MAX_ATTEMPTS) {
+            ESP_LOGE(TAG, "Download failed after %d attempts (%lu bytes kept for the next request)",
+                     attempt, s->checkpoint_at);
+            update_progress(OTA_STATUS_FAILED, result, s->offset, s->total);
+            ota_publish_status("failed", 0, s->offset, s->total);
+            goto cleanup;
+        }
+
+        ESP_LOGW(TAG, "Attempt %d failed (%s) at %lu bytes - retry in %lu ms",
+                 attempt, ota_error_to_string(result), s->offset, retry_delay);
+        vTaskDelay(pdMS_TO_TICKS(retry_delay));
+        retry_delay = retry_delay * 2 > OTA_RETRY_DELAY_MAX_MS ? OTA_RETRY_DELAY_MAX_MS : retry_delay * 2;
     }
+
+    ota_pipeline_stop(s);
+    ota_timing_sync(s, true);
+    ota_timing_sync(s, false);
+    ESP_LOGI(TAG, "Pipeline: %lu ms total, network %lu ms (+%lu ms waiting for flash), "
+             "flash %lu ms + hash %lu ms (+%lu ms waiting for data)",
+             s_progress.timing.elapsed_ms, s_progress.timing.network_ms, s_progress.timing.network_wait_ms,
+             s_progress.timing.flash_ms, s_progress.timing.hash_ms, s_progress.timing.flash_wait_ms);
     
     // ========================================================================
-    // STEP 6: Finalize SHA256 and verify
+    // STEP 4: Finalize SHA256 and verify
     // ========================================================================
     
-    update_progress(OTA_STATUS_VERIFYING, OTA_ERR_NONE, bytes_downloaded, content_length);
-    ota_publish_status("verifying", 100, bytes_downloaded, content_length);
+    update_progress(OTA_STATUS_VERIFYING, OTA_ERR_NONE, s->offset, s->total);
+    ota_publish_status("verifying", 100, s->offset, s->total);
     
-    mbedtls_sha256_finish(&sha256_ctx, sha256_result);
+    mbedtls_sha256_finish(&s->sha_ctx, sha256_result);
     sha256_to_hex(sha256_result, sha256_hex);
     
     ESP_LOGI(TAG, "Calculated SHA256: %s", sha256_hex);
+
+    // the bytes are final either way, a later request must not resume on them
+    ota_checkpoint_clear();
     
     // Verify SHA256 if expected hash was provided
     if (strlen(s_expected_sha256) == OTA_SHA256_HEX_LEN) {
@@ -325,10 +1010,9 @@ static void ota_download_task(void *pvParameters)
         
         if (!sha256_compare(sha256_hex, s_expected_sha256)) {
             ESP_LOGE(TAG, "SHA256 MISMATCH! Aborting OTA");
-            update_progress(OTA_STATUS_FAILED, OTA_ERR_SHA256_MISMATCH, bytes_downloaded, content_length);
-            ota_publish_status("failed", 0, bytes_downloaded, content_length);
-            esp_ota_abort(ota_handle);
-            goto cleanup_http;
+            update_progress(OTA_STATUS_FAILED, OTA_ERR_SHA256_MISMATCH, s->offset, s->total);
+            ota_publish_status("failed", 0, s->offset, s->total);
+            goto cleanup;
         }
         
         ESP_LOGI(TAG, "SHA256 verification PASSED");
@@ -337,49 +1021,61 @@ static void ota_download_task(void *pvParameters)
     }
     
     // ========================================================================
-    // STEP 7: Finalize OTA
+    // STEP 5: Finalize OTA
     // ========================================================================
     
-    update_progress(OTA_STATUS_FLASHING, OTA_ERR_NONE, bytes_downloaded, content_length);
+    update_progress(OTA_STATUS_FLASHING, OTA_ERR_NONE, s->offset, s->total);
     
-    err = esp_ota_end(ota_handle);
+    err = esp_ota_end(s->ota_handle);
+    s->ota_open = false;    // esp_ota_end releases the handle, also on error
     if (err != ESP_OK) {
         if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
             ESP_LOGE(TAG, "Image validation failed (corrupt or wrong chip)");
-            update_progress(OTA_STATUS_FAILED, OTA_ERR_IMAGE_INVALID, bytes_downloaded, content_length);
-            ota_publish_status("failed", 0, bytes_downloaded, content_length);
+            update_progress(OTA_STATUS_FAILED, OTA_ERR_IMAGE_INVALID, s->offset, s->total);
+            ota_publish_status("failed", 0, s->offset, s->total);
         } else {
             ESP_LOGE(TAG, "esp_ota_end failed: %s", esp_err_to_name(err));
-            update_progress(OTA_STATUS_FAILED, OTA_ERR_FLASH_WRITE, bytes_downloaded, content_length);
-            ota_publish_status("failed", 0, bytes_downloaded, content_length);
+            update_progress(OTA_STATUS_FAILED, OTA_ERR_FLASH_WRITE, s->offset, s->total);
+            ota_publish_status("failed", 0, s->offset, s->total);
         }
-        goto cleanup_http;
+        goto cleanup;
     }
     
     // ========================================================================
-    // STEP 8: Set boot partition
+    // STEP 6: Set boot partition (held images are activated by the rollout)
     // ========================================================================
     
-    err = esp_ota_set_boot_partition(update_partition);
+    err = s_reboot_hold ? ESP_OK : esp_ota_set_boot_partition(s->partition);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "esp_ota_set_boot_partition failed: %s", esp_err_to_name(err));
-        update_progress(OTA_STATUS_FAILED, OTA_ERR_PARTITION, bytes_downloaded, content_length);
-        ota_publish_status("failed", 0, bytes_downloaded, content_length);
-        goto cleanup_http;
+        update_progress(OTA_STATUS_FAILED, OTA_ERR_PARTITION, s->offset, s->total);
+        ota_publish_status("failed", 0, s->offset, s->total);
+        goto cleanup;
     }
     
     // ========================================================================
     // SUCCESS!
     // ========================================================================
     
-    update_progress(OTA_STATUS_SUCCESS, OTA_ERR_NONE, bytes_downloaded, content_length);
-    ota_publish_status("success", 100, bytes_downloaded, content_length);
+    s_staged.partition = s->partition;
+    s_staged.size = s->image_bytes;
+    memcpy(s_staged.sha256, sha256_result, sizeof(s_staged.sha256));
+
+    update_progress(OTA_STATUS_SUCCESS, OTA_ERR_NONE, s->offset, s->total);
+    ota_publish_status("success", 100, s->offset, s->total);
     
     ESP_LOGI(TAG, "============================================");
     ESP_LOGI(TAG, "OTA UPDATE SUCCESSFUL!");
-    ESP_LOGI(TAG, "Firmware size: %lu bytes", bytes_downloaded);
+    ESP_LOGI(TAG, "Firmware size: %lu bytes", s->image_bytes);
+    if (s->delta) {
+        ESP_LOGI(TAG, "Rebuilt from a %lu byte delta patch (%lu bytes reused)", s->offset, s->patch.copied);
+    }
     ESP_LOGI(TAG, "SHA256: %s", sha256_hex);
-    ESP_LOGI(TAG, "Rebooting in %d seconds...", OTA_REBOOT_DELAY_MS / 1000);
+    if (s_reboot_hold) {
+        ESP_LOGI(TAG, "Reboot held - image staged for the mesh");
+    } else {
+        ESP_LOGI(TAG, "Rebooting in %d seconds...", OTA_REBOOT_DELAY_MS / 1000);
+    }
     ESP_LOGI(TAG, "============================================");
     
     // Notify completion callback
@@ -387,22 +1083,27 @@ static void ota_download_task(void *pvParameters)
         s_completion_callback(true, OTA_ERR_NONE);
     }
     
+    if (s_reboot_hold) {
+        goto cleanup;
+    }
+    
     // Delay then reboot
     vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
     esp_restart();
     
     // Should never reach here
     
-cleanup_http:
-    esp_http_client_close(http_client);
-    esp_http_client_cleanup(http_client);
-    
 cleanup:
-    mbedtls_sha256_free(&sha256_ctx);
-    
-    if (buffer) {
-        free(buffer);
+    ota_pipeline_stop(s);
+
+    // the flash content stays valid for a resume, only the handle is released
+    if (s->ota_open) {
+        esp_ota_abort(s->ota_handle);
+        s->ota_open = false;
     }
+    mbedtls_sha256_free(&s->sha_ctx);
+    free(s->copy_buf);
+    s->copy_buf = NULL;
     
     // Notify completion callback on failure
     if (s_progress.status == OTA_STATUS_FAILED && s_completion_callback) {
@@ -560,6 +1261,24 @@ void ota_register_completion_callback(ota_completion_cb_t callback)
     s_completion_callback = callback;
 }
 
+void ota_set_reboot_hold(bool hold)
+{
+    s_reboot_hold = hold;
+}
+
+esp_err_t ota_get_staged_image(ota_staged_image_t *image)
+{
+    if (!image) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_staged.partition == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    *image = s_staged;
+    return ESP_OK;
+}
+
 const char* ota_status_to_string(ota_status_t status)
 {
     switch (status) {
@@ -589,6 +1308,7 @@ const char* ota_error_to_string(ota_error_t error)
         case OTA_ERR_IMAGE_INVALID:   return "Invalid firmware image";
         case OTA_ERR_NO_MEMORY:       return "Memory allocation failed";
         case OTA_ERR_TIMEOUT:         return "Timeout";
+        case OTA_ERR_PATCH_INVALID:   return "Invalid delta patch";
         default:                      return "Unknown error";
     }
 }
@@ -0,0 +1,742 @@
+/**
+ * @file ota_mesh.c
+ * @brief Mesh OTA relay - mesh-lite transport and flash side of ota_relay,
+ *        activation of the staged image driven by ota_rollout
+ */
+
+#include "ota_mesh.h"
+#include "wifiMesh.h"
+#include "esp_random.h"
+
+static const char *TAG = "OTA_MESH";
+
+typedef enum {
+    OTA_MESH_IDLE = 0,
+    OTA_MESH_RECEIVING,         // writing the image served by the parent
+    OTA_MESH_SERVING,           // serving our update partition to the children
+    OTA_MESH_ROLLOUT,           // root: activating the staged image node by node
+} ota_mesh_state_t;
+
+// ============================================================================
+// PRIVATE VARIABLES
+// ============================================================================
+
+static SemaphoreHandle_t ota_mesh_mutex = NULL;
+static ota_mesh_state_t ota_mesh_state = OTA_MESH_IDLE;
+
+// Parent side
+static ota_relay_tx_t relay_tx;
+static TaskHandle_t serve_task_handle = NULL;
+static const esp_partition_t *serve_partition = NULL;
+static ota_mesh_offer_t my_offer;
+static ota_mesh_chunk_t my_chunk;
+
+// Child side
+static ota_relay_rx_t relay_rx;
+static ota_mesh_offer_t rx_offer;               // offer of the parent we joined
+static bool rx_verified = false;                // rx_offer image is in our update partition
+static QueueHandle_t rx_queue = NULL;           // accepted chunks waiting for flash
+static ota_mesh_chunk_t rx_staging;             // full-size copy for the queue (frames are shorter)
+static ota_mesh_chunk_t rx_chunk;               // owned by ota_mesh_rx_task
+static TaskHandle_t rx_task_handle = NULL;
+static bool rx_failed = false;                  // rx_offer image failed to arrive or verify
+
+// Rollout
+static const esp_partition_t *staged_partition = NULL;     // verified image, boot partition not set
+static bool activated = false;                  // the root told us to boot the staged image
+static ota_rollout_t rollout;                   // root
+static ota_mesh_rollout_t my_beacon;            // root
+static ota_rollout_config_t rollout_config = {
+    .canary = OTA_MESH_CANARY_NODES,
+    .concurrent = OTA_MESH_CONCURRENT,
+    .max_failures = OTA_MESH_MAX_FAILURES,
+    .canary_soak_ms = OTA_MESH_CANARY_SOAK_MS,
+    .confirm_timeout_ms = OTA_MESH_CONFIRM_TIMEOUT_MS,
+    .silence_ms = OTA_MESH_SILENCE_MS,
+    .stage_timeout_ms = OTA_MESH_STAGE_TIMEOUT_MS,
+    .discovery_ms = OTA_MESH_DISCOVERY_MS,
+};
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+// Relay messages are sent once - ota_relay does the retransmissions
+static void send_ota_message(uint32_t msg_id, const void *data, size_t data_len,
+                             esp_err_t (*send)(const uint8_t *data, size_t size))
+{
+    esp_mesh_lite_msg_config_t config = {
+        .raw_msg = {
+            .msg_id = msg_id,
+            .expect_resp_msg_id = 0,
+            .max_retry = 0,
+            .data = (const uint8_t *)data,
+            .size = data_len,
+            .raw_resend = send,
+        },
+    };
+
+    esp_mesh_lite_send_msg(ESP_MESH_LITE_RAW_MSG, &config);
+}
+
+static void send_ack_to_parent(uint32_t session, ota_relay_ack_t ack, uint32_t next)
+{
+    // mesh-lite copies the payload, so it can live on the stack
+    ota_mesh_ack_t payload = {
+        .session = session,
+        .next = next,
+        .ack = (uint8_t)ack,
+    };
+    memcpy(payload.macAddr, self_mac, ETH_HWADDR_LEN);
+
+    send_ota_message(TO_PARENT_OTA_ACK_MSG_ID, &payload, sizeof(payload), esp_mesh_lite_send_raw_msg_to_parent);
+}
+
+static void ota_mesh_reboot_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Rebooting in %d seconds...", OTA_REBOOT_DELAY_MS / 1000);
+    vTaskDelay(pdMS_TO_TICKS(OTA_REBOOT_DELAY_MS));
+    esp_restart();
+}
+
+// Boot the staged image - the reboot is delayed so that the last report goes out
+static esp_err_t boot_staged_image(void)
+{
+    esp_err_t err = esp_ota_set_boot_partition(staged_partition);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot activate the image: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    if (xTaskCreate(ota_mesh_reboot_task, "ota_mesh_reboot", 2048, NULL, 5, NULL) != pdPASS)
+        esp_restart();
+    return ESP_OK;
+}
+
+// ============================================================================
+// PARENT SIDE
+// ============================================================================
+
+static void send_chunk(uint32_t index)
+{
+    uint32_t offset = index * OTA_MESH_CHUNK_SIZE;
+    uint32_t len = my_offer.image_size - offset;
+    if (len > OTA_MESH_CHUNK_SIZE)
+        len = OTA_MESH_CHUNK_SIZE;
+
+    esp_err_t err = esp_partition_read(serve_partition, offset, my_chunk.data, len);
+    if (err != ESP_OK) {
+        // not sent - the children see a hole and the window is resent
+        ESP_LOGE(TAG, "Read of chunk %lu failed: %s", index, esp_err_to_name(err));
+        return;
+    }
+
+    my_chunk.session = my_offer.session;
+    my_chunk.index = index;
+    my_chunk.len = (uint16_t)len;
+    mbedtls_sha256(my_chunk.data, len, my_chunk.sha256, 0);
+
+    send_ota_message(TO_CHILD_OTA_CHUNK_MSG_ID, &my_chunk, OTA_MESH_CHUNK_HEADER_LEN + len,
+                     esp_mesh_lite_send_broadcast_raw_msg_to_child);
+}
+
+static void publish_rollout_status(uint32_t start)
+{
+    static char payload[320];
+    char topic[64];
+    uint8_t counts[OTA_ROLLOUT_NODE_STATES];
+
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    ota_rollout_count(&rollout, counts);
+    snprintf(payload, sizeof(payload),
+        "{\"unit_id\":%d,\"version\":\"%s\",\"phase\":\"%s\",\"nodes\":%d,\"pending\":%d,\"staged\":%d,"
+        "\"activating\":%d,\"updated\":%d,\"failed\":%d,\"skipped\":%d,\"last_failed\":\"" MACSTR "\","
+        "\"elapsed_ms\":%lu}",
+        UNIT_ID, my_offer.version, ota_rollout_phase_to_string(rollout.phase), rollout.node_count,
+        counts[OTA_ROLLOUT_NODE_PENDING], counts[OTA_ROLLOUT_NODE_STAGED], counts[OTA_ROLLOUT_NODE_ACTIVATING],
+        counts[OTA_ROLLOUT_NODE_UPDATED], counts[OTA_ROLLOUT_NODE_FAILED], counts[OTA_ROLLOUT_NODE_SKIPPED],
+        MAC2STR(rollout.last_failed), now_ms() - start);
+    xSemaphoreGive(ota_mesh_mutex);
+
+    ESP_LOGI(TAG, "Rollout: %s", payload);
+
+    snprintf(topic, sizeof(topic), "bumblebee/%d/ota/rollout", UNIT_ID);
+    if (mqtt_client)
+        esp_mqtt_client_publish(mqtt_client, topic, payload, 0, 1, 0);
+}
+
+// Root: beacon the nodes to activate until the rollout completes or halts
+static void ota_mesh_rollout_run(void)
+{
+    const uint32_t start = now_ms();
+    uint32_t last_status = start;
+
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    ota_rollout_init(&rollout, &rollout_config, start);
+    ota_rollout_phase_t phase = rollout.phase;
+    memset(&my_beacon, 0, sizeof(my_beacon));
+    my_beacon.session = my_offer.session;
+    memcpy(my_beacon.sha256, my_offer.sha256, sizeof(my_beacon.sha256));
+    memcpy(my_beacon.app_elf_sha256, my_offer.app_elf_sha256, sizeof(my_beacon.app_elf_sha256));
+    xSemaphoreGive(ota_mesh_mutex);
+
+    ESP_LOGI(TAG, "Rolling out %s: %d canary, %d at a time, %d failures tolerated", my_offer.version,
+             rollout.config.canary, rollout.config.concurrent, rollout.config.max_failures);
+    publish_rollout_status(start);
+
+    while (1) {
+        uint32_t now = now_ms();
+
+        xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+        ota_rollout_phase_t next = ota_rollout_step(&rollout, now);
+        my_beacon.count = ota_rollout_activating(&rollout, my_beacon.activate, OTA_ROLLOUT_MAX_ACTIVE);
+        bool finished = ota_rollout_finished(&rollout);
+        xSemaphoreGive(ota_mesh_mutex);
+
+        if (!finished)
+            send_ota_message(TO_CHILD_OTA_ROLLOUT_MSG_ID, &my_beacon, sizeof(my_beacon),
+                             esp_mesh_lite_send_broadcast_raw_msg_to_child);
+
+        if (next != phase || now - last_status >= OTA_MESH_STATUS_PERIOD_MS) {
+            publish_rollout_status(start);
+            phase = next;
+            last_status = now;
+        }
+        if (finished)
+            break;
+
+        vTaskDelay(pdMS_TO_TICKS(OTA_MESH_BEACON_PERIOD_MS));
+    }
+
+    if (phase == OTA_ROLLOUT_COMPLETE) {
+        // every node is done, the root is the last one
+        if (boot_staged_image() == ESP_OK)
+            return;
+    } else {
+        ESP_LOGE(TAG, "Rollout halted after %d failures (last "MACSTR") - staying on %s",
+                 rollout.failures, MAC2STR(rollout.last_failed), esp_app_get_description()->version);
+    }
+
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    ota_mesh_state = OTA_MESH_IDLE;
+    xSemaphoreGive(ota_mesh_mutex);
+}
+
+static void ota_mesh_serve_task(void *pvParameters)
+{
+    const uint32_t start = now_ms();
+    uint32_t last_offer = 0;
+    bool first_offer = true;
+
+    ESP_LOGI(TAG, "Serving %s (%lu bytes, %lu chunks) to the children",
+             my_offer.version, my_offer.image_size, my_offer.chunk_count);
+
+    while (1) {
+        uint32_t now = now_ms();
+
+        // keep offering, a child that missed the first offers still joins
+        if (first_offer || now - last_offer >= OTA_MESH_OFFER_PERIOD_MS) {
+            send_ota_message(TO_CHILD_OTA_OFFER_MSG_ID, &my_offer, sizeof(my_offer),
+                             esp_mesh_lite_send_broadcast_raw_msg_to_child);
+            last_offer = now;
+            first_offer = false;
+        }
+        if (now - start < OTA_MESH_JOIN_WINDOW_MS) {
+            vTaskDelay(pdMS_TO_TICKS(OTA_MESH_OFFER_PERIOD_MS));
+            continue;
+        }
+
+        uint32_t index = 0;
+        xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+        bool send = ota_relay_tx_next(&relay_tx, now, &index);
+        bool finished = ota_relay_tx_finished(&relay_tx);
+        xSemaphoreGive(ota_mesh_mutex);
+
+        if (finished)
+            break;
+        if (send) {
+            send_chunk(index);
+            continue;
+        }
+
+        // window full: wait for an ack (or the retransmission timeout)
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(OTA_MESH_RTO_MS / 4));
+    }
+
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    uint8_t done = 0;
+    for (uint8_t i = 0; i < relay_tx.child_count; i++) {
+        const ota_relay_child_t *c = &relay_tx.children[i];
+        if (c->state == OTA_RELAY_CHILD_DONE)
+            done++;
+        else
+            ESP_LOGW(TAG, "Child "MACSTR" not updated (%s, %lu/%lu chunks)", MAC2STR(c->mac),
+                     c->state == OTA_RELAY_CHILD_FAILED ? "failed" : "lost", c->next, my_offer.chunk_count);
+    }
+    ESP_LOGI(TAG, "Session over in %lu ms: %d/%d children updated, %lu chunks sent (%lu resent, %lu rewinds)",
+             now_ms() - start, done, relay_tx.child_count, relay_tx.sent, relay_tx.resent, relay_tx.rewinds);
+
+    // the root drives the rollout, the others now report STAGED and wait for their turn
+    bool root = is_root_node;
+    serve_task_handle = NULL;
+    ota_mesh_state = root ? OTA_MESH_ROLLOUT : OTA_MESH_IDLE;
+    xSemaphoreGive(ota_mesh_mutex);
+
+    if (root)
+        ota_mesh_rollout_run();
+
+    vTaskDelete(NULL);
+}
+
+esp_err_t ota_mesh_serve(const esp_partition_t *partition, uint32_t size, const uint8_t *sha256)
+{
+    if (partition == NULL || size == 0 || sha256 == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_app_desc_t desc;
+    esp_err_t err = esp_ota_get_partition_description(partition, &desc);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "No valid image in %s: %s", partition->label, esp_err_to_name(err));
+        return err;
+    }
+
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    if (serve_task_handle != NULL || ota_mesh_state == OTA_MESH_RECEIVING || ota_mesh_state == OTA_MESH_ROLLOUT) {
+        xSemaphoreGive(ota_mesh_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    serve_partition = partition;
+    memset(&my_offer, 0, sizeof(my_offer));
+    my_offer.session = esp_random();
+    my_offer.image_size = size;
+    my_offer.chunk_count = (size + OTA_MESH_CHUNK_SIZE - 1) / OTA_MESH_CHUNK_SIZE;
+    my_offer.chunk_size = OTA_MESH_CHUNK_SIZE;
+    memcpy(my_offer.sha256, sha256, sizeof(my_offer.sha256));
+    memcpy(my_offer.app_elf_sha256, desc.app_elf_sha256, sizeof(my_offer.app_elf_sha256));
+    strlcpy(my_offer.version, desc.version, sizeof(my_offer.version));
+
+    const ota_relay_config_t config = {
+        .chunk_count = my_offer.chunk_count,
+        .window = OTA_MESH_WINDOW,
+        .rto_ms = OTA_MESH_RTO_MS,
+        .child_timeout_ms = OTA_MESH_CHILD_TIMEOUT_MS,
+    };
+    ota_relay_tx_init(&relay_tx, &config, now_ms());
+    ota_mesh_state = OTA_MESH_SERVING;
+
+    if (xTaskCreate(ota_mesh_serve_task, "ota_mesh_serve", 4096, NULL, 5, &serve_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create serve task");
+        serve_task_handle = NULL;
+        ota_mesh_state = OTA_MESH_IDLE;
+        xSemaphoreGive(ota_mesh_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(ota_mesh_mutex);
+
+    return ESP_OK;
+}
+
+static esp_err_t ota_ack_to_parent_raw_msg_process(uint8_t *data, uint32_t len,
+                                     uint8_t **out_data, uint32_t* out_len,
+                                     uint32_t seq)
+{
+    if (len != sizeof(ota_mesh_ack_t)) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    ota_mesh_ack_t *ack = (ota_mesh_ack_t *)data;
+    bool known = false;
+
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    if (serve_task_handle != NULL && ack->session == my_offer.session)
+        known = ota_relay_tx_ack(&relay_tx, ack->macAddr, ack->next, (ota_relay_ack_t)ack->ack, now_ms());
+    xSemaphoreGive(ota_mesh_mutex);
+
+    if (!known)
+        return ESP_OK;
+
+    if (ack->ack == OTA_RELAY_ACK_DONE)
+        ESP_LOGI(TAG, "Child "MACSTR" updated", MAC2STR(ack->macAddr));
+    else if (ack->ack == OTA_RELAY_ACK_FAILED)
+        ESP_LOGW(TAG, "Child "MACSTR" failed the update", MAC2STR(ack->macAddr));
+
+    xTaskNotifyGive(serve_task_handle);
+    return ESP_OK;
+}
+
+static esp_err_t ota_report_to_root_raw_msg_process(uint8_t *data, uint32_t len,
+                                     uint8_t **out_data, uint32_t* out_len,
+                                     uint32_t seq)
+{
+    if (len != sizeof(ota_mesh_report_t)) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    ota_mesh_report_t *report = (ota_mesh_report_t *)data;
+    if (report->report > OTA_ROLLOUT_REPORT_RUNNING)
+        return ESP_OK;
+
+    bool known = true;
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    if (ota_mesh_state == OTA_MESH_ROLLOUT && report->session == my_offer.session)
+        known = ota_rollout_report(&rollout, report->macAddr, (ota_rollout_report_t)report->report, now_ms());
+    xSemaphoreGive(ota_mesh_mutex);
+
+    if (!known)
+        ESP_LOGW(TAG, "Rollout table full - ignoring "MACSTR, MAC2STR(report->macAddr));
+
+    return ESP_OK;
+}
+
+// Root: the image downloaded by ota_manager is served, then rolled out
+static void ota_mesh_on_update(bool success, ota_error_t error)
+{
+    if (!success)
+        return;
+
+    ota_staged_image_t image;
+    if (ota_get_staged_image(&image) != ESP_OK) {
+        ESP_LOGW(TAG, "No staged image to serve");
+        return;
+    }
+    staged_partition = image.partition;
+
+    if (ota_mesh_serve(image.partition, image.size, image.sha256) != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot serve the update to the mesh - rebooting");
+        if (boot_staged_image() != ESP_OK)
+            esp_restart();
+    }
+}
+
+// ============================================================================
+// CHILD SIDE
+// ============================================================================
+
+static void ota_mesh_rx_task(void *pvParameters)
+{
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    esp_ota_handle_t handle = 0;
+    mbedtls_sha256_context sha_ctx;
+    uint8_t sha256[32];
+    bool ok = false;
+
+    mbedtls_sha256_init(&sha_ctx);
+    mbedtls_sha256_starts(&sha_ctx, 0);
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (partition != NULL && partition->size >= rx_offer.image_size)
+        err = esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot open the update partition: %s", esp_err_to_name(err));
+        goto done;
+    }
+
+    while (1) {
+        if (xQueueReceive(rx_queue, &rx_chunk, pdMS_TO_TICKS(OTA_MESH_RX_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGE(TAG, "No chunk from the parent for %d ms - giving up", OTA_MESH_RX_TIMEOUT_MS);
+            esp_ota_abort(handle);
+            goto done;
+        }
+
+        err = esp_ota_write(handle, rx_chunk.data, rx_chunk.len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Write of chunk %lu failed: %s", rx_chunk.index, esp_err_to_name(err));
+            esp_ota_abort(handle);
+            goto done;
+        }
+        mbedtls_sha256_update(&sha_ctx, rx_chunk.data, rx_chunk.len);
+
+        uint32_t next = 0;
+        xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+        bool due = ota_relay_rx_written(&relay_rx, &next);
+        bool complete = ota_relay_rx_complete(&relay_rx);
+        xSemaphoreGive(ota_mesh_mutex);
+
+        if (complete)
+            break;
+        if (due)
+            send_ack_to_parent(rx_offer.session, OTA_RELAY_ACK_PROGRESS, next);
+    }
+
+    mbedtls_sha256_finish(&sha_ctx, sha256);
+    if (memcmp(sha256, rx_offer.sha256, sizeof(sha256)) != 0) {
+        ESP_LOGE(TAG, "SHA256 MISMATCH! Aborting OTA");
+        esp_ota_abort(handle);
+        goto done;
+    }
+
+    // staged only, the root activates it during the rollout
+    err = esp_ota_end(handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot validate the image: %s", esp_err_to_name(err));
+        goto done;
+    }
+    ok = true;
+
+done:
+    mbedtls_sha256_free(&sha_ctx);
+
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    vQueueDelete(rx_queue);
+    rx_queue = NULL;
+    rx_verified = ok;
+    rx_failed = !ok;
+    if (ok)
+        staged_partition = partition;
+    ota_mesh_state = OTA_MESH_IDLE;
+    xSemaphoreGive(ota_mesh_mutex);
+
+    send_ack_to_parent(rx_offer.session, ok ? OTA_RELAY_ACK_DONE : OTA_RELAY_ACK_FAILED, relay_rx.written);
+
+    if (ok) {
+        ESP_LOGI(TAG, "Image %s verified (%lu bytes, %lu duplicates, %lu holes, %lu corrupt chunks)",
+                 rx_offer.version, rx_offer.image_size, relay_rx.duplicates, relay_rx.gaps, relay_rx.corrupt);
+        // without children to serve, the image just waits for its turn
+        if (ota_mesh_serve(partition, rx_offer.image_size, rx_offer.sha256) != ESP_OK)
+            ESP_LOGW(TAG, "Cannot serve the image to the children");
+    }
+
+    rx_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+static esp_err_t ota_offer_to_child_raw_msg_process(uint8_t *data, uint32_t len,
+                                     uint8_t **out_data, uint32_t* out_len,
+                                     uint32_t seq)
+{
+    if (len != sizeof(ota_mesh_offer_t)) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    ota_mesh_offer_t *offer = (ota_mesh_offer_t *)data;
+
+    if (offer->chunk_size != OTA_MESH_CHUNK_SIZE ||
+        offer->chunk_count != (offer->image_size + OTA_MESH_CHUNK_SIZE - 1) / OTA_MESH_CHUNK_SIZE) {
+        ESP_LOGW(TAG, "Ignoring offer with %d-byte chunks", offer->chunk_size);
+        return ESP_OK;
+    }
+
+    // already running this build: nothing to do, tell the parent not to wait
+    const esp_app_desc_t *running = esp_app_get_description();
+    if (memcmp(offer->app_elf_sha256, running->app_elf_sha256, sizeof(running->app_elf_sha256)) == 0) {
+        send_ack_to_parent(offer->session, OTA_RELAY_ACK_DONE, offer->chunk_count);
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+
+    if (rx_verified && memcmp(offer->sha256, rx_offer.sha256, sizeof(rx_offer.sha256)) == 0) {
+        // staged already (maybe serving our own children), our DONE was lost
+        rx_offer.session = offer->session;
+        xSemaphoreGive(ota_mesh_mutex);
+        send_ack_to_parent(offer->session, OTA_RELAY_ACK_DONE, offer->chunk_count);
+        return ESP_OK;
+    }
+
+    if (ota_mesh_state == OTA_MESH_RECEIVING) {
+        // join again in case the first answer was lost, the parent ignores repeats
+        bool same = (offer->session == rx_offer.session);
+        uint32_t next = relay_rx.written;
+        xSemaphoreGive(ota_mesh_mutex);
+        if (same)
+            send_ack_to_parent(offer->session, OTA_RELAY_ACK_PROGRESS, next);
+        return ESP_OK;
+    }
+
+    if (ota_mesh_state != OTA_MESH_IDLE || is_root_node || ota_is_running()) {
+        xSemaphoreGive(ota_mesh_mutex);
+        return ESP_OK;
+    }
+
+    rx_queue = xQueueCreate(OTA_MESH_WINDOW, sizeof(ota_mesh_chunk_t));
+    if (rx_queue == NULL) {
+        xSemaphoreGive(ota_mesh_mutex);
+        ESP_LOGE(TAG, "No memory for the chunk queue");
+        return ESP_OK;
+    }
+
+    rx_offer = *offer;
+    rx_verified = false;
+    rx_failed = false;
+    activated = false;
+    ota_relay_rx_init(&relay_rx, offer->chunk_count, OTA_MESH_ACK_EVERY);
+    ota_mesh_state = OTA_MESH_RECEIVING;
+
+    if (xTaskCreate(ota_mesh_rx_task, "ota_mesh_rx", 4096, NULL, 5, &rx_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create receive task");
+        vQueueDelete(rx_queue);
+        rx_queue = NULL;
+        rx_task_handle = NULL;
+        ota_mesh_state = OTA_MESH_IDLE;
+        xSemaphoreGive(ota_mesh_mutex);
+        return ESP_OK;
+    }
+    xSemaphoreGive(ota_mesh_mutex);
+
+    ESP_LOGI(TAG, "Joining update to %s (%lu bytes)", offer->version, offer->image_size);
+    send_ack_to_parent(offer->session, OTA_RELAY_ACK_PROGRESS, 0);
+
+    return ESP_OK;
+}
+
+static esp_err_t ota_chunk_to_child_raw_msg_process(uint8_t *data, uint32_t len,
+                                     uint8_t **out_data, uint32_t* out_len,
+                                     uint32_t seq)
+{
+    ota_mesh_chunk_t *chunk = (ota_mesh_chunk_t *)data;
+
+    if (len < OTA_MESH_CHUNK_HEADER_LEN || chunk->len > OTA_MESH_CHUNK_SIZE ||
+        len != OTA_MESH_CHUNK_HEADER_LEN + chunk->len) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    uint8_t sha256[32];
+    mbedtls_sha256(chunk->data, chunk->len, sha256, 0);
+    bool intact = (memcmp(sha256, chunk->sha256, sizeof(sha256)) == 0);
+
+    bool send = false;
+    ota_relay_ack_t ack = OTA_RELAY_ACK_PROGRESS;
+    uint32_t next = 0;
+    uint32_t session = chunk->session;
+
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    if (ota_mesh_state == OTA_MESH_RECEIVING && session == rx_offer.session) {
+        ota_relay_rx_result_t result = ota_relay_rx_check(&relay_rx, chunk->index, intact);
+        if (result == OTA_RELAY_RX_ACCEPT) {
+            // the queue copies a whole item, the frame of the last chunk is shorter
+            memcpy(&rx_staging, chunk, len);
+            if (xQueueSend(rx_queue, &rx_staging, 0) == pdTRUE)
+                ota_relay_rx_commit(&relay_rx);
+        }
+        send = ota_relay_rx_ack_due(&relay_rx, result, &ack, &next);
+    } else if (rx_verified && session == rx_offer.session) {
+        // the parent resends the last chunk when our DONE was lost
+        send = true;
+        ack = OTA_RELAY_ACK_DONE;
+        next = rx_offer.chunk_count;
+    }
+    xSemaphoreGive(ota_mesh_mutex);
+
+    if (send)
+        send_ack_to_parent(session, ack, next);
+
+    return ESP_OK;
+}
+
+static void send_report_to_root(uint32_t session, ota_rollout_report_t report)
+{
+    ota_mesh_report_t payload = {
+        .session = session,
+        .report = (uint8_t)report,
+    };
+    memcpy(payload.macAddr, self_mac, ETH_HWADDR_LEN);
+
+    send_ota_message(TO_ROOT_OTA_REPORT_MSG_ID, &payload, sizeof(payload), esp_mesh_lite_send_raw_msg_to_root);
+}
+
+static esp_err_t ota_rollout_to_child_raw_msg_process(uint8_t *data, uint32_t len,
+                                     uint8_t **out_data, uint32_t* out_len,
+                                     uint32_t seq)
+{
+    if (len != sizeof(ota_mesh_rollout_t)) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    ota_mesh_rollout_t *beacon = (ota_mesh_rollout_t *)data;
+    if (beacon->count > OTA_ROLLOUT_MAX_ACTIVE || is_root_node)
+        return ESP_OK;
+
+    // broadcasts reach the direct children only, pass it down
+    send_ota_message(TO_CHILD_OTA_ROLLOUT_MSG_ID, beacon, sizeof(*beacon),
+                     esp_mesh_lite_send_broadcast_raw_msg_to_child);
+
+    const esp_app_desc_t *running = esp_app_get_description();
+    if (memcmp(beacon->app_elf_sha256, running->app_elf_sha256, sizeof(running->app_elf_sha256)) == 0) {
+        send_report_to_root(beacon->session, OTA_ROLLOUT_REPORT_RUNNING);
+        return ESP_OK;
+    }
+
+    bool listed = false;
+    for (uint8_t i = 0; i < beacon->count && !listed; i++)
+        listed = (memcmp(beacon->activate[i], self_mac, ETH_HWADDR_LEN) == 0);
+
+    ota_rollout_report_t report = OTA_ROLLOUT_REPORT_WAITING;
+    bool boot = false;
+
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    bool same = (memcmp(beacon->sha256, rx_offer.sha256, sizeof(rx_offer.sha256)) == 0);
+    if (same && rx_verified && ota_mesh_state == OTA_MESH_IDLE) {
+        // staged and done serving the children: ready for activation
+        report = OTA_ROLLOUT_REPORT_STAGED;
+        boot = listed && !activated;
+        activated |= listed;
+    } else if (same && rx_failed) {
+        report = OTA_ROLLOUT_REPORT_FAILED;
+    }
+    xSemaphoreGive(ota_mesh_mutex);
+
+    if (boot) {
+        ESP_LOGW(TAG, "Activated by the rollout - booting %s", rx_offer.version);
+        if (boot_staged_image() != ESP_OK) {
+            xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+            rx_verified = false;
+            rx_failed = true;
+            xSemaphoreGive(ota_mesh_mutex);
+            report = OTA_ROLLOUT_REPORT_FAILED;
+        }
+    }
+
+    send_report_to_root(beacon->session, report);
+    return ESP_OK;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void ota_mesh_set_rollout(uint8_t canary, uint8_t concurrent, uint8_t max_failures)
+{
+    xSemaphoreTake(ota_mesh_mutex, portMAX_DELAY);
+    rollout_config.canary = canary;
+    rollout_config.concurrent = concurrent;
+    rollout_config.max_failures = max_failures;
+    xSemaphoreGive(ota_mesh_mutex);
+}
+
+bool ota_mesh_is_busy(void)
+{
+    return ota_mesh_state != OTA_MESH_IDLE;
+}
+
+void ota_mesh_init(void)
+{
+    if (ota_mesh_mutex != NULL)
+        return;
+
+    ota_mesh_mutex = xSemaphoreCreateMutex();
+
+    static const esp_mesh_lite_raw_msg_action_t ota_mesh_actions[] = {
+        { TO_CHILD_OTA_OFFER_MSG_ID, 0, ota_offer_to_child_raw_msg_process},
+        { TO_CHILD_OTA_CHUNK_MSG_ID, 0, ota_chunk_to_child_raw_msg_process},
+        { TO_PARENT_OTA_ACK_MSG_ID, 0, ota_ack_to_parent_raw_msg_process},
+        { TO_CHILD_OTA_ROLLOUT_MSG_ID, 0, ota_rollout_to_child_raw_msg_process},
+        { TO_ROOT_OTA_REPORT_MSG_ID, 0, ota_report_to_root_raw_msg_process},
+        {0, 0, NULL}
+    };
+    esp_mesh_lite_raw_msg_action_list_register(ota_mesh_actions);
+
+    // the root serves the image it downloads and rolls it out before booting it
+    ota_set_reboot_hold(true);
+    ota_register_completion_callback(ota_mesh_on_update);
+}
@@ -0,0 +1,221 @@
+#include "ota_relay.h"
+
+#include <string.h>
+
+/*******************************************************
+ *                Parent side
+ *******************************************************/
+
+void ota_relay_tx_init(ota_relay_tx_t *tx, const ota_relay_config_t *config, uint32_t now_ms)
+{
+    memset(tx, 0, sizeof(*tx));
+    tx->config = *config;
+    if (tx->config.window == 0)
+        tx->config.window = 1;
+    tx->progress_ms = now_ms;
+}
+
+static ota_relay_child_t *find_child(ota_relay_tx_t *tx, const uint8_t *mac)
+{
+    for (uint8_t i = 0; i < tx->child_count; i++) {
+        if (memcmp(tx->children[i].mac, mac, 6) == 0)
+            return &tx->children[i];
+    }
+    return NULL;
+}
+
+bool ota_relay_tx_join(ota_relay_tx_t *tx, const uint8_t *mac, uint32_t now_ms)
+{
+    if (find_child(tx, mac) != NULL)
+        return true;
+    if (tx->child_count >= OTA_RELAY_MAX_CHILDREN)
+        return false;
+
+    ota_relay_child_t *c = &tx->children[tx->child_count++];
+    memcpy(c->mac, mac, 6);
+    c->next = 0;
+    c->last_ack_ms = now_ms;
+    c->state = OTA_RELAY_CHILD_ACTIVE;
+    return true;
+}
+
+uint32_t ota_relay_tx_base(const ota_relay_tx_t *tx)
+{
+    uint32_t base = tx->config.chunk_count;
+    for (uint8_t i = 0; i < tx->child_count; i++) {
+        const ota_relay_child_t *c = &tx->children[i];
+        if (c->state == OTA_RELAY_CHILD_ACTIVE && c->next < base)
+            base = c->next;
+    }
+    return base;
+}
+
+bool ota_relay_tx_ack(ota_relay_tx_t *tx, const uint8_t *mac, uint32_t next, ota_relay_ack_t ack, uint32_t now_ms)
+{
+    ota_relay_child_t *c = find_child(tx, mac);
+    if (c == NULL) {
+        // its join was lost, the child has been receiving the broadcasts anyway
+        if (ack == OTA_RELAY_ACK_DONE || ack == OTA_RELAY_ACK_FAILED || !ota_relay_tx_join(tx, mac, now_ms))
+            return false;
+        c = find_child(tx, mac);
+    }
+
+    // done and failed are final, a lost child that speaks again is served again
+    if (c->state == OTA_RELAY_CHILD_DONE || c->state == OTA_RELAY_CHILD_FAILED)
+        return true;
+
+    uint32_t old_base = ota_relay_tx_base(tx);
+    c->state = OTA_RELAY_CHILD_ACTIVE;
+    c->last_ack_ms = now_ms;
+
+    if (next > tx->config.chunk_count)
+        next = tx->config.chunk_count;
+
+    switch (ack) {
+        case OTA_RELAY_ACK_DONE:
+            c->state = OTA_RELAY_CHILD_DONE;
+            c->next = tx->config.chunk_count;
+            break;
+        case OTA_RELAY_ACK_FAILED:
+            c->state = OTA_RELAY_CHILD_FAILED;
+            break;
+        case OTA_RELAY_ACK_GAP:
+            // the chunks before the hole may still be queued at the child, only rewind
+            if (next < tx->next_send)
+                tx->next_send = next;
+            break;
+        default:
+            // acks may arrive out of order, the written position only moves forward
+            if (next > c->next)
+                c->next = next;
+            break;
+    }
+
+    if (ota_relay_tx_base(tx) > old_base)
+        tx->progress_ms = now_ms;
+    return true;
+}
+
+bool ota_relay_tx_finished(const ota_relay_tx_t *tx)
+{
+    for (uint8_t i = 0; i < tx->child_count; i++) {
+        if (tx->children[i].state == OTA_RELAY_CHILD_ACTIVE)
+            return false;
+    }
+    return true;
+}
+
+bool ota_relay_tx_next(ota_relay_tx_t *tx, uint32_t now_ms, uint32_t *index)
+{
+    for (uint8_t i = 0; i < tx->child_count; i++) {
+        ota_relay_child_t *c = &tx->children[i];
+        if (c->state == OTA_RELAY_CHILD_ACTIVE && now_ms - c->last_ack_ms >= tx->config.child_timeout_ms)
+            c->state = OTA_RELAY_CHILD_LOST;
+    }
+    if (ota_relay_tx_finished(tx) || tx->config.chunk_count == 0)
+        return false;
+
+    const uint32_t count = tx->config.chunk_count;
+    uint32_t base = ota_relay_tx_base(tx);
+    if (tx->next_send < base)
+        tx->next_send = base;
+
+    if (now_ms - tx->progress_ms >= tx->config.rto_ms) {
+        // go back to the slowest child; once all chunks are acked the last one
+        // is resent to get the final status of a child whose ack was lost
+        uint32_t from = base < count ? base : count - 1;
+        if (tx->next_send != from)
+            tx->rewinds++;
+        tx->next_send = from;
+        tx->progress_ms = now_ms;
+    }
+
+    uint32_t limit = base + tx->config.window;
+    if (limit > count)
+        limit = count;
+    if (tx->next_send >= limit)
+        return false;
+
+    *index = tx->next_send++;
+    if (*index < tx->high_water)
+        tx->resent++;
+    else
+        tx->high_water = *index + 1;
+    tx->sent++;
+    return true;
+}
+
+/*******************************************************
+ *                Child side
+ *******************************************************/
+
+void ota_relay_rx_init(ota_relay_rx_t *rx, uint32_t chunk_count, uint8_t ack_every)
+{
+    memset(rx, 0, sizeof(*rx));
+    rx->chunk_count = chunk_count;
+    rx->ack_every = ack_every ? ack_every : 1;
+}
+
+ota_relay_rx_result_t ota_relay_rx_check(ota_relay_rx_t *rx, uint32_t index, bool intact)
+{
+    // the index going backwards means the parent rewound: a new pass, report again
+    if (index < rx->last_index)
+        rx->reported = false;
+    rx->last_index = index;
+
+    if (!intact) {
+        rx->corrupt++;
+        return OTA_RELAY_RX_CORRUPT;
+    }
+    if (index < rx->next) {
+        rx->duplicates++;
+        return OTA_RELAY_RX_DUPLICATE;
+    }
+    if (index > rx->next) {
+        rx->gaps++;
+        return OTA_RELAY_RX_GAP;
+    }
+    return OTA_RELAY_RX_ACCEPT;
+}
+
+void ota_relay_rx_commit(ota_relay_rx_t *rx)
+{
+    if (rx->next < rx->chunk_count)
+        rx->next++;
+    rx->reported = false;
+}
+
+bool ota_relay_rx_ack_due(ota_relay_rx_t *rx, ota_relay_rx_result_t result, ota_relay_ack_t *ack, uint32_t *next)
+{
+    switch (result) {
+        case OTA_RELAY_RX_ACCEPT:
+            return false;
+        case OTA_RELAY_RX_DUPLICATE:
+            // the parent went back, most likely our progress ack was lost
+            *ack = OTA_RELAY_ACK_PROGRESS;
+            *next = rx->written;
+            break;
+        default:
+            *ack = OTA_RELAY_ACK_GAP;
+            *next = rx->next;
+            break;
+    }
+
+    if (rx->reported)
+        return false;
+    rx->reported = true;
+    return true;
+}
+
+bool ota_relay_rx_written(ota_relay_rx_t *rx, uint32_t *next)
+{
+    if (rx->written < rx->next)
+        rx->written++;
+    *next = rx->written;
+    return (rx->written % rx->ack_every) == 0 || rx->written == rx->chunk_count;
+}
+
+bool ota_relay_rx_complete(const ota_relay_rx_t *rx)
+{
+    return rx->written >= rx->chunk_count;
+}
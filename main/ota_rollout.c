@@ -0,0 +1,210 @@
+#include "ota_rollout.h"
+
+#include <string.h>
+
+void ota_rollout_init(ota_rollout_t *r, const ota_rollout_config_t *config, uint32_t now_ms)
+{
+    memset(r, 0, sizeof(*r));
+    r->config = *config;
+    if (r->config.concurrent == 0)
+        r->config.concurrent = 1;
+    if (r->config.concurrent > OTA_ROLLOUT_MAX_ACTIVE)
+        r->config.concurrent = OTA_ROLLOUT_MAX_ACTIVE;
+    if (r->config.canary > OTA_ROLLOUT_MAX_ACTIVE)
+        r->config.canary = OTA_ROLLOUT_MAX_ACTIVE;
+
+    r->phase = r->config.canary ? OTA_ROLLOUT_CANARY : OTA_ROLLOUT_ROLLING;
+    r->start_ms = now_ms;
+    r->phase_ms = now_ms;
+}
+
+static ota_rollout_node_t *find_node(ota_rollout_t *r, const uint8_t *mac)
+{
+    for (uint8_t i = 0; i < r->node_count; i++) {
+        if (memcmp(r->nodes[i].mac, mac, 6) == 0)
+            return &r->nodes[i];
+    }
+    return NULL;
+}
+
+static void set_state(ota_rollout_node_t *n, ota_rollout_node_state_t state, uint32_t now_ms)
+{
+    n->state = state;
+    n->since_ms = now_ms;
+}
+
+static void fail_node(ota_rollout_t *r, ota_rollout_node_t *n, uint32_t now_ms)
+{
+    set_state(n, OTA_ROLLOUT_NODE_FAILED, now_ms);
+    if (r->failures < UINT8_MAX)
+        r->failures++;
+    memcpy(r->last_failed, n->mac, 6);
+}
+
+static void set_phase(ota_rollout_t *r, ota_rollout_phase_t phase, uint32_t now_ms)
+{
+    r->phase = phase;
+    r->phase_ms = now_ms;
+}
+
+bool ota_rollout_report(ota_rollout_t *r, const uint8_t *mac, ota_rollout_report_t report, uint32_t now_ms)
+{
+    ota_rollout_node_t *n = find_node(r, mac);
+    if (n == NULL) {
+        if (r->node_count >= OTA_ROLLOUT_MAX_NODES)
+            return false;
+        n = &r->nodes[r->node_count++];
+        memset(n, 0, sizeof(*n));
+        memcpy(n->mac, mac, 6);
+        set_state(n, OTA_ROLLOUT_NODE_PENDING, now_ms);
+    }
+    n->last_report_ms = now_ms;
+
+    // a failure is final, even if the node shows up later
+    if (n->state == OTA_ROLLOUT_NODE_FAILED)
+        return true;
+
+    switch (report) {
+        case OTA_ROLLOUT_REPORT_RUNNING:
+            // activated and back, or was already running the build
+            if (n->state != OTA_ROLLOUT_NODE_UPDATED)
+                set_state(n, OTA_ROLLOUT_NODE_UPDATED, now_ms);
+            break;
+        case OTA_ROLLOUT_REPORT_STAGED:
+            // an activating node keeps reporting STAGED until it reboots
+            if (n->state == OTA_ROLLOUT_NODE_PENDING || n->state == OTA_ROLLOUT_NODE_SKIPPED)
+                set_state(n, OTA_ROLLOUT_NODE_STAGED, now_ms);
+            break;
+        case OTA_ROLLOUT_REPORT_WAITING:
+            if (n->state == OTA_ROLLOUT_NODE_ACTIVATING || n->state == OTA_ROLLOUT_NODE_UPDATED) {
+                // rebooted but not into the new build: rolled back
+                fail_node(r, n, now_ms);
+            } else if (n->state == OTA_ROLLOUT_NODE_STAGED) {
+                // rebooted on its own, the staged image is gone
+                set_state(n, OTA_ROLLOUT_NODE_PENDING, now_ms);
+            }
+            break;
+        case OTA_ROLLOUT_REPORT_FAILED:
+            if (n->state == OTA_ROLLOUT_NODE_PENDING || n->state == OTA_ROLLOUT_NODE_STAGED)
+                fail_node(r, n, now_ms);
+            break;
+    }
+    return true;
+}
+
+static uint8_t count_state(const ota_rollout_t *r, ota_rollout_node_state_t state)
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < r->node_count; i++) {
+        if (r->nodes[i].state == state)
+            count++;
+    }
+    return count;
+}
+
+// Activate staged nodes (in discovery order) until `limit` are activating
+static void activate_staged(ota_rollout_t *r, uint8_t limit, bool canary, uint32_t now_ms)
+{
+    uint8_t active = count_state(r, OTA_ROLLOUT_NODE_ACTIVATING);
+
+    for (uint8_t i = 0; i < r->node_count && active < limit; i++) {
+        ota_rollout_node_t *n = &r->nodes[i];
+        if (n->state != OTA_ROLLOUT_NODE_STAGED)
+            continue;
+        if (canary) {
+            if (r->canaries >= r->config.canary)
+                break;
+            r->canaries++;
+            n->canary = true;
+        }
+        set_state(n, OTA_ROLLOUT_NODE_ACTIVATING, now_ms);
+        active++;
+    }
+}
+
+ota_rollout_phase_t ota_rollout_step(ota_rollout_t *r, uint32_t now_ms)
+{
+    if (ota_rollout_finished(r))
+        return r->phase;
+
+    for (uint8_t i = 0; i < r->node_count; i++) {
+        ota_rollout_node_t *n = &r->nodes[i];
+        if (n->state == OTA_ROLLOUT_NODE_PENDING && now_ms - n->since_ms >= r->config.stage_timeout_ms)
+            set_state(n, OTA_ROLLOUT_NODE_SKIPPED, now_ms);
+        else if (n->state == OTA_ROLLOUT_NODE_ACTIVATING && now_ms - n->since_ms >= r->config.confirm_timeout_ms)
+            fail_node(r, n, now_ms);
+        else if (r->phase == OTA_ROLLOUT_SOAK && n->canary && n->state == OTA_ROLLOUT_NODE_UPDATED &&
+                 now_ms - n->last_report_ms >= r->config.silence_ms)
+            fail_node(r, n, now_ms);    // a canary that went silent may be crashing
+    }
+
+    if (r->failures > r->config.max_failures) {
+        set_phase(r, OTA_ROLLOUT_HALTED, now_ms);
+        return r->phase;
+    }
+
+    bool discovered = (now_ms - r->start_ms >= r->config.discovery_ms);
+
+    if (r->phase == OTA_ROLLOUT_CANARY) {
+        activate_staged(r, r->config.canary, true, now_ms);
+
+        // over once the canaries are back, or when no node is left to be one
+        bool none_left = discovered && count_state(r, OTA_ROLLOUT_NODE_PENDING) == 0 &&
+                         count_state(r, OTA_ROLLOUT_NODE_STAGED) == 0;
+        bool busy = false, updated = false;
+        for (uint8_t i = 0; i < r->node_count; i++) {
+            const ota_rollout_node_t *n = &r->nodes[i];
+            busy |= (n->canary && n->state == OTA_ROLLOUT_NODE_ACTIVATING);
+            updated |= (n->canary && n->state == OTA_ROLLOUT_NODE_UPDATED);
+        }
+        if (!busy && (r->canaries >= r->config.canary || none_left))
+            set_phase(r, updated ? OTA_ROLLOUT_SOAK : OTA_ROLLOUT_ROLLING, now_ms);
+    }
+
+    if (r->phase == OTA_ROLLOUT_SOAK && now_ms - r->phase_ms >= r->config.canary_soak_ms)
+        set_phase(r, OTA_ROLLOUT_ROLLING, now_ms);
+
+    if (r->phase == OTA_ROLLOUT_ROLLING) {
+        activate_staged(r, r->config.concurrent, false, now_ms);
+
+        if (discovered && count_state(r, OTA_ROLLOUT_NODE_PENDING) == 0 &&
+            count_state(r, OTA_ROLLOUT_NODE_STAGED) == 0 && count_state(r, OTA_ROLLOUT_NODE_ACTIVATING) == 0)
+            set_phase(r, OTA_ROLLOUT_COMPLETE, now_ms);
+    }
+
+    return r->phase;
+}
+
+uint8_t ota_rollout_activating(const ota_rollout_t *r, uint8_t (*macs)[6], uint8_t max)
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < r->node_count && count < max; i++) {
+        if (r->nodes[i].state == OTA_ROLLOUT_NODE_ACTIVATING)
+            memcpy(macs[count++], r->nodes[i].mac, 6);
+    }
+    return count;
+}
+
+void ota_rollout_count(const ota_rollout_t *r, uint8_t counts[OTA_ROLLOUT_NODE_STATES])
+{
+    memset(counts, 0, OTA_ROLLOUT_NODE_STATES);
+    for (uint8_t i = 0; i < r->node_count; i++)
+        counts[r->nodes[i].state]++;
+}
+
+bool ota_rollout_finished(const ota_rollout_t *r)
+{
+    return r->phase == OTA_ROLLOUT_COMPLETE || r->phase == OTA_ROLLOUT_HALTED;
+}
+
+const char *ota_rollout_phase_to_string(ota_rollout_phase_t phase)
+{
+    switch (phase) {
+        case OTA_ROLLOUT_CANARY:    return "canary";
+        case OTA_ROLLOUT_SOAK:      return "soak";
+        case OTA_ROLLOUT_ROLLING:   return "rolling";
+        case OTA_ROLLOUT_COMPLETE:  return "complete";
+        case OTA_ROLLOUT_HALTED:    return "halted";
+        default:                    return "unknown";
+    }
+}
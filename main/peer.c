@@ -1,4 +1,6 @@
 #include "peer.h"
+#include "peer_index.h"
+#include "mesh_codec.h"
 
 static const char *TAG = "PEER";
 
@@ -17,6 +19,144 @@ mesh_tuning_params_t self_tuning_params = {0};
 
 peer_type UNIT_ROLE;
 
+// Bumped under TX_peers_mutex whenever a TX peer is added or removed
+static uint32_t TX_peers_epoch = 0;
+static uint32_t snapshot_max_hold_us = 0;
+
+// =============================================================================
+// PEER INDEX - open addressing on MAC (peer_index.c), direct map on position
+// =============================================================================
+// The SLISTs stay the iteration order; lookups go through these tables.
+// Both are only touched with the matching peers mutex held.
+
+// Power of two, at least twice the mesh size to keep probe chains short
+#if MESH_LITE_MAXIMUM_NODE_NUMBER <= 8
+#define PEER_INDEX_SIZE 16
+#elif MESH_LITE_MAXIMUM_NODE_NUMBER <= 16
+#define PEER_INDEX_SIZE 32
+#elif MESH_LITE_MAXIMUM_NODE_NUMBER <= 32
+#define PEER_INDEX_SIZE 64
+#elif MESH_LITE_MAXIMUM_NODE_NUMBER <= 64
+#define PEER_INDEX_SIZE 128
+#else
+#define PEER_INDEX_SIZE 256
+#endif
+
+// Positions are int8_t, one slot per possible value
+#define PEER_POSITION_SLOTS 256
+
+static peer_index_entry_t TX_mac_slots[PEER_INDEX_SIZE];
+static peer_index_entry_t RX_mac_slots[PEER_INDEX_SIZE];
+static peer_index_t TX_mac_index = { TX_mac_slots, PEER_INDEX_SIZE - 1 };
+static peer_index_t RX_mac_index = { RX_mac_slots, PEER_INDEX_SIZE - 1 };
+static struct TX_peer *TX_position_index[PEER_POSITION_SLOTS];
+static struct RX_peer *RX_position_index[PEER_POSITION_SLOTS];
+
+// =============================================================================
+// PEER POOL - static slots, O(1) alloc/free, no heap traffic on join/leave
+// =============================================================================
+
+#define PEER_POOL_SIZE MESH_LITE_MAXIMUM_NODE_NUMBER
+
+static struct TX_peer TX_pool[PEER_POOL_SIZE];
+static struct RX_peer RX_pool[PEER_POOL_SIZE];
+
+// Each pool hands out never-used slots in order, then recycles freed ones
+// from a stack of indexes. All-zero state means "every slot free".
+typedef struct {
+    uint8_t free_stack[PEER_POOL_SIZE];
+    uint16_t free_top;
+    uint16_t fresh;             /* Slots [fresh, PEER_POOL_SIZE) were never handed out */
+    peer_pool_stats_t stats;
+} peer_pool_t;
+
+static peer_pool_t TX_pool_state;
+static peer_pool_t RX_pool_state;
+
+// Slots may be taken outside the peers mutexes, so the pools have their own lock
+static portMUX_TYPE peer_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void peer_pool_reset(void)
+{
+    portENTER_CRITICAL(&peer_pool_lock);
+    TX_pool_state.free_top = TX_pool_state.fresh = TX_pool_state.stats.in_use = 0;
+    RX_pool_state.free_top = RX_pool_state.fresh = RX_pool_state.stats.in_use = 0;
+    portEXIT_CRITICAL(&peer_pool_lock);
+}
+
+static int peer_pool_take(peer_pool_t *pool)
+{
+    int slot = -1;
+
+    portENTER_CRITICAL(&peer_pool_lock);
+    if (pool->free_top > 0)
+        slot = pool->free_stack[--pool->free_top];
+    else if (pool->fresh < PEER_POOL_SIZE)
+        slot = pool->fresh++;
+
+    if (slot >= 0) {
+        pool->stats.alloc_count++;
+        if (++pool->stats.in_use > pool->stats.high_water)
+            pool->stats.high_water = pool->stats.in_use;
+    } else {
+        pool->stats.alloc_failures++;
+    }
+    portEXIT_CRITICAL(&peer_pool_lock);
+
+    return slot;
+}
+
+static void peer_pool_give(peer_pool_t *pool, int slot)
+{
+    portENTER_CRITICAL(&peer_pool_lock);
+    if (pool->free_top < PEER_POOL_SIZE) {
+        pool->free_stack[pool->free_top++] = slot;
+        pool->stats.free_count++;
+        pool->stats.in_use--;
+    }
+    portEXIT_CRITICAL(&peer_pool_lock);
+}
+
+static struct TX_peer *TX_peer_alloc(void)
+{
+    int slot = peer_pool_take(&TX_pool_state);
+    return (slot < 0) ? NULL : &TX_pool[slot];
+}
+
+static void TX_peer_free(struct TX_peer *p)
+{
+    peer_pool_give(&TX_pool_state, p - TX_pool);
+}
+
+static struct RX_peer *RX_peer_alloc(void)
+{
+    int slot = peer_pool_take(&RX_pool_state);
+    return (slot < 0) ? NULL : &RX_pool[slot];
+}
+
+static void RX_peer_free(struct RX_peer *p)
+{
+    peer_pool_give(&RX_pool_state, p - RX_pool);
+}
+
+void peer_pool_get_stats(peer_type type, peer_pool_stats_t *stats)
+{
+    portENTER_CRITICAL(&peer_pool_lock);
+    *stats = (type == TX) ? TX_pool_state.stats : RX_pool_state.stats;
+    portEXIT_CRITICAL(&peer_pool_lock);
+
+    stats->capacity = PEER_POOL_SIZE;
+    stats->heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    stats->heap_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+// RX_peers_mutex must be held
+static void RX_position_unlink(struct RX_peer *p)
+{
+    if (p->position && RX_position_index[(uint8_t)p->position] == p)
+        RX_position_index[(uint8_t)p->position] = NULL;
+}
+
 void init_HW()
 {
     if (UNIT_ROLE == TX) 
@@ -68,6 +208,8 @@ void peer_init()
     SLIST_INIT(&RX_peers);
     SLIST_INIT(&TX_peers);
 
+    // Lists were just emptied, so every pool slot is free again
+    peer_pool_reset();
     delete_all_peers();
 
     struct TX_peer *p = TX_peer_add(self_mac, UNIT_ID);
@@ -75,20 +217,7 @@ void peer_init()
     {
         ESP_LOGI(TAG, "Added self TX peer with ID %d", UNIT_ID);
 
-        // Free the malloc'd memory first to avoid leak
-        if (p->static_payload)
-            free(p->static_payload);
-        if (p->dynamic_payload)
-            free(p->dynamic_payload);
-        if (p->previous_dynamic_payload)
-            free(p->previous_dynamic_payload);
-        if (p->alert_payload)
-            free(p->alert_payload);
-        if (p->previous_alert_payload)
-            free(p->previous_alert_payload);
-        if (p->tuning_params)
-            free(p->tuning_params);
-
+        // Self peer aliases the globals instead of its inline storage
         p->static_payload = &self_static_payload;
         p->dynamic_payload = &self_dynamic_payload;
         p->previous_dynamic_payload = &self_previous_dynamic_payload;
@@ -114,71 +243,72 @@ void allLocalizationTxPeersOFF()
     }
 }
 
-struct TX_peer* find_next_TX_for_localization(int8_t previousTX_pos) 
+uint8_t TX_peers_localization_candidates(int8_t *positions, uint8_t max)
 {
-    struct TX_peer *result = NULL;
-    struct TX_peer *first_available = NULL;
-    bool found_previous = (!previousTX_pos);
-    
+    uint8_t count = 0;
+
     WITH_TX_PEERS_LOCKED {
         struct TX_peer *p;
         SLIST_FOREACH(p, &TX_peers, next) {
-            if (p->dynamic_payload->TX.tx_status == TX_OFF || p->dynamic_payload->TX.tx_status == TX_LOCALIZATION) {
-                if (first_available == NULL) {
-                    first_available = p;
-                }
-                
-                if (found_previous) {
-                    result = p;
-                    break;  //OK - breaks FOREACH, not the guard
-                }
-            }
-            
-            if (p->position == previousTX_pos) {
-                found_previous = true;
-            }
-        }
-        
-        if (result == NULL) {
-            result = first_available;  // Wrap around
+            if (count >= max)
+                break;  //OK - breaks FOREACH, not the guard
+            if (p->dynamic_payload->TX.tx_status == TX_OFF || p->dynamic_payload->TX.tx_status == TX_LOCALIZATION)
+                positions[count++] = p->position;
         }
     }
-    
-    return result;  //Pointer - use immediately!
+
+    return count;
 }
 
-struct RX_peer* findRXpeerWPosition(uint8_t pos)
+uint8_t TX_peers_probe_candidates(int8_t *positions, uint8_t max)
 {
-    struct RX_peer *result = NULL;
+    uint8_t count = 0;
 
-    WITH_RX_PEERS_LOCKED {
-        struct RX_peer *p;
-        SLIST_FOREACH(p, &RX_peers, next) 
-        {
-            if (p->position == pos) {
-                result = p;
-                break;
-            }
+    WITH_TX_PEERS_LOCKED {
+        struct TX_peer *p;
+        SLIST_FOREACH(p, &TX_peers, next) {
+            if (count >= max)
+                break;  //OK - breaks FOREACH, not the guard
+            if (p->dynamic_payload->TX.tx_status == TX_OFF)
+                positions[count++] = p->position;
         }
     }
-    
-    return result;
+
+    return count;
 }
 
-struct TX_peer* TX_peer_find_by_mac(uint8_t *mac)
+bool TX_peer_start_localization(int8_t position, uint8_t *mac)
 {
-    struct TX_peer *result = NULL;
+    bool found = false;
 
     WITH_TX_PEERS_LOCKED {
         struct TX_peer *p;
         SLIST_FOREACH(p, &TX_peers, next) {
-            if (memcmp(p->MACaddress, mac, 6) == 0) {
-                result = p;
-                break;
+            if (p->position == position) {
+                p->dynamic_payload->TX.tx_status = TX_LOCALIZATION;
+                memcpy(mac, p->MACaddress, ETH_HWADDR_LEN);
+                found = true;
+                break;  //OK - breaks FOREACH, not the guard
             }
         }
     }
 
+    return found;
+}
+
+struct RX_peer* findRXpeerWPosition(uint8_t pos)
+{
+    return RX_peer_find_by_position((int8_t)pos);
+}
+
+struct TX_peer* TX_peer_find_by_mac(uint8_t *mac)
+{
+    struct TX_peer *result = NULL;
+
+    WITH_TX_PEERS_LOCKED {
+        result = peer_index_find(&TX_mac_index, mac);
+    }
+
     return result;
 }
 
@@ -187,13 +317,7 @@ struct RX_peer* RX_peer_find_by_mac(uint8_t *mac)
     struct RX_peer *result = NULL;
 
     WITH_RX_PEERS_LOCKED {
-        struct RX_peer *p;
-        SLIST_FOREACH(p, &RX_peers, next) {
-            if (memcmp(p->MACaddress, mac, ETH_HWADDR_LEN) == 0) {
-                result = p;
-                break;
-            }
-        }
+        result = peer_index_find(&RX_mac_index, mac);
     }
     
     return result;
@@ -204,13 +328,7 @@ struct TX_peer* TX_peer_find_by_position(uint8_t position)
     struct TX_peer *result = NULL;
 
     WITH_TX_PEERS_LOCKED {
-        struct TX_peer *p;
-        SLIST_FOREACH(p, &TX_peers, next) {
-            if (p->position == position) {
-                result = p;
-                break;
-            }
-        }
+        result = TX_position_index[position];
     }
 
     return result;
@@ -221,11 +339,16 @@ struct RX_peer* RX_peer_find_by_position(int8_t position)
     struct RX_peer *result = NULL;
 
     WITH_RX_PEERS_LOCKED {
-        struct RX_peer *p;
-        SLIST_FOREACH(p, &RX_peers, next) {
-            if (p->position == position) {
-                result = p;
-                break;
+        if (position) {
+            result = RX_position_index[(uint8_t)position];
+        } else {
+            // Position 0 means "not localized" and is not indexed
+            struct RX_peer *p;
+            SLIST_FOREACH(p, &RX_peers, next) {
+                if (p->position == 0) {
+                    result = p;
+                    break;
+                }
             }
         }
     }
@@ -233,18 +356,26 @@ struct RX_peer* RX_peer_find_by_position(int8_t position)
     return result;
 }
 
+void RX_peer_set_position(struct RX_peer *peer, int8_t position)
+{
+    WITH_RX_PEERS_LOCKED {
+        RX_position_unlink(peer);
+        peer->position = position;
+        if (position)
+            RX_position_index[(uint8_t)position] = peer;
+    }
+}
+
 void removeRelativeRX(int8_t pos)
 {
     // Atomic: Find and remove in one critical section
     WITH_RX_PEERS_LOCKED {
-        struct RX_peer *p;
-        SLIST_FOREACH(p, &RX_peers, next) {
-            if (p->position == pos) 
-            {
-                p->position = 0;
-                p->RX_status = RX_CONNECTED;
-                break;
-            }
+        struct RX_peer *p = pos ? RX_position_index[(uint8_t)pos] : NULL;
+        if (p != NULL) 
+        {
+            RX_position_unlink(p);
+            p->position = 0;
+            p->RX_status = RX_CONNECTED;
         }
     }
     
@@ -254,25 +385,22 @@ void removeFromRelativeTX(int8_t pos)
 {
     // Atomic: Find and remove in one critical section
     WITH_TX_PEERS_LOCKED {
-        struct TX_peer *p;
-        SLIST_FOREACH(p, &TX_peers, next) {
-            if (p->position == pos) 
-            {
-                p->alert_payload->RX.RX_all_flags = p->alert_payload->TX.TX_all_flags = 0;
-                p->alert_payload->RX.id = 0;
-                memset(p->alert_payload->RX.macAddr, 0, ETH_HWADDR_LEN);
-                memset(p->dynamic_payload->RX.macAddr, 0, ETH_HWADDR_LEN);
-                p->dynamic_payload->RX.rx_status = RX_NOT_PRESENT;
-                p->dynamic_payload->TX.tx_status = TX_OFF;
-                p->dynamic_payload->RX.id = 0;
-                p->dynamic_payload->RX.current = p->dynamic_payload->RX.voltage = p->dynamic_payload->RX.temp1 = p->dynamic_payload->RX.temp2 = 0;
-
-                strip_charging = strip_misalignment = false;
-                strip_enable = true;
-
-                //todo switch off! also - remove from espNOW how?
-                break;
-            }
+        struct TX_peer *p = pos ? TX_position_index[(uint8_t)pos] : NULL;
+        if (p != NULL) 
+        {
+            p->alert_payload->RX.RX_all_flags = p->alert_payload->TX.TX_all_flags = 0;
+            p->alert_payload->RX.id = 0;
+            memset(p->alert_payload->RX.macAddr, 0, ETH_HWADDR_LEN);
+            memset(p->dynamic_payload->RX.macAddr, 0, ETH_HWADDR_LEN);
+            p->dynamic_payload->RX.rx_status = RX_NOT_PRESENT;
+            p->dynamic_payload->TX.tx_status = TX_OFF;
+            p->dynamic_payload->RX.id = 0;
+            p->dynamic_payload->RX.current = p->dynamic_payload->RX.voltage = p->dynamic_payload->RX.temp1 = p->dynamic_payload->RX.temp2 = 0;
+
+            strip_charging = strip_misalignment = false;
+            strip_enable = true;
+
+            //todo switch off! also - remove from espNOW how?
         }
     }
     
@@ -294,44 +422,22 @@ void peer_delete(uint8_t *mac)
     
     // Atomic: Find and remove in one critical section
     WITH_TX_PEERS_LOCKED {
-        struct TX_peer *p;
-        if (!SLIST_EMPTY(&TX_peers)) {
-            SLIST_FOREACH(p, &TX_peers, next) {
-                if (memcmp(p->MACaddress, mac, ETH_HWADDR_LEN) == 0) {
-                    //reset relative RX (if any)
-                    removeRelativeRX(p->position);
-                    SLIST_REMOVE(&TX_peers, p, TX_peer, next);
-                    TX_p = p;  // Store for freeing outside lock
-                    break;
-                }
-            }
+        struct TX_peer *p = peer_index_find(&TX_mac_index, mac);
+        if (p != NULL) {
+            //reset relative RX (if any)
+            removeRelativeRX(p->position);
+            peer_index_remove(&TX_mac_index, p->MACaddress);
+            if (TX_position_index[(uint8_t)p->position] == p)
+                TX_position_index[(uint8_t)p->position] = NULL;
+            SLIST_REMOVE(&TX_peers, p, TX_peer, next);
+            TX_peers_epoch++;
+            TX_p = p;  // Store for freeing outside lock
         }
     }
     
-    // Free outside mutex (peer already removed from list)
+    // Release outside mutex (peer already removed from list)
     if (TX_p != NULL) {
-        // Defensive: Only free if not pointing to globals
-        if (TX_p->static_payload && TX_p->static_payload != &self_static_payload) {
-            free(TX_p->static_payload);
-        }
-        if (TX_p->dynamic_payload && TX_p->dynamic_payload != &self_dynamic_payload) {
-            free(TX_p->dynamic_payload);
-        }
-        if (TX_p->previous_dynamic_payload && 
-            TX_p->previous_dynamic_payload != &self_previous_dynamic_payload) {
-            free(TX_p->previous_dynamic_payload);
-        }
-        if (TX_p->alert_payload && TX_p->alert_payload != &self_alert_payload) {
-            free(TX_p->alert_payload);
-        }
-        if (TX_p->previous_alert_payload && 
-            TX_p->previous_alert_payload != &self_previous_alert_payload) {
-            free(TX_p->previous_alert_payload);
-        }
-        if (TX_p->tuning_params && TX_p->tuning_params != &self_tuning_params) {
-            free(TX_p->tuning_params);
-        }
-        free(TX_p);
+        TX_peer_free(TX_p);
         ESP_LOGI(TAG, "Deleted TX peer "MACSTR, MAC2STR(mac));
         return;
     }
@@ -340,22 +446,19 @@ void peer_delete(uint8_t *mac)
     struct RX_peer *RX_p = NULL;
     
     WITH_RX_PEERS_LOCKED {
-        struct RX_peer *p;
-            if (!SLIST_EMPTY(&RX_peers)) {
-            SLIST_FOREACH(p, &RX_peers, next) {
-                if (memcmp(p->MACaddress, mac, ETH_HWADDR_LEN) == 0) {
-                    //remove from relative TX (if any)
-                    removeFromRelativeTX(p->position);
-                    SLIST_REMOVE(&RX_peers, p, RX_peer, next);
-                    RX_p = p;
-                    break;
-                }
-            }
+        struct RX_peer *p = peer_index_find(&RX_mac_index, mac);
+        if (p != NULL) {
+            //remove from relative TX (if any)
+            removeFromRelativeTX(p->position);
+            peer_index_remove(&RX_mac_index, p->MACaddress);
+            RX_position_unlink(p);
+            SLIST_REMOVE(&RX_peers, p, RX_peer, next);
+            RX_p = p;
         }
     }
     
     if (RX_p != NULL) {
-        free(RX_p);
+        RX_peer_free(RX_p);
         ESP_LOGI(TAG, "Deleted RX peer "MACSTR, MAC2STR(mac));
     } else {
         ESP_LOGW(TAG, "Peer "MACSTR" not found for deletion", MAC2STR(mac));
@@ -370,30 +473,11 @@ void delete_all_peers(void)
         while (!SLIST_EMPTY(&TX_peers)) {
             TX_p = SLIST_FIRST(&TX_peers);
             SLIST_REMOVE_HEAD(&TX_peers, next);
-
-            // Defensive: Only free if not pointing to globals
-            if (TX_p->static_payload && TX_p->static_payload != &self_static_payload) {
-                free(TX_p->static_payload);
-            }
-            if (TX_p->dynamic_payload && TX_p->dynamic_payload != &self_dynamic_payload) {
-                free(TX_p->dynamic_payload);
-            }
-            if (TX_p->previous_dynamic_payload && 
-                TX_p->previous_dynamic_payload != &self_previous_dynamic_payload) {
-                free(TX_p->previous_dynamic_payload);
-            }
-            if (TX_p->alert_payload && TX_p->alert_payload != &self_alert_payload) {
-                free(TX_p->alert_payload);
-            }
-            if (TX_p->previous_alert_payload && 
-                TX_p->previous_alert_payload != &self_previous_alert_payload) {
-                free(TX_p->previous_alert_payload);
-            }
-            if (TX_p->tuning_params && TX_p->tuning_params != &self_tuning_params) {
-                free(TX_p->tuning_params);
-            }
-            free(TX_p);
+            TX_peer_free(TX_p);
         }
+        peer_index_clear(&TX_mac_index);
+        TX_peers_epoch++;
+        memset(TX_position_index, 0, sizeof(TX_position_index));
     }
 
     struct RX_peer *RX_p;
@@ -402,8 +486,10 @@ void delete_all_peers(void)
         while (!SLIST_EMPTY(&RX_peers)) {
             RX_p = SLIST_FIRST(&RX_peers);
             SLIST_REMOVE_HEAD(&RX_peers, next);
-            free(RX_p);
+            RX_peer_free(RX_p);
         }
+        peer_index_clear(&RX_mac_index);
+        memset(RX_position_index, 0, sizeof(RX_position_index));
     }
 }
 
@@ -456,44 +542,23 @@ struct TX_peer* TX_peer_add(uint8_t *mac, uint8_t id)
         return p;
     }
 
-    // Allocate memory for the peer (outside mutex - slow operation)
-    p = malloc(sizeof * p);
+    // Take a slot from the pool (outside mutex)
+    p = TX_peer_alloc();
     if (!p) 
     {
-        ESP_LOGE(TAG, "Failed to allocate memory for peer");
+        ESP_LOGE(TAG, "TX peer pool exhausted");
         return NULL;
     }
     
+    // Clears the inline payloads too
     memset(p, 0, sizeof * p);
 
-    // Allocate memory for payloads
-    p->static_payload = malloc(sizeof(mesh_static_payload_t));
-    p->dynamic_payload = malloc(sizeof(mesh_dynamic_payload_t));
-    p->previous_dynamic_payload = malloc(sizeof(mesh_dynamic_payload_t));
-    p->alert_payload = malloc(sizeof(mesh_alert_payload_t));
-    p->previous_alert_payload = malloc(sizeof(mesh_alert_payload_t));
-    p->tuning_params = malloc(sizeof(mesh_tuning_params_t));
-
-    if (!p->static_payload || !p->dynamic_payload || !p->previous_dynamic_payload ||
-        !p->alert_payload || !p->previous_alert_payload || !p->tuning_params) {
-        ESP_LOGE(TAG, "Failed to allocate memory for payloads");
-        // Clean up
-        if (p->static_payload) free(p->static_payload);
-        if (p->dynamic_payload) free(p->dynamic_payload);
-        if (p->previous_dynamic_payload) free(p->previous_dynamic_payload);
-        if (p->alert_payload) free(p->alert_payload);
-        if (p->previous_alert_payload) free(p->previous_alert_payload);
-        if (p->tuning_params) free(p->tuning_params);
-        free(p);
-        return NULL;
-    }
-
-    memset(p->static_payload, 0, sizeof(mesh_static_payload_t));
-    memset(p->dynamic_payload, 0, sizeof(mesh_dynamic_payload_t));
-    memset(p->previous_dynamic_payload, 0, sizeof(mesh_dynamic_payload_t));
-    memset(p->alert_payload, 0, sizeof(mesh_alert_payload_t));
-    memset(p->previous_alert_payload, 0, sizeof(mesh_alert_payload_t));
-    memset(p->tuning_params, 0, sizeof(mesh_tuning_params_t));
+    p->static_payload = &p->storage.static_payload;
+    p->dynamic_payload = &p->storage.dynamic_payload;
+    p->previous_dynamic_payload = &p->storage.previous_dynamic_payload;
+    p->alert_payload = &p->storage.alert_payload;
+    p->previous_alert_payload = &p->storage.previous_alert_payload;
+    p->tuning_params = &p->storage.tuning_params;
 
     // Initialize peer parameters
     memcpy(p->MACaddress, mac, 6);
@@ -506,35 +571,33 @@ struct TX_peer* TX_peer_add(uint8_t *mac, uint8_t id)
     p->position = p->id = id; // Position same as ID for TX  
     *p->previous_dynamic_payload = *p->dynamic_payload;
     *p->previous_alert_payload = *p->alert_payload;
+    telemetry_agg_init(&p->summary, PEER_SUMMARY_WINDOW_MS, PEER_SUMMARY_MAX_GAP_MS);
 
-    struct TX_peer *existing;
+    struct TX_peer *existing = NULL;
+    bool inserted = false;
 
     // Add to list - quick operation, hold mutex briefly
     WITH_TX_PEERS_LOCKED {
         // Double-check peer doesn't exist (defensive)
-        SLIST_FOREACH(existing, &TX_peers, next) {
-            if (memcmp(existing->MACaddress, mac, ETH_HWADDR_LEN) == 0) {
-                // Race condition - another thread added it
-                ESP_LOGW(TAG, "Peer was added by another thread, cleaning up");
-                // Clean up our allocation (outside macro to avoid issues)
-                goto cleanup_and_return_existing;
-            }
+        existing = peer_index_find(&TX_mac_index, mac);
+        if (existing == NULL && peer_index_insert(&TX_mac_index, p->MACaddress, p)) {
+            TX_position_index[(uint8_t)p->position] = p;
+            SLIST_INSERT_HEAD(&TX_peers, p, next);
+            TX_peers_epoch++;
+            inserted = true;
         }
-        
-        SLIST_INSERT_HEAD(&TX_peers, p, next);
     }
 
-    return p;
+    if (inserted)
+        return p;
 
-cleanup_and_return_existing:
-    // Free our allocations
-    free(p->static_payload);
-    free(p->dynamic_payload);
-    free(p->previous_dynamic_payload);
-    free(p->alert_payload);
-    free(p->previous_alert_payload);
-    free(p->tuning_params);
-    free(p);
+    // Clean up our allocation outside the guard (goto would leave it locked)
+    if (existing != NULL)
+        ESP_LOGW(TAG, "Peer was added by another thread, cleaning up");   // Race condition
+    else
+        ESP_LOGE(TAG, "TX peer index full");
+
+    TX_peer_free(p);
     return existing;  // Return the one that won the race
 }
 
@@ -550,11 +613,11 @@ struct RX_peer* RX_peer_add(uint8_t *mac, uint8_t id)
         return p;
     }
 
-    // Allocate memory (outside mutex)
-    p = malloc(sizeof * p);
+    // Take a slot from the pool (outside mutex)
+    p = RX_peer_alloc();
     if (!p) 
     {
-        ESP_LOGE(TAG, "Failed to allocate memory for peer");
+        ESP_LOGE(TAG, "RX peer pool exhausted");
         return NULL;
     }
 
@@ -565,27 +628,196 @@ struct RX_peer* RX_peer_add(uint8_t *mac, uint8_t id)
     p->position = 0;
     p->id = id;
 
-    struct RX_peer *existing;
+    struct RX_peer *existing = NULL;
+    bool inserted = false;
 
     // Add to list
     WITH_RX_PEERS_LOCKED {
         // Double-check (defensive)
-        SLIST_FOREACH(existing, &RX_peers, next) {
-            if (memcmp(existing->MACaddress, mac, 6) == 0) {
-                goto cleanup_and_return_existing_rx;
-            }
+        existing = peer_index_find(&RX_mac_index, mac);
+        if (existing == NULL && peer_index_insert(&RX_mac_index, p->MACaddress, p)) {
+            SLIST_INSERT_HEAD(&RX_peers, p, next);
+            inserted = true;
         }
-        
-        SLIST_INSERT_HEAD(&RX_peers, p, next);
     }
 
-    return p;
+    if (inserted)
+        return p;
 
-    cleanup_and_return_existing_rx:
-    free(p);
+    if (existing == NULL)
+        ESP_LOGE(TAG, "RX peer index full");
+    RX_peer_free(p);
     return existing;
 }
 
+// =============================================================================
+// SNAPSHOTS - copy under the lock, do the slow work (JSON, network) outside
+// =============================================================================
+
+static void record_hold_time(int64_t start_us)
+{
+    uint32_t held = (uint32_t)(esp_timer_get_time() - start_us);
+    if (held > snapshot_max_hold_us)
+        snapshot_max_hold_us = held;
+}
+
+uint16_t TX_peers_snapshot(TX_peers_snapshot_t *snap)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    snap->count = 0;
+
+    WITH_TX_PEERS_LOCKED {
+        int64_t start = esp_timer_get_time();
+        struct TX_peer *p;
+
+        snap->epoch = TX_peers_epoch;
+        SLIST_FOREACH(p, &TX_peers, next) {
+            if (snap->count >= MESH_LITE_MAXIMUM_NODE_NUMBER)
+                break;
+
+            update_status(p);
+
+            TX_peer_snapshot_t *s = &snap->peers[snap->count++];
+            s->id = p->id;
+            memcpy(s->MACaddress, p->MACaddress, ETH_HWADDR_LEN);
+            s->dynamic_payload = *p->dynamic_payload;
+            s->previous_dynamic_payload = *p->previous_dynamic_payload;
+            s->alert_payload = *p->alert_payload;
+            s->previous_alert_payload = *p->previous_alert_payload;
+            s->lastDynamicPublished = p->lastDynamicPublished;
+
+            // windows only close here, so nothing changes the closed one before the commit
+            s->summary_ready = telemetry_agg_close(&p->summary, now);
+            if (s->summary_ready)
+                s->summary = p->summary.closed;
+        }
+        record_hold_time(start);
+    }
+
+    return snap->count;
+}
+
+void TX_peer_commit_published(const TX_peer_snapshot_t *peer, bool dynamic_published, bool alert_published)
+{
+    if (!dynamic_published && !alert_published)
+        return;
+
+    WITH_TX_PEERS_LOCKED {
+        int64_t start = esp_timer_get_time();
+
+        // Peer may have left since the snapshot - nothing to write back then
+        struct TX_peer *p = peer_index_find(&TX_mac_index, peer->MACaddress);
+        if (p != NULL) {
+            if (dynamic_published) {
+                *p->previous_dynamic_payload = peer->dynamic_payload;
+                p->lastDynamicPublished = peer->lastDynamicPublished;
+            }
+            if (alert_published)
+                *p->previous_alert_payload = peer->alert_payload;
+        }
+        record_hold_time(start);
+    }
+}
+
+static void aggregate_dynamic(struct TX_peer *p, uint32_t now)
+{
+    const mesh_dynamic_payload_t *d = p->dynamic_payload;
+    const telemetry_agg_sample_t sample = {
+        .tx = { d->TX.voltage, d->TX.current, d->TX.temp1, d->TX.temp2 },
+        .rx = { d->RX.voltage, d->RX.current, d->RX.temp1, d->RX.temp2 },
+    };
+    telemetry_agg_add(&p->summary, &sample, now);
+}
+
+void TX_peer_aggregate_dynamic(const uint8_t *mac)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    WITH_TX_PEERS_LOCKED {
+        struct TX_peer *p = peer_index_find(&TX_mac_index, mac);
+        if (p != NULL)
+            aggregate_dynamic(p, now);
+    }
+}
+
+bool TX_peer_store_dynamic(const uint8_t *mac, const mesh_dynamic_payload_t *payload)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    bool found = false;
+
+    WITH_TX_PEERS_LOCKED {
+        struct TX_peer *p = peer_index_find(&TX_mac_index, mac);
+        if (p != NULL) {
+            *p->dynamic_payload = *payload;
+            aggregate_dynamic(p, now);
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+esp_err_t TX_peer_decode_dynamic(const uint8_t *mac, const uint8_t *frame, uint32_t len)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    WITH_TX_PEERS_LOCKED {
+        struct TX_peer *p = peer_index_find(&TX_mac_index, mac);
+        if (p != NULL) {
+            // delta frames only carry the changed fields, apply them on the frame they were computed against
+            err = mesh_codec_decode_dynamic(frame, len, p->dynamic_payload, &p->codec_rx);
+            if (err == ESP_OK)
+                aggregate_dynamic(p, now);
+        }
+    }
+
+    return err;
+}
+
+bool TX_peer_store_alert(const uint8_t *mac, const mesh_alert_payload_t *payload)
+{
+    bool found = false;
+
+    WITH_TX_PEERS_LOCKED {
+        struct TX_peer *p = peer_index_find(&TX_mac_index, mac);
+        if (p != NULL) {
+            *p->alert_payload = *payload;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+esp_err_t TX_peer_decode_alert(const uint8_t *mac, const uint8_t *frame, uint32_t len)
+{
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    WITH_TX_PEERS_LOCKED {
+        struct TX_peer *p = peer_index_find(&TX_mac_index, mac);
+        if (p != NULL)
+            err = mesh_codec_decode_alert(frame, len, p->alert_payload);
+    }
+
+    return err;
+}
+
+void TX_peer_commit_summary(const TX_peer_snapshot_t *peer)
+{
+    WITH_TX_PEERS_LOCKED {
+        struct TX_peer *p = peer_index_find(&TX_mac_index, peer->MACaddress);
+        if (p != NULL)
+            telemetry_agg_release(&p->summary);
+    }
+}
+
+uint32_t TX_peers_snapshot_max_hold_us(void)
+{
+    return snapshot_max_hold_us;
+}
+
 bool dynamic_payload_changed(mesh_dynamic_payload_t *current, 
                                     mesh_dynamic_payload_t *previous)
 {
@@ -634,8 +866,8 @@ bool dynamic_payload_changed(mesh_dynamic_payload_t *current,
     if (current->TX.tx_status != previous->TX.tx_status || current->RX.rx_status != previous->RX.rx_status)
         res = true;
 
-    //avoid localization status
-    if (current->TX.tx_status == TX_LOCALIZATION)
+    //avoid localization and probe status
+    if (current->TX.tx_status == TX_LOCALIZATION || current->TX.tx_status == TX_PROBE)
         res = false;
 
     return res;
@@ -655,6 +887,61 @@ bool alert_payload_changed(mesh_alert_payload_t *current,
     return res;
 }
 
+/* Alert notification - producers wake alert_task instead of it polling */
+static portMUX_TYPE self_alert_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t self_alert_task = NULL;
+static int64_t self_alert_first_us = 0;     // oldest sample not yet taken by the consumer, 0 if none
+static self_alert_stats_t self_alert_stats;
+
+void self_alert_register_task(TaskHandle_t task)
+{
+    portENTER_CRITICAL(&self_alert_lock);
+    self_alert_task = task;
+    portEXIT_CRITICAL(&self_alert_lock);
+}
+
+void self_alert_notify(int64_t sample_us)
+{
+    portENTER_CRITICAL(&self_alert_lock);
+    if (self_alert_first_us == 0 || sample_us < self_alert_first_us)
+        self_alert_first_us = sample_us;
+    self_alert_stats.notifications++;
+    TaskHandle_t task = self_alert_task;
+    portEXIT_CRITICAL(&self_alert_lock);
+
+    if (task != NULL)
+        xTaskNotifyGive(task);
+}
+
+bool self_alert_wait(TickType_t timeout, uint32_t *latency_us)
+{
+    ulTaskNotifyTake(pdTRUE, timeout);
+    const int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&self_alert_lock);
+    const int64_t first = self_alert_first_us;
+    self_alert_first_us = 0;
+    if (first != 0)
+    {
+        const uint32_t latency = (uint32_t)(now - first);
+        self_alert_stats.last_latency_us = latency;
+        if (latency > self_alert_stats.max_latency_us)
+            self_alert_stats.max_latency_us = latency;
+        if (latency_us != NULL)
+            *latency_us = latency;
+    }
+    portEXIT_CRITICAL(&self_alert_lock);
+
+    return (first != 0);
+}
+
+void self_alert_get_stats(self_alert_stats_t *stats)
+{
+    portENTER_CRITICAL(&self_alert_lock);
+    *stats = self_alert_stats;
+    portEXIT_CRITICAL(&self_alert_lock);
+}
+
 void init_payloads()
 {
     //Init payloads
@@ -693,6 +980,8 @@ void update_status(struct TX_peer *peer)
         peer->dynamic_payload->TX.tx_status = TX_ALERT;
     else if (peer->dynamic_payload->TX.tx_status == TX_LOCALIZATION)
         peer->dynamic_payload->TX.tx_status = TX_LOCALIZATION;
+    else if (peer->dynamic_payload->TX.tx_status == TX_PROBE)
+        peer->dynamic_payload->TX.tx_status = TX_PROBE;
     else if (peer->dynamic_payload->RX.macAddr[0] != 0)
         peer->dynamic_payload->TX.tx_status = TX_DEPLOY;
     else
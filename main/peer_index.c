@@ -0,0 +1,88 @@
+#include "peer_index.h"
+
+#include <string.h>
+
+static inline uint32_t mac_hash(const peer_index_t *index, const uint8_t *mac)
+{
+    // FNV-1a over the 6 MAC bytes
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < PEER_INDEX_MAC_LEN; i++) {
+        h ^= mac[i];
+        h *= 16777619u;
+    }
+    return h & index->mask;
+}
+
+static int find_slot(const peer_index_t *index, const uint8_t *mac)
+{
+    uint32_t i = mac_hash(index, mac);
+
+    for (uint32_t n = 0; n <= index->mask; n++) {
+        if (index->slots[i].mac == NULL)
+            return -1;
+        if (memcmp(index->slots[i].mac, mac, PEER_INDEX_MAC_LEN) == 0)
+            return i;
+        i = (i + 1) & index->mask;
+    }
+    return -1;
+}
+
+void peer_index_init(peer_index_t *index, peer_index_entry_t *slots, uint32_t size)
+{
+    index->slots = slots;
+    index->mask = size - 1;
+    peer_index_clear(index);
+}
+
+void peer_index_clear(peer_index_t *index)
+{
+    memset(index->slots, 0, (index->mask + 1) * sizeof(index->slots[0]));
+}
+
+void *peer_index_find(const peer_index_t *index, const uint8_t *mac)
+{
+    int slot = find_slot(index, mac);
+    return (slot < 0) ? NULL : index->slots[slot].peer;
+}
+
+bool peer_index_insert(peer_index_t *index, const uint8_t *mac, void *peer)
+{
+    uint32_t i = mac_hash(index, mac);
+
+    for (uint32_t n = 0; n <= index->mask; n++) {
+        if (index->slots[i].mac == NULL) {
+            index->slots[i].mac = mac;
+            index->slots[i].peer = peer;
+            return true;
+        }
+        i = (i + 1) & index->mask;
+    }
+    return false;
+}
+
+void peer_index_remove(peer_index_t *index, const uint8_t *mac)
+{
+    peer_index_entry_t *slots = index->slots;
+    const uint32_t mask = index->mask;
+
+    int slot = find_slot(index, mac);
+    if (slot < 0)
+        return;
+
+    // Backward-shift deletion: pull later entries of the probe chain into the
+    // hole so lookups never need tombstones
+    uint32_t hole = slot;
+    uint32_t j = slot;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (slots[j].mac == NULL)
+            break;
+        uint32_t home = mac_hash(index, slots[j].mac);
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            slots[hole] = slots[j];
+            hole = j;
+        }
+    }
+    slots[hole].mac = NULL;
+    slots[hole].peer = NULL;
+}
@@ -0,0 +1,193 @@
+#include "stm_frame.h"
+
+#include <string.h>
+
+typedef enum {
+    ST_IDLE,
+    ST_TYPE,
+    ST_LEN,
+    ST_PAYLOAD,
+    ST_CRC_LO,
+    ST_CRC_HI,
+} stm_parser_state_t;
+
+/* Nibble table - small enough to keep in flash, fast enough for 100+ Hz */
+static const uint16_t crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+uint16_t stm_frame_crc16(uint16_t crc, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)((crc << 4) ^ crc16_nibble[((crc >> 12) ^ (data[i] >> 4)) & 0x0F]);
+        crc = (uint16_t)((crc << 4) ^ crc16_nibble[((crc >> 12) ^ (data[i] & 0x0F)) & 0x0F]);
+    }
+    return crc;
+}
+
+static inline uint16_t crc16_byte(uint16_t crc, uint8_t byte)
+{
+    return stm_frame_crc16(crc, &byte, 1);
+}
+
+void stm_frame_parser_init(stm_frame_parser_t *parser)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->state = ST_IDLE;
+}
+
+/* Parse again the bytes of a dropped frame, after its SOF, ahead of anything still queued */
+static void replay(stm_frame_parser_t *parser, const uint8_t *bytes, uint8_t len)
+{
+    // only a caller feeding without polling can overflow it: the newest bytes are lost
+    if (parser->replay_len > STM_FRAME_REPLAY_SIZE - len)
+        parser->replay_len = (uint8_t)(STM_FRAME_REPLAY_SIZE - len);
+    memmove(&parser->replay[len], &parser->replay[parser->replay_head], parser->replay_len);
+    memcpy(parser->replay, bytes, len);
+    parser->replay_head = 0;
+    parser->replay_len += len;
+}
+
+static stm_feed_result_t step(stm_frame_parser_t *parser, uint8_t byte)
+{
+    switch (parser->state)
+    {
+        case ST_IDLE:
+            if (byte != STM_FRAME_SOF) {
+                parser->byte = byte;
+                return STM_FEED_UNCLAIMED;
+            }
+            parser->crc = 0xFFFF;
+            parser->state = ST_TYPE;
+            return STM_FEED_CONSUMED;
+
+        case ST_TYPE:
+            parser->type = byte;
+            parser->crc = crc16_byte(parser->crc, byte);
+            parser->state = ST_LEN;
+            return STM_FEED_CONSUMED;
+
+        case ST_LEN:
+            if (byte > STM_FRAME_MAX_PAYLOAD) {
+                const uint8_t dropped[2] = { parser->type, byte };
+                parser->length_errors++;
+                parser->state = ST_IDLE;
+                replay(parser, dropped, sizeof(dropped));
+                return STM_FEED_ERROR;
+            }
+            parser->len = byte;
+            parser->idx = 0;
+            parser->crc = crc16_byte(parser->crc, byte);
+            parser->state = (byte == 0) ? ST_CRC_LO : ST_PAYLOAD;
+            return STM_FEED_CONSUMED;
+
+        case ST_PAYLOAD:
+            parser->payload[parser->idx++] = byte;
+            parser->crc = crc16_byte(parser->crc, byte);
+            if (parser->idx == parser->len)
+                parser->state = ST_CRC_LO;
+            return STM_FEED_CONSUMED;
+
+        case ST_CRC_LO:
+            parser->rx_crc = byte;
+            parser->state = ST_CRC_HI;
+            return STM_FEED_CONSUMED;
+
+        case ST_CRC_HI:
+            parser->rx_crc |= (uint16_t)byte << 8;
+            parser->state = ST_IDLE;
+            if (parser->rx_crc != parser->crc) {
+                uint8_t dropped[STM_FRAME_REPLAY_SIZE];
+                dropped[0] = parser->type;
+                dropped[1] = parser->len;
+                memcpy(&dropped[2], parser->payload, parser->len);
+                dropped[2 + parser->len] = (uint8_t)parser->rx_crc;
+                dropped[3 + parser->len] = byte;
+                parser->crc_errors++;
+                replay(parser, dropped, (uint8_t)(parser->len + 4));
+                return STM_FEED_ERROR;
+            }
+            parser->frames++;
+            return STM_FEED_FRAME;
+
+        default:
+            parser->state = ST_IDLE;
+            return STM_FEED_ERROR;
+    }
+}
+
+stm_feed_result_t stm_frame_feed(stm_frame_parser_t *parser, uint8_t byte)
+{
+    if (parser->replay_len == 0)
+        return step(parser, byte);
+
+    // the caller did not poll the replayed bytes first: queue behind them, if there is room
+    if (parser->replay_head + parser->replay_len == STM_FRAME_REPLAY_SIZE) {
+        memmove(parser->replay, &parser->replay[parser->replay_head], parser->replay_len);
+        parser->replay_head = 0;
+    }
+    if (parser->replay_len < STM_FRAME_REPLAY_SIZE)
+        parser->replay[parser->replay_head + parser->replay_len++] = byte;
+    return stm_frame_poll(parser);
+}
+
+stm_feed_result_t stm_frame_poll(stm_frame_parser_t *parser)
+{
+    while (parser->replay_len) {
+        uint8_t byte = parser->replay[parser->replay_head++];
+        parser->replay_len--;
+        stm_feed_result_t result = step(parser, byte);
+        if (result != STM_FEED_CONSUMED)
+            return result;
+    }
+    parser->replay_head = 0;
+    return STM_FEED_CONSUMED;
+}
+
+static inline int16_t get_i16(const uint8_t *p)
+{
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+bool stm_frame_decode_measurement(const uint8_t *payload, uint8_t len, stm_measurement_t *m)
+{
+    if (len < STM_MEASUREMENT_PAYLOAD_LEN)
+        return false;
+
+    m->temperature1         = get_i16(&payload[0]) / 100.0f;
+    m->temperature2         = get_i16(&payload[2]) / 100.0f;
+    m->voltage              = get_i16(&payload[4]) / 100.0f;
+    m->current              = get_i16(&payload[6]) / 1000.0f;
+    m->alert                = payload[8];
+    m->duty                 = get_u16(&payload[9]) / 10000.0f;
+    m->tuning               = payload[11];
+    m->low_vds_threshold    = payload[12];
+    m->low_vds              = payload[13];
+    // longer payloads (fields appended by newer STM firmware) are accepted
+
+    return true;
+}
+
+size_t stm_frame_encode(uint8_t type, const uint8_t *payload, uint8_t len, uint8_t *out, size_t out_len)
+{
+    if (len > STM_FRAME_MAX_PAYLOAD || out_len < (size_t)len + STM_FRAME_OVERHEAD)
+        return 0;
+
+    out[0] = STM_FRAME_SOF;
+    out[1] = type;
+    out[2] = len;
+    if (len)
+        memcpy(&out[3], payload, len);
+
+    uint16_t crc = stm_frame_crc16(0xFFFF, &out[1], (size_t)len + 2);
+    out[3 + len] = (uint8_t)crc;
+    out[4 + len] = (uint8_t)(crc >> 8);
+
+    return (size_t)len + STM_FRAME_OVERHEAD;
+}
@@ -0,0 +1,300 @@
+#include "stm_json.h"
+
+#include <string.h>
+
+typedef enum {
+    ST_IDLE,            // waiting for '{'
+    ST_KEY_OR_END,      // after '{' or ','
+    ST_KEY,             // inside "key"
+    ST_COLON,
+    ST_VALUE,
+    ST_NUMBER,
+    ST_SKIP_STRING,     // string value (ignored)
+    ST_SKIP_NESTED,     // object / array value (ignored)
+    ST_SKIP_LITERAL,    // true / false / null (ignored)
+    ST_AFTER_VALUE,
+} stm_json_state_t;
+
+typedef enum {
+    FIELD_FLOAT,
+    FIELD_U8,
+    FIELD_U16,
+} field_type_t;
+
+/* Same order as stm_json_key_t - offsets are relative to the parser */
+static const struct {
+    const char      *key;
+    size_t          offset;
+    field_type_t    type;
+} known_fields[] = {
+    { "temperature1",       offsetof(stm_json_parser_t, m.temperature1),        FIELD_FLOAT },
+    { "temperature2",       offsetof(stm_json_parser_t, m.temperature2),        FIELD_FLOAT },
+    { "voltage",            offsetof(stm_json_parser_t, m.voltage),             FIELD_FLOAT },
+    { "current",            offsetof(stm_json_parser_t, m.current),             FIELD_FLOAT },
+    { "alert",              offsetof(stm_json_parser_t, m.alert),               FIELD_U8 },
+    { "duty",               offsetof(stm_json_parser_t, m.duty),                FIELD_FLOAT },
+    { "tuning",             offsetof(stm_json_parser_t, m.tuning),              FIELD_U8 },
+    { "low_vds_threshold",  offsetof(stm_json_parser_t, m.low_vds_threshold),   FIELD_U8 },
+    { "low_vds",            offsetof(stm_json_parser_t, m.low_vds),             FIELD_U8 },
+    { "ack",                offsetof(stm_json_parser_t, ack),                   FIELD_U16 },
+};
+
+#define KNOWN_FIELDS    (sizeof(known_fields) / sizeof(known_fields[0]))
+
+static inline bool is_space(uint8_t c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool is_number_char(uint8_t c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+/* Decimal number without strtod (newlib's strtod may allocate) */
+static bool parse_number(const char *s, uint8_t len, float *out)
+{
+    uint8_t i = 0;
+    bool neg = false, digits = false;
+    double value = 0.0;
+
+    if (i < len && (s[i] == '-' || s[i] == '+'))
+        neg = (s[i++] == '-');
+
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+        value = value * 10.0 + (s[i] - '0');
+        digits = true;
+    }
+
+    if (i < len && s[i] == '.') {
+        double scale = 0.1;
+        for (i++; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+            value += (s[i] - '0') * scale;
+            scale *= 0.1;
+            digits = true;
+        }
+    }
+
+    if (!digits)
+        return false;
+
+    if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+        bool exp_neg = false;
+        int exp = 0;
+        i++;
+        if (i < len && (s[i] == '-' || s[i] == '+'))
+            exp_neg = (s[i++] == '-');
+        if (i >= len)
+            return false;
+        for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+            if (exp < 64)
+                exp = exp * 10 + (s[i] - '0');
+        }
+        while (exp--)
+            value = exp_neg ? value / 10.0 : value * 10.0;
+    }
+
+    if (i != len)
+        return false;
+
+    *out = (float)(neg ? -value : value);
+    return true;
+}
+
+static int8_t lookup_field(const char *key, uint8_t len)
+{
+    for (size_t i = 0; i < KNOWN_FIELDS; i++) {
+        if (strlen(known_fields[i].key) == len && memcmp(known_fields[i].key, key, len) == 0)
+            return (int8_t)i;
+    }
+    return -1;
+}
+
+static bool commit_number(stm_json_parser_t *parser)
+{
+    float value;
+
+    if (!parse_number(parser->num, parser->num_len, &value))
+        return false;
+
+    if (parser->field >= 0) {
+        uint8_t *dst = (uint8_t *)parser + known_fields[parser->field].offset;
+        if (known_fields[parser->field].type == FIELD_FLOAT) {
+            memcpy(dst, &value, sizeof(value));
+        } else if (known_fields[parser->field].type == FIELD_U16) {
+            uint16_t v = (uint16_t)(int32_t)value;
+            memcpy(dst, &v, sizeof(v));
+        } else {
+            *dst = (uint8_t)(int)value;
+        }
+        parser->present |= (uint16_t)(1u << parser->field);
+    }
+    return true;
+}
+
+static void start_object(stm_json_parser_t *parser)
+{
+    memset(&parser->m, 0, sizeof(parser->m));
+    parser->ack = 0;
+    parser->present = 0;
+    parser->state = ST_KEY_OR_END;
+}
+
+static stm_json_result_t fail(stm_json_parser_t *parser, uint8_t c)
+{
+    parser->errors++;
+    parser->state = ST_IDLE;
+    // a '{' may well be the start of the next object
+    if (c == '{')
+        start_object(parser);
+    return STM_JSON_ERROR;
+}
+
+static stm_json_result_t end_object(stm_json_parser_t *parser)
+{
+    parser->state = ST_IDLE;
+    parser->objects++;
+    return STM_JSON_OBJECT;
+}
+
+void stm_json_parser_init(stm_json_parser_t *parser)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->state = ST_IDLE;
+    parser->field = -1;
+}
+
+stm_json_result_t stm_json_feed(stm_json_parser_t *parser, uint8_t c)
+{
+    switch (parser->state)
+    {
+        case ST_IDLE:
+            if (c == '{')
+                start_object(parser);
+            return STM_JSON_PENDING;
+
+        case ST_KEY_OR_END:
+            if (is_space(c))
+                return STM_JSON_PENDING;
+            if (c == '}')
+                return end_object(parser);
+            if (c != '"')
+                return fail(parser, c);
+            parser->key_len = 0;
+            parser->escape = false;
+            parser->state = ST_KEY;
+            return STM_JSON_PENDING;
+
+        case ST_KEY:
+            if (parser->escape) {
+                parser->escape = false;
+            } else if (c == '\\') {
+                parser->escape = true;
+                return STM_JSON_PENDING;
+            } else if (c == '{') {
+                // keys never hold a brace: the line was cut, this starts the next object
+                return fail(parser, c);
+            } else if (c == '"') {
+                parser->field = (parser->key_len <= STM_JSON_MAX_TOKEN) ? lookup_field(parser->key, parser->key_len) : -1;
+                parser->state = ST_COLON;
+                return STM_JSON_PENDING;
+            }
+            // keys longer than any known key are kept as "unknown"
+            if (parser->key_len < STM_JSON_MAX_TOKEN)
+                parser->key[parser->key_len] = (char)c;
+            if (parser->key_len <= STM_JSON_MAX_TOKEN)
+                parser->key_len++;
+            return STM_JSON_PENDING;
+
+        case ST_COLON:
+            if (is_space(c))
+                return STM_JSON_PENDING;
+            if (c != ':')
+                return fail(parser, c);
+            parser->state = ST_VALUE;
+            return STM_JSON_PENDING;
+
+        case ST_VALUE:
+            if (is_space(c))
+                return STM_JSON_PENDING;
+            if (is_number_char(c)) {
+                parser->num[0] = (char)c;
+                parser->num_len = 1;
+                parser->state = ST_NUMBER;
+            } else if (c == '"') {
+                parser->escape = false;
+                parser->state = ST_SKIP_STRING;
+            } else if (c == '{' || c == '[') {
+                parser->nested = 1;
+                parser->escape = false;
+                parser->in_string = false;
+                parser->state = ST_SKIP_NESTED;
+            } else if (c == 't' || c == 'f' || c == 'n') {
+                parser->state = ST_SKIP_LITERAL;
+            } else {
+                return fail(parser, c);
+            }
+            return STM_JSON_PENDING;
+
+        case ST_NUMBER:
+            if (is_number_char(c)) {
+                if (parser->num_len >= STM_JSON_MAX_TOKEN)
+                    return fail(parser, c);
+                parser->num[parser->num_len++] = (char)c;
+                return STM_JSON_PENDING;
+            }
+            if (!commit_number(parser))
+                return fail(parser, c);
+            parser->state = ST_AFTER_VALUE;
+            return stm_json_feed(parser, c);
+
+        case ST_SKIP_STRING:
+            if (parser->escape)
+                parser->escape = false;
+            else if (c == '\\')
+                parser->escape = true;
+            else if (c == '"')
+                parser->state = ST_AFTER_VALUE;
+            return STM_JSON_PENDING;
+
+        case ST_SKIP_NESTED:
+            // strings inside the nested value may contain brackets
+            if (parser->escape) {
+                parser->escape = false;
+            } else if (parser->in_string) {
+                if (c == '\\')
+                    parser->escape = true;
+                else if (c == '"')
+                    parser->in_string = false;
+            } else if (c == '"') {
+                parser->in_string = true;
+            } else if (c == '{' || c == '[') {
+                if (++parser->nested == 0)
+                    return fail(parser, c);
+            } else if (c == '}' || c == ']') {
+                if (--parser->nested == 0)
+                    parser->state = ST_AFTER_VALUE;
+            }
+            return STM_JSON_PENDING;
+
+        case ST_SKIP_LITERAL:
+            if (c >= 'a' && c <= 'z')
+                return STM_JSON_PENDING;
+            parser->state = ST_AFTER_VALUE;
+            return stm_json_feed(parser, c);
+
+        case ST_AFTER_VALUE:
+            if (is_space(c))
+                return STM_JSON_PENDING;
+            if (c == ',') {
+                parser->state = ST_KEY_OR_END;
+                return STM_JSON_PENDING;
+            }
+            if (c == '}')
+                return end_object(parser);
+            return fail(parser, c);
+
+        default:
+            return fail(parser, c);
+    }
+}
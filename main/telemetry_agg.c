@@ -0,0 +1,140 @@
+#include "telemetry_agg.h"
+
+#include <math.h>
+#include <string.h>
+
+#define MS_PER_HOUR     3600000.0f
+
+static void stat_reset(telemetry_agg_stat_t *st)
+{
+    memset(st, 0, sizeof(*st));
+}
+
+static void stat_add(telemetry_agg_stat_t *st, float v)
+{
+    if (isnan(v))
+        return;
+
+    if (st->count == 0 || v < st->min)
+        st->min = v;
+    if (st->count == 0 || v > st->max)
+        st->max = v;
+    st->sum += v;
+    st->last = v;
+    st->count++;
+}
+
+/* Fold a later window into an earlier one */
+static void stat_merge(telemetry_agg_stat_t *into, const telemetry_agg_stat_t *from)
+{
+    if (from->count == 0)
+        return;
+    if (into->count == 0) {
+        *into = *from;
+        return;
+    }
+
+    if (from->min < into->min)
+        into->min = from->min;
+    if (from->max > into->max)
+        into->max = from->max;
+    into->sum += from->sum;
+    into->last = from->last;
+    into->count += from->count;
+}
+
+static void window_reset(telemetry_agg_window_t *w)
+{
+    w->start_ms = w->end_ms = 0;
+    w->samples = 0;
+    for (int i = 0; i < TELEMETRY_AGG_FIELDS; i++) {
+        stat_reset(&w->tx[i]);
+        stat_reset(&w->rx[i]);
+    }
+    w->tx_wh = w->rx_wh = 0.0f;
+}
+
+/* Trapezoid between the previous and the current power, 0 across a hole or a NaN */
+static float interval_wh(float w0, float w1, uint32_t dt_ms)
+{
+    if (isnan(w0) || isnan(w1))
+        return 0.0f;
+    return (w0 + w1) * 0.5f * (float)dt_ms / MS_PER_HOUR;
+}
+
+void telemetry_agg_init(telemetry_agg_t *a, uint32_t window_ms, uint32_t max_gap_ms)
+{
+    memset(a, 0, sizeof(*a));
+    a->window_ms = window_ms;
+    a->max_gap_ms = max_gap_ms;
+    window_reset(&a->current);
+    window_reset(&a->closed);
+}
+
+void telemetry_agg_add(telemetry_agg_t *a, const telemetry_agg_sample_t *s, uint32_t now_ms)
+{
+    telemetry_agg_window_t *w = &a->current;
+    float tx_w = s->tx[TELEMETRY_AGG_VOLTAGE] * s->tx[TELEMETRY_AGG_CURRENT];
+    float rx_w = s->rx[TELEMETRY_AGG_VOLTAGE] * s->rx[TELEMETRY_AGG_CURRENT];
+
+    if (w->samples == 0)
+        w->start_ms = now_ms;
+    w->end_ms = now_ms;
+    w->samples++;
+
+    for (int i = 0; i < TELEMETRY_AGG_FIELDS; i++) {
+        stat_add(&w->tx[i], s->tx[i]);
+        stat_add(&w->rx[i], s->rx[i]);
+    }
+
+    // the interval since the previous sample belongs to the window of its end
+    uint32_t dt = now_ms - a->last_ms;
+    if (a->has_last && dt <= a->max_gap_ms) {
+        w->tx_wh += interval_wh(a->tx_w, tx_w, dt);
+        w->rx_wh += interval_wh(a->rx_w, rx_w, dt);
+    }
+
+    a->has_last = true;
+    a->last_ms = now_ms;
+    a->tx_w = tx_w;
+    a->rx_w = rx_w;
+}
+
+bool telemetry_agg_close(telemetry_agg_t *a, uint32_t now_ms)
+{
+    telemetry_agg_window_t *w = &a->current;
+
+    if (w->samples > 0 && now_ms - w->start_ms >= a->window_ms) {
+        if (!a->closed_ready) {
+            a->closed = *w;
+            a->closed_ready = true;
+        } else {
+            telemetry_agg_window_t *c = &a->closed;
+            for (int i = 0; i < TELEMETRY_AGG_FIELDS; i++) {
+                stat_merge(&c->tx[i], &w->tx[i]);
+                stat_merge(&c->rx[i], &w->rx[i]);
+            }
+            c->end_ms = w->end_ms;
+            c->samples += w->samples;
+            c->tx_wh += w->tx_wh;
+            c->rx_wh += w->rx_wh;
+            a->merged++;
+        }
+        window_reset(w);
+    }
+
+    return a->closed_ready;
+}
+
+void telemetry_agg_release(telemetry_agg_t *a)
+{
+    a->closed_ready = false;
+    window_reset(&a->closed);
+}
+
+float telemetry_agg_mean(const telemetry_agg_stat_t *st)
+{
+    if (st->count == 0)
+        return NAN;
+    return st->sum / (float)st->count;
+}
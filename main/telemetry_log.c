@@ -0,0 +1,243 @@
+#include "telemetry_log.h"
+#include "stm_frame.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define CRC_LEN     offsetof(telemetry_record_t, state)
+
+typedef enum {
+    SLOT_ERASED = 0,
+    SLOT_VALID,
+    SLOT_CORRUPT,               // torn write or bit rot
+} slot_t;
+
+static uint16_t record_crc(const telemetry_record_t *r)
+{
+    return stm_frame_crc16(0xFFFF, (const uint8_t *)r, CRC_LEN);
+}
+
+// records never straddle a sector, the end of each sector is left unused
+static uint32_t slot_offset(uint32_t slot)
+{
+    return (slot / TELEMETRY_LOG_SLOTS) * TELEMETRY_LOG_SECTOR_SIZE +
+           (slot % TELEMETRY_LOG_SLOTS) * TELEMETRY_LOG_RECORD_SIZE;
+}
+
+static slot_t read_slot(telemetry_log_t *log, uint32_t slot, telemetry_record_t *r)
+{
+    if (!log->io.read(log->ctx, slot_offset(slot), r, sizeof(*r))) {
+        log->stats.io_errors++;
+        return SLOT_CORRUPT;
+    }
+
+    const uint8_t *p = (const uint8_t *)r;
+    bool erased = true;
+    for (uint32_t i = 0; i < sizeof(*r) && erased; i++)
+        erased = (p[i] == 0xFF);
+    if (erased)
+        return SLOT_ERASED;
+
+    return record_crc(r) == r->crc ? SLOT_VALID : SLOT_CORRUPT;
+}
+
+static uint32_t wrap(const telemetry_log_t *log, uint32_t slot)
+{
+    return slot % log->slots;
+}
+
+bool telemetry_log_mount(telemetry_log_t *log, const telemetry_log_io_t *io, void *ctx, uint32_t size)
+{
+    memset(log, 0, sizeof(*log));
+    log->io = *io;
+    log->ctx = ctx;
+
+    uint32_t sectors = size / TELEMETRY_LOG_SECTOR_SIZE;
+    if (sectors < 2)
+        return false;
+    log->slots = sectors * TELEMETRY_LOG_SLOTS;
+
+    // newest sector: the valid first record with the highest sequence
+    telemetry_record_t r;
+    bool found = false;
+    uint32_t newest = 0, newest_seq = 0;
+    for (uint32_t s = 0; s < sectors; s++) {
+        if (read_slot(log, s * TELEMETRY_LOG_SLOTS, &r) != SLOT_VALID)
+            continue;
+        if (!found || r.seq > newest_seq) {
+            found = true;
+            newest = s;
+            newest_seq = r.seq;
+        }
+    }
+    if (!found)
+        return log->stats.io_errors == 0;      // empty log, head and tail at slot 0
+
+    // write position: after the last written slot of the newest sector
+    uint32_t first = newest * TELEMETRY_LOG_SLOTS;
+    uint32_t last = first;
+    for (uint32_t i = 0; i < TELEMETRY_LOG_SLOTS; i++) {
+        slot_t st = read_slot(log, first + i, &r);
+        if (st == SLOT_ERASED)
+            continue;
+        last = first + i;
+        if (st == SLOT_VALID && r.seq >= newest_seq) {
+            newest_seq = r.seq;
+            log->boot = r.boot;
+        }
+    }
+    log->head = wrap(log, last + 1);
+    log->next_seq = newest_seq + 1;
+    log->boot++;
+
+    // oldest sector: the first written one after the newest
+    uint32_t oldest = newest;
+    for (uint32_t i = 1; i < sectors; i++) {
+        uint32_t s = (newest + i) % sectors;
+        if (read_slot(log, s * TELEMETRY_LOG_SLOTS, &r) != SLOT_ERASED) {
+            oldest = s;
+            break;
+        }
+    }
+
+    // replayed records form a prefix: the tail is the first record still pending
+    log->tail = log->head;
+    bool pending = false;
+    for (uint32_t i = 0; i < sectors; i++) {
+        uint32_t s = (oldest + i) % sectors;
+        uint32_t base = s * TELEMETRY_LOG_SLOTS;
+        uint32_t end = (s == newest) ? last - base + 1 : TELEMETRY_LOG_SLOTS;
+
+        // a full sector replayed up to its last record is skipped in one read
+        if (s != newest && read_slot(log, base + end - 1, &r) == SLOT_VALID &&
+            r.state == TELEMETRY_STATE_REPLAYED)
+            continue;
+
+        for (uint32_t j = 0; j < end && !pending; j++) {
+            if (read_slot(log, base + j, &r) == SLOT_VALID && r.state == TELEMETRY_STATE_PENDING) {
+                log->tail = base + j;
+                pending = true;
+            }
+        }
+        if (pending)
+            break;
+        if (s == newest)
+            break;
+    }
+    log->pending = wrap(log, log->head + log->slots - log->tail);
+    if (pending && log->pending == 0)
+        log->pending = log->slots;      // full, the tail is where the head wraps to
+
+    return true;
+}
+
+bool telemetry_log_append(telemetry_log_t *log, const telemetry_record_t *record)
+{
+    // entering a sector: erase it, dropping what it still holds
+    if (log->head % TELEMETRY_LOG_SLOTS == 0) {
+        uint32_t sector_end = log->head + TELEMETRY_LOG_SLOTS;
+        if (log->pending > 0 && log->tail >= log->head && log->tail < sector_end) {
+            uint32_t lost = sector_end - log->tail;
+            log->stats.dropped += lost;
+            log->pending -= lost;
+            log->tail = wrap(log, sector_end);
+        }
+        if (!log->io.erase(log->ctx, slot_offset(log->head), TELEMETRY_LOG_SECTOR_SIZE)) {
+            log->stats.io_errors++;
+            return false;
+        }
+    }
+
+    telemetry_record_t r = *record;
+    r.seq = log->next_seq;
+    r.boot = log->boot;
+    r.state = TELEMETRY_STATE_PENDING;
+    r.crc = record_crc(&r);
+
+    // the slot is used even if the write fails: it may be half written
+    bool ok = log->io.write(log->ctx, slot_offset(log->head), &r, sizeof(r));
+    if (log->pending == 0)
+        log->tail = log->head;
+    log->head = wrap(log, log->head + 1);
+    log->pending++;
+    log->next_seq++;
+
+    if (!ok) {
+        log->stats.io_errors++;
+        return false;
+    }
+    log->stats.recorded++;
+    return true;
+}
+
+uint32_t telemetry_log_peek(telemetry_log_t *log, telemetry_record_t *records, uint32_t max, uint32_t *slots)
+{
+    uint32_t count = 0, used = 0;
+
+    while (count < max && used < log->pending) {
+        slot_t st = read_slot(log, wrap(log, log->tail + used), &records[count]);
+        used++;
+        if (st == SLOT_VALID && records[count].state == TELEMETRY_STATE_PENDING)
+            count++;
+    }
+
+    *slots = used;
+    return count;
+}
+
+void telemetry_log_consume(telemetry_log_t *log, uint32_t slots, uint32_t count)
+{
+    const uint8_t replayed = TELEMETRY_STATE_REPLAYED;
+
+    if (slots > log->pending)
+        slots = log->pending;
+    if (count > slots)
+        count = slots;
+
+    // corrupt slots are marked too, a remount then skips them with the rest
+    for (uint32_t i = 0; i < slots; i++) {
+        uint32_t slot = wrap(log, log->tail + i);
+        if (!log->io.write(log->ctx, slot_offset(slot) + offsetof(telemetry_record_t, state), &replayed, 1))
+            log->stats.io_errors++;
+    }
+
+    log->stats.replayed += count;
+    log->stats.corrupt += slots - count;
+    log->tail = wrap(log, log->tail + slots);
+    log->pending -= slots;
+}
+
+uint32_t telemetry_log_backlog(const telemetry_log_t *log)
+{
+    return log->pending;
+}
+
+telemetry_age_t telemetry_log_age(const telemetry_log_t *log, const telemetry_record_t *record,
+                                  uint32_t now_ms, uint64_t epoch_ms, uint32_t *age_ms)
+{
+    if (record->boot == log->boot) {
+        *age_ms = now_ms - record->uptime_ms;
+        return TELEMETRY_AGE_KNOWN;
+    }
+    if (record->epoch_ms == 0)
+        return TELEMETRY_AGE_UNKNOWN;
+    if (epoch_ms == 0)
+        return TELEMETRY_AGE_NO_CLOCK;
+
+    // a clock stepped back by SNTP makes the sample look newer than now
+    uint64_t age = epoch_ms > record->epoch_ms ? epoch_ms - record->epoch_ms : 0;
+    *age_ms = age > UINT32_MAX ? UINT32_MAX : (uint32_t)age;
+    return TELEMETRY_AGE_KNOWN;
+}
+
+int16_t telemetry_log_fixed(float value, float unit)
+{
+    float scaled = value / unit;
+    if (!(scaled == scaled))
+        return 0;               // NaN
+    if (scaled >= INT16_MAX)
+        return INT16_MAX;
+    if (scaled <= INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)(scaled + (scaled >= 0 ? 0.5f : -0.5f));
+}
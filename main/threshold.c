@@ -0,0 +1,29 @@
+#include "threshold.h"
+
+#include <stddef.h>
+
+void threshold_init(threshold_t *t, float hysteresis, uint8_t debounce)
+{
+    t->hysteresis = hysteresis < 0 ? 0 : hysteresis;
+    t->debounce = debounce ? debounce : 1;
+    t->active = false;
+    t->count = 0;
+}
+
+threshold_event_t threshold_update(threshold_t *t, float value, float limit)
+{
+    // comparisons with NaN are false on both sides
+    const bool against = t->active ? (value < limit - t->hysteresis) : (value > limit);
+
+    if (!against) {
+        t->count = 0;
+        return THRESHOLD_NO_CHANGE;
+    }
+
+    if (++t->count < t->debounce)
+        return THRESHOLD_NO_CHANGE;
+
+    t->count = 0;
+    t->active = !t->active;
+    return t->active ? THRESHOLD_RAISED : THRESHOLD_CLEARED;
+}
@@ -1,4 +1,5 @@
 #include "wifiMesh.h"
+#include "espnow_window.h"
 
 /*******************************************************
  *                Variable Definitions
@@ -10,21 +11,83 @@ static bool is_mesh_connected = false;
 static int mesh_level = -1;
 static bool gotIP = false;
 
-// Send semaphore to avoid concurrent access to RF resources
+// Counting semaphore of free send slots (global in-flight limit)
 static SemaphoreHandle_t send_semaphore = NULL;
-// ESP-NOW messages queue
+// ESP-NOW send window - frames stay in their slot until acked or given up (espnow_window.h, under espnow_tx_lock)
+static espnow_window_t espnow_tx_window;
+static espnow_data_t espnow_tx_frames[ESPNOW_MAX_IN_FLIGHT];
+_Static_assert(ESPNOW_MAX_IN_FLIGHT <= ESPNOW_WINDOW_MAX_SLOTS, "ESPNOW_MAX_IN_FLIGHT exceeds the send window");
+static espnow_tx_stats_t espnow_tx_stats = {0};
+static portMUX_TYPE espnow_tx_lock = portMUX_INITIALIZER_UNLOCKED;
+// ESP-NOW send-callback events queue
 static QueueHandle_t espnow_queue;
-// ESP-NOW payload structure
-static espnow_data_t *espnow_data;
-// ESP-NOW Retrasmissions variable
+static TaskHandle_t espnow_task_handle = NULL;
+// ESP-NOW receive rings, one per priority lane - single producer (WiFi task) / single consumer (espnow_task)
+typedef struct {
+    espnow_rx_frame_t frames[ESPNOW_RX_RING_SIZE];
+    uint32_t head;      // written by producer only
+    uint32_t tail;      // written by consumer only
+} espnow_rx_ring_t;
+static espnow_rx_ring_t espnow_rx_lanes[ESPNOW_LANE_MAX];
+static espnow_rx_stats_t espnow_rx_stats = {0};
+// Sends espnow_task could not do without waiting for a slot, in order (espnow_task only)
+typedef struct {
+    uint8_t type;                       // espnow_message_type
+    bool then_encrypt;                  // handshake: encrypt the peer ESPNOW_HANDSHAKE_ENCRYPT_MS after the send
+    bool then_delete;                   // RX left: delete the peer once the frame is acked or given up
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN];
+} espnow_deferred_send_t;
+static espnow_deferred_send_t espnow_deferred[ESPNOW_DEFERRED_MAX];
+static uint8_t espnow_deferred_count = 0;
+// Handshakes waiting to encrypt their peer (espnow_task only)
+typedef struct {
+    bool used;
+    uint8_t mac_addr[ESP_NOW_ETH_ALEN];
+    int64_t due_us;
+} espnow_pending_encrypt_t;
+static espnow_pending_encrypt_t espnow_pending_encrypt[ESPNOW_DEFERRED_MAX];
+// Peers deleted once no frame towards them is in flight any more (espnow_task only)
+static uint8_t espnow_pending_delete[ESPNOW_DEFERRED_MAX][ESP_NOW_ETH_ALEN];
+static uint8_t espnow_pending_delete_count = 0;
+// ESP-NOW consecutive failures (restart above MAX_COMMS_ERROR)
 static uint8_t comms_fail = 0;
-static espnow_message_type last_msg_type;
 static bool staticSent = false;
 
 //Mesh Lite self payloads
 static mesh_localization_payload_t my_localization_payload;
 static mesh_control_payload_t my_control_payload;
 
+// Binary codec state (child side) - buffers must outlive the send for mesh-lite retries
+static uint8_t root_codec_version = MESH_CODEC_LEGACY_VERSION;
+static uint8_t my_codec_version = MESH_CODEC_VERSION;
+static uint8_t codec_dynamic_buf[MESH_CODEC_DYNAMIC_MAX_LEN];
+static uint8_t codec_alert_buf[MESH_CODEC_ALERT_MAX_LEN];
+static mesh_dynamic_payload_t codec_last_dynamic;
+static uint8_t codec_frames_since_full = MESH_CODEC_FULL_INTERVAL; // first frame is full
+static uint8_t codec_dynamic_seq = 0;
+static uint8_t codec_alert_seq = 0;
+
+// Parallel localization - root: scheduler and claim window, pad: last claim sent
+static loc_scheduler_t loc_scheduler;
+static loc_claims_t loc_claims;
+static loc_claims_t loc_reports;        // RSSI of the RX broadcasts at the pads not energized
+static bool loc_window_open = false;
+static bool loc_hint_active = false;    // the window waits for the claim of loc_hint only
+static loc_assignment_t loc_hint;
+static bool loc_energized = true;       // pads may be left in LOCALIZATION (unknown at boot)
+static portMUX_TYPE loc_lock = portMUX_INITIALIZER_UNLOCKED;
+static const loc_adjacency_t loc_adjacent_pairs[] = LOCALIZATION_ADJACENT_PAIRS;
+static mesh_loc_group_payload_t my_loc_group_payload;
+static mesh_loc_grant_payload_t my_loc_grant_payload;
+static mesh_loc_claim_payload_t my_loc_claim_payload;
+static int64_t my_loc_claim_us = 0;
+static mesh_loc_claim_payload_t my_loc_report_payload;
+static int64_t my_loc_report_us = 0;
+
+// Dead battery probing - root: idle pads split in non-adjacent groups, served round robin
+static loc_scheduler_t probe_scheduler;
+static mesh_loc_group_payload_t my_probe_payload;
+
 // Broadcast MAC address
 static uint8_t broadcast_mac[ETH_HWADDR_LEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 static uint8_t TX_parent_mac[ETH_HWADDR_LEN] = {0};
@@ -32,6 +95,10 @@ static uint8_t TX_parent_mac[ETH_HWADDR_LEN] = {0};
 // Declarations
 static void espnow_send_message(espnow_message_type mdgType, uint8_t* mac_addr);
 static void espnow_delete(uint8_t* mac_addr);
+static void espnow_defer_send(espnow_message_type mdgType, const uint8_t *mac_addr, bool then_encrypt, bool then_delete);
+static void espnow_tx_slot_release(int slot);
+static void espnow_tx_slot_drop_failed(const espnow_event_send_cb_t *send_cb);
+static void espnow_post_handshake(const uint8_t *rx_mac);
 
 /*******************************************************
  *                Function Definitions
@@ -175,18 +242,8 @@ static esp_err_t dynamic_to_root_raw_msg_process(uint8_t *data, uint32_t len,
     mesh_dynamic_payload_t *received_payload = (mesh_dynamic_payload_t *)data;
     //ESP_LOGI(TAG, "Received dynamic payload from MAC: "MACSTR,  MAC2STR(received_payload->TX.macAddr));
 
-    struct TX_peer *p = TX_peer_find_by_mac(received_payload->TX.macAddr);
-    if (p != NULL)
-    {
-        *p->dynamic_payload = *received_payload;
-        //ESP_LOGI(TAG, "TX Peer ID %d dynamic payload updated", p->id);
-        // show data
-        
-        /*ESP_LOGI(TAG, "TX: Voltage: %.2f V, Current: %.2f A, Temp1: %.2f C, Temp2: %.2f C \n\
-                        RX: Voltage: %.2f V, Current: %.2f A, Temp1: %.2f C, Temp2: %.2f C",
-                 p->dynamic_payload->TX.voltage, p->dynamic_payload->TX.current, p->dynamic_payload->TX.temp1, p->dynamic_payload->TX.temp2,
-                p->dynamic_payload->RX.voltage, p->dynamic_payload->RX.current, p->dynamic_payload->RX.temp1, p->dynamic_payload->RX.temp2);*/
-    }
+    // copied under TX_peers_mutex, a snapshot never sees half a payload
+    TX_peer_store_dynamic(received_payload->TX.macAddr, received_payload);
 
     return ESP_OK;
 }
@@ -224,20 +281,117 @@ static esp_err_t alert_to_root_raw_msg_process(uint8_t *data, uint32_t len,
     mesh_alert_payload_t *received_payload = (mesh_alert_payload_t *)data;
     //ESP_LOGI(TAG, "Received alert payload from MAC: "MACSTR,  MAC2STR(received_payload->TX.macAddr));
 
-    struct TX_peer *p = TX_peer_find_by_mac(received_payload->TX.macAddr);
-    if (p != NULL)
-    {
-        *p->alert_payload = *received_payload;
-        //ESP_LOGI(TAG, "TX Peer ID %d alert payload received - tx %d rx %d", p->id, p->alert_payload->TX.TX_all_flags, p->alert_payload->RX.RX_all_flags);
-        // show data
-        //ESP_LOGI(TAG, "TX: OV %d, OC %d, OT %d, FOD %d \n RX: OV: %d, OC %d, OT %d FC %d",
-        //    p->alert_payload->TX.TX_internal.overvoltage, p->alert_payload->TX.TX_internal.overcurrent, p->alert_payload->TX.TX_internal.overtemperature, p->alert_payload->TX.TX_internal.FOD,
-        //    p->alert_payload->RX.RX_internal.overvoltage, p->alert_payload->RX.RX_internal.overcurrent, p->alert_payload->RX.RX_internal.overtemperature, p->alert_payload->RX.RX_internal.FullyCharged);
-    
-        //handle alert payload (swith off command and reconnect) - done automatically inside the node
-        //TODO: update position?
+    //handle alert payload (swith off command and reconnect) - done automatically inside the node
+    //TODO: update position?
+    TX_peer_store_alert(received_payload->TX.macAddr, received_payload);
+
+    return ESP_OK;
+}
+
+// process response to capabilities raw message - inside child
+static esp_err_t caps_to_root_raw_msg_response_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    if (len < 1) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    // binary frames only with a root of the same major (it skips the fields of a newer minor)
+    root_codec_version = (MESH_CODEC_MAJOR(data[0]) == MESH_CODEC_VERSION_MAJOR) ? MESH_CODEC_VERSION : MESH_CODEC_LEGACY_VERSION;
+    codec_frames_since_full = MESH_CODEC_FULL_INTERVAL;
+    ESP_LOGI(TAG, "Root codec version %d - using %d", data[0], root_codec_version);
+
+    return ESP_OK;
+}
+
+// Process received capabilities raw messages - inside root
+static esp_err_t caps_to_root_raw_msg_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    if (len < 1) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    //ESP_LOGI(TAG, "Child codec version %d", data[0]);
+
+    *out_len = 1;
+    *out_data = malloc(*out_len);
+    if (*out_data == NULL)
+        return ESP_ERR_NO_MEM;
+    // a child of another major keeps the legacy structs (older children take the lower version)
+    (*out_data)[0] = (MESH_CODEC_MAJOR(data[0]) == MESH_CODEC_VERSION_MAJOR) ? MESH_CODEC_VERSION : MESH_CODEC_LEGACY_VERSION;
+
+    return ESP_OK;
+}
+
+// process response to binary dynamic raw message - inside child
+static esp_err_t dynamic_v2_to_root_raw_msg_response_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    // the root missed the base of a delta - next frame in full
+    if (len >= 1 && data[0] == MESH_CODEC_ACK_RESYNC)
+        codec_frames_since_full = MESH_CODEC_FULL_INTERVAL;
+
+    return ESP_OK;
+}
+
+// Process received binary dynamic raw messages - inside root
+static esp_err_t dynamic_v2_to_root_raw_msg_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    const uint8_t *mac = mesh_codec_frame_key(data, len, MESH_CODEC_KIND_DYNAMIC);
+    if (mac == NULL) {
+        ESP_LOGW(TAG, "Received invalid dynamic frame (%ld bytes)", len);
+        return ESP_FAIL;
+    }
+
+    uint8_t ack = MESH_CODEC_ACK_OK;
+    esp_err_t err = TX_peer_decode_dynamic(mac, data, len);
+    if (err == ESP_ERR_INVALID_STATE)
+        ack = MESH_CODEC_ACK_RESYNC;
+    else if (err != ESP_OK && err != ESP_ERR_NOT_FOUND)
+        return ESP_FAIL;
+
+    *out_len = 1;
+    *out_data = malloc(*out_len);
+    if (*out_data == NULL)
+        return ESP_ERR_NO_MEM;
+    (*out_data)[0] = ack;
+
+    return ESP_OK;
+}
+
+// process response to binary alert raw message - inside child
+static esp_err_t alert_v2_to_root_raw_msg_response_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    return ESP_OK;
+}
+
+// Process received binary alert raw messages - inside root
+static esp_err_t alert_v2_to_root_raw_msg_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    ESP_LOGW( TAG, "Process alert message");   
+
+    const uint8_t *mac = mesh_codec_frame_key(data, len, MESH_CODEC_KIND_ALERT);
+    if (mac == NULL) {
+        ESP_LOGW(TAG, "Received invalid alert frame (%ld bytes)", len);
+        return ESP_FAIL;
     }
 
+    esp_err_t err = TX_peer_decode_alert(mac, data, len);
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND)
+        return ESP_FAIL;
+
     return ESP_OK;
 }
 
@@ -282,6 +436,9 @@ static esp_err_t control_to_child_raw_msg_process(uint8_t *data, uint32_t len,
     if (command == TX_OFF)
     {
         //ESP_LOGI(TAG, "Received command to SWITCH OFF");
+        // a probed scooter stays powered through the localization sweeps (until the hold expires)
+        if (STM_probe_holding() && IS_BROADCAST_ADDR(received_payload->macAddr))
+            return ESP_OK;
         write_STM_command(TX_OFF);
     }
     else if (memcmp(received_payload->macAddr, self_mac, ETH_HWADDR_LEN) == 0)
@@ -302,6 +459,191 @@ static esp_err_t control_to_child_raw_msg_process(uint8_t *data, uint32_t len,
     return ESP_OK;
 }
 
+// Record a claim while the root has a claim window open
+static void loc_claim_record(const uint8_t *rx_mac, int8_t position, int8_t rssi)
+{
+    bool recorded = false;
+    bool hinted = false;
+
+    portENTER_CRITICAL(&loc_lock);
+    if (loc_window_open)
+    {
+        recorded = loc_claims_add(&loc_claims, rx_mac, position, rssi);
+        hinted = loc_hint_active && position == loc_hint.position;
+    }
+    else
+    {
+        // e.g. a pad holding a probed scooter - its RSSI still ranks it for the next step
+        loc_claims_add(&loc_reports, rx_mac, position, rssi);
+    }
+    portEXIT_CRITICAL(&loc_lock);
+
+    if (recorded)
+        ESP_LOGI(TAG, "Localization claim: RX "MACSTR" at pad %d, RSSI %d", MAC2STR(rx_mac), position, rssi);
+    // the ranked pad is the only one energized - no need to wait for the end of the window
+    if (hinted)
+        xEventGroupSetBits(eventGroupHandle, LOC_CLAIMBIT);
+}
+
+// Record the RSSI a pad (not energized) measured for an RX broadcast
+static void loc_report_record(const uint8_t *rx_mac, int8_t position, int8_t rssi)
+{
+    portENTER_CRITICAL(&loc_lock);
+    loc_claims_add(&loc_reports, rx_mac, position, rssi);
+    portEXIT_CRITICAL(&loc_lock);
+}
+
+// Process localization group raw messages - inside child
+static esp_err_t loc_group_to_child_raw_msg_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    if (UNIT_ROLE == RX)
+        return ESP_OK; // RX do not process control messages
+
+    mesh_loc_group_payload_t *received_payload = (mesh_loc_group_payload_t *)data;
+    if (len < 1 || received_payload->count > LOCALIZATION_GROUP_MAX ||
+        len < 1 + received_payload->count * ETH_HWADDR_LEN) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < received_payload->count; i++)
+    {
+        if (memcmp(received_payload->macAddr[i], self_mac, ETH_HWADDR_LEN) == 0)
+        {
+            write_STM_command(TX_LOCALIZATION);
+            break;
+        }
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t loc_group_to_child_raw_msg_response_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    return ESP_OK;
+}
+
+// Process localization claim raw messages - inside root
+static esp_err_t loc_claim_to_root_raw_msg_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    if (len != sizeof(mesh_loc_claim_payload_t)) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    mesh_loc_claim_payload_t *received_payload = (mesh_loc_claim_payload_t *)data;
+    loc_claim_record(received_payload->macAddr, (int8_t)received_payload->position, received_payload->rssi);
+
+    return ESP_OK;
+}
+
+static esp_err_t loc_claim_to_root_raw_msg_response_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    return ESP_OK;
+}
+
+// Process probe raw messages - inside child
+static esp_err_t probe_to_child_raw_msg_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    if (UNIT_ROLE == RX)
+        return ESP_OK; // RX do not process control messages
+
+    mesh_loc_group_payload_t *received_payload = (mesh_loc_group_payload_t *)data;
+    if (len < 1 || received_payload->count > LOCALIZATION_GROUP_MAX ||
+        len < 1 + received_payload->count * ETH_HWADDR_LEN) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < received_payload->count; i++)
+    {
+        if (memcmp(received_payload->macAddr[i], self_mac, ETH_HWADDR_LEN) == 0)
+        {
+            STM_probe();
+            break;
+        }
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t probe_to_child_raw_msg_response_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    return ESP_OK;
+}
+
+// Process localization RSSI report raw messages - inside root
+static esp_err_t loc_report_to_root_raw_msg_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    if (len != sizeof(mesh_loc_claim_payload_t)) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    mesh_loc_claim_payload_t *received_payload = (mesh_loc_claim_payload_t *)data;
+    loc_report_record(received_payload->macAddr, (int8_t)received_payload->position, received_payload->rssi);
+
+    return ESP_OK;
+}
+
+static esp_err_t loc_report_to_root_raw_msg_response_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    return ESP_OK;
+}
+
+// Process localization grant raw messages - inside child
+static esp_err_t loc_grant_to_child_raw_msg_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    if (UNIT_ROLE == RX)
+        return ESP_OK; // RX do not process control messages
+
+    mesh_loc_grant_payload_t *received_payload = (mesh_loc_grant_payload_t *)data;
+    if (len < 1 || received_payload->count > LOCALIZATION_GROUP_MAX ||
+        len < 1 + received_payload->count * 2 * ETH_HWADDR_LEN) {
+        ESP_LOGW(TAG, "Received unexpected message size: %ld", len);
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < received_payload->count; i++)
+    {
+        if (memcmp(received_payload->grant[i].padMac, self_mac, ETH_HWADDR_LEN) == 0)
+        {
+            ESP_LOGI(TAG, "RX has been located on this pad!");
+            write_STM_command(TX_DEPLOY);
+            // the ESP-NOW handshake waits, keep it out of the mesh-lite task
+            espnow_post_handshake(received_payload->grant[i].rxMac);
+            break;
+        }
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t loc_grant_to_child_raw_msg_response_process(uint8_t *data, uint32_t len, 
+                                     uint8_t **out_data, uint32_t* out_len, 
+                                     uint32_t seq) 
+{
+    return ESP_OK;
+}
+
 static esp_err_t localization_to_root_raw_msg_process_response(uint8_t *data, uint32_t len, 
                                      uint8_t **out_data, uint32_t* out_len, 
                                      uint32_t seq) 
@@ -340,7 +682,7 @@ static esp_err_t localization_to_root_raw_msg_process(uint8_t *data, uint32_t le
             ESP_LOGW(TAG, "Problem, RX was already localized - abort");
             return ESP_OK;
         }
-        p->position = received_payload->position;
+        RX_peer_set_position(p, received_payload->position);
         if (p->position)
             p->RX_status = RX_CHARGING;
         else 
@@ -451,16 +793,77 @@ static void send_control_message_to_child(uint8_t *data, size_t data_len)
     esp_mesh_lite_send_msg(ESP_MESH_LITE_RAW_MSG, &config);
 }
 
+// Send a localization message to every child (group / grant)
+static void send_loc_message_to_child(uint32_t msg_id, uint32_t resp_msg_id, uint8_t *data, size_t data_len) 
+{
+    esp_mesh_lite_msg_config_t config = {
+        .raw_msg = {
+            .msg_id = msg_id,
+            .expect_resp_msg_id = resp_msg_id,
+            .max_retry = 3,
+            .retry_interval = 10,
+            .data = data,
+            .size = data_len,
+            .raw_resend = esp_mesh_lite_send_broadcast_raw_msg_to_child,  // Send raw message to Child
+        },
+    };
+    
+    esp_mesh_lite_send_msg(ESP_MESH_LITE_RAW_MSG, &config);
+}
+
+// Send binary codec message to Root
+static void send_codec_message_to_root(uint32_t msg_id, uint32_t resp_msg_id, uint8_t *data, size_t data_len) 
+{
+    esp_mesh_lite_msg_config_t config = {
+        .raw_msg = {
+            .msg_id = msg_id,
+            .expect_resp_msg_id = resp_msg_id,
+            .max_retry = 3,
+            .retry_interval = 10,
+            .data = data,
+            .size = data_len,
+            .raw_resend = esp_mesh_lite_send_raw_msg_to_root,  // Send raw message to Root
+        },
+    };
+    
+    esp_mesh_lite_send_msg(ESP_MESH_LITE_RAW_MSG, &config);
+}
+
 //* High level sending functions
 
 static void send_alert_payload()
 {
-    send_alert_message_to_root((uint8_t*)&self_alert_payload, sizeof(mesh_alert_payload_t));
+    if (root_codec_version == MESH_CODEC_LEGACY_VERSION)
+    {
+        send_alert_message_to_root((uint8_t*)&self_alert_payload, sizeof(mesh_alert_payload_t));
+        return;
+    }
+
+    size_t len = mesh_codec_encode_alert(&self_alert_payload, ++codec_alert_seq, codec_alert_buf, sizeof(codec_alert_buf));
+    if (len)
+        send_codec_message_to_root(TO_ROOT_ALERT_V2_MSG_ID, TO_ROOT_ALERT_V2_MSG_ID_RESP, codec_alert_buf, len);
 }
 
 static void send_dynamic_payload()
 {
-    send_dynamic_message_to_root((uint8_t*)&self_dynamic_payload, sizeof(mesh_dynamic_payload_t));
+    if (root_codec_version == MESH_CODEC_LEGACY_VERSION)
+    {
+        send_dynamic_message_to_root((uint8_t*)&self_dynamic_payload, sizeof(mesh_dynamic_payload_t));
+        return;
+    }
+
+    // delta against the last frame sent (the root answers RESYNC if it missed it),
+    // with a periodic full frame as a backstop
+    bool full = (codec_frames_since_full >= MESH_CODEC_FULL_INTERVAL);
+    size_t len = mesh_codec_encode_dynamic(&self_dynamic_payload, full ? NULL : &codec_last_dynamic,
+                                           (uint8_t)(codec_dynamic_seq + 1), codec_dynamic_buf, sizeof(codec_dynamic_buf));
+    if (len == 0)
+        return;
+
+    codec_dynamic_seq++;
+    codec_last_dynamic = self_dynamic_payload;
+    codec_frames_since_full = full ? 1 : codec_frames_since_full + 1;
+    send_codec_message_to_root(TO_ROOT_DYNAMIC_V2_MSG_ID, TO_ROOT_DYNAMIC_V2_MSG_ID_RESP, codec_dynamic_buf, len);
 }
 
 static void send_localization_payload(uint8_t pos, uint8_t *mac)
@@ -470,6 +873,38 @@ static void send_localization_payload(uint8_t pos, uint8_t *mac)
     send_localization_message_to_root((uint8_t*)&my_localization_payload, sizeof(mesh_localization_payload_t));
 }
 
+static void send_loc_claim_payload(uint8_t *mac, int8_t rssi)
+{
+    // the RX keeps broadcasting while powered - one claim per RX and energized step is enough
+    int64_t now = esp_timer_get_time();
+    if (memcmp(my_loc_claim_payload.macAddr, mac, ETH_HWADDR_LEN) == 0 &&
+        (now - my_loc_claim_us) < (int64_t)LOCALIZATION_TIME_MS * 1000)
+        return;
+
+    my_loc_claim_payload.position = UNIT_ID;
+    my_loc_claim_payload.rssi = rssi;
+    memcpy(my_loc_claim_payload.macAddr, mac, ETH_HWADDR_LEN);
+    my_loc_claim_us = now;
+    send_codec_message_to_root(TO_ROOT_LOC_CLAIM_MSG_ID, TO_ROOT_LOC_CLAIM_MSG_ID_RESP, 
+                               (uint8_t*)&my_loc_claim_payload, sizeof(mesh_loc_claim_payload_t));
+}
+
+static void send_loc_report_payload(uint8_t *mac, int8_t rssi)
+{
+    // same rate as the claims, the root keeps the strongest RSSI anyway
+    int64_t now = esp_timer_get_time();
+    if (memcmp(my_loc_report_payload.macAddr, mac, ETH_HWADDR_LEN) == 0 &&
+        (now - my_loc_report_us) < (int64_t)LOCALIZATION_TIME_MS * 1000)
+        return;
+
+    my_loc_report_payload.position = UNIT_ID;
+    my_loc_report_payload.rssi = rssi;
+    memcpy(my_loc_report_payload.macAddr, mac, ETH_HWADDR_LEN);
+    my_loc_report_us = now;
+    send_codec_message_to_root(TO_ROOT_LOC_REPORT_MSG_ID, TO_ROOT_LOC_REPORT_MSG_ID_RESP, 
+                               (uint8_t*)&my_loc_report_payload, sizeof(mesh_loc_claim_payload_t));
+}
+
 static void send_control_payload(TX_status command, uint8_t *mac)
 {
     my_control_payload.command = (uint8_t)command;
@@ -480,6 +915,10 @@ static void send_control_payload(TX_status command, uint8_t *mac)
 static void send_static_payload(void)
 {
     send_static_message_to_root((uint8_t*)&self_static_payload, sizeof(mesh_static_payload_t));
+
+    // (new) root: fall back to legacy structs until it confirms the binary codec
+    root_codec_version = MESH_CODEC_LEGACY_VERSION;
+    send_codec_message_to_root(TO_ROOT_CAPS_MSG_ID, TO_ROOT_CAPS_MSG_ID_RESP, &my_codec_version, sizeof(my_codec_version));
 }
 
 //*esp-NOW functions
@@ -528,13 +967,12 @@ static void handle_peer_dynamic(espnow_data_t* data, uint8_t* mac)
             {
                 struct RX_peer* p = RX_peer_find_by_mac(mac);
                 if (p != NULL)
-                    p->position = 0;
+                    RX_peer_set_position(p, 0);
             }
             else
                 send_localization_payload(0, mac);
-            // advise RX
-            espnow_send_message(DATA_RX_LEFT, mac);
-            espnow_delete(mac);
+            // advise RX - the peer goes once the frame is acked or given up (runs in espnow_task, the send may be deferred)
+            espnow_defer_send(DATA_RX_LEFT, mac, false, true);
 
             //dynamic payload reset
             self_dynamic_payload.RX.id = 0;
@@ -545,7 +983,7 @@ static void handle_peer_dynamic(espnow_data_t* data, uint8_t* mac)
     }
 }
 
-static void handle_peer_alert(espnow_data_t* data, uint8_t* mac)
+static void handle_peer_alert(espnow_data_t* data, uint8_t* mac, int64_t rx_us)
 {
     ESP_LOGW(TAG, "Handle peer alert "MACSTR" ", MAC2STR(mac));
     
@@ -564,6 +1002,8 @@ static void handle_peer_alert(espnow_data_t* data, uint8_t* mac)
         self_dynamic_payload.RX.rx_status = RX_ALERT;
         self_dynamic_payload.TX.tx_status = TX_ALERT;
     }
+
+    self_alert_notify(rx_us);
 }
 
 uint8_t espnow_data_crc_control(uint8_t *data, uint16_t data_len)
@@ -596,9 +1036,6 @@ static void espnow_data_prepare(espnow_data_t *buf, espnow_message_type type)
     buf->id = UNIT_ID;
     buf->type = type;
 
-    // save last message type to allow retranmission
-    last_msg_type = type;
-
     switch (type)
     {
     case DATA_BROADCAST:
@@ -686,30 +1123,100 @@ static void esp_now_encrypt_peer(const uint8_t *peer_addr)
 }
 
 
+/* Alerts and RX-left notifications must never wait behind telemetry */
+static espnow_lane_t espnow_lane_for_type(uint8_t type)
+{
+    return (type == DATA_ALERT || type == DATA_RX_LEFT) ? ESPNOW_LANE_HIGH : ESPNOW_LANE_NORMAL;
+}
+
+/* Oldest unconsumed frame of a lane, NULL if the ring is empty (consumer side) */
+static espnow_rx_frame_t *espnow_rx_ring_peek(espnow_lane_t lane)
+{
+    espnow_rx_ring_t *ring = &espnow_rx_lanes[lane];
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (ring->tail == head)
+        return NULL;
+    return &ring->frames[ring->tail & (ESPNOW_RX_RING_SIZE - 1)];
+}
+
+/* Release the frame returned by espnow_rx_ring_peek (consumer side) */
+static void espnow_rx_ring_pop(espnow_lane_t lane)
+{
+    espnow_rx_ring_t *ring = &espnow_rx_lanes[lane];
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Record callback-to-handler latency of a lane (consumer side) */
+static void espnow_lane_latency_record(espnow_lane_t lane, int64_t enqueue_us)
+{
+    espnow_latency_hist_t *hist = &espnow_rx_stats.latency[lane];
+    uint32_t us = (uint32_t)(esp_timer_get_time() - enqueue_us);
+
+    // bucket 0: < 64 us, bucket i: [2^(i+5), 2^(i+6)) us, last bucket: everything above
+    int bucket = 0;
+    for (uint32_t v = us >> 6; v && bucket < ESPNOW_LATENCY_BUCKETS - 1; v >>= 1)
+        bucket++;
+
+    hist->bucket[bucket]++;
+    hist->count++;
+    if (us > hist->max_us)
+        hist->max_us = us;
+}
+
+void espnow_get_rx_stats(espnow_rx_stats_t *stats)
+{
+    *stats = espnow_rx_stats;
+}
+
 /* ESPNOW sending or receiving callback function is called in WiFi task.
  * Users should not do lengthy operations from this task. Instead, post
- * necessary data to a queue and handle it from a lower priority task. */
+ * necessary data to a queue/ring and handle it from a lower priority task. 
+ * Neither callback ever blocks or allocates. */
 static void my_espnow_send_cb(const esp_now_send_info_t *tx_info, esp_now_send_status_t status)
 {
     espnow_event_t evt;
     espnow_event_send_cb_t *send_cb = &evt.info.send_cb;
 
-    if (tx_info == NULL) {
+    if (tx_info == NULL || espnow_queue == NULL) {
         ESP_LOGE(TAG, "Send cb arg error");
         return;
     }
 
-    //give back the semaphore if status is successfull
-    if (status == ESP_NOW_SEND_SUCCESS)
+    // Completes the oldest frame in flight to this peer, or the late callback of one reclaimed as stale
+    bool broadcast = IS_BROADCAST_ADDR(tx_info->des_addr);
+    int slot;
+    uint16_t seq;
+
+    //broadcast has no ack - never retransmitted
+    portENTER_CRITICAL(&espnow_tx_lock);
+    espnow_window_callback_t result = espnow_window_callback(&espnow_tx_window, tx_info->des_addr,
+                                                             status == ESP_NOW_SEND_SUCCESS || broadcast,
+                                                             esp_timer_get_time(), &slot, &seq);
+    portEXIT_CRITICAL(&espnow_tx_lock);
+    if (result == ESPNOW_WINDOW_LATE)
+        return;
+
+    //give back the slot if status is successfull
+    if (result == ESPNOW_WINDOW_ACKED)
         xSemaphoreGive(send_semaphore);
 
     evt.id = ID_ESPNOW_SEND_CB;
+    evt.enqueue_us = esp_timer_get_time();
     memcpy(send_cb->mac_addr, tx_info->des_addr, ESP_NOW_ETH_ALEN);
     send_cb->status = status;
-
-    if (xQueueSend(espnow_queue, &evt, pdMS_TO_TICKS(ESPNOW_QUEUE_MAXDELAY)) != pdTRUE) {
-        ESP_LOGW(TAG, "Send send queue fail");
+    send_cb->slot = result == ESPNOW_WINDOW_FAILED ? slot : -1;
+    send_cb->seq = seq;
+
+    if (xQueueSend(espnow_queue, &evt, 0) != pdTRUE) {
+        espnow_rx_stats.queue_overruns++;
+        // nobody will retransmit it - drop the frame rather than leak the slot
+        if (send_cb->slot >= 0)
+            espnow_tx_slot_drop_failed(send_cb);
+        return;
     }
+
+    if (espnow_task_handle)
+        xTaskNotifyGive(espnow_task_handle);
 }
 
 static esp_err_t my_espnow_recv_cb(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len)
@@ -717,45 +1224,297 @@ static esp_err_t my_espnow_recv_cb(const esp_now_recv_info_t *recv_info, const u
     //ESP_LOGI(TAG, "ESP-NOW received %d bytes from "MACSTR" (RSSI: %d)", 
     //        len, MAC2STR(recv_info->src_addr), recv_info->rx_ctrl->rssi);
     
-    espnow_event_t evt;
-    espnow_event_recv_cb_t *recv_cb = &evt.info.recv_cb;
     uint8_t * mac_addr = recv_info->src_addr;
-    //int rssi = recv_info->rx_ctrl->rssi;
 
     if (mac_addr == NULL || data == NULL || len <= 0) {
         ESP_LOGE(TAG, "Receive cb arg error");
         return ESP_FAIL;
     }
 
-    evt.id = ID_ESPNOW_RECV_CB;
-    memcpy(recv_cb->mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
-    recv_cb->data = malloc(len);
-    if (recv_cb->data == NULL) {
-        ESP_LOGE(TAG, "Malloc receive data fail");
+    // Every valid frame is exactly one espnow_data_t
+    if (len != sizeof(espnow_data_t)) {
+        espnow_rx_stats.dropped_bad_len++;
         return ESP_FAIL;
     }
-    memcpy(recv_cb->data, data, len);
-    recv_cb->data_len = len;
 
-    if (xQueueSend(espnow_queue, &evt, pdMS_TO_TICKS(ESPNOW_QUEUE_MAXDELAY)) != pdTRUE) {
-        ESP_LOGW(TAG, "Send receive queue fail");
-        free(recv_cb->data);
+    espnow_lane_t lane = espnow_lane_for_type(((const espnow_data_t *)data)->type);
+    espnow_rx_ring_t *ring = &espnow_rx_lanes[lane];
+
+    uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= ESPNOW_RX_RING_SIZE) {
+        espnow_rx_stats.dropped_full[lane]++;
+        return ESP_FAIL;
     }
 
+    espnow_rx_frame_t *frame = &ring->frames[head & (ESPNOW_RX_RING_SIZE - 1)];
+    memcpy(frame->mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
+    memcpy(&frame->data, data, len);
+    frame->data_len = len;
+    frame->rssi = recv_info->rx_ctrl ? recv_info->rx_ctrl->rssi : 0;
+    frame->enqueue_us = esp_timer_get_time();
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    espnow_rx_stats.rx_frames++;
+
+    if (espnow_task_handle)
+        xTaskNotifyGive(espnow_task_handle);
+
     return ESP_OK;
 }
 
-static void espnow_send_message(espnow_message_type mdgType, uint8_t* mac_addr)
+void espnow_get_tx_stats(espnow_tx_stats_t *stats)
+{
+    portENTER_CRITICAL(&espnow_tx_lock);
+    *stats = espnow_tx_stats;
+    stats->in_flight = espnow_window_in_flight(&espnow_tx_window, NULL);
+    stats->retransmissions = espnow_tx_window.stats.retransmissions;
+    stats->given_up = espnow_tx_window.stats.given_up;
+    stats->window_waits = espnow_tx_window.stats.window_waits;
+    stats->stale_reclaimed = espnow_tx_window.stats.stale_reclaimed;
+    stats->late_callbacks = espnow_tx_window.stats.late_callbacks;
+    stats->lost_callbacks = espnow_tx_window.stats.lost_callbacks;
+    stats->stale_events = espnow_tx_window.stats.stale_events;
+    portEXIT_CRITICAL(&espnow_tx_lock);
+}
+
+/* Free a slot and give it back to senders */
+static void espnow_tx_slot_release(int slot)
+{
+    portENTER_CRITICAL(&espnow_tx_lock);
+    espnow_window_release(&espnow_tx_window, slot);
+    portEXIT_CRITICAL(&espnow_tx_lock);
+    xSemaphoreGive(send_semaphore);
+}
+
+/* Reclaim slots whose send callback never came back, or whose failure espnow_task never handled */
+static void espnow_tx_reclaim_stale(void)
+{
+    portENTER_CRITICAL(&espnow_tx_lock);
+    int reclaimed = espnow_window_reclaim_stale(&espnow_tx_window, esp_timer_get_time());
+    portEXIT_CRITICAL(&espnow_tx_lock);
+
+    while (reclaimed--)
+        xSemaphoreGive(send_semaphore);
+}
+
+/* Take a send slot towards mac_addr, respecting the per-peer window. Waits up to max_wait
+ * (0: a single try). Returns slot index or -1 */
+static int espnow_tx_slot_acquire(const uint8_t *mac_addr, TickType_t max_wait)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    do
+    {
+        if (xSemaphoreTake(send_semaphore, max_wait ? pdMS_TO_TICKS(ESPNOW_TX_SLOT_TIMEOUT_MS) : 0) != pdTRUE) {
+            espnow_tx_reclaim_stale();
+            continue;
+        }
+
+        portENTER_CRITICAL(&espnow_tx_lock);
+        int slot = espnow_window_acquire(&espnow_tx_window, mac_addr, esp_timer_get_time());
+        portEXIT_CRITICAL(&espnow_tx_lock);
+
+        if (slot >= 0)
+            return slot;
+
+        // This peer's window is full - let other senders use the slot meanwhile
+        xSemaphoreGive(send_semaphore);
+        espnow_tx_reclaim_stale();
+        if (max_wait)
+            vTaskDelay(pdMS_TO_TICKS(2));
+    } while (xTaskGetTickCount() - start < max_wait);
+
+    return -1;
+}
+
+/* (Re)send the frame held by a slot */
+static esp_err_t espnow_tx_slot_send(int slot)
+{
+    portENTER_CRITICAL(&espnow_tx_lock);
+    espnow_window_sent(&espnow_tx_window, slot, esp_timer_get_time());
+    portEXIT_CRITICAL(&espnow_tx_lock);
+
+    // the slot's MAC only changes once the slot is free again
+    esp_err_t err = esp_mesh_lite_espnow_send(ESPNOW_DATA_TYPE_RESERVE, espnow_tx_window.slot[slot].mac,
+                                              (const uint8_t *)&espnow_tx_frames[slot], sizeof(espnow_data_t));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Send error");
+        espnow_tx_slot_release(slot);
+    }
+    return err;
+}
+
+/* Take a slot and send. ESP_ERR_TIMEOUT if no slot was free within max_wait */
+static esp_err_t espnow_send_frame(espnow_message_type mdgType, const uint8_t *mac_addr, TickType_t max_wait)
 {
-    if (xSemaphoreTake(send_semaphore, pdMS_TO_TICKS(ESPNOW_QUEUE_MAXDELAY)) == pdTRUE)
+    int slot = espnow_tx_slot_acquire(mac_addr, max_wait);
+    if (slot < 0)
+        return ESP_ERR_TIMEOUT;
+
+    espnow_data_prepare(&espnow_tx_frames[slot], mdgType);
+    esp_err_t err = espnow_tx_slot_send(slot);
+    if (err == ESP_OK) {
+        portENTER_CRITICAL(&espnow_tx_lock);
+        espnow_tx_stats.sent++;
+        portEXIT_CRITICAL(&espnow_tx_lock);
+    }
+    return err;
+}
+
+/* Encrypt a handshaked peer once the RX had time to get DATA_ASK_DYNAMIC in clear (espnow_task only) */
+static void espnow_schedule_encrypt(const uint8_t *mac_addr)
+{
+    for (int i = 0; i < ESPNOW_DEFERRED_MAX; i++)
     {
-        espnow_data_prepare(espnow_data, mdgType);
-        if (esp_mesh_lite_espnow_send(ESPNOW_DATA_TYPE_RESERVE, mac_addr, (const uint8_t *)espnow_data, sizeof(espnow_data_t)) != ESP_OK) {
-            ESP_LOGE(TAG, "Send error");
+        espnow_pending_encrypt_t *e = &espnow_pending_encrypt[i];
+        if (!e->used) {
+            e->used = true;
+            memcpy(e->mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
+            e->due_us = esp_timer_get_time() + ESPNOW_HANDSHAKE_ENCRYPT_MS * 1000LL;
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "No pending encryption entry, encrypting "MACSTR" now", MAC2STR(mac_addr));
+    esp_now_encrypt_peer(mac_addr);
+}
+
+/* Delete a peer once the frames towards it are done, the RX_LEFT it was just sent among them (espnow_task only) */
+static void espnow_schedule_delete(const uint8_t *mac_addr)
+{
+    for (int i = 0; i < espnow_pending_delete_count; i++)
+        if (memcmp(espnow_pending_delete[i], mac_addr, ESP_NOW_ETH_ALEN) == 0)
+            return;
+    if (espnow_pending_delete_count == ESPNOW_DEFERRED_MAX) {
+        ESP_LOGW(TAG, "No pending delete entry, deleting "MACSTR" now", MAC2STR(mac_addr));
+        espnow_delete((uint8_t *)mac_addr);
+        return;
+    }
+    memcpy(espnow_pending_delete[espnow_pending_delete_count++], mac_addr, ESP_NOW_ETH_ALEN);
+}
+
+/* The RX is back: keep its peer, whether the delete is scheduled or still behind a deferred RX_LEFT (espnow_task only) */
+static void espnow_cancel_delete(const uint8_t *mac_addr)
+{
+    for (int i = 0; i < espnow_deferred_count; i++)
+        if (memcmp(espnow_deferred[i].mac_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0)
+            espnow_deferred[i].then_delete = false;
+    for (int i = 0; i < espnow_pending_delete_count; i++) {
+        if (memcmp(espnow_pending_delete[i], mac_addr, ESP_NOW_ETH_ALEN) == 0) {
+            memmove(espnow_pending_delete[i], espnow_pending_delete[i + 1],
+                    (--espnow_pending_delete_count - i) * sizeof(espnow_pending_delete[0]));
+            return;
         }
     }
+}
+
+/* Frames towards mac_addr still holding a slot (acked, given up and reclaimed ones do not) */
+static int espnow_tx_in_flight_to(const uint8_t *mac_addr)
+{
+    int n = 0;
+
+    portENTER_CRITICAL(&espnow_tx_lock);
+    n = espnow_window_in_flight(&espnow_tx_window, mac_addr);
+    portEXIT_CRITICAL(&espnow_tx_lock);
+    return n;
+}
+
+/* Send from espnow_task without waiting: queued behind earlier deferred sends, or if no slot is free.
+ * then_encrypt / then_delete run once the frame is handed to ESP-NOW (a failed send included) */
+static void espnow_defer_send(espnow_message_type mdgType, const uint8_t *mac_addr, bool then_encrypt, bool then_delete)
+{
+    if (espnow_deferred_count == 0 && espnow_send_frame(mdgType, mac_addr, 0) != ESP_ERR_TIMEOUT) {
+        if (then_encrypt)
+            espnow_schedule_encrypt(mac_addr);
+        if (then_delete)
+            espnow_schedule_delete(mac_addr);
+        return;
+    }
+
+    portENTER_CRITICAL(&espnow_tx_lock);
+    if (espnow_deferred_count < ESPNOW_DEFERRED_MAX)
+        espnow_tx_stats.deferred++;
     else
-        ESP_LOGE(TAG, "Could not take send semaphore!");
+        espnow_tx_stats.deferred_dropped++;
+    portEXIT_CRITICAL(&espnow_tx_lock);
+
+    if (espnow_deferred_count == ESPNOW_DEFERRED_MAX) {
+        ESP_LOGE(TAG, "Deferred send queue full, dropping type %d to "MACSTR"", mdgType, MAC2STR(mac_addr));
+        if (then_delete)
+            espnow_schedule_delete(mac_addr);
+        return;
+    }
+    espnow_deferred_send_t *d = &espnow_deferred[espnow_deferred_count++];
+    d->type = mdgType;
+    d->then_encrypt = then_encrypt;
+    d->then_delete = then_delete;
+    memcpy(d->mac_addr, mac_addr, ESP_NOW_ETH_ALEN);
+}
+
+/* Send what espnow_task deferred, in order, while slots are free */
+static void espnow_deferred_flush(void)
+{
+    while (espnow_deferred_count > 0)
+    {
+        espnow_deferred_send_t *d = &espnow_deferred[0];
+        if (espnow_send_frame(d->type, d->mac_addr, 0) == ESP_ERR_TIMEOUT)
+            return;
+        if (d->then_encrypt)
+            espnow_schedule_encrypt(d->mac_addr);
+        if (d->then_delete)
+            espnow_schedule_delete(d->mac_addr);
+        memmove(&espnow_deferred[0], &espnow_deferred[1], --espnow_deferred_count * sizeof(espnow_deferred[0]));
+    }
+}
+
+/* Run the due encryption and delete steps. Returns the ticks espnow_task may sleep before the next deferred step */
+static TickType_t espnow_deferred_steps(void)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t next_us = INT64_MAX;
+
+    espnow_deferred_flush();
+    for (int i = 0; i < espnow_pending_delete_count; )
+    {
+        if (espnow_tx_in_flight_to(espnow_pending_delete[i]) > 0) {
+            i++;
+            continue;
+        }
+        espnow_delete(espnow_pending_delete[i]);
+        memmove(espnow_pending_delete[i], espnow_pending_delete[i + 1],
+                (--espnow_pending_delete_count - i) * sizeof(espnow_pending_delete[0]));
+    }
+    for (int i = 0; i < ESPNOW_DEFERRED_MAX; i++)
+    {
+        espnow_pending_encrypt_t *e = &espnow_pending_encrypt[i];
+        if (!e->used)
+            continue;
+        if (e->due_us <= now) {
+            e->used = false;
+            // the RX may have left meanwhile
+            if (esp_now_is_peer_exist(e->mac_addr))
+                esp_now_encrypt_peer(e->mac_addr);
+        } else if (e->due_us < next_us) {
+            next_us = e->due_us;
+        }
+    }
+
+    // slots are freed by send callbacks (which wake the task) or by the stale timeout (which does not)
+    if ((espnow_deferred_count > 0 || espnow_pending_delete_count > 0) && now + ESPNOW_TX_SLOT_TIMEOUT_MS * 1000LL < next_us)
+        next_us = now + ESPNOW_TX_SLOT_TIMEOUT_MS * 1000LL;
+    if (next_us == INT64_MAX)
+        return portMAX_DELAY;
+    return pdMS_TO_TICKS((next_us - now) / 1000) + 1;
+}
+
+/* espnow_task never waits for a send slot: its sends are deferred and flushed between lane checks */
+static void espnow_send_message(espnow_message_type mdgType, uint8_t* mac_addr)
+{
+    if (espnow_task_handle != NULL && xTaskGetCurrentTaskHandle() == espnow_task_handle) {
+        espnow_defer_send(mdgType, mac_addr, false, false);
+        return;
+    }
+
+    if (espnow_send_frame(mdgType, mac_addr, pdMS_TO_TICKS(ESPNOW_QUEUE_MAXDELAY)) == ESP_ERR_TIMEOUT)
+        ESP_LOGE(TAG, "Could not take send slot!");
 }
 
 static void espnow_delete(uint8_t* mac_addr)
@@ -776,246 +1535,460 @@ static void espnow_delete(uint8_t* mac_addr)
     }
 }
 
-static void espnow_task(void *pvParameter)
+/* Free the failed slot of a send-callback event that will not be retransmitted
+ * (it may have been reclaimed as stale and reused since the callback) */
+static void espnow_tx_slot_drop_failed(const espnow_event_send_cb_t *send_cb)
 {
-    //Create queue to process esp now events
-    espnow_queue = xQueueCreate(ESPNOW_QUEUE_SIZE, sizeof(espnow_event_t));
-    if (espnow_queue == NULL) {
-        ESP_LOGE(TAG, "Create ESP-NOW queue fail");
+    portENTER_CRITICAL(&espnow_tx_lock);
+    bool owned = espnow_window_drop_failed(&espnow_tx_window, send_cb->slot, send_cb->seq);
+    portEXIT_CRITICAL(&espnow_tx_lock);
+
+    if (owned)
+        xSemaphoreGive(send_semaphore);
+}
+
+/* Handle the outcome of an ESP-NOW send (retransmission / comms failure accounting) */
+static void espnow_handle_send_event(espnow_event_send_cb_t *send_cb)
+{
+    //ESP_LOGI(TAG, "send data to "MACSTR", status: %d", MAC2STR(send_cb->mac_addr), send_cb->status);
+    bool addr_type = IS_BROADCAST_ADDR(send_cb->mac_addr);
+    if (addr_type)
+    {
+        //ESP_LOGI(TAG, "Broadcast data sent!");
+        //broadcast always successfull anyway (no ack)
+    }
+    else
+    {
+        //unicast message
+        if (send_cb->status != ESP_NOW_SEND_SUCCESS) 
+        {
+            ESP_LOGE(TAG, "ERROR SENDING DATA TO "MACSTR"", MAC2STR(send_cb->mac_addr));
+            comms_fail++;
+
+            //MAX_COMMS_CONSECUTIVE_ERRORS --> RESTART
+            if (comms_fail > MAX_COMMS_ERROR)
+            {
+                ESP_LOGE(TAG, "TOO MANY COMMS ERRORS, RESTARTING");
+
+                //delete all peers
+                delete_all_peers();
+
+                //reboot
+                esp_restart();
+            }
+            else if (send_cb->slot >= 0) //RETRANSMISSIONS
+            {
+                portENTER_CRITICAL(&espnow_tx_lock);
+                espnow_window_retry_t retry = espnow_window_retry(&espnow_tx_window, send_cb->slot, send_cb->seq,
+                                                                  esp_timer_get_time());
+                portEXIT_CRITICAL(&espnow_tx_lock);
+
+                if (retry == ESPNOW_WINDOW_GIVE_UP)
+                {
+                    ESP_LOGE(TAG, "Giving up frame seq %d to "MACSTR"", send_cb->seq, MAC2STR(send_cb->mac_addr));
+                    xSemaphoreGive(send_semaphore);
+                }
+                else if (retry == ESPNOW_WINDOW_RESEND)
+                {
+                    //retransmit the very frame that failed
+                    ESP_LOGW(TAG, "RETRANSMISSION n. %d (seq %d)", comms_fail, send_cb->seq);
+                    espnow_tx_slot_send(send_cb->slot);
+                }
+            }
+        }
+        else 
+        {
+            //reset comms - we are good
+            comms_fail = 0;
+        }
+    }
+}
+
+/* Handle a received ESP-NOW frame taken from the receive ring */
+static void espnow_handle_recv_frame(espnow_rx_frame_t *recv_cb)
+{
+    // Check CRC of received ESPNOW data.
+    if(!espnow_data_crc_control((uint8_t *)&recv_cb->data, recv_cb->data_len))
+    {
+        ESP_LOGE(TAG, "Receive error data from: "MACSTR"", MAC2STR(recv_cb->mac_addr));
         return;
     }
-    
+    // Parse received ESPNOW data.
+    espnow_data_t *recv_data = &recv_cb->data; 
+    //int8_t unitID = recv_data->id;
+    espnow_message_type msg_type = recv_data->type;
+
+    //ESP_LOGI(TAG, "Received ESP-NOW message %d with from: "MACSTR"", msg_type, MAC2STR(recv_cb->mac_addr));
+
+    if (msg_type == DATA_BROADCAST && (UNIT_ROLE == TX))
+    {
+        ESP_LOGI(TAG, "Receive broadcast data from: "MACSTR", RX voltage: %.2f", MAC2STR(recv_cb->mac_addr), recv_data->field_1);
+        //double check its position is 0
+        if (is_root_node) {
+            struct RX_peer* p = RX_peer_find_by_mac(recv_cb->mac_addr);
+            if (p != NULL && p->position != 0)
+            {
+                removeFromRelativeTX(p->position);
+                RX_peer_set_position(p, 0);
+            }
+        }
+        if (recv_data->field_1 > MIN_RX_VOLTAGE)
+        {
+            //Case 1 - I am another RX - discard - done
+            //Case 2 - I am master TX - energized with other pads, claim it with the RSSI (resolved at the end of the step)
+            //         not energized, keep the RSSI to rank the pads for the next step
+            if (is_root_node)
+            {
+                if (self_dynamic_payload.TX.tx_status == TX_LOCALIZATION)
+                    loc_claim_record(recv_cb->mac_addr, UNIT_ID, recv_cb->rssi);
+                else
+                    loc_report_record(recv_cb->mac_addr, UNIT_ID, recv_cb->rssi);
+            }
+            //Case 3 - I am TX - am I active? yes then claim it to the master - no then report the RSSI to the master
+            else if (self_dynamic_payload.TX.tx_status == TX_LOCALIZATION)
+            {
+                // the master answers with a grant to the pad with the strongest RSSI
+                send_loc_claim_payload(recv_cb->mac_addr, recv_cb->rssi);
+            }
+            else
+            {
+                send_loc_report_payload(recv_cb->mac_addr, recv_cb->rssi);
+            }
+        }   
+    }
+    else if (msg_type == DATA_ASK_DYNAMIC)
+    {
+        ESP_LOGW(TAG, "Locking TX on ESPNOW!");
+        // Save peer and communicate via ESP-NOW
+        add_peer_if_needed(recv_cb->mac_addr);
+        //RX encrypts the TX peer after receiving this first unicast message
+        esp_now_encrypt_peer(recv_cb->mac_addr);
+        //save TX parent MAC addr
+        memcpy(TX_parent_mac, recv_cb->mac_addr, ETH_HWADDR_LEN);
+        DynTimeout = recv_data->field_1;
+        rxLocalized = true;
+    }
+    else if (msg_type == DATA_RX_LEFT)
+    {
+        //ESP_LOGW(TAG, "RX has left received from: "MACSTR"", MAC2STR(recv_cb->mac_addr));
+        rxLocalized = false;
+        espnow_delete(recv_cb->mac_addr);
+    }
+    else if(msg_type == DATA_DYNAMIC)
+    {
+        //ESP_LOGI(TAG, "Receive DYNAMIC data from: "MACSTR", len: %d", MAC2STR(recv_cb->mac_addr), recv_cb->data_len);
+        handle_peer_dynamic(recv_data, recv_cb->mac_addr);
+    }
+    else if (msg_type == DATA_ALERT)
+    {
+        //ESP_LOGW(TAG, "Receive ALERT data from: "MACSTR", len: %d", MAC2STR(recv_cb->mac_addr), recv_cb->data_len);
+        handle_peer_alert(recv_data, recv_cb->mac_addr, recv_cb->enqueue_us);
+    }
+    else
+        ESP_LOGI(TAG, "Receive unexpected message type %d data from: "MACSTR"", msg_type, MAC2STR(recv_cb->mac_addr));
+}
+
+/* Lock a localized RX on ESP-NOW - runs in espnow_task, which must not sleep through the encryption delay */
+static void espnow_localization_handshake(const uint8_t *rx_mac)
+{
+    // Save peer and communicate via ESP-NOW - it may still be waiting to be deleted after an RX_LEFT
+    espnow_cancel_delete(rx_mac);
+    add_peer_if_needed(rx_mac);
+    // ask for dynamic data, then TX encrypts the peer after this first unicast message
+    // (as it needs to be encrypted on both sides!) - done by espnow_deferred_steps
+    espnow_defer_send(DATA_ASK_DYNAMIC, rx_mac, true, false);
+}
+
+static void espnow_post_handshake(const uint8_t *rx_mac)
+{
     espnow_event_t evt;
+    evt.id = ID_ESPNOW_LOC_HANDSHAKE;
+    evt.enqueue_us = esp_timer_get_time();
+    memcpy(evt.info.handshake.mac_addr, rx_mac, ESP_NOW_ETH_ALEN);
+
+    if (espnow_queue == NULL || xQueueSend(espnow_queue, &evt, pdMS_TO_TICKS(100)) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Localization handshake for "MACSTR" not queued", MAC2STR(rx_mac));
+        return;
+    }
+    xTaskNotifyGive(espnow_task_handle);
+}
+
+static void espnow_task(void *pvParameter)
+{
+    espnow_event_t evt;
+    espnow_rx_frame_t *frame;
 
     add_peer_if_needed(broadcast_mac);
 
     while (1) 
     {
-        if (xQueueReceive(espnow_queue, &evt, portMAX_DELAY) && is_mesh_connected) //if mesh not connected dump the queue?
+        // Woken by both callbacks or the next deferred send/encryption step, then drain everything pending
+        ulTaskNotifyTake(pdTRUE, espnow_deferred_steps());
+
+        bool pending = true;
+        while (pending)
         {
-            switch (evt.id) {
-                case ID_ESPNOW_SEND_CB:
-                {
-                    espnow_event_send_cb_t *send_cb = &evt.info.send_cb;
-                    //ESP_LOGI(TAG, "send data to "MACSTR", status: %d", MAC2STR(send_cb->mac_addr), send_cb->status);
-                    bool addr_type = IS_BROADCAST_ADDR(send_cb->mac_addr);
-                    if (addr_type)
-                    {
-                        //ESP_LOGI(TAG, "Broadcast data sent!");
-                        //broadcast always successfull anyway (no ack)
-                    }
-                    else
-                    {
-                        //ESP_LOGW(TAG, "Unicast data sent %d!", last_msg_type);
-
-                        //unicast message
-                        if (send_cb->status != ESP_NOW_SEND_SUCCESS) 
-                        {
-                            ESP_LOGE(TAG, "ERROR SENDING DATA TO "MACSTR"", MAC2STR(send_cb->mac_addr));
-                            comms_fail++;
-
-                            //MAX_COMMS_CONSECUTIVE_ERRORS --> RESTART
-                            if (comms_fail > MAX_COMMS_ERROR)
-                            {
-                                ESP_LOGE(TAG, "TOO MANY COMMS ERRORS, RESTARTING");
-
-                                //delete all peers
-                                delete_all_peers();
-
-                                //reboot
-                                esp_restart();
-                            }
-                            else //RETRANSMISSIONS
-                            {
-                                //retransmit
-                                ESP_LOGW(TAG, "RETRANSMISSION n. %d", comms_fail);
-                                espnow_data_prepare(espnow_data, last_msg_type);
-                                esp_mesh_lite_espnow_send(ESPNOW_DATA_TYPE_RESERVE, send_cb->mac_addr, (const uint8_t *)espnow_data, sizeof(espnow_data_t));
-                            }
-                        }
-                        else 
-                        {
-                            //reset comms - we are good
-                            comms_fail = 0;
-                        }
-                    }
-                    break;
+            // High lane (alerts, RX left) is always drained first
+            while ((frame = espnow_rx_ring_peek(ESPNOW_LANE_HIGH)) != NULL)
+            {
+                espnow_lane_latency_record(ESPNOW_LANE_HIGH, frame->enqueue_us);
+                if (is_mesh_connected) //if mesh not connected dump the lane
+                    espnow_handle_recv_frame(frame);
+                espnow_rx_ring_pop(ESPNOW_LANE_HIGH);
+            }
+
+            // Then a single normal lane item, so the high lane is re-checked between telemetry frames.
+            // Nothing below blocks, so the longest item bounds the high lane wait
+            pending = false;
+            int64_t item_start_us = esp_timer_get_time();
+            if (xQueueReceive(espnow_queue, &evt, 0) == pdTRUE)
+            {
+                pending = true;
+                espnow_lane_latency_record(ESPNOW_LANE_NORMAL, evt.enqueue_us);
+                if (!is_mesh_connected) {
+                    // no retransmission while disconnected - free a failed frame's slot
+                    if (evt.id == ID_ESPNOW_SEND_CB && evt.info.send_cb.slot >= 0)
+                        espnow_tx_slot_drop_failed(&evt.info.send_cb);
+                    continue;
                 }
-                case ID_ESPNOW_RECV_CB:
-                {
-                    espnow_event_recv_cb_t *recv_cb = &evt.info.recv_cb;
 
-                    // Check CRC of received ESPNOW data.
-                    if(!espnow_data_crc_control(recv_cb->data, recv_cb->data_len))
-                    {
-                        ESP_LOGE(TAG, "Receive error data from: "MACSTR"", MAC2STR(recv_cb->mac_addr));
+                switch (evt.id) {
+                    case ID_ESPNOW_SEND_CB:
+                        espnow_handle_send_event(&evt.info.send_cb);
+                        break;
+                    case ID_ESPNOW_LOC_HANDSHAKE:
+                        espnow_localization_handshake(evt.info.handshake.mac_addr);
+                        break;
+                    default:
+                        ESP_LOGE(TAG, "Callback type error: %d", evt.id);
                         break;
-                    }
-                    // Parse received ESPNOW data.
-                    espnow_data_t *recv_data = (espnow_data_t *)recv_cb->data; 
-                    //int8_t unitID = recv_data->id;
-                    espnow_message_type msg_type = recv_data->type;
-
-                    //ESP_LOGI(TAG, "Received ESP-NOW message %d with from: "MACSTR"", msg_type, MAC2STR(recv_cb->mac_addr));
-
-                    if (msg_type == DATA_BROADCAST && (UNIT_ROLE == TX))
-                    {
-                        ESP_LOGI(TAG, "Receive broadcast data from: "MACSTR", RX voltage: %.2f", MAC2STR(recv_cb->mac_addr), recv_data->field_1);
-                        //double check its position is 0
-                        if (is_root_node) {
-                            struct RX_peer* p = RX_peer_find_by_mac(recv_cb->mac_addr);
-                            if (p != NULL && p->position != 0)
-                            {
-                                removeFromRelativeTX(p->position);
-                                p->position = 0;
-                            }
-                        }
-                        if (recv_data->field_1 > MIN_RX_VOLTAGE)
-                        {
-                            //Case 1 - I am another RX - discard - done
-                            //Case 2 - I am master TX - localization done (advise other TXs updating localization table)
-                            if (is_root_node)
-                            {
-                                // TX will tell the RX via ESP-NOW
-                                if (self_dynamic_payload.TX.tx_status == TX_LOCALIZATION)
-                                {
-                                    //update RX peer position
-                                    struct RX_peer* p = RX_peer_find_by_mac(recv_cb->mac_addr);
-                                    if (p != NULL)
-                                    {
-                                        if (p->position != 0)
-                                        {
-                                            ESP_LOGW(TAG, "Problem, RX was already localized - abort");
-                                            free(recv_data);
-                                            break;
-                                        }
-                                        p->position = UNIT_ID; //position same as ID for RX
-                                        p->RX_status = RX_CHARGING;
-                                        ESP_LOGI(TAG, "RX peer position updated to %d", p->position);
-                                    }
-                                    ESP_LOGI(TAG, "RX has been located to this TX (which is also the master)!");
-                                    write_STM_command(TX_DEPLOY);
-                                    // Save peer and communicate via ESP-NOW
-                                    add_peer_if_needed(recv_cb->mac_addr);
-                                    // ask for dynamic data 
-                                    espnow_send_message(DATA_ASK_DYNAMIC, recv_cb->mac_addr);
-                                    vTaskDelay(500);
-                                    // master encrypt the peer after sending this first unicast message (as it needs to be encrypted on both sides!)
-                                    esp_now_encrypt_peer(recv_cb->mac_addr);
-                                }
-                            }
-                            //Case 3 - I am TX - am I active? yes then tell master - no then discard
-                            else if (self_dynamic_payload.TX.tx_status == TX_LOCALIZATION)
-                            {
-                                //Advise master TO update peer position
-                                send_localization_payload(UNIT_ID, recv_cb->mac_addr);
-                                ESP_LOGI(TAG, "RX has been located on this pad!");
-                                // Save peer and communicate via ESP-NOW
-                                add_peer_if_needed(recv_cb->mac_addr);
-                                // ask for dynamic data 
-                                espnow_send_message(DATA_ASK_DYNAMIC, recv_cb->mac_addr);
-                                write_STM_command(TX_DEPLOY);
-                                vTaskDelay(500);
-                                // TX encrypt the peer after sending this first unicast message (as it needs to be encrypted on both sides!)
-                                esp_now_encrypt_peer(recv_cb->mac_addr);
-                            }
-                        }   
-                    }
-                    else if (msg_type == DATA_ASK_DYNAMIC)
-                    {
-                        ESP_LOGW(TAG, "Locking TX on ESPNOW!");
-                        // Save peer and communicate via ESP-NOW
-                        add_peer_if_needed(recv_cb->mac_addr);
-                        //RX encrypts the TX peer after receiving this first unicast message
-                        esp_now_encrypt_peer(recv_cb->mac_addr);
-                        //save TX parent MAC addr
-                        memcpy(TX_parent_mac, recv_cb->mac_addr, ETH_HWADDR_LEN);
-                        DynTimeout = recv_data->field_1;
-                        rxLocalized = true;
-                    }
-                    else if (msg_type == DATA_RX_LEFT)
-                    {
-                        //ESP_LOGW(TAG, "RX has left received from: "MACSTR"", MAC2STR(recv_cb->mac_addr));
-                        rxLocalized = false;
-                        espnow_delete(recv_cb->mac_addr);
-                    }
-                    else if(msg_type == DATA_DYNAMIC)
-                    {
-                        //ESP_LOGI(TAG, "Receive DYNAMIC data from: "MACSTR", len: %d", MAC2STR(recv_cb->mac_addr), recv_cb->data_len);
-                        handle_peer_dynamic(recv_data, recv_cb->mac_addr);
-                    }
-                    else if (msg_type == DATA_ALERT)
-                    {
-                        //ESP_LOGW(TAG, "Receive ALERT data from: "MACSTR", len: %d", MAC2STR(recv_cb->mac_addr), recv_cb->data_len);
-                        handle_peer_alert(recv_data, recv_cb->mac_addr); 
-                    }
-                    else
-                        ESP_LOGI(TAG, "Receive unexpected message type %d data from: "MACSTR"", msg_type, MAC2STR(recv_cb->mac_addr));
-
-                    free(recv_data);
-                    break;
                 }
-                default:
-                    ESP_LOGE(TAG, "Callback type error: %d", evt.id);
-                    break;
             }
+            else if ((frame = espnow_rx_ring_peek(ESPNOW_LANE_NORMAL)) != NULL)
+            {
+                pending = true;
+                espnow_lane_latency_record(ESPNOW_LANE_NORMAL, frame->enqueue_us);
+                if (is_mesh_connected)
+                    espnow_handle_recv_frame(frame);
+                espnow_rx_ring_pop(ESPNOW_LANE_NORMAL);
+            }
+
+            uint32_t item_us = (uint32_t)(esp_timer_get_time() - item_start_us);
+            if (pending && item_us > espnow_rx_stats.normal_item_max_us)
+                espnow_rx_stats.normal_item_max_us = item_us;
         }
     }
 
     vQueueDelete(espnow_queue);
     vTaskDelete(NULL);
-    free(espnow_data);
 }
 
 static void reset_the_baton()
 {
     // switch all TX available for localization OFF (mesh-lite and local switch off)
     send_control_payload(TX_OFF, broadcast_mac); //broadcast
-    write_STM_command(TX_OFF);
+    if (!STM_probe_holding())
+        write_STM_command(TX_OFF);
 
     // update list structures
     allLocalizationTxPeersOFF();
 }
 
-static void pass_the_baton()
+/* Hand each resolved RX to its pad (locally or with one grant broadcast) */
+static void localization_grant(const loc_assignment_t *assignments, uint8_t count)
+{
+    my_loc_grant_payload.count = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        const loc_assignment_t *a = &assignments[i];
+
+        // located - its reports must not rank pads for a later arrival
+        portENTER_CRITICAL(&loc_lock);
+        loc_claims_forget(&loc_reports, a->rx_mac);
+        portEXIT_CRITICAL(&loc_lock);
+
+        //update RX peer position
+        struct RX_peer* p = RX_peer_find_by_mac((uint8_t *)a->rx_mac);
+        if (p != NULL)
+        {
+            if (p->position != 0)
+            {
+                ESP_LOGW(TAG, "Problem, RX was already localized - abort");
+                continue;
+            }
+            RX_peer_set_position(p, a->position); //position same as ID for RX
+            p->RX_status = RX_CHARGING;
+            ESP_LOGI(TAG, "RX peer position updated to %d", p->position);
+        }
+
+        if (a->position == UNIT_ID)
+        {
+            ESP_LOGI(TAG, "RX has been located to this TX (which is also the master)!");
+            write_STM_command(TX_DEPLOY);
+            espnow_post_handshake(a->rx_mac);
+        }
+        else
+        {
+            struct TX_peer* tx = TX_peer_find_by_position(a->position);
+            if (tx == NULL || my_loc_grant_payload.count >= LOCALIZATION_GROUP_MAX)
+                continue;
+            memcpy(my_loc_grant_payload.grant[my_loc_grant_payload.count].padMac, tx->MACaddress, ETH_HWADDR_LEN);
+            memcpy(my_loc_grant_payload.grant[my_loc_grant_payload.count].rxMac, a->rx_mac, ETH_HWADDR_LEN);
+            my_loc_grant_payload.count++;
+        }
+    }
+
+    if (my_loc_grant_payload.count)
+        send_loc_message_to_child(TO_CHILD_LOC_GRANT_MSG_ID, TO_CHILD_LOC_GRANT_MSG_ID_RESP,
+                                  (uint8_t*)&my_loc_grant_payload, sizeof(mesh_loc_grant_payload_t));
+}
+
+/* One localization step: energize the pad ranked from the RSSI reports or a group of non-adjacent pads,
+   collect the claims, grant the winners */
+static void localization_step()
 {
-    struct TX_peer* p = find_next_TX_for_localization(previousTX_pos);
-    if (p == NULL)
+    int8_t candidates[LOCALIZATION_MAX_PADS];
+    int8_t group[LOCALIZATION_GROUP_MAX];
+    uint8_t group_len;
+
+    uint8_t count = TX_peers_localization_candidates(candidates, LOCALIZATION_MAX_PADS);
+
+    // hybrid: a pad clearly ahead in the reports is tried alone first, the sweep is the fallback
+    portENTER_CRITICAL(&loc_lock);
+    bool hinted = loc_claims_rank(&loc_reports, candidates, count, LOCALIZATION_RSSI_MARGIN_DB, &loc_hint);
+    if (hinted)
+        loc_claims_forget(&loc_reports, loc_hint.rx_mac); // one try per ranking, fresh reports for the next one
+    portEXIT_CRITICAL(&loc_lock);
+
+    if (hinted)
+    {
+        ESP_LOGI(TAG, "RX "MACSTR" most likely on pad %d", MAC2STR(loc_hint.rx_mac), loc_hint.position);
+        group[0] = loc_hint.position;
+        group_len = 1;
+    }
+    else
+    {
+        group_len = loc_next_group(&loc_scheduler, candidates, count, group);
+    }
+    if (group_len == 0)
     {
         ESP_LOGE(TAG, "TX peer not found during localization");
         return;
     }
-    p->dynamic_payload->TX.tx_status = TX_LOCALIZATION;
 
-    //ESP_LOGW(TAG, "next baton %d", p->position);
-
-    //switch all OFF
-    reset_the_baton();
-    vTaskDelay(LOCALIZATION_TIME_MS);
+    //switch all OFF - only if the previous step left pads ON
+    if (loc_energized)
+    {
+        reset_the_baton();
+        vTaskDelay(LOCALIZATION_TIME_MS);
+    }
 
-    //switch next ON
-    if(p->position == UNIT_ID)
+    // open the claim window before any pad of the group is ON
+    xEventGroupClearBits(eventGroupHandle, LOC_CLAIMBIT);
+    portENTER_CRITICAL(&loc_lock);
+    loc_claims_reset(&loc_claims);
+    loc_hint_active = hinted;
+    loc_window_open = true;
+    portEXIT_CRITICAL(&loc_lock);
+
+    //switch the group ON - a single broadcast for all the children
+    my_loc_group_payload.count = 0;
+    for (int i = 0; i < group_len; i++)
     {
-        //ESP_LOGI(TAG, "I am the next TX for localization, switching ON locally");
-        write_STM_command(TX_LOCALIZATION);
+        uint8_t mac[ETH_HWADDR_LEN];
+        if (!TX_peer_start_localization(group[i], mac))
+            continue;
+
+        if (group[i] == UNIT_ID)
+            write_STM_command(TX_LOCALIZATION);
+        else
+            memcpy(my_loc_group_payload.macAddr[my_loc_group_payload.count++], mac, ETH_HWADDR_LEN);
     }
+    if (my_loc_group_payload.count)
+        send_loc_message_to_child(TO_CHILD_LOC_GROUP_MSG_ID, TO_CHILD_LOC_GROUP_MSG_ID_RESP,
+                                  (uint8_t*)&my_loc_group_payload, 1 + my_loc_group_payload.count * ETH_HWADDR_LEN);
+    loc_energized = true;
+
+    // a single ranked pad closes the window as soon as it claims, a group waits for all the claims
+    int64_t start_us = esp_timer_get_time();
+    if (hinted)
+        xEventGroupWaitBits(eventGroupHandle, LOC_CLAIMBIT, pdTRUE, pdFALSE, LOCALIZATION_HINT_TIME_MS);
     else
+        vTaskDelay(LOCALIZATION_TIME_MS);
+
+    // close the window and pick the strongest pad for every RX heard
+    static loc_claims_t claims;
+    portENTER_CRITICAL(&loc_lock);
+    loc_window_open = false;
+    loc_hint_active = false;
+    claims = loc_claims;
+    portEXIT_CRITICAL(&loc_lock);
+
+    loc_assignment_t assignments[LOCALIZATION_GROUP_MAX];
+    uint8_t assigned = loc_claims_resolve(&claims, &loc_scheduler, assignments, LOCALIZATION_GROUP_MAX);
+
+    ESP_LOGD(TAG, "Localization step: %d pads, %d claims, %d located", group_len, claims.count, assigned);
+    if (hinted)
     {
-        //ESP_LOGI(TAG, "Next TX for localization is ID %d, switching it ON via mesh-lite", p->position);
-        send_control_payload(TX_LOCALIZATION, p->MACaddress);
+        bool located = assigned == 1 && assignments[0].position == loc_hint.position;
+        if (located)
+            loc_energized = false; // the only pad ON is now deploying
+        ESP_LOGI(TAG, "Ranked pad %d %s after %lld ms", loc_hint.position, 
+                 located ? "confirmed" : "missed - back to the sweep", (esp_timer_get_time() - start_us) / 1000);
     }
-    vTaskDelay(LOCALIZATION_TIME_MS);
-    
-    previousTX_pos = p->position;
+    if (assigned)
+        localization_grant(assignments, assigned);
+}
+
+/* Dead battery mode: pulse the next idle non-adjacent pads, a pad that sees a load holds itself ON */
+static void probe_idle_pads()
+{
+    int8_t candidates[LOCALIZATION_MAX_PADS];
+    int8_t group[PROBE_GROUP_MAX];
+
+    // adjacent pads may see the same scooter, never probe them together
+    uint8_t count = TX_peers_probe_candidates(candidates, LOCALIZATION_MAX_PADS);
+    uint8_t group_len = loc_next_group(&probe_scheduler, candidates, count, group);
+
+    my_probe_payload.count = 0;
+    for (int i = 0; i < group_len; i++)
+    {
+        if (group[i] == UNIT_ID)
+        {
+            STM_probe();
+            continue;
+        }
+        struct TX_peer* tx = TX_peer_find_by_position(group[i]);
+        if (tx != NULL)
+            memcpy(my_probe_payload.macAddr[my_probe_payload.count++], tx->MACaddress, ETH_HWADDR_LEN);
+    }
+    if (my_probe_payload.count)
+        send_loc_message_to_child(TO_CHILD_PROBE_MSG_ID, TO_CHILD_PROBE_MSG_ID_RESP,
+                                  (uint8_t*)&my_probe_payload, 1 + my_probe_payload.count * ETH_HWADDR_LEN);
 }
 
 static void alert_task(void *pvParameters)
 {    
+    self_alert_register_task(xTaskGetCurrentTaskHandle());
+
     while (1) 
     {
+        // Woken by the producers on a threshold crossing, the timeout only re-checks the flags as a fallback
+        uint32_t latency_us = 0;
+        bool notified = self_alert_wait(pdMS_TO_TICKS(ALERT_POLL_FALLBACK_MS), &latency_us);
+
         // Check for alert
         if (alert_payload_changed(&self_alert_payload, &self_previous_alert_payload))
         {   
+            if (notified)
+            {
+                self_alert_stats_t stats;
+                self_alert_get_stats(&stats);
+                ESP_LOGW(TAG, "Alert raised %ld us after the sample (worst case %ld us)", latency_us, stats.max_latency_us);
+            }
+
             //LEDs
             if (UNIT_ROLE == TX && (self_alert_payload.TX.TX_all_flags || self_alert_payload.RX.RX_all_flags))
             {
@@ -1047,8 +2020,6 @@ static void alert_task(void *pvParameters)
                 esp_restart(); // restart after alert sent
             }
         }
-
-        vTaskDelay(pdMS_TO_TICKS(10)); //minimum wait
     }
 }
 
@@ -1066,11 +2037,42 @@ static void wifi_mesh_lite_task(void *pvParameters)
         { TO_ROOT_LOCALIZATION_ID_RESP, 0, localization_to_root_raw_msg_process_response},
         { TO_CHILD_CONTROL_MSG_ID, TO_CHILD_CONTROL_MSG_ID_RESP, control_to_child_raw_msg_process},
         { TO_CHILD_CONTROL_MSG_ID_RESP, 0, control_to_child_raw_msg_response_process},
+        { TO_ROOT_CAPS_MSG_ID, TO_ROOT_CAPS_MSG_ID_RESP, caps_to_root_raw_msg_process},
+        { TO_ROOT_CAPS_MSG_ID_RESP, 0, caps_to_root_raw_msg_response_process},
+        { TO_ROOT_DYNAMIC_V2_MSG_ID, TO_ROOT_DYNAMIC_V2_MSG_ID_RESP, dynamic_v2_to_root_raw_msg_process},
+        { TO_ROOT_DYNAMIC_V2_MSG_ID_RESP, 0, dynamic_v2_to_root_raw_msg_response_process},
+        { TO_ROOT_ALERT_V2_MSG_ID, TO_ROOT_ALERT_V2_MSG_ID_RESP, alert_v2_to_root_raw_msg_process},
+        { TO_ROOT_ALERT_V2_MSG_ID_RESP, 0, alert_v2_to_root_raw_msg_response_process},
+        { TO_CHILD_LOC_GROUP_MSG_ID, TO_CHILD_LOC_GROUP_MSG_ID_RESP, loc_group_to_child_raw_msg_process},
+        { TO_CHILD_LOC_GROUP_MSG_ID_RESP, 0, loc_group_to_child_raw_msg_response_process},
+        { TO_ROOT_LOC_CLAIM_MSG_ID, TO_ROOT_LOC_CLAIM_MSG_ID_RESP, loc_claim_to_root_raw_msg_process},
+        { TO_ROOT_LOC_CLAIM_MSG_ID_RESP, 0, loc_claim_to_root_raw_msg_response_process},
+        { TO_CHILD_LOC_GRANT_MSG_ID, TO_CHILD_LOC_GRANT_MSG_ID_RESP, loc_grant_to_child_raw_msg_process},
+        { TO_CHILD_LOC_GRANT_MSG_ID_RESP, 0, loc_grant_to_child_raw_msg_response_process},
+        { TO_ROOT_LOC_REPORT_MSG_ID, TO_ROOT_LOC_REPORT_MSG_ID_RESP, loc_report_to_root_raw_msg_process},
+        { TO_ROOT_LOC_REPORT_MSG_ID_RESP, 0, loc_report_to_root_raw_msg_response_process},
+        { TO_CHILD_PROBE_MSG_ID, TO_CHILD_PROBE_MSG_ID_RESP, probe_to_child_raw_msg_process},
+        { TO_CHILD_PROBE_MSG_ID_RESP, 0, probe_to_child_raw_msg_response_process},
         {0, 0, NULL}
     };
     esp_mesh_lite_raw_msg_action_list_register(raw_actions);
+    ota_mesh_init();
+
+    const loc_config_t loc_config = {
+        .distance = LOCALIZATION_ADJACENT_DISTANCE,
+        .pairs = loc_adjacent_pairs,
+        .pair_count = sizeof(loc_adjacent_pairs) / sizeof(loc_adjacent_pairs[0]),
+        .group_max = LOCALIZATION_GROUP_MAX,
+        .rssi_margin = LOCALIZATION_RSSI_MARGIN_DB,
+    };
+    loc_scheduler_init(&loc_scheduler, &loc_config);
+
+    loc_config_t probe_config = loc_config;
+    probe_config.group_max = PROBE_GROUP_MAX;
+    loc_scheduler_init(&probe_scheduler, &probe_config);
 
     static uint32_t lastDynamic = 0;
+    static uint32_t lastProbe = 0;
 
     while (1) 
     {
@@ -1081,8 +2083,13 @@ static void wifi_mesh_lite_task(void *pvParameters)
                 // take care of sequential switching during localization
                 if (atLeastOneRxNeedLocalization())
                 {
-                    pass_the_baton();
-                    //todo (make this smarter /hybrid for dead battery sceanario)
+                    localization_step();
+                }
+                // dead battery: an RX that cannot broadcast is found by probing the idle pads
+                else if (PROBE_PERIOD_MS && (xTaskGetTickCount() - lastProbe) * portTICK_PERIOD_MS >= PROBE_PERIOD_MS)
+                {
+                    probe_idle_pads();
+                    lastProbe = xTaskGetTickCount();
                 }
             }
             else
@@ -1146,6 +2153,46 @@ static void handle_mesh_changes_timercb(TimerHandle_t timer)
         printf("%ld: Level %d, MAC "MACSTR", %s, TTL %ld\r\n" , loop + 1, node->node->level, MAC2STR(node->node->mac_addr), inet_ntoa(ip_struct), node->ttl);
         node = node->next;
     }
+
+    if (is_root_node)
+    {
+        peer_pool_stats_t tx_pool, rx_pool;
+        peer_pool_get_stats(TX, &tx_pool);
+        peer_pool_get_stats(RX, &rx_pool);
+        ESP_LOGI(TAG, "Peer pool -- TX %d/%d (max %d, fail %ld), RX %d/%d (max %d, fail %ld), heap free %u, largest block %u",
+                 tx_pool.in_use, tx_pool.capacity, tx_pool.high_water, tx_pool.alloc_failures,
+                 rx_pool.in_use, rx_pool.capacity, rx_pool.high_water, rx_pool.alloc_failures,
+                 tx_pool.heap_free, tx_pool.heap_largest_block);
+        ESP_LOGI(TAG, "TX peers snapshot -- max lock hold %ld us", TX_peers_snapshot_max_hold_us());
+        mesh_codec_stats_t codec;
+        mesh_codec_get_stats(&codec);
+        ESP_LOGI(TAG, "Mesh codec -- bad major %ld, bad kind %ld, truncated %ld, out of sync %ld, duplicates %ld",
+                 codec.bad_major, codec.bad_kind, codec.truncated, codec.out_of_sync, codec.duplicates);
+    }
+
+    espnow_rx_stats_t rx_stats;
+    espnow_get_rx_stats(&rx_stats);
+    ESP_LOGI(TAG, "ESP-NOW rx -- frames %ld, dropped full %ld/%ld (high/normal), bad len %ld, send queue overruns %ld",
+             rx_stats.rx_frames, rx_stats.dropped_full[ESPNOW_LANE_HIGH], rx_stats.dropped_full[ESPNOW_LANE_NORMAL],
+             rx_stats.dropped_bad_len, rx_stats.queue_overruns);
+    espnow_tx_stats_t tx_stats;
+    espnow_get_tx_stats(&tx_stats);
+    ESP_LOGI(TAG, "ESP-NOW tx -- sent %ld, in flight %d, retransmissions %ld, given up %ld, window waits %ld, stale %ld (late cb %ld, lost cb %ld, stale events %ld), deferred %ld (dropped %ld)",
+             tx_stats.sent, tx_stats.in_flight, tx_stats.retransmissions, tx_stats.given_up,
+             tx_stats.window_waits, tx_stats.stale_reclaimed, tx_stats.late_callbacks, tx_stats.lost_callbacks, tx_stats.stale_events,
+             tx_stats.deferred, tx_stats.deferred_dropped);
+    // a high lane frame waits at most for the normal lane item in progress
+    ESP_LOGI(TAG, "ESP-NOW high lane bound -- longest normal item %ld us", rx_stats.normal_item_max_us);
+    for (int lane = 0; lane < ESPNOW_LANE_MAX; lane++)
+    {
+        espnow_latency_hist_t *hist = &rx_stats.latency[lane];
+        char buckets[ESPNOW_LATENCY_BUCKETS * 11 + 1];
+        int off = 0;
+        for (int i = 0; i < ESPNOW_LATENCY_BUCKETS; i++)
+            off += snprintf(buckets + off, sizeof(buckets) - off, " %ld", hist->bucket[i]);
+        ESP_LOGI(TAG, "ESP-NOW %s lane latency -- n %ld, max %ld us, log2 buckets from 64us:%s",
+                 lane == ESPNOW_LANE_HIGH ? "high" : "normal", hist->count, hist->max_us, buckets);
+    }
 }
 
 
@@ -1343,6 +2390,13 @@ void wifi_mesh_init()
     ESP_ERROR_CHECK(xTaskCreate(wifi_mesh_lite_task, "wifi_mesh_lite_task", 10000, NULL, 11, NULL));
 
     // ESP-NOW
+    //Create queue for send-callback events (received frames go through the ring)
+    espnow_queue = xQueueCreate(ESPNOW_QUEUE_SIZE, sizeof(espnow_event_t));
+    if (espnow_queue == NULL) {
+        ESP_LOGE(TAG, "Create ESP-NOW queue fail");
+        return;
+    }
+
     // Initialize ESP-NOW through mesh-lite //max payload ESPNOW_PAYLOAD_MAX_LEN
     // Register receive callback through mesh-lite function
     ESP_ERROR_CHECK(esp_mesh_lite_espnow_recv_cb_register(ESPNOW_DATA_TYPE_RESERVE, my_espnow_recv_cb));
@@ -1350,24 +2404,26 @@ void wifi_mesh_init()
     // Register send callback
     ESP_ERROR_CHECK(esp_now_register_send_cb(my_espnow_send_cb));
 
-    espnow_data = malloc(sizeof(espnow_data_t));
-    if (espnow_data == NULL) {
-        ESP_LOGE(TAG, "Malloc send buffer fail");
-        return;
-    }
-
     // Create ESPNOW task
-    ESP_ERROR_CHECK(xTaskCreate(espnow_task, "espnow_task", 4096, NULL, 11, NULL));
+    ESP_ERROR_CHECK(xTaskCreate(espnow_task, "espnow_task", 4096, NULL, 11, &espnow_task_handle));
 
     // Create alert high priority task
     ESP_ERROR_CHECK(xTaskCreate(alert_task, "alert_task", 4096, NULL, 10, NULL));
 
-    send_semaphore = xSemaphoreCreateBinary();
+    // all slots free at start
+    const espnow_window_config_t window_config = {
+        .slots = ESPNOW_MAX_IN_FLIGHT,
+        .peer_window = ESPNOW_PEER_WINDOW,
+        .max_retries = ESPNOW_MAX_RETRIES,
+        .slot_timeout_us = ESPNOW_TX_SLOT_TIMEOUT_MS * 1000LL,
+        .orphan_timeout_us = ESPNOW_TX_ORPHAN_TIMEOUT_MS * 1000LL,
+    };
+    espnow_window_init(&espnow_tx_window, &window_config);
+    send_semaphore = xSemaphoreCreateCounting(ESPNOW_MAX_IN_FLIGHT, ESPNOW_MAX_IN_FLIGHT);
     if (send_semaphore == NULL) {
         ESP_LOGE(TAG, "Create send semaphore fail");
         return;
     }
-    xSemaphoreGive(send_semaphore); // crucial
     
     ESP_LOGI(TAG, "ESP-MESH-LITE initialized");
 }
\ No newline at end of file
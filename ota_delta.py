@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+"""Generate delta OTA patches (format decoded by main/ota_delta.c)
+
+A patch rebuilds the new firmware from the firmware a node is running, so
+only the bytes that changed cross the network. The server hosts it next to
+firmware.bin as ota/patch/<running version>.patch; a node whose version has
+no patch (or whose image differs from the one the patch was made from)
+downloads the full image instead.
+
+Usage:
+    python ota_delta.py make <old.bin> <new.bin> [out.patch]
+    python ota_delta.py apply <old.bin> <patch> <out.bin>
+    python ota_delta.py info <patch>
+"""
+import hashlib
+import os
+import re
+import struct
+import sys
+
+MAGIC = b'BBD1'
+FORMAT_VERSION = 1
+HEADER_FMT = '<4sHHI32sI32s32s'
+HEADER_LEN = struct.calcsize(HEADER_FMT)   # 112, OTA_DELTA_HEADER_LEN
+OP_FMT = '<BII'                            # opcode, arg, len (OTA_DELTA_OP_LEN)
+
+OP_END = 0
+OP_COPY = 1
+OP_INSERT = 2
+
+BLOCK = 32          # bytes hashed to find a match
+STEP = 8            # source positions indexed (every STEP bytes)
+MIN_MATCH = 40      # shorter matches cost more in op headers than they save
+MAX_CANDIDATES = 16 # source positions tried per block
+
+# esp_image_header_t (24) + esp_image_segment_header_t (8), then esp_app_desc_t
+APP_DESC_OFFSET = 32
+APP_DESC_MAGIC = 0xABCD5432
+
+
+def app_version(image):
+    """Firmware version from the esp_app_desc_t of an image, or None"""
+    desc = image[APP_DESC_OFFSET:APP_DESC_OFFSET + 48]
+    if len(desc) < 48 or struct.unpack_from('<I', desc)[0] != APP_DESC_MAGIC:
+        return None
+    return desc[16:48].split(b'\0')[0].decode('ascii', 'replace')
+
+
+def patch_name(version):
+    """File name the node requests for its running version (same rule as ota_manager.c)"""
+    return re.sub(r'[^A-Za-z0-9._-]', '_', version) + '.patch'
+
+
+def match_length(a, i, b, j):
+    """Length of the common run of a[i:] and b[j:]"""
+    n = 0
+    limit = min(len(a) - i, len(b) - j)
+    # compare in slices first, bytes only for the last one
+    step = 256
+    while n + step <= limit and a[i + n:i + n + step] == b[j + n:j + n + step]:
+        n += step
+    while n < limit and a[i + n] == b[j + n]:
+        n += 1
+    return n
+
+
+def make_ops(old, new):
+    """Greedy COPY / INSERT list rebuilding new from old"""
+    index = {}
+    for pos in range(0, len(old) - BLOCK + 1, STEP):
+        index.setdefault(old[pos:pos + BLOCK], []).append(pos)
+
+    ops = []
+    literal_start = 0
+    i = 0
+    while i + BLOCK <= len(new):
+        candidates = index.get(new[i:i + BLOCK])
+        best_len, best_src, best_back = 0, 0, 0
+        if candidates:
+            for src in candidates[:MAX_CANDIDATES]:
+                length = match_length(new, i, old, src)
+                # extend backwards into the pending literal
+                back = 0
+                while back < i - literal_start and back < src and new[i - back - 1] == old[src - back - 1]:
+                    back += 1
+                if length + back > best_len + best_back:
+                    best_len, best_src, best_back = length, src, back
+
+        if best_len + best_back < MIN_MATCH:
+            i += 1
+            continue
+
+        start = i - best_back
+        if start > literal_start:
+            ops.append((OP_INSERT, literal_start, start - literal_start))
+        if ops and ops[-1][0] == OP_COPY and ops[-1][1] + ops[-1][2] == best_src - best_back:
+            ops[-1] = (OP_COPY, ops[-1][1], ops[-1][2] + best_len + best_back)
+        else:
+            ops.append((OP_COPY, best_src - best_back, best_len + best_back))
+        i += best_len
+        literal_start = i
+
+    if literal_start < len(new):
+        ops.append((OP_INSERT, literal_start, len(new) - literal_start))
+    return ops
+
+
+def make_patch(old, new):
+    version = (app_version(new) or '').encode('ascii', 'replace')[:32]
+    out = [struct.pack(HEADER_FMT, MAGIC, FORMAT_VERSION, HEADER_LEN,
+                       len(old), hashlib.sha256(old).digest(),
+                       len(new), hashlib.sha256(new).digest(),
+                       version.ljust(32, b'\0'))]
+    for op, arg, length in make_ops(old, new):
+        if op == OP_COPY:
+            out.append(struct.pack(OP_FMT, OP_COPY, arg, length))
+        else:
+            out.append(struct.pack(OP_FMT, OP_INSERT, 0, length))
+            out.append(new[arg:arg + length])
+    out.append(struct.pack(OP_FMT, OP_END, 0, 0))
+    return b''.join(out)
+
+
+def read_header(patch):
+    if len(patch) < HEADER_LEN:
+        raise ValueError('truncated header')
+    magic, fmt, hdr_len, src_size, src_sha, dst_size, dst_sha, version = struct.unpack_from(HEADER_FMT, patch)
+    if magic != MAGIC or fmt != FORMAT_VERSION or hdr_len != HEADER_LEN:
+        raise ValueError('not a delta patch (format %d)' % FORMAT_VERSION)
+    return src_size, src_sha, dst_size, dst_sha, version.split(b'\0')[0].decode('ascii', 'replace')
+
+
+def apply_patch(old, patch):
+    """Reference decoder, same checks as ota_delta.c"""
+    src_size, src_sha, dst_size, dst_sha, _ = read_header(patch)
+    if len(old) != src_size or hashlib.sha256(old).digest() != src_sha:
+        raise ValueError('patch made for another image')
+
+    out = bytearray()
+    pos = HEADER_LEN
+    while True:
+        op, arg, length = struct.unpack_from(OP_FMT, patch, pos)
+        pos += struct.calcsize(OP_FMT)
+        if op == OP_END:
+            break
+        if len(out) + length > dst_size:
+            raise ValueError('output beyond the target size')
+        if op == OP_COPY:
+            if arg + length > src_size:
+                raise ValueError('copy outside the source')
+            out += old[arg:arg + length]
+        elif op == OP_INSERT:
+            out += patch[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError('unknown opcode %d' % op)
+    if pos != len(patch) or len(out) != dst_size or hashlib.sha256(out).digest() != dst_sha:
+        raise ValueError('patch does not rebuild the target')
+    return bytes(out)
+
+
+def main(argv):
+    if len(argv) < 3 or argv[1] not in ('make', 'apply', 'info'):
+        print(__doc__.strip())
+        sys.exit(1)
+
+    if argv[1] == 'info':
+        patch = open(argv[2], 'rb').read()
+        src_size, src_sha, dst_size, dst_sha, version = read_header(patch)
+        print(f"source: {src_size} bytes, sha256 {src_sha.hex()}")
+        print(f"target: {dst_size} bytes, sha256 {dst_sha.hex()}, version {version}")
+        print(f"patch:  {len(patch)} bytes ({100 * len(patch) / max(dst_size, 1):.1f}% of the target)")
+        return
+
+    old = open(argv[2], 'rb').read()
+
+    if argv[1] == 'apply':
+        if len(argv) < 5:
+            print(__doc__.strip())
+            sys.exit(1)
+        new = apply_patch(old, open(argv[3], 'rb').read())
+        open(argv[4], 'wb').write(new)
+        print(f"Rebuilt {argv[4]}: {len(new)} bytes, sha256 {hashlib.sha256(new).hexdigest()}")
+        return
+
+    new = open(argv[3], 'rb').read()
+    out_path = argv[4] if len(argv) > 4 else None
+    if out_path is None:
+        version = app_version(old)
+        if version is None:
+            print("Error: no app descriptor in the old image, give the output file name")
+            sys.exit(1)
+        out_path = patch_name(version)
+
+    patch = make_patch(old, new)
+    apply_patch(old, patch)     # never publish a patch that does not rebuild the image
+    open(out_path, 'wb').write(patch)
+
+    print(f"Patch {app_version(old)} -> {app_version(new)}: {out_path}")
+    print(f"  {len(patch)} bytes, {100 * len(patch) / max(len(new), 1):.1f}% of the full image ({len(new)} bytes)")
+    print(f"  target sha256 {hashlib.sha256(new).hexdigest()}")
+    print(f"Upload it as ota/patch/{os.path.basename(out_path)} next to firmware.bin")
+
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -0,0 +1,261 @@
+/*
+ * Decimating ADC filter (user-014).
+ *
+ * adc_filter.c with the cru_hw.h settings (2 stages, shift 5, 250 samples per
+ * window at 10 kHz per channel) on 12-bit samples:
+ *
+ *   - DC plus switching ripple and conversion noise: the filtered output
+ *     stays within the theoretical gain of the cascade at the ripple
+ *     frequency, give or take the noise and the rounding;
+ *   - a step settles to 1% within a window, without overshoot, and reaches
+ *     the target exactly;
+ *   - min / max / mean / RMS of each window are exact for a square and a
+ *     sine wave, whatever the decimation;
+ *   - adc_filter_init rejects stages, shift and decimation out of range.
+ */
+#include "adc_filter.h"
+#include "host_test.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#define STAGES          2           // ADC_FILTER_STAGES
+#define SHIFT           5           // ADC_FILTER_SHIFT
+#define DECIMATION      250         // ADC_FILTER_DECIMATION
+#define RATE_HZ         10000       // ADC_SAMPLE_FREQ_HZ, shared by the two channels
+#define ADC_MAX         4095
+#define SETTLE_WINDOWS  4           // ignored before checking the ripple
+#define WINDOWS         400
+
+static const adc_filter_config_t firmware = { STAGES, SHIFT, DECIMATION };
+
+static uint16_t clamp(double v)
+{
+    return (uint16_t)(v < 0 ? 0 : v > ADC_MAX ? ADC_MAX : lround(v));
+}
+
+/* |H| of the cascade at f: each stage is y += a (x - y) */
+static double cascade_gain(const adc_filter_config_t *c, double f)
+{
+    const double a = 1.0 / (1 << c->shift), w = 2 * M_PI * f / RATE_HZ;
+    const double re = 1 - (1 - a) * cos(w), im = (1 - a) * sin(w);
+    return pow(a / sqrt(re * re + im * im), c->stages);
+}
+
+/* Residual ripple of the filtered output, in LSB */
+static double ripple_residual(const adc_filter_config_t *c, double dc, double amplitude, double f)
+{
+    adc_filter_t filter;
+    adc_filter_result_t out;
+    double residual = 0;
+    int windows = 0;
+
+    HOST_CHECK(adc_filter_init(&filter, c));
+    for (long n = 0; windows < WINDOWS; n++) {
+        double noise = (host_rand_unit() - 0.5) * 4;        // +-2 LSB of conversion noise
+        if (adc_filter_push(&filter, clamp(dc + amplitude * sin(2 * M_PI * f * n / RATE_HZ) + noise), &out) &&
+            ++windows > SETTLE_WINDOWS)
+            residual = fmax(residual, fabs(out.filtered - dc));
+    }
+    return residual;
+}
+
+static void check_ripple(void)
+{
+    // switching ripple aliased below Nyquist, off the window rate so the window end sees every phase
+    static const double freqs[] = { 330, 1234, 2750, 4321 };
+    const double dc = 2048, amplitude = 600;
+
+    printf("%-24s  %9s  %12s  %12s\n", "ripple (600 LSB)", "gain dB", "theory LSB", "residual LSB");
+    for (size_t i = 0; i < sizeof(freqs) / sizeof(freqs[0]); i++) {
+        double theory = amplitude * cascade_gain(&firmware, freqs[i]);
+        double residual = ripple_residual(&firmware, dc, amplitude, freqs[i]);
+        printf("%-20.1f Hz  %9.1f  %12.2f  %12.2f\n", freqs[i], 20 * log10(cascade_gain(&firmware, freqs[i])),
+               theory, residual);
+        // plus the filtered conversion noise and the rounding to an integer
+        HOST_CHECK(residual <= theory + 1.5);
+        HOST_CHECK(residual < amplitude / 20);
+    }
+
+    // one stage lets more through: the cascade is what reaches the attenuation
+    const adc_filter_config_t single = { 1, SHIFT, DECIMATION };
+    HOST_CHECK(ripple_residual(&single, dc, amplitude, 1234) > ripple_residual(&firmware, dc, amplitude, 1234));
+}
+
+/* Windows needed after the step for the filtered output to stay within 1% of it */
+static int step_response(uint16_t from, uint16_t to)
+{
+    adc_filter_t filter;
+    adc_filter_result_t out;
+    int windows = 0, settled = -1;
+    const double band = fabs((double)to - from) * 0.01;
+
+    HOST_CHECK(adc_filter_init(&filter, &firmware));
+    for (int n = 0; n < DECIMATION; n++)
+        adc_filter_push(&filter, from, &out);
+    HOST_CHECK(out.filtered == from);       // the first sample seeds the stages: no start-up ramp
+
+    for (int w = 1; w <= 20; w++) {
+        for (int n = 0; n < DECIMATION; n++)
+            HOST_CHECK(!adc_filter_push(&filter, to, &out) == (n < DECIMATION - 1));
+        windows++;
+        // real poles: no overshoot
+        HOST_CHECK(to > from ? out.filtered <= to && out.filtered >= from : out.filtered >= to && out.filtered <= from);
+        if (fabs((double)out.filtered - to) <= band) {
+            if (settled < 0)
+                settled = windows;
+        } else {
+            settled = -1;
+        }
+    }
+    HOST_CHECK(out.filtered == to);
+    return settled;
+}
+
+static void check_step(void)
+{
+    int up = step_response(500, 3500);
+    int down = step_response(3500, 500);
+
+    // the cascade settles to 1% in about 6.6 time constants of 2^SHIFT samples
+    printf("step 500 -> 3500 settled to 1%% in %d window(s), 3500 -> 500 in %d (%d samples each)\n",
+           up, down, DECIMATION);
+    HOST_CHECK(up == 1 && down == 1);
+}
+
+/* Reference statistics of the window [first, first + n) */
+static void reference(const uint16_t *x, int n, adc_filter_result_t *r)
+{
+    uint64_t sum = 0, sum_sq = 0;
+
+    r->min = UINT16_MAX;
+    r->max = 0;
+    for (int i = 0; i < n; i++) {
+        r->min = x[i] < r->min ? x[i] : r->min;
+        r->max = x[i] > r->max ? x[i] : r->max;
+        sum += x[i];
+        sum_sq += (uint64_t)x[i] * x[i];
+    }
+    r->mean = (uint16_t)((sum + n / 2) / n);
+    r->rms = (uint16_t)floor(sqrt((double)(sum_sq / n)));
+    r->samples = (uint16_t)n;
+}
+
+/* Every window of the signal against the reference */
+static int check_windows(const adc_filter_config_t *c, const uint16_t *x, int len)
+{
+    adc_filter_t filter;
+    adc_filter_result_t out, ref;
+    int windows = 0;
+
+    HOST_CHECK(adc_filter_init(&filter, c));
+    for (int i = 0; i < len; i++) {
+        if (!adc_filter_push(&filter, x[i], &out))
+            continue;
+        reference(&x[i + 1 - c->decimation], c->decimation, &ref);
+        HOST_CHECK(out.samples == c->decimation);
+        HOST_CHECK(out.min == ref.min && out.max == ref.max && out.mean == ref.mean && out.rms == ref.rms);
+        windows++;
+    }
+    return windows;
+}
+
+static void check_statistics(void)
+{
+    static uint16_t x[DECIMATION * 20];
+    const int len = (int)(sizeof(x) / sizeof(x[0]));
+    adc_filter_t filter;
+    adc_filter_result_t out;
+
+    // square wave 1000 / 3000, period 50 samples: known values per window
+    for (int i = 0; i < len; i++)
+        x[i] = (i % 50) < 25 ? 1000 : 3000;
+    HOST_CHECK(adc_filter_init(&filter, &firmware));
+    for (int i = 0; i < len; i++) {
+        if (adc_filter_push(&filter, x[i], &out)) {
+            // RMS = sqrt((1000^2 + 3000^2) / 2) = 2236.07
+            HOST_CHECK(out.min == 1000 && out.max == 3000 && out.mean == 2000 && out.rms == 2236);
+            HOST_CHECK(out.samples == DECIMATION);
+        }
+    }
+    HOST_CHECK(check_windows(&firmware, x, len) == len / DECIMATION);
+
+    // sine 2048 +- 1500 at 200 Hz, a whole number of periods per window, peaks on samples
+    for (int i = 0; i < len; i++)
+        x[i] = clamp(2048 + 1500 * cos(2 * M_PI * 200 * i / RATE_HZ));
+    HOST_CHECK(adc_filter_init(&filter, &firmware));
+    for (int i = 0; i < len; i++) {
+        if (adc_filter_push(&filter, x[i], &out)) {
+            // RMS = sqrt(2048^2 + 1500^2 / 2) = 2306.4, within the rounding of the samples
+            HOST_CHECK(out.min == 548 && out.max == 3548);
+            HOST_CHECK(abs((int)out.mean - 2048) <= 1 && abs((int)out.rms - 2306) <= 1);
+        }
+    }
+    HOST_CHECK(check_windows(&firmware, x, len) == len / DECIMATION);
+
+    // random signals, decimations that do not divide the period
+    static const uint16_t decimations[] = { 1, 2, 7, 64, 251, 1000 };
+    for (size_t d = 0; d < sizeof(decimations) / sizeof(decimations[0]); d++) {
+        const adc_filter_config_t c = { STAGES, SHIFT, decimations[d] };
+        for (int i = 0; i < len; i++)
+            x[i] = (uint16_t)(host_rand() % (ADC_MAX + 1));
+        HOST_CHECK(check_windows(&c, x, len) == len / decimations[d]);
+    }
+
+    // reset drops the partial window
+    HOST_CHECK(adc_filter_init(&filter, &firmware));
+    for (int i = 0; i < DECIMATION / 2; i++)
+        adc_filter_push(&filter, ADC_MAX, &out);
+    adc_filter_reset(&filter);
+    for (int i = 0; i < DECIMATION; i++)
+        adc_filter_push(&filter, 100, &out);
+    HOST_CHECK(out.max == 100 && out.filtered == 100);
+}
+
+static void check_config(void)
+{
+    adc_filter_t filter;
+    static const struct {
+        adc_filter_config_t config;
+        bool valid;
+    } cases[] = {
+        { { 0, SHIFT, DECIMATION }, false },
+        { { 1, SHIFT, DECIMATION }, true },
+        { { ADC_FILTER_MAX_STAGES, SHIFT, DECIMATION }, true },
+        { { ADC_FILTER_MAX_STAGES + 1, SHIFT, DECIMATION }, false },
+        { { STAGES, 0, DECIMATION }, false },
+        { { STAGES, 1, DECIMATION }, true },
+        { { STAGES, 12, DECIMATION }, true },
+        { { STAGES, 13, DECIMATION }, false },
+        { { STAGES, SHIFT, 0 }, false },
+        { { STAGES, SHIFT, 1 }, true },
+        { { STAGES, SHIFT, UINT16_MAX }, true },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        HOST_CHECK(adc_filter_init(&filter, &cases[i].config) == cases[i].valid);
+    HOST_CHECK(!adc_filter_init(NULL, &firmware));
+    HOST_CHECK(!adc_filter_init(&filter, NULL));
+
+    // the widest valid shift and the largest 12-bit swing stay inside the Q16 state
+    const adc_filter_config_t widest = { ADC_FILTER_MAX_STAGES, 12, 1 };
+    adc_filter_result_t out;
+    HOST_CHECK(adc_filter_init(&filter, &widest));
+    adc_filter_push(&filter, 0, &out);
+    for (int i = 0; i < 200000; i++)
+        adc_filter_push(&filter, ADC_MAX, &out);
+    HOST_CHECK(out.filtered == ADC_MAX);
+}
+
+int main(void)
+{
+    host_seed(2024);
+
+    check_config();
+    check_ripple();
+    check_step();
+    check_statistics();
+
+    return host_test_result();
+}
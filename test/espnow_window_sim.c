@@ -0,0 +1,323 @@
+/*
+ * ESP-NOW send window over a lossy link (user-006).
+ *
+ * espnow_window.c with the wifiMesh.h settings, fed by senders that always
+ * have a frame for each of PEERS peers, the way espnow_send_frame takes a
+ * slot. The radio sends one frame at a time; a send callback comes back
+ * LAT_MIN_US..LAT_MAX_US after the frame left (later for a failed one), in
+ * send order. A frame fails with probability `loss`; espnow_task handles the
+ * failure TASK_US later and retransmits or gives up. Now and then the
+ * WiFi task stalls for longer than the slot timeout, so slots are reclaimed
+ * and reused before their callback comes.
+ *
+ * The old path is the binary semaphore: one frame in flight, modelled as a
+ * window of one slot (so it also gets the stale-slot recovery it lacked).
+ *
+ * Reports delivered frames per second, and checks that a callback or a
+ * retransmission only ever acts on the slot of its own frame: a late
+ * callback of a reclaimed frame must never complete or fail the newer
+ * frame that reused the slot. At the end no slot may be left in flight.
+ *
+ * A last run also loses one callback in LOST_ODDS. A callback carries no
+ * frame identity, so the next callback of that peer then completes the frame
+ * whose callback was lost until the stale timeout clears it; that is only
+ * reported. Late callbacks must still never reach a slot, and the window
+ * must not leak.
+ */
+#include "espnow_window.h"
+#include "host_test.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#define PEERS           4
+#define SLOTS           4           // ESPNOW_MAX_IN_FLIGHT
+#define PEER_WINDOW     2           // ESPNOW_PEER_WINDOW
+#define MAX_RETRIES     3           // ESPNOW_MAX_RETRIES
+#define SLOT_TIMEOUT_US 500000      // ESPNOW_TX_SLOT_TIMEOUT_MS
+#define ORPHAN_US       5000000     // ESPNOW_TX_ORPHAN_TIMEOUT_MS
+#define AIR_US          500         // one espnow_data_t on air
+#define LAT_MIN_US      1000        // send callback after the frame left
+#define LAT_MAX_US      4000
+#define FAIL_EXTRA_US   2000        // a failed frame is called back after the MAC retries
+#define TASK_US         300         // espnow_task picks up a failure event
+#define STALL_ODDS      2000        // one callback in STALL_ODDS is held 1.2 - 3 slot timeouts
+#define LOST_ODDS       5000        // last run: one callback in LOST_ODDS never comes
+#define STEP_US         50
+#define RUN_US          5000000
+#define SEEDS           5
+#define MAX_TX          65536
+#define MAX_EVENTS      4096
+
+typedef struct {
+    int frame;
+    int peer;
+    int64_t cb_us;
+    bool ok;
+    bool lost;                      // the callback never comes
+    bool reclaimed;                 // its slot was reclaimed before the callback
+} tx_t;
+
+typedef struct {
+    int64_t due_us;
+    int slot;
+    uint16_t seq;
+    int tx;
+} task_event_t;
+
+typedef struct {
+    double fps;
+    uint32_t given_up, late, lost, stale, violations, reclaimed_frames;
+    uint32_t misattributed;         // a live frame's callback completed another frame of its peer
+} result_t;
+
+static tx_t txs[MAX_TX];
+static int tx_count, cb_head;
+static task_event_t events[MAX_EVENTS];
+static int event_head, event_tail;
+static bool delivered[MAX_TX];
+static int slot_tx[ESPNOW_WINDOW_MAX_SLOTS];    // transmission holding each slot, -1 if free
+static int64_t radio_free_us, last_cb_us;
+
+static void peer_mac(int peer, uint8_t *mac)
+{
+    static const uint8_t base[ESPNOW_WINDOW_MAC_LEN] = { 0x24, 0x6F, 0x28, 0x00, 0x00, 0x00 };
+    memcpy(mac, base, ESPNOW_WINDOW_MAC_LEN);
+    mac[5] = (uint8_t)(0x10 + peer);
+}
+
+static int64_t uniform_us(int64_t lo, int64_t hi)
+{
+    return lo + (int64_t)(host_rand_unit() * (double)(hi - lo));
+}
+
+/* Hand a frame to the radio, callbacks stay in send order */
+static int transmit(int frame, int peer, int64_t now, double loss, uint32_t lost_odds)
+{
+    int id = tx_count++;
+    tx_t *t = &txs[id];
+    int64_t start = now > radio_free_us ? now : radio_free_us;
+
+    radio_free_us = start + AIR_US;
+    t->frame = frame;
+    t->peer = peer;
+    t->ok = host_rand_unit() >= loss;
+    t->lost = lost_odds && host_rand() % lost_odds == 0;
+    t->reclaimed = false;
+    t->cb_us = radio_free_us + uniform_us(LAT_MIN_US, LAT_MAX_US) + (t->ok ? 0 : FAIL_EXTRA_US);
+    if (host_rand() % STALL_ODDS == 0)
+        t->cb_us += uniform_us(SLOT_TIMEOUT_US * 6 / 5, SLOT_TIMEOUT_US * 3);
+    if (t->cb_us < last_cb_us)
+        t->cb_us = last_cb_us;
+    last_cb_us = t->cb_us;
+    return id;
+}
+
+/* Reclaim the stale slots, their frames' callbacks are late from now on */
+static void reclaim(espnow_window_t *w, int64_t now, result_t *r)
+{
+    bool used[ESPNOW_WINDOW_MAX_SLOTS];
+
+    for (int i = 0; i < w->config.slots; i++)
+        used[i] = w->slot[i].used;
+    if (espnow_window_reclaim_stale(w, now) == 0)
+        return;
+    for (int i = 0; i < w->config.slots; i++) {
+        if (used[i] && !w->slot[i].used) {
+            txs[slot_tx[i]].reclaimed = true;
+            r->reclaimed_frames += !delivered[txs[slot_tx[i]].frame];
+            slot_tx[i] = -1;
+        }
+    }
+}
+
+static void callbacks(espnow_window_t *w, int64_t now, result_t *r)
+{
+    while (cb_head < tx_count && txs[cb_head].cb_us <= now) {
+        int id = cb_head++;
+        tx_t *t = &txs[id];
+        uint8_t mac[ESPNOW_WINDOW_MAC_LEN];
+        int slot;
+        uint16_t seq;
+
+        if (t->lost)
+            continue;
+        if (t->ok)
+            delivered[t->frame] = true;
+
+        peer_mac(t->peer, mac);
+        espnow_window_callback_t res = espnow_window_callback(w, mac, t->ok, now, &slot, &seq);
+        if (res == ESPNOW_WINDOW_ACKED || res == ESPNOW_WINDOW_FAILED) {
+            // must be this very transmission's slot: a late callback never reaches one, reused or not
+            if (slot_tx[slot] != id) {
+                if (t->reclaimed || slot_tx[slot] < 0 || txs[slot_tx[slot]].peer != t->peer ||
+                    !txs[slot_tx[slot]].lost) {
+                    r->violations++;
+                    continue;
+                }
+                // an earlier callback of this peer was lost, the window completes that frame instead,
+                // and for the window this frame's callback is the lost one now
+                r->misattributed++;
+                t->lost = true;
+                id = slot_tx[slot];
+            }
+            if (res == ESPNOW_WINDOW_ACKED) {
+                slot_tx[slot] = -1;
+            } else {
+                HOST_CHECK(event_tail - event_head < MAX_EVENTS);
+                events[event_tail++ % MAX_EVENTS] = (task_event_t){ now + TASK_US, slot, seq, id };
+            }
+        } else if (!t->reclaimed) {
+            // a frame still in flight was not matched: its slot would leak
+            r->violations++;
+        }
+    }
+}
+
+static void task_events(espnow_window_t *w, int64_t now, double loss, uint32_t lost_odds, result_t *r)
+{
+    while (event_head < event_tail && events[event_head % MAX_EVENTS].due_us <= now) {
+        task_event_t e = events[event_head++ % MAX_EVENTS];
+
+        switch (espnow_window_retry(w, e.slot, e.seq, now)) {
+        case ESPNOW_WINDOW_RESEND:
+            if (slot_tx[e.slot] != e.tx) {
+                r->violations++;
+                break;
+            }
+            slot_tx[e.slot] = transmit(txs[e.tx].frame, txs[e.tx].peer, now, loss, lost_odds);
+            break;
+        case ESPNOW_WINDOW_GIVE_UP:
+            if (slot_tx[e.slot] != e.tx)
+                r->violations++;
+            slot_tx[e.slot] = -1;
+            r->given_up++;
+            break;
+        case ESPNOW_WINDOW_STALE:
+            // only once the failed frame lost its slot
+            if (slot_tx[e.slot] == e.tx)
+                r->violations++;
+            break;
+        }
+    }
+}
+
+static result_t run(uint8_t slots, uint8_t peer_window, double loss, uint32_t lost_odds)
+{
+    const espnow_window_config_t config = { slots, peer_window, MAX_RETRIES, SLOT_TIMEOUT_US, ORPHAN_US };
+    espnow_window_t w;
+    result_t r = { 0 };
+    int frames = 0, next_peer = 0;
+    int64_t now = 0;
+
+    espnow_window_init(&w, &config);
+    tx_count = cb_head = event_head = event_tail = 0;
+    radio_free_us = last_cb_us = 0;
+    memset(delivered, 0, sizeof(delivered));
+    for (int i = 0; i < ESPNOW_WINDOW_MAX_SLOTS; i++)
+        slot_tx[i] = -1;
+
+    for (now = 0; now < RUN_US || cb_head < tx_count || event_head < event_tail; now += STEP_US) {
+        callbacks(&w, now, &r);
+        task_events(&w, now, loss, lost_odds, &r);
+
+        // senders: one frame per peer per step at most, while slots are free
+        bool blocked = false;
+        for (int k = 0; k < PEERS && now < RUN_US; k++) {
+            int peer = (next_peer + k) % PEERS;
+            uint8_t mac[ESPNOW_WINDOW_MAC_LEN];
+            peer_mac(peer, mac);
+            int slot = espnow_window_acquire(&w, mac, now);
+            if (slot < 0) {
+                blocked = true;
+                continue;
+            }
+            HOST_CHECK(tx_count < MAX_TX - 1);
+            slot_tx[slot] = transmit(frames++, peer, now, loss, lost_odds);
+        }
+        next_peer = (next_peer + 1) % PEERS;
+        if (blocked)
+            reclaim(&w, now, &r);
+    }
+
+    // the callbacks that never came: their slots go stale
+    reclaim(&w, now + SLOT_TIMEOUT_US + 1, &r);
+    HOST_CHECK(espnow_window_in_flight(&w, NULL) == 0);
+
+    uint32_t got = 0;
+    for (int f = 0; f < frames; f++)
+        got += delivered[f];
+    r.fps = got * 1e6 / RUN_US;
+    r.late = w.stats.late_callbacks;
+    r.lost = w.stats.lost_callbacks;
+    r.stale = w.stats.stale_events;
+    return r;
+}
+
+static void print_row(const char *path, double loss, const result_t *r)
+{
+    printf("%-14s  %5.2f  %9.0f  %9" PRIu32 "  %9" PRIu32 "  %9" PRIu32 "  %11" PRIu32 "\n", path, loss, r->fps,
+           r->given_up, r->reclaimed_frames, r->late, r->stale);
+}
+
+static void add(result_t *sum, const result_t *r)
+{
+    sum->fps += r->fps / SEEDS;
+    sum->given_up += r->given_up;
+    sum->reclaimed_frames += r->reclaimed_frames;
+    sum->late += r->late;
+    sum->lost += r->lost;
+    sum->stale += r->stale;
+    sum->violations += r->violations;
+    sum->misattributed += r->misattributed;
+}
+
+int main(void)
+{
+    static const double losses[] = { 0.0, 0.1, 0.3 };
+    uint32_t violations = 0, late = 0;
+
+    printf("%d peers, %d us on air, callback %d-%d us, 1 stall in %d, %d seeds x %d s\n",
+           PEERS, AIR_US, LAT_MIN_US, LAT_MAX_US, STALL_ODDS, SEEDS, RUN_US / 1000000);
+    printf("%-14s  %5s  %9s  %9s  %9s  %9s  %11s\n", "path", "loss", "frames/s", "given up", "reclaimed",
+           "late cb", "stale evts");
+    for (size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+        result_t old = { 0 }, win = { 0 };
+
+        for (int seed = 1; seed <= SEEDS; seed++) {
+            host_seed((uint64_t)seed * 7919 + l);
+            result_t a = run(1, 1, losses[l], 0);
+            host_seed((uint64_t)seed * 7919 + l);
+            result_t b = run(SLOTS, PEER_WINDOW, losses[l], 0);
+            add(&old, &a);
+            add(&win, &b);
+        }
+        print_row("one in flight", losses[l], &old);
+        print_row("window", losses[l], &win);
+        violations += old.violations + win.violations;
+        late += old.late + win.late;
+
+        // the window overlaps the callback latency of several frames
+        HOST_CHECK(win.fps > 2 * old.fps);
+    }
+
+    // stalls did reclaim slots whose callbacks came later, and none of them hit a slot
+    HOST_CHECK(late > 0);
+    HOST_CHECK(violations == 0);
+    printf("callbacks or retries acting on another frame's slot: %" PRIu32 "\n", violations);
+
+    result_t lost = { 0 };
+    for (int seed = 1; seed <= SEEDS; seed++) {
+        host_seed((uint64_t)seed * 7919);
+        result_t r = run(SLOTS, PEER_WINDOW, 0.1, LOST_ODDS);
+        add(&lost, &r);
+    }
+    print_row("window, lost", 0.1, &lost);
+    printf("1 callback in %d lost: %" PRIu32 " detected by a later frame's callback, "
+           "%" PRIu32 " callbacks completed the previous frame of their peer\n",
+           LOST_ODDS, lost.lost, lost.misattributed);
+    HOST_CHECK(lost.violations == 0);
+    HOST_CHECK(lost.lost > 0);
+
+    return host_test_result();
+}
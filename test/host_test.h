@@ -0,0 +1,63 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+/*
+ * Minimal helpers shared by the host tests: checks that count failures
+ * instead of aborting, a seedable PRNG so runs are reproducible, and a
+ * monotonic clock for the benchmarks. Header only, one test per executable.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static int host_failures = 0;
+
+#define HOST_CHECK(cond) do { \
+        if (!(cond)) { \
+            host_failures++; \
+            if (host_failures <= 20) \
+                fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+static uint64_t host_rand_state = 0x9E3779B97F4A7C15ull;
+
+static inline void host_seed(uint64_t seed)
+{
+    host_rand_state = seed ? seed : 0x9E3779B97F4A7C15ull;
+}
+
+/* xorshift64* */
+static inline uint32_t host_rand(void)
+{
+    uint64_t x = host_rand_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    host_rand_state = x;
+    return (uint32_t)((x * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+/* Uniform in [0, 1) */
+static inline double host_rand_unit(void)
+{
+    return host_rand() / 4294967296.0;
+}
+
+static inline uint64_t host_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Exit status of the test */
+static inline int host_test_result(void)
+{
+    if (host_failures)
+        fprintf(stderr, "%d check(s) failed\n", host_failures);
+    return host_failures ? 1 : 0;
+}
+
+#endif /* HOST_TEST_H */
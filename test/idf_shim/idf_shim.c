@@ -0,0 +1,209 @@
+/*
+ * FreeRTOS tasks, notifications and queues on pthreads, for the firmware
+ * sources that hand work between tasks (ota_manager.c).
+ */
+#include "idf_shim.h"
+
+#include <errno.h>
+
+struct idf_shim_task {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notified;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+struct idf_shim_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length, item_size, head, count;
+    uint8_t items[];
+};
+
+static __thread struct idf_shim_task *current_task;
+
+static struct idf_shim_task *task_new(void)
+{
+    struct idf_shim_task *t = calloc(1, sizeof(*t));
+    assert(t != NULL);
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+    return t;
+}
+
+/* Absolute CLOCK_REALTIME deadline `ticks` milliseconds away, for pthread_cond_timedwait */
+static struct timespec deadline(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+/* Waits on cond while pred() is false; false on timeout */
+static bool wait_until(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks,
+                       bool (*pred)(void *), void *arg)
+{
+    struct timespec end = deadline(ticks);
+
+    while (!pred(arg)) {
+        if (ticks == 0)
+            return false;
+        if (ticks == portMAX_DELAY)
+            pthread_cond_wait(cond, lock);
+        else if (pthread_cond_timedwait(cond, lock, &end) == ETIMEDOUT)
+            return pred(arg);
+    }
+    return true;
+}
+
+static void *task_entry(void *arg)
+{
+    current_task = arg;
+    current_task->fn(current_task->arg);
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *created)
+{
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+
+    struct idf_shim_task *t = task_new();
+    t->fn = fn;
+    t->arg = arg;
+    if (created)
+        *created = t;
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&thread, &attr, task_entry, t);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        free(t);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    (void)task;
+    assert(task == NULL || task == current_task);
+    // nobody may notify a task that deleted itself, so its handle can go
+    struct idf_shim_task *t = current_task;
+    current_task = NULL;
+    if (t) {
+        pthread_cond_destroy(&t->cond);
+        pthread_mutex_destroy(&t->lock);
+        free(t);
+    }
+    pthread_exit(NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    // threads not created by xTaskCreate (main) get a handle on first use
+    if (current_task == NULL)
+        current_task = task_new();
+    return current_task;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    if (task == NULL)
+        return;
+    pthread_mutex_lock(&task->lock);
+    task->notified++;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+}
+
+static bool task_notified(void *arg)
+{
+    return ((struct idf_shim_task *)arg)->notified != 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    struct idf_shim_task *t = xTaskGetCurrentTaskHandle();
+
+    pthread_mutex_lock(&t->lock);
+    wait_until(&t->cond, &t->lock, ticks, task_notified, t);
+    uint32_t value = t->notified;
+    if (value)
+        t->notified = clear ? 0 : value - 1;
+    pthread_mutex_unlock(&t->lock);
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct idf_shim_queue *q = calloc(1, sizeof(*q) + (size_t)length * item_size);
+    if (q == NULL)
+        return NULL;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    if (q == NULL)
+        return;
+    pthread_cond_destroy(&q->changed);
+    pthread_mutex_destroy(&q->lock);
+    free(q);
+}
+
+static bool queue_has_room(void *arg)
+{
+    struct idf_shim_queue *q = arg;
+    return q->count < q->length;
+}
+
+static bool queue_has_item(void *arg)
+{
+    return ((struct idf_shim_queue *)arg)->count != 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = wait_until(&q->changed, &q->lock, ticks, queue_has_room, q);
+    if (ok) {
+        UBaseType_t tail = (q->head + q->count) % q->length;
+        memcpy(q->items + (size_t)tail * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdPASS : pdFAIL;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->lock);
+    bool ok = wait_until(&q->changed, &q->lock, ticks, queue_has_item, q);
+    if (ok) {
+        memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdPASS : pdFAIL;
+}
@@ -0,0 +1,296 @@
+#ifndef IDF_SHIM_H
+#define IDF_SHIM_H
+
+/*
+ * Just enough of ESP-IDF / FreeRTOS to build firmware sources that are not
+ * pure C (peer.c) on the host. Every IDF header name under test/idf_shim
+ * includes this file. Semaphores and critical sections map to pthread
+ * mutexes, ticks to CLOCK_MONOTONIC milliseconds, tasks and queues to
+ * pthreads (idf_shim.c). Anything a test does not exercise is declared
+ * only; the test provides it if it links it.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+/* sdkconfig */
+#ifndef MESH_LITE_MAXIMUM_NODE_NUMBER
+#define MESH_LITE_MAXIMUM_NODE_NUMBER   20
+#endif
+#define ETH_HWADDR_LEN                  6
+
+/* esp_err.h */
+typedef int esp_err_t;
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_NO_MEM          0x101
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_STATE   0x103
+#define ESP_ERR_INVALID_SIZE    0x104
+#define ESP_ERR_NOT_FOUND       0x105
+#define ESP_ERR_TIMEOUT         0x107
+#define ESP_ERR_INVALID_VERSION 0x10A
+static inline const char *esp_err_to_name(esp_err_t err) { (void)err; return "ESP_ERR"; }
+
+/* esp_log.h */
+#ifndef IDF_SHIM_LOG
+#define IDF_SHIM_LOG 0
+#endif
+#define IDF_SHIM_PRINT(level, tag, fmt, ...) do { \
+        if (IDF_SHIM_LOG) printf(level " (%s) " fmt "\n", tag, ##__VA_ARGS__); \
+    } while (0)
+#define ESP_LOGE(tag, fmt, ...) IDF_SHIM_PRINT("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) IDF_SHIM_PRINT("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) IDF_SHIM_PRINT("I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) IDF_SHIM_PRINT("D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) IDF_SHIM_PRINT("V", tag, fmt, ##__VA_ARGS__)
+#define MACSTR "%02x:%02x:%02x:%02x:%02x:%02x"
+#define MAC2STR(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
+
+/* esp_timer.h */
+static inline int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* esp_heap_caps.h */
+#define MALLOC_CAP_8BIT         (1 << 2)
+static inline size_t heap_caps_get_free_size(uint32_t caps) { (void)caps; return 0; }
+static inline size_t heap_caps_get_largest_free_block(uint32_t caps) { (void)caps; return 0; }
+
+/* FreeRTOS */
+typedef uint32_t TickType_t;
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           UINT32_MAX
+#define portTICK_PERIOD_MS      1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+#define BIT0                    (1 << 0)
+#define BIT1                    (1 << 1)
+#define BIT2                    (1 << 2)
+#define BIT3                    (1 << 3)
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+/* Tests that exercise long retry delays may shorten them, ticks stay milliseconds */
+#ifndef IDF_SHIM_DELAY_DIVISOR
+#define IDF_SHIM_DELAY_DIVISOR  1
+#endif
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0)
+        sched_yield();
+    else
+        usleep((useconds_t)((uint64_t)ticks * 1000 / IDF_SHIM_DELAY_DIVISOR));
+}
+
+/* Tasks are detached pthreads, notifications a counter (idf_shim.c) */
+typedef struct idf_shim_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *created);
+void vTaskDelete(TaskHandle_t task);    // the calling task only (NULL)
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+
+/* Queues copy items by value like FreeRTOS (idf_shim.c) */
+typedef struct idf_shim_queue *QueueHandle_t;
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+
+typedef void *TimerHandle_t;
+typedef void *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+/* Mutex semaphores (the only kind the shimmed sources create) */
+typedef pthread_mutex_t *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    pthread_mutex_t *m = malloc(sizeof(*m));
+    if (m)
+        pthread_mutex_init(m, NULL);
+    return m;
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t m, TickType_t ticks)
+{
+    (void)ticks;
+    return pthread_mutex_lock(m) == 0 ? pdTRUE : pdFALSE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t m)
+{
+    return pthread_mutex_unlock(m) == 0 ? pdTRUE : pdFALSE;
+}
+
+/* portMUX critical sections */
+typedef struct { pthread_mutex_t m; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    { PTHREAD_MUTEX_INITIALIZER }
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(&(mux)->m)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(&(mux)->m)
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+
+/* Opaque handles of drivers the shimmed headers mention */
+typedef uint32_t nvs_handle_t;
+typedef void *esp_mqtt_client_handle_t;
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data,
+                            int len, int qos, int retain);
+typedef void *led_strip_handle_t;
+typedef void *adc_continuous_handle_t;
+typedef void *adc_cali_handle_t;
+typedef int adc_channel_t;
+typedef int i2c_port_t;
+typedef int uart_port_t;
+typedef int gpio_num_t;
+#define I2C_NUM_0               0
+#define I2C_MASTER_WRITE        0
+#define I2C_MASTER_READ         1
+#define UART_NUM_1              1
+#define UART_NUM_2              2
+
+/* mbedtls/sha256.h - software SHA256 (sha256.c), the context is plain data */
+typedef struct {
+    uint32_t total[2];
+    uint32_t state[8];
+    unsigned char buffer[64];
+    int is224;
+} mbedtls_sha256_context;
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_clone(mbedtls_sha256_context *dst, const mbedtls_sha256_context *src);
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t len);
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char output[32]);
+int mbedtls_sha256(const unsigned char *input, size_t len, unsigned char output[32], int is224);
+
+/* esp_system.h */
+void esp_restart(void);
+
+/* nvs.h - declared only, a test linking NVS users keeps the blobs itself */
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+#define ESP_ERR_NVS_NOT_FOUND   0x1102
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key);
+
+/* esp_app_format.h - same layout as the image, ota_delta.py reads it at offset 32 */
+#define ESP_APP_DESC_MAGIC_WORD 0xABCD5432
+typedef struct __attribute__((packed)) {
+    uint8_t magic, segment_count, spi_mode, spi_speed_size;
+    uint32_t entry_addr;
+    uint8_t reserved[16];
+} esp_image_header_t;
+typedef struct {
+    uint32_t load_addr;
+    uint32_t data_len;
+} esp_image_segment_header_t;
+typedef struct {
+    uint32_t magic_word;
+    uint32_t secure_version;
+    uint32_t reserv1[2];
+    char version[32];
+    char project_name[32];
+    char time[16];
+    char date[16];
+    char idf_ver[32];
+    uint8_t app_elf_sha256[32];
+    uint32_t reserv2[20];
+} esp_app_desc_t;
+const esp_app_desc_t *esp_app_get_description(void);
+
+/* esp_partition.h / esp_ota_ops.h - declared only, the test owns the flash */
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+typedef uint32_t esp_ota_handle_t;
+typedef enum {
+    ESP_OTA_IMG_NEW, ESP_OTA_IMG_PENDING_VERIFY, ESP_OTA_IMG_VALID,
+    ESP_OTA_IMG_INVALID, ESP_OTA_IMG_ABORTED, ESP_OTA_IMG_UNDEFINED
+} esp_ota_img_states_t;
+#define OTA_SIZE_UNKNOWN            0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES  0xfffffffe
+#define ESP_ERR_OTA_VALIDATE_FAILED 0x1503
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size);
+const esp_partition_t *esp_ota_get_running_partition(void);
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start);
+esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition, esp_ota_img_states_t *state);
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *handle);
+esp_err_t esp_ota_resume(const esp_partition_t *partition, size_t erase_size, size_t image_offset,
+                         esp_ota_handle_t *handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void);
+
+/* esp_http_client.h - declared only, the test plays the server */
+typedef struct esp_http_client *esp_http_client_handle_t;
+typedef enum {
+    HTTP_EVENT_ERROR, HTTP_EVENT_ON_CONNECTED, HTTP_EVENT_HEADERS_SENT, HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA, HTTP_EVENT_ON_FINISH, HTTP_EVENT_DISCONNECTED
+} esp_http_client_event_id_t;
+typedef struct {
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t client;
+    void *data;
+    int data_len;
+    void *user_data;
+    char *header_key;
+    char *header_value;
+} esp_http_client_event_t;
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *evt);
+typedef enum { HTTP_AUTH_TYPE_NONE, HTTP_AUTH_TYPE_BASIC, HTTP_AUTH_TYPE_DIGEST } esp_http_client_auth_type_t;
+typedef struct {
+    const char *url;
+    const char *cert_pem;
+    const char *username;
+    const char *password;
+    esp_http_client_auth_type_t auth_type;
+    int timeout_ms;
+    int buffer_size;
+    int buffer_size_tx;
+    http_event_handle_cb event_handler;
+    void *user_data;
+} esp_http_client_config_t;
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len);
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len);
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+
+#endif /* IDF_SHIM_H */
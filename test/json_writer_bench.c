@@ -0,0 +1,199 @@
+/*
+ * Dynamic payload serialization, json_writer vs cJSON (user-009).
+ *
+ * Builds the bumblebee/<id>/dynamic message the way dynamic_payload_to_json
+ * does and reports ns and heap allocations per message. Allocations are
+ * counted by wrapping malloc / calloc / realloc at link time.
+ *
+ * When libcjson is installed (HAVE_CJSON) the message is also built the way
+ * the firmware did before json_writer (a cJSON tree, PrintUnformatted,
+ * Delete), and both outputs must parse to the same document. cJSON allocates
+ * through counting hooks; with hooks it prints without realloc, so its count
+ * is a little above the firmware's.
+ */
+#include "json_writer.h"
+#include "host_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_CJSON
+#include <cjson/cJSON.h>
+#endif
+
+#define MESSAGES        200000
+#define DECIMALS        3           // MQTT_JSON_FLOAT_DECIMALS
+#define BUFFER_SIZE     1024        // MQTT_JSON_BUFFER_SIZE
+
+/* The fields of mesh_dynamic_payload_t that end up in the message */
+typedef struct {
+    uint8_t mac[6];
+    uint8_t id, status;
+    float voltage, current, temp1, temp2;
+} side_t;
+
+typedef struct {
+    side_t tx, rx;
+} payload_t;
+
+// volatile: the compiler assumes malloc leaves the program's globals alone
+static volatile unsigned long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    allocations++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+    allocations++;
+    return __real_realloc(p, size);
+}
+
+static void side_to_json(json_writer_t *jw, const char *key, const side_t *s)
+{
+    json_writer_object_begin(jw, key);
+    json_writer_mac(jw, "mac", s->mac);
+    json_writer_uint(jw, "id", s->id);
+    json_writer_uint(jw, "status", s->status);
+    json_writer_float(jw, "voltage", s->voltage, DECIMALS);
+    json_writer_float(jw, "current", s->current, DECIMALS);
+    json_writer_float(jw, "temp1", s->temp1, DECIMALS);
+    json_writer_float(jw, "temp2", s->temp2, DECIMALS);
+    json_writer_object_end(jw);
+}
+
+static const char *writer_message(char *buf, const payload_t *p, uint8_t unit_id)
+{
+    json_writer_t jw;
+
+    json_writer_init(&jw, buf, BUFFER_SIZE);
+    json_writer_object_begin(&jw, NULL);
+    json_writer_uint(&jw, "unit_id", unit_id);
+    side_to_json(&jw, "tx", &p->tx);
+    side_to_json(&jw, "rx", &p->rx);
+    json_writer_object_end(&jw);
+    return json_writer_finish(&jw);
+}
+
+#ifdef HAVE_CJSON
+static void side_to_cjson(cJSON *root, const char *key, const side_t *s)
+{
+    char mac[18];
+    cJSON *obj = cJSON_CreateObject();
+
+    snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+             s->mac[0], s->mac[1], s->mac[2], s->mac[3], s->mac[4], s->mac[5]);
+    cJSON_AddStringToObject(obj, "mac", mac);
+    cJSON_AddNumberToObject(obj, "id", s->id);
+    cJSON_AddNumberToObject(obj, "status", s->status);
+    cJSON_AddNumberToObject(obj, "voltage", s->voltage);
+    cJSON_AddNumberToObject(obj, "current", s->current);
+    cJSON_AddNumberToObject(obj, "temp1", s->temp1);
+    cJSON_AddNumberToObject(obj, "temp2", s->temp2);
+    cJSON_AddItemToObject(root, key, obj);
+}
+
+/* The removed dynamic_payload_to_cjson + PrintUnformatted (caller frees) */
+static char *cjson_message(const payload_t *p, uint8_t unit_id)
+{
+    cJSON *root = cJSON_CreateObject();
+
+    cJSON_AddNumberToObject(root, "unit_id", unit_id);
+    side_to_cjson(root, "tx", &p->tx);
+    side_to_cjson(root, "rx", &p->rx);
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+static void *counted_malloc(size_t size)
+{
+    return malloc(size);            // wrapped, so counted
+}
+
+static void counted_free(void *p)
+{
+    free(p);
+}
+#endif
+
+int main(void)
+{
+    static char buf[BUFFER_SIZE];
+    // values with an exact short decimal form, so both encoders agree
+    const payload_t p = {
+        { { 0x24, 0x6F, 0x28, 0x12, 0x34, 0x56 }, 3, 2, 48.5f, 1.875f, 35.25f, 33.75f },
+        { { 0x24, 0x6F, 0x28, 0xAB, 0xCD, 0xEF }, 101, 1, 52.25f, 1.75f, 38.5f, 37.125f },
+    };
+
+    const char *json = writer_message(buf, &p, 3);
+    HOST_CHECK(json != NULL);
+    HOST_CHECK(json && strcmp(json,
+        "{\"unit_id\":3,"
+        "\"tx\":{\"mac\":\"24:6F:28:12:34:56\",\"id\":3,\"status\":2,"
+        "\"voltage\":48.500,\"current\":1.875,\"temp1\":35.250,\"temp2\":33.750},"
+        "\"rx\":{\"mac\":\"24:6F:28:AB:CD:EF\",\"id\":101,\"status\":1,"
+        "\"voltage\":52.250,\"current\":1.750,\"temp1\":38.500,\"temp2\":37.125}}") == 0);
+    size_t writer_bytes = json ? strlen(json) : 0;
+
+    printf("%-12s  %10s  %14s  %6s\n", "encoder", "ns/msg", "allocs/msg", "bytes");
+
+    // the wrap is in place: an allocation of this file is counted
+    allocations = 0;
+    void *volatile probe = malloc(16);
+    free(probe);
+    HOST_CHECK(allocations == 1);
+
+    allocations = 0;
+    uint64_t t0 = host_now_ns();
+    for (int i = 0; i < MESSAGES; i++) {
+        payload_t q = p;
+        q.tx.voltage += (float)(i & 7);
+        writer_message(buf, &q, (uint8_t)i);
+    }
+    double writer_ns = (double)(host_now_ns() - t0) / MESSAGES;
+    unsigned long writer_allocs = allocations;
+    printf("%-12s  %10.0f  %14.2f  %6zu\n", "json_writer", writer_ns,
+           (double)writer_allocs / MESSAGES, writer_bytes);
+    HOST_CHECK(writer_allocs == 0);
+
+#ifdef HAVE_CJSON
+    cJSON_Hooks hooks = { counted_malloc, counted_free };
+    cJSON_InitHooks(&hooks);
+
+    // same document: names, nesting and values
+    char *old = cjson_message(&p, 3);
+    cJSON *a = cJSON_Parse(old), *b = cJSON_Parse(writer_message(buf, &p, 3));
+    HOST_CHECK(a && b && cJSON_Compare(a, b, true));
+    size_t cjson_bytes = old ? strlen(old) : 0;
+    cJSON_Delete(a);
+    cJSON_Delete(b);
+    cJSON_free(old);
+
+    allocations = 0;
+    t0 = host_now_ns();
+    for (int i = 0; i < MESSAGES; i++) {
+        payload_t q = p;
+        q.tx.voltage += (float)(i & 7);
+        cJSON_free(cjson_message(&q, (uint8_t)i));
+    }
+    double cjson_ns = (double)(host_now_ns() - t0) / MESSAGES;
+    printf("%-12s  %10.0f  %14.2f  %6zu\n", "cJSON", cjson_ns, (double)allocations / MESSAGES, cjson_bytes);
+    HOST_CHECK(allocations > 0);
+#else
+    printf("cJSON          not found, install libcjson-dev to compare\n");
+#endif
+
+    return host_test_result();
+}
@@ -0,0 +1,180 @@
+/*
+ * Time to localize scooters: baton vs parallel sweep (user-016).
+ *
+ * Pads sit in a row (positions 1..N, neighbours adjacent). Scooters park on
+ * random free pads at t = 0. A step costs LOCALIZATION_TIME_MS OFF plus
+ * LOCALIZATION_TIME_MS ON, like localization_step. A scooter's RX only
+ * broadcasts while the pad under it is energized, and every energized pad
+ * hears it with an RSSI that falls with the distance, plus noise.
+ *
+ *   baton:    one pad per step, round robin over the free pads
+ *   parallel: loc_next_group / loc_claims_resolve from localization.c
+ *
+ * Reports the mean and p99 time until each scooter is assigned, and checks
+ * that no scooter is ever assigned to a pad it is not on.
+ */
+#include "localization.h"
+#include "host_test.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STEP_MS         1000        // OFF + ON window of LOCALIZATION_TIME_MS each
+#define GROUP_MAX       8           // LOCALIZATION_GROUP_MAX
+#define RSSI_MARGIN     6           // LOCALIZATION_RSSI_MARGIN_DB
+#define TRIALS          2000
+#define MAX_STEPS       400
+#define MAX_SCOOTERS    8
+
+typedef struct {
+    uint8_t mac[6];
+    int8_t pad;                     // where it is parked
+    int located_ms;                 // -1 until assigned
+} scooter_t;
+
+static const loc_config_t config = { 1, NULL, 0, GROUP_MAX, RSSI_MARGIN };
+
+static double gauss(void)
+{
+    double u = host_rand_unit() + 1e-12, v = host_rand_unit();
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/* RSSI at pad `pos` of the RX parked on pad `on`: the pad under it is a few cm away */
+static int8_t rssi_at(int8_t pos, int8_t on)
+{
+    int d = abs(pos - on);
+    double rssi = (d == 0 ? -38.0 : -52.0 - 4.0 * d) + 3.0 * gauss();
+    return (int8_t)lround(rssi < -100 ? -100 : rssi);
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/* Free pads: not under a located scooter */
+static uint8_t candidates(int pads, const scooter_t *sc, int n, int8_t *out)
+{
+    uint8_t count = 0;
+    for (int8_t p = 1; p <= pads; p++) {
+        bool taken = false;
+        for (int i = 0; i < n; i++)
+            taken |= sc[i].located_ms >= 0 && sc[i].pad == p;
+        if (!taken)
+            out[count++] = p;
+    }
+    return count;
+}
+
+static void park(int pads, scooter_t *sc, int n)
+{
+    for (int i = 0; i < n; i++) {
+        bool clash;
+        do {
+            sc[i].pad = (int8_t)(1 + host_rand() % pads);
+            clash = false;
+            for (int j = 0; j < i; j++)
+                clash |= sc[j].pad == sc[i].pad;
+        } while (clash);
+        memset(sc[i].mac, 0, 6);
+        sc[i].mac[0] = 0x02;
+        sc[i].mac[5] = (uint8_t)(i + 1);
+        sc[i].located_ms = -1;
+    }
+}
+
+/* One trial, located times appended to times[] */
+static void run(bool parallel, int pads, int n, int *times, int *ntimes, int *wrong)
+{
+    scooter_t sc[MAX_SCOOTERS];
+    loc_scheduler_t sched;
+    loc_claims_t claims;
+    loc_assignment_t out[GROUP_MAX];
+    int8_t cand[LOCALIZATION_MAX_PADS], group[GROUP_MAX];
+
+    park(pads, sc, n);
+    loc_scheduler_init(&sched, &config);
+    // the sweep is somewhere in its cycle when the scooters arrive
+    int baton = (int)(host_rand() % pads);
+    uint8_t count = candidates(pads, sc, n, cand);
+    for (uint32_t k = host_rand() % pads; k; k--)
+        loc_next_group(&sched, cand, count, group);
+
+    int left = n;
+    for (int step = 1; step <= MAX_STEPS && left; step++) {
+        count = candidates(pads, sc, n, cand);
+        uint8_t len;
+        if (parallel) {
+            len = loc_next_group(&sched, cand, count, group);
+        } else {
+            group[0] = cand[baton++ % count];
+            len = 1;
+        }
+
+        loc_claims_reset(&claims);
+        for (int i = 0; i < n; i++) {
+            if (sc[i].located_ms >= 0)
+                continue;
+            bool powered = false;
+            for (int g = 0; g < len; g++)
+                powered |= group[g] == sc[i].pad;
+            if (!powered)
+                continue;
+            // every energized pad hears the broadcast (a few times per window)
+            for (int g = 0; g < len; g++)
+                for (int r = 0; r < 3; r++)
+                    loc_claims_add(&claims, sc[i].mac, group[g], rssi_at(group[g], sc[i].pad));
+        }
+
+        uint8_t assigned = loc_claims_resolve(&claims, &sched, out, GROUP_MAX);
+        for (int a = 0; a < assigned; a++) {
+            for (int i = 0; i < n; i++) {
+                if (memcmp(sc[i].mac, out[a].rx_mac, 6) != 0)
+                    continue;
+                if (out[a].position != sc[i].pad)
+                    (*wrong)++;
+                sc[i].located_ms = step * STEP_MS;
+                times[(*ntimes)++] = sc[i].located_ms;
+                left--;
+            }
+        }
+    }
+    HOST_CHECK(left == 0);
+}
+
+static double scenario(bool parallel, int pads, int n, int *p99_ms)
+{
+    static int times[TRIALS * MAX_SCOOTERS];
+    int ntimes = 0, wrong = 0;
+    double sum = 0;
+
+    for (int t = 0; t < TRIALS; t++)
+        run(parallel, pads, n, times, &ntimes, &wrong);
+    for (int i = 0; i < ntimes; i++)
+        sum += times[i];
+    qsort(times, ntimes, sizeof(times[0]), cmp_int);
+    *p99_ms = ntimes ? times[ntimes * 99 / 100] : 0;
+
+    HOST_CHECK(wrong == 0);
+    return ntimes ? sum / ntimes / 1000.0 : 0;
+}
+
+int main(void)
+{
+    static const int cases[][2] = { { 20, 1 }, { 20, 3 }, { 40, 6 } };
+
+    printf("time to localize each scooter, %d trials, %d ms per step\n", TRIALS, STEP_MS);
+    printf("pads  scooters   baton mean/p99 s   parallel mean/p99 s\n");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        int bp99, pp99;
+        double b = scenario(false, cases[c][0], cases[c][1], &bp99);
+        double p = scenario(true, cases[c][0], cases[c][1], &pp99);
+        printf("%4d  %8d   %6.1f / %5.1f     %6.1f / %5.1f\n",
+               cases[c][0], cases[c][1], b, bp99 / 1000.0, p, pp99 / 1000.0);
+        HOST_CHECK(p < b / 2);
+    }
+
+    return host_test_result();
+}
@@ -0,0 +1,286 @@
+/*
+ * mesh_codec round trips, robustness and size/throughput (user-007).
+ *
+ *   - random payload streams encoded as deltas (with the periodic full frame)
+ *     and decoded on the root's copy must match the quantized sender state;
+ *   - every truncation of a valid frame and random garbage must be rejected
+ *     without touching the destination;
+ *   - an unknown major is rejected and counted, a newer minor's tail skipped;
+ *   - a delta whose base the root did not apply is refused until a full frame;
+ *   - bytes per frame against the legacy struct, and encode/decode speed.
+ */
+#include "mesh_codec.h"
+#include "host_test.h"
+
+#define STREAM_FRAMES   200000
+#define GARBAGE_FRAMES  200000
+#define BENCH_FRAMES    2000000
+
+static const uint8_t tx_mac[ETH_HWADDR_LEN] = { 0x24, 0x6F, 0x28, 0x00, 0x00, 0x10 };
+
+/* Charging pad telemetry: values move a little between ticks, the RX comes and goes */
+static void payload_step(mesh_dynamic_payload_t *d)
+{
+    memcpy(d->TX.macAddr, tx_mac, ETH_HWADDR_LEN);
+    if (host_rand() % 50 == 0)
+        d->TX.tx_status = (TX_status)(host_rand() % 4);
+    d->TX.voltage = 48.0f + (float)(host_rand_unit() * 0.2 - 0.1);
+    d->TX.current = 1.0f + (float)(host_rand_unit() * 0.02);
+    if (host_rand() % 10 == 0)
+        d->TX.temp1 += (float)(host_rand_unit() - 0.5);
+    if (host_rand() % 10 == 0)
+        d->TX.temp2 += (float)(host_rand_unit() - 0.5);
+
+    if (host_rand() % 100 == 0) {
+        if (d->RX.macAddr[0]) {
+            memset(&d->RX, 0, sizeof(d->RX));
+        } else {
+            for (int i = 0; i < ETH_HWADDR_LEN; i++)
+                d->RX.macAddr[i] = (uint8_t)host_rand();
+            d->RX.macAddr[0] |= 1;
+            d->RX.id = (uint8_t)host_rand();
+        }
+    }
+    if (d->RX.macAddr[0]) {
+        d->RX.rx_status = (RX_status)(host_rand() % 3);
+        d->RX.voltage = 42.0f + (float)host_rand_unit();
+        d->RX.current = 0.9f + (float)(host_rand_unit() * 0.05);
+    }
+}
+
+/* Any payload, including values outside the fixed point range */
+static void payload_random(mesh_dynamic_payload_t *d)
+{
+    uint8_t *raw = (uint8_t *)d;
+    for (size_t i = 0; i < sizeof(*d); i++)
+        raw[i] = (uint8_t)host_rand();
+    d->TX.voltage = (float)(host_rand_unit() * 800 - 400);
+    d->TX.current = (float)(host_rand_unit() * 80 - 40);
+    d->TX.temp1 = (float)(host_rand_unit() * 800 - 400);
+    d->TX.temp2 = (float)(host_rand_unit() * 800 - 400);
+    d->RX.voltage = (float)(host_rand_unit() * 800 - 400);
+    d->RX.current = (float)(host_rand_unit() * 80 - 40);
+    d->RX.temp1 = (float)(host_rand_unit() * 800 - 400);
+    d->RX.temp2 = (float)(host_rand_unit() * 800 - 400);
+}
+
+/* Two payloads are equal as far as the wire is concerned */
+static bool same_on_wire(const mesh_dynamic_payload_t *a, const mesh_dynamic_payload_t *b)
+{
+    uint8_t fa[MESH_CODEC_DYNAMIC_MAX_LEN], fb[MESH_CODEC_DYNAMIC_MAX_LEN];
+    size_t la = mesh_codec_encode_dynamic(a, NULL, 0, fa, sizeof(fa));
+    size_t lb = mesh_codec_encode_dynamic(b, NULL, 0, fb, sizeof(fb));
+    return la == lb && memcmp(fa, fb, la) == 0;
+}
+
+/* Child stream as send_dynamic_payload builds it, root state as the v2 handler keeps it */
+static void check_stream(bool random_payloads, double loss)
+{
+    mesh_dynamic_payload_t cur = {0}, last = {0}, root = {0};
+    mesh_codec_rx_t rx = {0};
+    uint8_t buf[MESH_CODEC_DYNAMIC_MAX_LEN];
+    uint8_t seq = 0, since_full = MESH_CODEC_FULL_INTERVAL;
+    uint32_t resyncs = 0, lost = 0;
+
+    for (int i = 0; i < STREAM_FRAMES; i++) {
+        if (random_payloads)
+            payload_random(&cur);
+        else
+            payload_step(&cur);
+        memcpy(cur.TX.macAddr, tx_mac, ETH_HWADDR_LEN);
+
+        bool full = since_full >= MESH_CODEC_FULL_INTERVAL;
+        size_t len = mesh_codec_encode_dynamic(&cur, full ? NULL : &last, ++seq, buf, sizeof(buf));
+        HOST_CHECK(len >= MESH_CODEC_HEADER_LEN && len <= MESH_CODEC_DYNAMIC_MAX_LEN);
+        last = cur;
+        since_full = full ? 1 : since_full + 1;
+
+        if (host_rand_unit() < loss) {
+            lost++;
+            continue;
+        }
+
+        // a mesh-lite retry of an applied frame is harmless
+        int copies = host_rand() % 20 == 0 ? 2 : 1;
+        for (int c = 0; c < copies; c++) {
+            mesh_dynamic_payload_t before = root;
+            esp_err_t err = mesh_codec_decode_dynamic(buf, len, &root, &rx);
+            if (err == ESP_ERR_INVALID_STATE) {
+                HOST_CHECK(memcmp(&before, &root, sizeof(root)) == 0);
+                since_full = MESH_CODEC_FULL_INTERVAL;      // MESH_CODEC_ACK_RESYNC
+                resyncs++;
+                break;
+            }
+            HOST_CHECK(err == ESP_OK);
+            HOST_CHECK(same_on_wire(&root, &cur));
+        }
+    }
+
+    printf("stream %-7s loss %4.1f%%: %u lost, %u resync requests\n",
+           random_payloads ? "random" : "pad", loss * 100, lost, resyncs);
+    if (loss == 0)
+        HOST_CHECK(resyncs == 0);
+    else
+        HOST_CHECK(resyncs > 0);
+}
+
+static void check_truncation_and_garbage(void)
+{
+    mesh_dynamic_payload_t cur, dst, before;
+    mesh_alert_payload_t alert, adst, abefore;
+    uint8_t buf[MESH_CODEC_DYNAMIC_MAX_LEN + 8];
+
+    for (int i = 0; i < 2000; i++) {
+        payload_random(&cur);
+        payload_random(&dst);
+        size_t len = mesh_codec_encode_dynamic(&cur, NULL, 1, buf, sizeof(buf));
+        for (size_t cut = 0; cut < len; cut++) {
+            before = dst;
+            HOST_CHECK(mesh_codec_decode_dynamic(buf, cut, &dst, NULL) != ESP_OK);
+            HOST_CHECK(memcmp(&before, &dst, sizeof(dst)) == 0);
+        }
+
+        memset(&alert, 0, sizeof(alert));
+        alert.TX.TX_all_flags = (uint8_t)host_rand();
+        alert.RX.RX_all_flags = (uint8_t)host_rand();
+        len = mesh_codec_encode_alert(&alert, 1, buf, sizeof(buf));
+        for (size_t cut = 0; cut < len; cut++) {
+            abefore = adst;
+            HOST_CHECK(mesh_codec_decode_alert(buf, cut, &adst) != ESP_OK);
+            HOST_CHECK(memcmp(&abefore, &adst, sizeof(adst)) == 0);
+        }
+        HOST_CHECK(mesh_codec_decode_alert(buf, len, &adst) == ESP_OK);
+        HOST_CHECK(adst.TX.TX_all_flags == alert.TX.TX_all_flags && adst.RX.RX_all_flags == alert.RX.RX_all_flags);
+    }
+
+    // random bytes, half of them with a valid header so the field walk is exercised
+    for (int i = 0; i < GARBAGE_FRAMES; i++) {
+        size_t len = host_rand() % sizeof(buf);
+        for (size_t j = 0; j < len; j++)
+            buf[j] = (uint8_t)host_rand();
+        if (i & 1 && len >= MESH_CODEC_HEADER_LEN) {
+            buf[0] = MESH_CODEC_VERSION;
+            buf[1] = MESH_CODEC_KIND_DYNAMIC;
+        }
+        before = dst;
+        if (mesh_codec_decode_dynamic(buf, len, &dst, NULL) != ESP_OK)
+            HOST_CHECK(memcmp(&before, &dst, sizeof(dst)) == 0);
+        mesh_codec_frame_key(buf, len, MESH_CODEC_KIND_ALERT);
+    }
+}
+
+static void check_versions(void)
+{
+    mesh_dynamic_payload_t cur, dst = {0};
+    mesh_codec_stats_t s0, s1;
+    uint8_t buf[MESH_CODEC_DYNAMIC_MAX_LEN + 4];
+
+    payload_random(&cur);
+    memcpy(cur.TX.macAddr, tx_mac, ETH_HWADDR_LEN);
+    size_t len = mesh_codec_encode_dynamic(&cur, NULL, 1, buf, sizeof(buf));
+
+    mesh_codec_get_stats(&s0);
+    for (int major = 0; major < 16; major++) {
+        if (major == MESH_CODEC_VERSION_MAJOR)
+            continue;
+        buf[0] = (uint8_t)(major << 4 | MESH_CODEC_VERSION_MINOR);
+        HOST_CHECK(mesh_codec_frame_key(buf, len, MESH_CODEC_KIND_DYNAMIC) == NULL);
+        HOST_CHECK(mesh_codec_decode_dynamic(buf, len, &dst, NULL) == ESP_ERR_INVALID_VERSION);
+    }
+    mesh_codec_get_stats(&s1);
+    HOST_CHECK(s1.bad_major - s0.bad_major == 2 * 15);
+    // the legacy and pre-split binary versions are major 0
+    HOST_CHECK(MESH_CODEC_MAJOR(MESH_CODEC_LEGACY_VERSION) != MESH_CODEC_VERSION_MAJOR);
+    HOST_CHECK(MESH_CODEC_MAJOR(2) != MESH_CODEC_VERSION_MAJOR);
+
+    // newer minor: an appended field (mask bit 15) and its bytes are skipped
+    buf[0] = (uint8_t)(MESH_CODEC_VERSION_MAJOR << 4 | 0x0F);
+    buf[3] |= 0x80;
+    buf[len] = 0xAA;
+    buf[len + 1] = 0x55;
+    HOST_CHECK(mesh_codec_frame_key(buf, len + 2, MESH_CODEC_KIND_DYNAMIC) == &buf[4]);
+    HOST_CHECK(mesh_codec_decode_dynamic(buf, len + 2, &dst, NULL) == ESP_OK);
+    HOST_CHECK(same_on_wire(&dst, &cur));
+}
+
+static void check_sequence(void)
+{
+    mesh_dynamic_payload_t a, b, c, root = {0};
+    mesh_codec_rx_t rx = {0};
+    uint8_t fa[MESH_CODEC_DYNAMIC_MAX_LEN], fb[MESH_CODEC_DYNAMIC_MAX_LEN], fc[MESH_CODEC_DYNAMIC_MAX_LEN];
+
+    payload_random(&a); payload_random(&b); payload_random(&c);
+    memcpy(a.TX.macAddr, tx_mac, ETH_HWADDR_LEN);
+    memcpy(b.TX.macAddr, tx_mac, ETH_HWADDR_LEN);
+    memcpy(c.TX.macAddr, tx_mac, ETH_HWADDR_LEN);
+    size_t la = mesh_codec_encode_dynamic(&a, NULL, 255, fa, sizeof(fa));
+    size_t lb = mesh_codec_encode_dynamic(&b, &a, 0, fb, sizeof(fb));     // seq wraps
+    size_t lc = mesh_codec_encode_dynamic(&c, &b, 1, fc, sizeof(fc));
+
+    // a delta before any full frame is refused
+    HOST_CHECK(mesh_codec_decode_dynamic(fb, lb, &root, &rx) == ESP_ERR_INVALID_STATE);
+    HOST_CHECK(mesh_codec_decode_dynamic(fa, la, &root, &rx) == ESP_OK);
+    HOST_CHECK(rx.synced && rx.seq == 255);
+    // b lost: c's base is not the last frame applied
+    HOST_CHECK(mesh_codec_decode_dynamic(fc, lc, &root, &rx) == ESP_ERR_INVALID_STATE);
+    HOST_CHECK(same_on_wire(&root, &a));
+    // and stays refused once out of sync, even for the delta that was lost
+    HOST_CHECK(mesh_codec_decode_dynamic(fb, lb, &root, &rx) == ESP_ERR_INVALID_STATE);
+    HOST_CHECK(mesh_codec_decode_dynamic(fa, la, &root, &rx) == ESP_OK);
+    HOST_CHECK(mesh_codec_decode_dynamic(fb, lb, &root, &rx) == ESP_OK);
+    HOST_CHECK(mesh_codec_decode_dynamic(fc, lc, &root, &rx) == ESP_OK);
+    HOST_CHECK(same_on_wire(&root, &c));
+    // a rebooted child restarts its seq with a full frame
+    HOST_CHECK(mesh_codec_decode_dynamic(fa, la, &root, &rx) == ESP_OK);
+    HOST_CHECK(same_on_wire(&root, &a));
+}
+
+static void bench(void)
+{
+    mesh_dynamic_payload_t *stream = malloc(256 * sizeof(*stream));
+    mesh_dynamic_payload_t root = {0};
+    uint8_t buf[MESH_CODEC_DYNAMIC_MAX_LEN];
+    uint64_t bytes = 0, full_bytes = 0;
+    volatile size_t sink = 0;
+
+    for (int i = 0; i < 256; i++) {
+        stream[i] = i ? stream[i - 1] : root;
+        payload_step(&stream[i]);
+    }
+
+    uint64_t t0 = host_now_ns();
+    for (int i = 1; i < BENCH_FRAMES; i++) {
+        bool full = i % MESH_CODEC_FULL_INTERVAL == 0;
+        size_t len = mesh_codec_encode_dynamic(&stream[i & 255], full ? NULL : &stream[(i - 1) & 255],
+                                               (uint8_t)i, buf, sizeof(buf));
+        bytes += len;
+        sink += len;
+    }
+    uint64_t t1 = host_now_ns();
+    size_t len = mesh_codec_encode_dynamic(&stream[1], &stream[0], 1, buf, sizeof(buf));
+    for (int i = 1; i < BENCH_FRAMES; i++)
+        sink += (size_t)mesh_codec_decode_dynamic(buf, len, &root, NULL);
+    uint64_t t2 = host_now_ns();
+    full_bytes = mesh_codec_encode_dynamic(&stream[0], NULL, 0, buf, sizeof(buf));
+
+    printf("bytes per dynamic frame: legacy struct %zu, full %" PRIu64 ", stream average %.1f (full every %d)\n",
+           sizeof(mesh_dynamic_payload_t), full_bytes, (double)bytes / (BENCH_FRAMES - 1), MESH_CODEC_FULL_INTERVAL);
+    printf("encode %.1f ns/frame, decode %.1f ns/frame\n",
+           (double)(t1 - t0) / (BENCH_FRAMES - 1), (double)(t2 - t1) / (BENCH_FRAMES - 1));
+    HOST_CHECK((double)bytes / (BENCH_FRAMES - 1) < sizeof(mesh_dynamic_payload_t) / 2.0);
+    free(stream);
+}
+
+int main(void)
+{
+    check_stream(false, 0.0);
+    check_stream(true, 0.0);
+    check_stream(false, 0.05);
+    check_stream(true, 0.05);
+    check_truncation_and_garbage();
+    check_versions();
+    check_sequence();
+    bench();
+
+    return host_test_result();
+}
@@ -0,0 +1,162 @@
+#include "ota_delta_encoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK           32      // bytes hashed to find a match
+#define STEP            8       // source positions indexed
+#define MIN_MATCH       40      // shorter matches cost more in op headers than they save
+#define MAX_CANDIDATES  16      // source positions tried per block
+#define HASH_BITS       16
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t block_hash(const uint8_t *p)
+{
+    uint32_t h = 2166136261u;      // FNV-1a
+    for (int i = 0; i < BLOCK; i++)
+        h = (h ^ p[i]) * 16777619u;
+    return h >> (32 - HASH_BITS);
+}
+
+size_t ota_delta_put_op(uint8_t *out, ota_delta_op_t op, uint32_t arg, uint32_t len)
+{
+    out[0] = (uint8_t)op;
+    put_u32(out + 1, arg);
+    put_u32(out + 5, len);
+    return OTA_DELTA_OP_LEN;
+}
+
+typedef struct {
+    uint8_t *out;
+    size_t len, max;
+    bool overflow;
+} patch_out_t;
+
+static void emit(patch_out_t *p, const void *data, size_t len)
+{
+    if (p->overflow || len > p->max - p->len) {
+        p->overflow = true;
+        return;
+    }
+    memcpy(p->out + p->len, data, len);
+    p->len += len;
+}
+
+static void emit_op(patch_out_t *p, ota_delta_op_t op, uint32_t arg, uint32_t len)
+{
+    uint8_t raw[OTA_DELTA_OP_LEN];
+    emit(p, raw, ota_delta_put_op(raw, op, arg, len));
+}
+
+static void emit_insert(patch_out_t *p, const uint8_t *target, uint32_t from, uint32_t to)
+{
+    if (to > from) {
+        emit_op(p, OTA_DELTA_OP_INSERT, 0, to - from);
+        emit(p, target + from, to - from);
+    }
+}
+
+size_t ota_delta_encode(const uint8_t *source, uint32_t source_len, const uint8_t source_sha256[32],
+                        const uint8_t *target, uint32_t target_len, const uint8_t target_sha256[32],
+                        const char *target_version, uint8_t *out, size_t out_max)
+{
+    patch_out_t p = { out, 0, out_max, false };
+    uint8_t header[OTA_DELTA_HEADER_LEN] = { 0 };
+
+    memcpy(header, OTA_DELTA_MAGIC, 4);
+    header[4] = OTA_DELTA_FORMAT_VERSION;
+    header[6] = OTA_DELTA_HEADER_LEN;
+    put_u32(header + 8, source_len);
+    memcpy(header + 12, source_sha256, 32);
+    put_u32(header + 44, target_len);
+    memcpy(header + 48, target_sha256, 32);
+    memcpy(header + 80, target_version, strnlen(target_version, 32));
+    emit(&p, header, sizeof(header));
+
+    // source positions every STEP bytes, chained per block hash, oldest first
+    uint32_t slots = source_len >= BLOCK ? (source_len - BLOCK) / STEP + 1 : 0;
+    int32_t *head = malloc(sizeof(int32_t) << HASH_BITS);
+    int32_t *tail = malloc(sizeof(int32_t) << HASH_BITS);
+    int32_t *next = malloc(sizeof(int32_t) * (slots + 1));
+    if (!head || !tail || !next) {
+        free(head);
+        free(tail);
+        free(next);
+        return 0;
+    }
+    memset(head, 0xFF, sizeof(int32_t) << HASH_BITS);
+    for (uint32_t s = 0; s < slots; s++) {
+        uint32_t h = block_hash(source + s * STEP);
+        next[s] = -1;
+        if (head[h] < 0)
+            head[h] = (int32_t)s;
+        else
+            next[tail[h]] = (int32_t)s;
+        tail[h] = (int32_t)s;
+    }
+
+    // open COPY, merged with the next one when they are contiguous
+    uint32_t copy_src = 0, copy_len = 0;
+    uint32_t literal_start = 0, i = 0;
+    while (i + BLOCK <= target_len) {
+        uint32_t best_len = 0, best_src = 0, best_back = 0;
+        int tried = 0;
+        for (int32_t s = head[block_hash(target + i)]; s >= 0 && tried < MAX_CANDIDATES; s = next[s]) {
+            uint32_t src = (uint32_t)s * STEP;
+            if (memcmp(target + i, source + src, BLOCK) != 0)
+                continue;
+            tried++;
+            uint32_t len = 0;
+            while (i + len < target_len && src + len < source_len && target[i + len] == source[src + len])
+                len++;
+            // extend backwards into the pending literal
+            uint32_t back = 0;
+            while (back < i - literal_start && back < src && target[i - back - 1] == source[src - back - 1])
+                back++;
+            if (len + back > best_len + best_back) {
+                best_len = len;
+                best_src = src;
+                best_back = back;
+            }
+        }
+
+        if (best_len + best_back < MIN_MATCH) {
+            i++;
+            continue;
+        }
+
+        uint32_t start = i - best_back;
+        if (start > literal_start) {
+            if (copy_len)
+                emit_op(&p, OTA_DELTA_OP_COPY, copy_src, copy_len);
+            copy_len = 0;
+            emit_insert(&p, target, literal_start, start);
+        }
+        if (copy_len && copy_src + copy_len == best_src - best_back) {
+            copy_len += best_len + best_back;
+        } else {
+            if (copy_len)
+                emit_op(&p, OTA_DELTA_OP_COPY, copy_src, copy_len);
+            copy_src = best_src - best_back;
+            copy_len = best_len + best_back;
+        }
+        i += best_len;
+        literal_start = i;
+    }
+    if (copy_len)
+        emit_op(&p, OTA_DELTA_OP_COPY, copy_src, copy_len);
+    emit_insert(&p, target, literal_start, target_len);
+    emit_op(&p, OTA_DELTA_OP_END, 0, 0);
+
+    free(head);
+    free(tail);
+    free(next);
+    return p.overflow ? 0 : p.len;
+}
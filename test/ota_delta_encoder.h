@@ -0,0 +1,30 @@
+#ifndef OTA_DELTA_ENCODER_H
+#define OTA_DELTA_ENCODER_H
+
+#include "ota_delta.h"
+
+/*
+ * Patch encoder for the host tests: the greedy COPY / INSERT search of
+ * ota_delta.py (BLOCK, STEP, MIN_MATCH, MAX_CANDIDATES) in C, so a test can
+ * build patches between images it generates on the fly.
+ */
+
+/**
+ * @brief Patch rebuilding `target` from `source`
+ *
+ * The SHA256s only go into the header, the caller computes them (or not).
+ *
+ * @return patch length, 0 if it does not fit in out_max
+ */
+size_t ota_delta_encode(const uint8_t *source, uint32_t source_len, const uint8_t source_sha256[32],
+                        const uint8_t *target, uint32_t target_len, const uint8_t target_sha256[32],
+                        const char *target_version, uint8_t *out, size_t out_max);
+
+/**
+ * @brief Append one raw op, for hand-made (broken) patches
+ *
+ * @return bytes written (OTA_DELTA_OP_LEN)
+ */
+size_t ota_delta_put_op(uint8_t *out, ota_delta_op_t op, uint32_t arg, uint32_t len);
+
+#endif /* OTA_DELTA_ENCODER_H */
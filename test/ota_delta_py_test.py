@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+"""ota_delta.py patches decoded by main/ota_delta.c (user-022)
+
+Makes an old and a new image, builds the patch with ota_delta.py, checks
+its own apply_patch, then has ota_delta_test decode the same files.
+
+Usage: ota_delta_py_test.py <ota_delta_test binary>
+"""
+import os
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import ota_delta  # noqa: E402
+
+
+def image(rng, version, size):
+    body = bytearray(rng.getrandbits(8) for _ in range(size))
+    desc = struct.pack('<I12s32s', ota_delta.APP_DESC_MAGIC, b'', version.encode())
+    body[ota_delta.APP_DESC_OFFSET:ota_delta.APP_DESC_OFFSET + len(desc)] = desc
+    return bytes(body)
+
+
+def main(argv):
+    rng = random.Random(22)
+    old = image(rng, '2.0.0', 128 * 1024)
+
+    new = bytearray(old)
+    new[ota_delta.APP_DESC_OFFSET + 16:ota_delta.APP_DESC_OFFSET + 21] = b'2.1.0'
+    new[20000:20000] = bytes(rng.getrandbits(8) for _ in range(1500))   # new code
+    del new[70000:71000]                                                 # removed code
+    for pos in rng.sample(range(100000, len(new)), 20):                  # changed bytes
+        new[pos] ^= 0x5A
+    new = bytes(new)
+
+    patch = ota_delta.make_patch(old, new)
+    assert ota_delta.apply_patch(old, patch) == new
+    assert ota_delta.read_header(patch)[4] == '2.1.0'
+    assert ota_delta.patch_name('2.0.0-rc 1') == '2.0.0-rc_1.patch'
+
+    with tempfile.TemporaryDirectory() as tmp:
+        paths = [os.path.join(tmp, name) for name in ('old.bin', 'new.patch', 'new.bin')]
+        for path, data in zip(paths, (old, patch, new)):
+            with open(path, 'wb') as f:
+                f.write(data)
+        result = subprocess.run([argv[1], paths[0], paths[1], paths[2]])
+    print(f"{len(patch)} byte patch ({100 * len(patch) / len(new):.1f}% of the image)")
+    return result.returncode
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,351 @@
+/*
+ * Delta patch decoder (user-022).
+ *
+ * Builds patches with the C port of the ota_delta.py encoder between a
+ * generated "firmware" and edited versions of it, feeds them to
+ * ota_delta_feed in random pieces of 1..5000 bytes and checks that the
+ * output is the target, byte for byte. Then feeds broken patches (bad
+ * magic / version / opcode, copies outside the source, output beyond the
+ * target, early END, truncation, bytes after END, refused header, failed
+ * write) and checks each stops with the right status and never writes past
+ * the target.
+ *
+ * With three file arguments it decodes a patch made by ota_delta.py
+ * instead: ota_delta_test <old.bin> <patch> <new.bin>
+ */
+#include "ota_delta.h"
+#include "ota_delta_encoder.h"
+#include "host_test.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_MAX       (512 * 1024)
+#define PATCH_MAX       (IMAGE_MAX + 64 * 1024)
+#define PIECE_MAX       5000
+
+typedef struct {
+    const uint8_t *source;
+    uint32_t source_len;
+    uint8_t *out;
+    uint32_t out_len, out_max;
+    bool refuse_header;
+    uint32_t fail_write_at;     // 0: never
+} sink_t;
+
+static bool sink_header(void *ctx, const ota_delta_header_t *header)
+{
+    sink_t *s = ctx;
+    return !s->refuse_header && header->target_size <= s->out_max && header->source_size <= s->source_len;
+}
+
+static bool sink_write(void *ctx, const uint8_t *data, uint32_t len)
+{
+    sink_t *s = ctx;
+    // the decoder checks the target size, the sink only double-checks it
+    HOST_CHECK(len <= s->out_max - s->out_len);
+    if (len > s->out_max - s->out_len)
+        return false;
+    if (s->fail_write_at && s->out_len + len >= s->fail_write_at)
+        return false;
+    memcpy(s->out + s->out_len, data, len);
+    s->out_len += len;
+    return true;
+}
+
+static bool sink_copy(void *ctx, uint32_t source_offset, uint32_t len)
+{
+    sink_t *s = ctx;
+    HOST_CHECK(source_offset <= s->source_len && len <= s->source_len - source_offset);
+    return sink_write(ctx, s->source + source_offset, len);
+}
+
+static const ota_delta_io_t sink_io = { sink_header, sink_write, sink_copy };
+
+/* Feeds the patch in random pieces; stops at the first status other than MORE */
+static ota_delta_status_t decode(ota_delta_t *d, sink_t *sink, const uint8_t *patch, size_t len)
+{
+    ota_delta_status_t status = OTA_DELTA_MORE;
+
+    ota_delta_init(d, &sink_io, sink);
+    for (size_t pos = 0; pos < len && status == OTA_DELTA_MORE; ) {
+        size_t n = 1 + host_rand() % PIECE_MAX;
+        if (n > len - pos)
+            n = len - pos;
+        status = ota_delta_feed(d, patch + pos, n);
+        pos += n;
+    }
+    return status;
+}
+
+static uint8_t source[IMAGE_MAX], target[IMAGE_MAX], output[IMAGE_MAX];
+static uint8_t patch[PATCH_MAX];
+static const uint8_t no_sha[32];
+
+static void random_bytes(uint8_t *p, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+        p[i] = (uint8_t)host_rand();
+}
+
+/* Firmware-like source: random code with repeated tables and zero padding */
+static uint32_t make_source(void)
+{
+    uint32_t len = 384 * 1024;
+
+    random_bytes(source, len);
+    for (uint32_t t = 0; t < 8; t++)
+        memcpy(source + 200000 + t * 4096, source + 1000, 4096);
+    memset(source + 330000, 0, 20000);
+    return len;
+}
+
+/* A new build: patched bytes, a grown function, a removed one, moved data */
+static uint32_t edit(uint32_t source_len, int edits)
+{
+    uint32_t len = 0, from = 0;
+
+    for (int e = 0; e < edits; e++) {
+        uint32_t at = from + host_rand() % ((source_len - from) / (uint32_t)(edits - e + 1) + 1);
+        memcpy(target + len, source + from, at - from);
+        len += at - from;
+        from = at;
+        switch (host_rand() % 4) {
+            case 0:     // changed bytes in place
+                for (uint32_t n = 1 + host_rand() % 64; n && from < source_len; n--)
+                    target[len++] = (uint8_t)(source[from++] ^ (1 + host_rand() % 255));
+                break;
+            case 1: {   // new code
+                uint32_t n = 1 + host_rand() % 3000;
+                random_bytes(target + len, n);
+                len += n;
+                break;
+            }
+            case 2:     // removed code
+                from += host_rand() % 2000;
+                if (from > source_len)
+                    from = source_len;
+                break;
+            case 3: {   // data taken from somewhere else in the image
+                uint32_t n = 64 + host_rand() % 4000, src = host_rand() % (source_len - n);
+                memcpy(target + len, source + src, n);
+                len += n;
+                break;
+            }
+        }
+        if (len > IMAGE_MAX - 8192)
+            break;
+    }
+    uint32_t rest = source_len - from;
+    if (rest > IMAGE_MAX - len)
+        rest = IMAGE_MAX - len;
+    memcpy(target + len, source + from, rest);
+    return len + rest;
+}
+
+static void set_u32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+/* Encodes source -> target, decodes it SPLITS times, checks the output */
+#define SPLITS          20
+static void roundtrip(const char *name, uint32_t source_len, uint32_t target_len)
+{
+    size_t len = ota_delta_encode(source, source_len, no_sha, target, target_len, no_sha, "2.0.0",
+                                  patch, sizeof(patch));
+    HOST_CHECK(len >= OTA_DELTA_HEADER_LEN + OTA_DELTA_OP_LEN);
+
+    ota_delta_t d;
+    bool ok = true;
+    for (int split = 0; split < SPLITS; split++) {
+        sink_t sink = { source, source_len, output, 0, target_len, false, 0 };
+        ota_delta_status_t status = decode(&d, &sink, patch, len);
+        ok &= status == OTA_DELTA_DONE && ota_delta_done(&d);
+        ok &= sink.out_len == target_len && memcmp(output, target, target_len) == 0;
+        ok &= d.header.source_size == source_len && d.header.target_size == target_len;
+        ok &= strcmp(d.header.target_version, "2.0.0") == 0;
+    }
+    HOST_CHECK(ok);
+    printf("%-24s %7" PRIu32 " -> %7" PRIu32 " bytes  patch %7zu (%5.1f%%)  %5.1f%% copied  %s\n",
+           name, source_len, target_len, len, target_len ? 100.0 * len / target_len : 0.0,
+           target_len ? 100.0 * d.copied / target_len : 0.0, ok ? "ok" : "FAILED");
+}
+
+/* Header of a hand-made patch; the ops follow */
+static size_t put_header(uint8_t *out, uint32_t source_len, uint32_t target_len)
+{
+    ota_delta_encode(source, source_len, no_sha, target, 0, no_sha, "2.0.0", out, PATCH_MAX);
+    set_u32(out + 44, target_len);
+    return OTA_DELTA_HEADER_LEN;
+}
+
+typedef struct {
+    const char *name;
+    size_t len;
+    ota_delta_status_t expect;
+    uint32_t max_out;           // target bytes written before the error
+    bool refuse_header;
+    uint32_t fail_write_at;
+} broken_t;
+
+static void check_broken(const broken_t *b, uint32_t source_len, uint32_t target_len)
+{
+    ota_delta_t d;
+    bool ok = true;
+
+    for (int split = 0; split < SPLITS; split++) {
+        sink_t sink = { source, source_len, output, 0, target_len, b->refuse_header, b->fail_write_at };
+        ota_delta_status_t status = decode(&d, &sink, patch, b->len);
+        ok &= status == b->expect && !ota_delta_done(&d);
+        ok &= sink.out_len <= b->max_out;
+        // errors are final: more bytes change nothing
+        if (status != OTA_DELTA_MORE) {
+            uint32_t written = sink.out_len;
+            ok &= ota_delta_feed(&d, patch, b->len) == status && sink.out_len == written;
+        }
+    }
+    HOST_CHECK(ok);
+    printf("%-30s status %d  %s\n", b->name, b->expect, ok ? "ok" : "FAILED");
+}
+
+static void broken_patches(void)
+{
+    const uint32_t source_len = 4096, target_len = 1000;
+    size_t n, valid_len;
+
+    // COPY 500, INSERT 500, END
+    random_bytes(target, target_len);
+    memcpy(target, source, 500);
+    n = put_header(patch, source_len, target_len);
+    n += ota_delta_put_op(patch + n, OTA_DELTA_OP_COPY, 0, 500);
+    n += ota_delta_put_op(patch + n, OTA_DELTA_OP_INSERT, 0, 500);
+    memcpy(patch + n, target + 500, 500);
+    n += 500;
+    n += ota_delta_put_op(patch + n, OTA_DELTA_OP_END, 0, 0);
+    valid_len = n;
+
+    broken_t valid = { "hand-made patch", valid_len, OTA_DELTA_DONE, target_len, false, 0 };
+    ota_delta_t d;
+    sink_t sink = { source, source_len, output, 0, target_len, false, 0 };
+    HOST_CHECK(decode(&d, &sink, patch, valid.len) == OTA_DELTA_DONE && memcmp(output, target, target_len) == 0);
+    printf("%-30s status %d  ok\n", valid.name, valid.expect);
+
+    for (uint32_t cut = 1; cut < valid_len; cut += 1 + host_rand() % 50) {
+        broken_t truncated = { "truncated", valid_len - cut, OTA_DELTA_MORE, target_len, false, 0 };
+        if (cut == 1)
+            check_broken(&truncated, source_len, target_len);
+        else
+            for (int split = 0; split < SPLITS; split++) {
+                sink = (sink_t){ source, source_len, output, 0, target_len, false, 0 };
+                HOST_CHECK(decode(&d, &sink, patch, truncated.len) == OTA_DELTA_MORE && !ota_delta_done(&d));
+            }
+    }
+
+    const broken_t after_end = { "bytes after END", valid_len + 1, OTA_DELTA_ERR_FORMAT, target_len, false, 0 };
+    patch[valid_len] = 0;
+    check_broken(&after_end, source_len, target_len);
+
+    const broken_t refused = { "header refused", valid_len, OTA_DELTA_ERR_REJECTED, 0, true, 0 };
+    check_broken(&refused, source_len, target_len);
+    const broken_t write_failed = { "write failed", valid_len, OTA_DELTA_ERR_IO, 700, false, 700 };
+    check_broken(&write_failed, source_len, target_len);
+
+    patch[0] = 'X';
+    const broken_t magic = { "bad magic", valid_len, OTA_DELTA_ERR_FORMAT, 0, false, 0 };
+    check_broken(&magic, source_len, target_len);
+    patch[0] = 'B';
+    patch[4] = OTA_DELTA_FORMAT_VERSION + 1;
+    const broken_t version = { "bad format version", valid_len, OTA_DELTA_ERR_FORMAT, 0, false, 0 };
+    check_broken(&version, source_len, target_len);
+    patch[4] = OTA_DELTA_FORMAT_VERSION;
+
+    // single ops after a good header
+    static const struct {
+        const char *name;
+        uint8_t op;
+        uint32_t arg, len;
+        ota_delta_status_t expect;
+    } ops[] = {
+        { "unknown opcode",          7, 0, 10, OTA_DELTA_ERR_FORMAT },
+        { "COPY beyond the source",  OTA_DELTA_OP_COPY, 4000, 200, OTA_DELTA_ERR_RANGE },
+        { "COPY offset wrapping",    OTA_DELTA_OP_COPY, 0xFFFFFF00u, 0x200, OTA_DELTA_ERR_RANGE },
+        { "COPY length wrapping",    OTA_DELTA_OP_COPY, 0x100, 0xFFFFFF80u, OTA_DELTA_ERR_RANGE },
+        { "INSERT beyond the target", OTA_DELTA_OP_INSERT, 0, 1001, OTA_DELTA_ERR_RANGE },
+        { "END before the target",   OTA_DELTA_OP_END, 0, 0, OTA_DELTA_ERR_RANGE },
+    };
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        n = put_header(patch, source_len, target_len);
+        n += ota_delta_put_op(patch + n, OTA_DELTA_OP_COPY, 0, 500);
+        n += ota_delta_put_op(patch + n, (ota_delta_op_t)ops[i].op, ops[i].arg, ops[i].len);
+        n += ota_delta_put_op(patch + n, OTA_DELTA_OP_END, 0, 0);
+        const broken_t b = { ops[i].name, n, ops[i].expect, 500, false, 0 };
+        check_broken(&b, source_len, target_len);
+    }
+
+    // two COPYs that together overshoot the target
+    n = put_header(patch, source_len, target_len);
+    n += ota_delta_put_op(patch + n, OTA_DELTA_OP_COPY, 0, 600);
+    n += ota_delta_put_op(patch + n, OTA_DELTA_OP_COPY, 0, 600);
+    const broken_t overshoot = { "COPY beyond the target", n, OTA_DELTA_ERR_RANGE, 600, false, 0 };
+    check_broken(&overshoot, source_len, target_len);
+}
+
+static size_t read_file(const char *path, uint8_t *buf, size_t max)
+{
+    FILE *f = fopen(path, "rb");
+    HOST_CHECK(f != NULL);
+    if (f == NULL)
+        return 0;
+    size_t n = fread(buf, 1, max, f);
+    HOST_CHECK(feof(f));
+    fclose(f);
+    return n;
+}
+
+/* Patch from ota_delta.py, decoded like the firmware does */
+static int decode_files(const char *old_path, const char *patch_path, const char *new_path)
+{
+    uint32_t source_len = (uint32_t)read_file(old_path, source, sizeof(source));
+    size_t len = read_file(patch_path, patch, sizeof(patch));
+    uint32_t target_len = (uint32_t)read_file(new_path, target, sizeof(target));
+
+    for (int split = 0; split < SPLITS; split++) {
+        ota_delta_t d;
+        sink_t sink = { source, source_len, output, 0, sizeof(output), false, 0 };
+        HOST_CHECK(decode(&d, &sink, patch, len) == OTA_DELTA_DONE);
+        HOST_CHECK(sink.out_len == target_len && memcmp(output, target, target_len) == 0);
+        HOST_CHECK(d.header.source_size == source_len && d.header.target_size == target_len);
+    }
+    printf("%s: %zu byte patch rebuilt %s (%" PRIu32 " bytes)\n", patch_path, len, new_path, target_len);
+    return host_test_result();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 4)
+        return decode_files(argv[1], argv[2], argv[3]);
+
+    uint32_t source_len = make_source();
+    uint32_t len;
+
+    printf("decoded in random pieces of 1..%d bytes, %d times each\n", PIECE_MAX, SPLITS);
+    memcpy(target, source, source_len);
+    roundtrip("same image", source_len, source_len);
+    len = edit(source_len, 10);
+    roundtrip("10 edits", source_len, len);
+    len = edit(source_len, 200);
+    roundtrip("200 edits", source_len, len);
+    random_bytes(target, source_len);
+    roundtrip("unrelated image", source_len, source_len);
+    roundtrip("empty target", source_len, 0);
+    memcpy(target, source, 20);
+    roundtrip("source below one block", 20, 20);
+
+    printf("\nbroken patches\n");
+    broken_patches();
+
+    return host_test_result();
+}
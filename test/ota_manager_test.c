@@ -0,0 +1,714 @@
+/*
+ * Resumable OTA download against a flaky server (user-019).
+ *
+ * Runs the real ota_manager.c (through test/idf_shim) with:
+ *   - an in-memory HTTP server that cuts responses at random offsets,
+ *     refuses connections, and may ignore Range requests;
+ *   - two OTA partitions and the NVS checkpoint in shared memory, so a
+ *     forked child can lose power mid-download and the parent resumes
+ *     from what it left in flash and NVS.
+ * Checks that the flash ends up byte for byte equal to the image and
+ * counts the bytes the server had to send more than once.
+ *
+ * The download pipeline (user-021) is timed with a link that only moves
+ * data while the reader reads (TCP window below one buffer) and a flash
+ * that takes a fixed time per byte: with the reader and the writer
+ * overlapping, the download takes about max(network, flash), not the sum.
+ *
+ * Delta updates (user-022): the server also hosts a patch against the
+ * running image, made by the C port of ota_delta.py. The patch must rebuild
+ * the new image whatever the cuts, and ota_manager must fall back to the
+ * full image when it is missing, truncated, made from another running
+ * image or builds another image.
+ */
+#include "ota_manager.h"
+#include "ota_delta_encoder.h"
+#include "host_test.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define PARTITION_SIZE  (2 * 1024 * 1024)
+#define IMAGE_LEN       (1536 * 1024)
+#define POWER_LOSS_AT   (800 * 1024)
+#define NVS_BLOB_MAX    1024
+
+/* Firmware globals ota_manager.c links against */
+uint8_t UNIT_ID = 1;
+esp_mqtt_client_handle_t mqtt_client = NULL;
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data,
+                            int len, int qos, int retain)
+{
+    (void)client; (void)topic; (void)data; (void)len; (void)qos; (void)retain;
+    return 0;
+}
+
+/* What survives a power loss: the partitions and NVS */
+typedef struct {
+    uint8_t flash[2][PARTITION_SIZE];   // ota_0 (running), ota_1 (update)
+    uint8_t nvs_blob[NVS_BLOB_MAX];
+    size_t nvs_len;
+} persistent_t;
+
+static persistent_t *persist;
+
+static const esp_partition_t partitions[2] = {
+    { 0x10000, PARTITION_SIZE, "ota_0" },
+    { 0x210000, PARTITION_SIZE, "ota_1" },
+};
+
+/* ---- server ---- */
+
+typedef struct {
+    const uint8_t *image;
+    uint32_t image_len;
+    bool range;                 // honours "Range: bytes=<n>-"
+    double cut;                 // chance a response is cut short
+    double refuse;              // chance a connection is refused
+    uint32_t read_us_per_kb;    // link speed
+    const uint8_t *patch;       // NULL: 404 for patches
+    uint32_t patch_len;
+    char patch_url[128];        // last patch requested
+    // counters
+    uint32_t requests;
+    uint64_t served;            // body bytes sent
+} server_t;
+
+static server_t server;
+
+struct esp_http_client {
+    esp_http_client_config_t config;
+    int64_t range_from;         // -1: no Range header
+    const uint8_t *body;
+    uint32_t pos, end, cut_at;
+    int status;
+};
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    struct esp_http_client *c = calloc(1, sizeof(*c));
+    c->config = *config;
+    c->range_from = -1;
+    return c;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t c, const char *key, const char *value)
+{
+    unsigned long from;
+    if (strcasecmp(key, "Range") == 0 && sscanf(value, "bytes=%lu-", &from) == 1)
+        c->range_from = (int64_t)from;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t c, int write_len)
+{
+    (void)c;
+    (void)write_len;
+    server.requests++;
+    return host_rand_unit() < server.refuse ? ESP_FAIL : ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t c)
+{
+    uint32_t from = 0;
+
+    c->body = server.image;
+    c->end = server.image_len;
+    if (strstr(c->config.url, "/patch/") != NULL) {
+        snprintf(server.patch_url, sizeof(server.patch_url), "%s", c->config.url);
+        if (server.patch == NULL) {
+            c->status = 404;
+            return 0;
+        }
+        c->body = server.patch;
+        c->end = server.patch_len;
+    }
+
+    if (c->range_from >= 0 && server.range) {
+        if (c->range_from >= c->end) {
+            c->status = 416;
+            c->pos = c->cut_at = c->end;
+            return 0;
+        }
+        from = (uint32_t)c->range_from;
+        c->status = 206;
+
+        char value[64];
+        snprintf(value, sizeof(value), "bytes %" PRIu32 "-%" PRIu32 "/%" PRIu32,
+                 from, c->end - 1, c->end);
+        esp_http_client_event_t evt = {
+            .event_id = HTTP_EVENT_ON_HEADER, .client = c, .user_data = c->config.user_data,
+            .header_key = "Content-Range", .header_value = value,
+        };
+        c->config.event_handler(&evt);
+    } else {
+        c->status = 200;
+    }
+
+    c->pos = from;
+    c->cut_at = c->end;
+    if (host_rand_unit() < server.cut)
+        c->cut_at = from + host_rand() % (c->end - from + 1);
+    return c->end - from;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t c)
+{
+    return c->status;
+}
+
+int esp_http_client_read(esp_http_client_handle_t c, char *buffer, int len)
+{
+    if (c->pos == c->cut_at && c->cut_at < c->end)
+        return (c->cut_at & 1) ? -1 : 0;    // read error or early close
+
+    uint32_t n = c->cut_at - c->pos;
+    if (n > (uint32_t)len)
+        n = (uint32_t)len;
+    memcpy(buffer, c->body + c->pos, n);
+    c->pos += n;
+    server.served += n;
+    if (server.read_us_per_kb)
+        usleep(n * server.read_us_per_kb / 1024);
+    return (int)n;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t c)
+{
+    return c->pos == c->end;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t c)
+{
+    (void)c;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t c)
+{
+    free(c);
+    return ESP_OK;
+}
+
+/* ---- flash ---- */
+
+static struct {
+    bool open;
+    uint32_t pos;
+    uint32_t power_loss_at;     // 0: never
+    uint32_t write_us_per_kb;   // erase + program
+    const esp_partition_t *boot;
+    bool restarted;
+} ota;
+
+static int partition_index(const esp_partition_t *p)
+{
+    return p == &partitions[0] ? 0 : 1;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t offset, void *dst, size_t size)
+{
+    if (offset + size > p->size)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, persist->flash[partition_index(p)] + offset, size);
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return &partitions[0];
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start)
+{
+    (void)start;
+    return &partitions[1];
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t *p, esp_ota_img_states_t *state)
+{
+    (void)p;
+    *state = ESP_OTA_IMG_VALID;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *p, size_t image_size, esp_ota_handle_t *handle)
+{
+    (void)image_size;
+    HOST_CHECK(!ota.open && p == &partitions[1]);
+    memset(persist->flash[1], 0xFF, PARTITION_SIZE);
+    ota.open = true;
+    ota.pos = 0;
+    *handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_resume(const esp_partition_t *p, size_t erase_size, size_t image_offset,
+                         esp_ota_handle_t *handle)
+{
+    (void)erase_size;
+    HOST_CHECK(!ota.open && p == &partitions[1]);
+    ota.open = true;
+    ota.pos = (uint32_t)image_offset;
+    *handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    if (handle != 1 || !ota.open || ota.pos + size > PARTITION_SIZE)
+        return ESP_ERR_INVALID_ARG;
+    if (ota.power_loss_at && ota.pos + size > ota.power_loss_at)
+        _exit(0);
+    memcpy(persist->flash[1] + ota.pos, data, size);
+    if (ota.write_us_per_kb)
+        usleep(size * ota.write_us_per_kb / 1024);
+    ota.pos += (uint32_t)size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    (void)handle;
+    ota.open = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    (void)handle;
+    ota.open = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *p)
+{
+    ota.boot = p;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void)
+{
+    return ESP_OK;
+}
+
+void esp_restart(void)
+{
+    ota.restarted = true;
+}
+
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    static esp_app_desc_t running = { .magic_word = ESP_APP_DESC_MAGIC_WORD, .version = "1.0.0" };
+    return &running;
+}
+
+/* ---- NVS (one blob is all ota_manager keeps) ---- */
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle)
+{
+    (void)mode;
+    HOST_CHECK(strcmp(name, OTA_NVS_NAMESPACE) == 0);
+    *handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *length)
+{
+    (void)handle;
+    (void)key;
+    if (persist->nvs_len == 0)
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (*length < persist->nvs_len)
+        return ESP_ERR_INVALID_SIZE;
+    memcpy(value, persist->nvs_blob, persist->nvs_len);
+    *length = persist->nvs_len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    (void)handle;
+    (void)key;
+    HOST_CHECK(length <= NVS_BLOB_MAX);
+    memcpy(persist->nvs_blob, value, length);
+    persist->nvs_len = length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    (void)handle;
+    (void)key;
+    persist->nvs_len = 0;
+    return ESP_OK;
+}
+
+/* ---- scenarios ---- */
+
+static uint8_t image_a[IMAGE_LEN], image_b[IMAGE_LEN], image_c[IMAGE_LEN];
+static char sha_a[OTA_SHA256_HEX_LEN + 1], sha_b[OTA_SHA256_HEX_LEN + 1], sha_c[OTA_SHA256_HEX_LEN + 1];
+static uint8_t patch[IMAGE_LEN + 64 * 1024];
+
+static void set_version(uint8_t *image, const char *version, char *sha_hex)
+{
+    esp_app_desc_t desc = { .magic_word = ESP_APP_DESC_MAGIC_WORD };
+    uint8_t digest[32];
+
+    strncpy(desc.version, version, sizeof(desc.version) - 1);
+    strncpy(desc.project_name, "bumblebee", sizeof(desc.project_name) - 1);
+    memcpy(image + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), &desc, sizeof(desc));
+
+    mbedtls_sha256(image, IMAGE_LEN, digest, 0);
+    for (int i = 0; i < 32; i++)
+        sprintf(sha_hex + 2 * i, "%02x", digest[i]);
+}
+
+static void make_image(uint8_t *image, const char *version, char *sha_hex)
+{
+    for (uint32_t i = 0; i < IMAGE_LEN; i++)
+        image[i] = (uint8_t)host_rand();
+    image[0] = 0xE9;
+    set_version(image, version, sha_hex);
+}
+
+/* The next build of `from`: 48 KB of new code at 300 KB, 16 KB removed at 900 KB, patched bytes */
+static void make_next_image(uint8_t *image, const uint8_t *from, const char *version, char *sha_hex)
+{
+    const uint32_t grown_at = 300 * 1024, grown = 48 * 1024, removed_at = 900 * 1024, removed = 16 * 1024;
+    uint32_t pos = grown_at;
+
+    memcpy(image, from, grown_at);
+    for (uint32_t i = 0; i < grown; i++)
+        image[pos++] = (uint8_t)host_rand();
+    memcpy(image + pos, from + grown_at, removed_at - grown_at);
+    pos += removed_at - grown_at;
+    // the image keeps its size, its last bytes are dropped
+    memcpy(image + pos, from + removed_at + removed, IMAGE_LEN - pos);
+    for (int i = 0; i < 30; i++)
+        image[1024 + host_rand() % (IMAGE_LEN - 1024)] ^= 0x5A;
+    set_version(image, version, sha_hex);
+}
+
+/* Patch from `source` to `target` at server.patch */
+static void serve_patch(const uint8_t *source, const uint8_t *target, const char *version)
+{
+    uint8_t source_sha[32], target_sha[32];
+
+    mbedtls_sha256(source, IMAGE_LEN, source_sha, 0);
+    mbedtls_sha256(target, IMAGE_LEN, target_sha, 0);
+    server.patch_len = (uint32_t)ota_delta_encode(source, IMAGE_LEN, source_sha, target, IMAGE_LEN, target_sha,
+                                                  version, patch, sizeof(patch));
+    HOST_CHECK(server.patch_len != 0);
+    server.patch = patch;
+}
+
+static void serve(const uint8_t *image, bool range, double cut, double refuse)
+{
+    server = (server_t){ .image = image, .image_len = IMAGE_LEN, .range = range, .cut = cut, .refuse = refuse };
+}
+
+/* One update request, until the task is gone */
+static ota_progress_t run_update(const char *sha)
+{
+    ota_progress_t progress;
+
+    HOST_CHECK(ota_start_update(sha) == ESP_OK);
+    while (ota_is_running())
+        usleep(1000);
+    ota_get_progress(&progress);
+    return progress;
+}
+
+/* Update requests until one succeeds, like a dashboard re-triggering a failed update */
+static ota_progress_t run_until_success(const char *sha, int *triggers)
+{
+    ota_progress_t progress;
+
+    for (*triggers = 1; *triggers <= 50; (*triggers)++) {
+        progress = run_update(sha);
+        if (progress.status == OTA_STATUS_SUCCESS)
+            break;
+    }
+    return progress;
+}
+
+static bool flash_holds(const uint8_t *image)
+{
+    return memcmp(persist->flash[1], image, IMAGE_LEN) == 0;
+}
+
+/* needed: bytes the server had to send at least once */
+static void report(const char *name, const ota_progress_t *p, int triggers, uint32_t needed)
+{
+    printf("%-28s %-8s %4" PRIu32 " requests %3d triggers  %8.1f KB re-sent\n",
+           name, ota_status_to_string(p->status), server.requests, triggers,
+           ((double)server.served - needed) / 1024);
+}
+
+static void clean_download(void)
+{
+    serve(image_a, true, 0, 0);
+    ota_progress_t p = run_update(sha_a);
+    report("clean", &p, 1, IMAGE_LEN);
+
+    HOST_CHECK(p.status == OTA_STATUS_SUCCESS && p.attempts == 1);
+    HOST_CHECK(strcmp(p.version, "2.0.0") == 0);
+    HOST_CHECK(flash_holds(image_a) && server.served == IMAGE_LEN);
+    HOST_CHECK(persist->nvs_len == 0);
+
+    ota_staged_image_t staged;
+    HOST_CHECK(ota_get_staged_image(&staged) == ESP_OK && staged.size == IMAGE_LEN);
+}
+
+static void flaky_server(double cut, double refuse)
+{
+    char name[40];
+    int triggers;
+
+    serve(image_a, true, cut, refuse);
+    ota_progress_t p = run_until_success(sha_a, &triggers);
+    snprintf(name, sizeof(name), "%.0f%% cut, %.0f%% refused", cut * 100, refuse * 100);
+    report(name, &p, triggers, IMAGE_LEN);
+
+    // every byte made it to flash once, whatever the attempts and the triggers
+    HOST_CHECK(p.status == OTA_STATUS_SUCCESS && flash_holds(image_a));
+    HOST_CHECK(server.served == IMAGE_LEN);
+    HOST_CHECK(persist->nvs_len == 0);
+}
+
+static void power_loss(void)
+{
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        serve(image_a, true, 0, 0);
+        ota.power_loss_at = POWER_LOSS_AT;
+        run_update(sha_a);
+        _exit(1);   // the power loss never came
+    }
+    int status;
+    waitpid(child, &status, 0);
+    HOST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // the parent boots again: only the flash and NVS are left
+    serve(image_a, true, 0, 0);
+    ota_progress_t p = run_update(sha_a);
+    uint32_t checkpoint = POWER_LOSS_AT / OTA_CHECKPOINT_BYTES * OTA_CHECKPOINT_BYTES;
+    report("power loss at 800 KB", &p, 1, IMAGE_LEN - checkpoint);
+    HOST_CHECK(p.status == OTA_STATUS_SUCCESS && flash_holds(image_a));
+    HOST_CHECK(p.resumed_from == checkpoint);
+    HOST_CHECK(server.served == IMAGE_LEN - checkpoint);
+}
+
+static void no_range_support(void)
+{
+    int triggers;
+
+    serve(image_a, false, 0.5, 0);
+    ota_progress_t p = run_until_success(sha_a, &triggers);
+    report("no Range support, 50% cut", &p, triggers, IMAGE_LEN);
+
+    // every retry starts over from byte 0, the image still lands intact
+    HOST_CHECK(p.status == OTA_STATUS_SUCCESS && flash_holds(image_a));
+    HOST_CHECK(server.served >= IMAGE_LEN);
+}
+
+static void wrong_sha256(void)
+{
+    serve(image_a, true, 0.5, 0);
+    ota_progress_t p = run_update(sha_b);
+    
+    if (p.status == OTA_STATUS_FAILED && p.error != OTA_ERR_SHA256_MISMATCH) {
+        // the attempts ran out first: the next request resumes and ends the same way
+        serve(image_a, true, 0, 0);
+        p = run_update(sha_b);
+    }
+    HOST_CHECK(p.status == OTA_STATUS_FAILED && p.error == OTA_ERR_SHA256_MISMATCH);
+    HOST_CHECK(persist->nvs_len == 0);
+}
+
+static void checkpoint_of_another_image(void)
+{
+    // leave a checkpoint of image A behind
+    serve(image_a, true, 1.0, 0);
+    ota_progress_t p = run_update(sha_a);
+    HOST_CHECK(p.status == OTA_STATUS_FAILED);
+    HOST_CHECK(persist->nvs_len != 0);
+
+    serve(image_b, true, 0, 0);
+    p = run_update(sha_b);
+    report("checkpoint of another image", &p, 1, IMAGE_LEN);
+
+    HOST_CHECK(p.status == OTA_STATUS_SUCCESS && flash_holds(image_b));
+    HOST_CHECK(p.resumed_from == 0 && server.served == IMAGE_LEN);
+}
+
+static void without_sha256(void)
+{
+    serve(image_a, true, 1.0, 0);
+    ota_progress_t p = run_update(NULL);
+    HOST_CHECK(p.status == OTA_STATUS_FAILED);
+    // nothing ties the bytes to an image, so nothing is kept
+    HOST_CHECK(persist->nvs_len == 0);
+}
+
+static void reboot_into_update(void)
+{
+    serve(image_a, true, 0, 0);
+    ota_set_reboot_hold(false);
+    ota_progress_t p = run_update(sha_a);
+    ota_set_reboot_hold(true);
+
+    HOST_CHECK(p.status == OTA_STATUS_SUCCESS);
+    HOST_CHECK(ota.boot == &partitions[1] && ota.restarted);
+}
+
+static void delta_update(void)
+{
+    // the running image (ota_0) is B, version 1.0.0 for ota_manager
+    serve(image_c, true, 0, 0);
+    serve_patch(image_b, image_c, "2.1.0");
+    ota_progress_t p = run_update(sha_c);
+    report("delta patch", &p, 1, server.patch_len);
+    printf("%-28s %" PRIu32 " KB patch for a %d KB image\n", "", server.patch_len / 1024, IMAGE_LEN / 1024);
+
+    const char *name = strrchr(server.patch_url, '/');
+    HOST_CHECK(name != NULL && strcmp(name, "/1.0.0.patch") == 0);
+    HOST_CHECK(p.status == OTA_STATUS_SUCCESS && p.delta && flash_holds(image_c));
+    HOST_CHECK(strcmp(p.version, "2.1.0") == 0);
+    HOST_CHECK(server.requests == 1 && server.served == server.patch_len);
+}
+
+/* A patch that cannot be used: ota_manager downloads the full image instead */
+static void delta_fallback(const char *name, const uint8_t *image, const char *sha)
+{
+    ota_progress_t p = run_update(sha);
+    uint32_t patch_bytes = (uint32_t)(server.served - IMAGE_LEN);
+    report(name, &p, 1, IMAGE_LEN);
+
+    HOST_CHECK(p.status == OTA_STATUS_SUCCESS && !p.delta && flash_holds(image));
+    HOST_CHECK(server.served >= IMAGE_LEN && patch_bytes <= server.patch_len);
+}
+
+static void delta_fallbacks(void)
+{
+    serve(image_c, true, 0, 0);
+    delta_fallback("no patch (404)", image_c, sha_c);
+
+    // the patch rebuilds C, the request is for A
+    serve(image_a, true, 0, 0);
+    serve_patch(image_b, image_c, "2.1.0");
+    delta_fallback("patch builds another image", image_a, sha_a);
+
+    // made from A, the node runs B
+    serve(image_c, true, 0, 0);
+    serve_patch(image_a, image_c, "2.1.0");
+    delta_fallback("patch from another image", image_c, sha_c);
+
+    serve(image_c, true, 0, 0);
+    serve_patch(image_b, image_c, "2.1.0");
+    server.patch_len -= 50;
+    delta_fallback("truncated patch", image_c, sha_c);
+}
+
+static void delta_flaky_server(bool range, double cut)
+{
+    char name[40];
+    int triggers;
+
+    serve(image_c, range, cut, 0);
+    serve_patch(image_b, image_c, "2.1.0");
+    ota_progress_t p = run_until_success(sha_c, &triggers);
+    snprintf(name, sizeof(name), "delta, %.0f%% cut%s", cut * 100, range ? "" : ", no Range");
+    report(name, &p, triggers, server.patch_len);
+
+    HOST_CHECK(p.status == OTA_STATUS_SUCCESS && flash_holds(image_c));
+    // the decoder state is not saved, so nothing is kept in NVS
+    HOST_CHECK(persist->nvs_len == 0);
+    HOST_CHECK(p.delta && server.requests > 1);
+    if (range)
+        HOST_CHECK(server.served == server.patch_len);
+}
+
+/* Network and flash times per KB; the image is cut to 256 KB and not verified */
+static void pipeline_overlap(uint32_t read_us_per_kb, uint32_t write_us_per_kb)
+{
+    serve(image_a, true, 0, 0);
+    server.image_len = 256 * 1024;
+    server.read_us_per_kb = read_us_per_kb;
+    ota.write_us_per_kb = write_us_per_kb;
+    ota_progress_t p = run_update(NULL);
+    ota.write_us_per_kb = 0;
+
+    const ota_timing_t *t = &p.timing;
+    uint32_t serial_ms = t->network_ms + t->flash_ms + t->hash_ms;
+    printf("net %4" PRIu32 " us/KB, flash %4" PRIu32 " us/KB  %5" PRIu32 " ms  (net %4" PRIu32 " + %4" PRIu32
+           " waiting, flash %4" PRIu32 " + hash %3" PRIu32 " + %4" PRIu32 " waiting; serial %4" PRIu32 " ms)\n",
+           read_us_per_kb, write_us_per_kb, t->elapsed_ms, t->network_ms, t->network_wait_ms,
+           t->flash_ms, t->hash_ms, t->flash_wait_ms, serial_ms);
+
+    HOST_CHECK(p.status == OTA_STATUS_SUCCESS);
+    HOST_CHECK(memcmp(persist->flash[1], image_a, server.image_len) == 0);
+    // the slower stage sets the pace, the faster one waits for it
+    HOST_CHECK(t->elapsed_ms < serial_ms);
+    if (read_us_per_kb == write_us_per_kb)
+        HOST_CHECK(t->elapsed_ms * 10 < serial_ms * 7);
+    if (read_us_per_kb > 2 * write_us_per_kb)
+        HOST_CHECK(t->flash_wait_ms > t->flash_ms);
+    if (write_us_per_kb > 2 * read_us_per_kb)
+        HOST_CHECK(t->network_wait_ms > t->network_ms);
+}
+
+int main(void)
+{
+    persist = mmap(NULL, sizeof(*persist), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    HOST_CHECK(persist != MAP_FAILED);
+    if (persist == MAP_FAILED)
+        return host_test_result();
+
+    make_image(image_a, "2.0.0", sha_a);
+    make_image(image_b, "2.0.1", sha_b);
+    make_next_image(image_c, image_b, "2.1.0", sha_c);
+    memcpy(persist->flash[0], image_b, IMAGE_LEN);
+
+    HOST_CHECK(ota_manager_init() == ESP_OK);
+    ota_set_reboot_hold(true);
+
+    printf("%d KB image, %d KB buffers, checkpoint every %d KB, %d attempts per request\n",
+           IMAGE_LEN / 1024, OTA_BUF_SIZE / 1024, OTA_CHECKPOINT_BYTES / 1024, OTA_MAX_ATTEMPTS);
+    clean_download();
+    flaky_server(0.80, 0.05);
+    flaky_server(0.95, 0.50);
+    power_loss();
+    no_range_support();
+    wrong_sha256();
+    checkpoint_of_another_image();
+    without_sha256();
+    reboot_into_update();
+
+    delta_update();
+    delta_fallbacks();
+    delta_flaky_server(true, 0.6);
+    delta_flaky_server(false, 0.6);
+
+    printf("\n%d pipeline buffers, 256 KB\n", OTA_PIPELINE_BUFFERS);
+    pipeline_overlap(500, 500);
+    pipeline_overlap(1500, 500);
+    pipeline_overlap(500, 1500);
+
+    munmap(persist, sizeof(*persist));
+    return host_test_result();
+}
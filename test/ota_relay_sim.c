@@ -0,0 +1,284 @@
+/*
+ * Mesh OTA relay over lossy links (user-020).
+ *
+ * A 3-level tree: the root, 3 children, 2 grandchildren under each. Every
+ * hop runs ota_relay.c on both ends with the ota_mesh.h settings: the
+ * parent broadcasts chunks, each child queues them for a flash writer
+ * (OTA_MESH_WINDOW deep) and acks, and serves its own children once its
+ * image is complete (store and forward). Frames are lost with probability
+ * `loss` per receiver, and a received chunk is corrupt with loss / 5.
+ * Offers repeat while serving, so a child that missed them joins late.
+ *
+ * Reports the chunks each hop sent per image chunk, and checks that every
+ * node wrote every chunk once, in order, and intact.
+ */
+#include "ota_relay.h"
+#include "host_test.h"
+
+#include <string.h>
+
+#define CHUNK_COUNT     256         // 256 KB image in OTA_MESH_CHUNK_SIZE chunks
+#define WINDOW          8           // OTA_MESH_WINDOW
+#define ACK_EVERY       4           // OTA_MESH_ACK_EVERY
+#define RTO_MS          400         // OTA_MESH_RTO_MS
+#define CHILD_TIMEOUT   15000       // OTA_MESH_CHILD_TIMEOUT_MS
+#define OFFER_MS        500         // OTA_MESH_OFFER_PERIOD_MS
+#define JOIN_WINDOW_MS  3000        // OTA_MESH_JOIN_WINDOW_MS
+#define SEND_MS         2           // airtime of one chunk frame
+#define WRITE_MS        3           // flash write of one chunk
+#define LATENCY_MS      4           // frame delivery
+#define NODES           10
+#define SEEDS           50
+#define MAX_MS          600000
+
+typedef enum { MSG_OFFER, MSG_CHUNK, MSG_ACK } msg_type_t;
+
+typedef struct {
+    msg_type_t type;
+    uint8_t from, to;
+    uint32_t index;                 // chunk, or ack position
+    bool intact;
+    ota_relay_ack_t ack;
+} msg_t;
+
+typedef struct {
+    int parent;
+    int children[3];
+    int child_count;
+    uint8_t mac[6];
+    // receiving from the parent
+    bool receiving, verified;
+    ota_relay_rx_t rx;
+    uint32_t queued;                // chunks waiting for the writer
+    uint32_t write_done_ms;         // writer busy until (0 = idle)
+    uint32_t expect;                // next chunk the writer must see
+    bool order_ok;
+    // serving its children
+    bool serving, served;
+    ota_relay_tx_t tx;
+    uint32_t serve_start_ms, last_offer_ms, busy_until_ms;
+} node_t;
+
+/* Frames in flight, bucketed by delivery time */
+#define WHEEL           (LATENCY_MS + 1)
+#define BUCKET_MAX      512
+static msg_t wheel[WHEEL][BUCKET_MAX];
+static int wheel_len[WHEEL];
+
+static node_t nodes[NODES];
+static double loss;
+
+static void post(uint32_t now, const msg_t *m)
+{
+    if (host_rand_unit() < loss)
+        return;
+    int b = (now + LATENCY_MS) % WHEEL;
+    HOST_CHECK(wheel_len[b] < BUCKET_MAX);
+    if (wheel_len[b] < BUCKET_MAX)
+        wheel[b][wheel_len[b]++] = *m;
+}
+
+static void send_ack(uint32_t now, int from, ota_relay_ack_t ack, uint32_t next)
+{
+    msg_t m = { MSG_ACK, (uint8_t)from, (uint8_t)nodes[from].parent, next, true, ack };
+    post(now, &m);
+}
+
+static void build_tree(void)
+{
+    memset(nodes, 0, sizeof(nodes));
+    for (int i = 0; i < NODES; i++) {
+        nodes[i].mac[0] = 0x02;
+        nodes[i].mac[5] = (uint8_t)i;
+        nodes[i].parent = i == 0 ? -1 : i <= 3 ? 0 : 1 + (i - 4) / 2;
+        if (nodes[i].parent >= 0) {
+            node_t *p = &nodes[nodes[i].parent];
+            p->children[p->child_count++] = i;
+        }
+        nodes[i].order_ok = true;
+    }
+    // the root holds the image it downloaded
+    nodes[0].verified = true;
+}
+
+static void start_serving(int n, uint32_t now)
+{
+    const ota_relay_config_t config = { CHUNK_COUNT, WINDOW, RTO_MS, CHILD_TIMEOUT };
+    node_t *p = &nodes[n];
+
+    if (p->child_count == 0)
+        return;
+    ota_relay_tx_init(&p->tx, &config, now);
+    p->serving = true;
+    p->serve_start_ms = now;
+    p->last_offer_ms = now - OFFER_MS;
+}
+
+static void deliver(uint32_t now, const msg_t *m)
+{
+    node_t *to = &nodes[m->to];
+
+    switch (m->type) {
+        case MSG_OFFER:
+            // like ota_offer_to_child_raw_msg_process: every offer is answered,
+            // in case the previous answer was lost
+            if (to->verified) {
+                send_ack(now, m->to, OTA_RELAY_ACK_DONE, CHUNK_COUNT);
+            } else if (to->receiving) {
+                send_ack(now, m->to, OTA_RELAY_ACK_PROGRESS, to->rx.written);
+            } else {
+                ota_relay_rx_init(&to->rx, CHUNK_COUNT, ACK_EVERY);
+                to->receiving = true;
+                send_ack(now, m->to, OTA_RELAY_ACK_PROGRESS, 0);
+            }
+            break;
+        case MSG_ACK:
+            if (to->serving)
+                ota_relay_tx_ack(&to->tx, nodes[m->from].mac, m->index, m->ack, now);
+            break;
+        case MSG_CHUNK:
+            if (to->verified) {
+                // the parent resends the last chunk when our DONE was lost
+                send_ack(now, m->to, OTA_RELAY_ACK_DONE, CHUNK_COUNT);
+            } else if (to->receiving) {
+                ota_relay_rx_result_t r = ota_relay_rx_check(&to->rx, m->index, m->intact);
+                if (r == OTA_RELAY_RX_ACCEPT) {
+                    if (m->index != to->expect + to->queued || !m->intact)
+                        to->order_ok = false;
+                    if (to->queued < WINDOW) {
+                        to->queued++;
+                        ota_relay_rx_commit(&to->rx);
+                    }
+                }
+                ota_relay_ack_t ack;
+                uint32_t next;
+                if (ota_relay_rx_ack_due(&to->rx, r, &ack, &next))
+                    send_ack(now, m->to, ack, next);
+            }
+            break;
+    }
+}
+
+static void step_writer(int n, uint32_t now)
+{
+    node_t *c = &nodes[n];
+
+    if (c->write_done_ms && now >= c->write_done_ms) {
+        c->write_done_ms = 0;
+        c->queued--;
+        c->expect++;
+        uint32_t next;
+        bool due = ota_relay_rx_written(&c->rx, &next);
+        if (ota_relay_rx_complete(&c->rx)) {
+            c->receiving = false;
+            c->verified = c->order_ok && c->expect == CHUNK_COUNT;
+            send_ack(now, n, c->verified ? OTA_RELAY_ACK_DONE : OTA_RELAY_ACK_FAILED, CHUNK_COUNT);
+            if (c->verified)
+                start_serving(n, now);
+        } else if (due) {
+            send_ack(now, n, OTA_RELAY_ACK_PROGRESS, next);
+        }
+    }
+    if (!c->write_done_ms && c->queued)
+        c->write_done_ms = now + WRITE_MS;
+}
+
+static void step_parent(int n, uint32_t now)
+{
+    node_t *p = &nodes[n];
+
+    if (now - p->last_offer_ms >= OFFER_MS) {
+        for (int i = 0; i < p->child_count; i++) {
+            msg_t offer = { MSG_OFFER, (uint8_t)n, (uint8_t)p->children[i], 0, true, OTA_RELAY_ACK_PROGRESS };
+            post(now, &offer);
+        }
+        p->last_offer_ms = now;
+    }
+    if (now - p->serve_start_ms < JOIN_WINDOW_MS || now < p->busy_until_ms)
+        return;
+
+    uint32_t index;
+    bool send = ota_relay_tx_next(&p->tx, now, &index);
+    if (ota_relay_tx_finished(&p->tx)) {
+        p->serving = false;
+        p->served = true;
+        return;
+    }
+    if (!send)
+        return;
+
+    // one broadcast, each child hears it (or not) on its own
+    for (int i = 0; i < p->child_count; i++) {
+        msg_t chunk = { MSG_CHUNK, (uint8_t)n, (uint8_t)p->children[i], index,
+                        host_rand_unit() >= loss / 5, OTA_RELAY_ACK_PROGRESS };
+        post(now, &chunk);
+    }
+    p->busy_until_ms = now + SEND_MS;
+}
+
+/* One update of the tree; returns the time until every node verified its image */
+static uint32_t run(uint32_t *hop_sent)
+{
+    memset(wheel_len, 0, sizeof(wheel_len));
+    build_tree();
+    start_serving(0, 0);
+
+    uint32_t now;
+    for (now = 1; now < MAX_MS; now++) {
+        int b = now % WHEEL;
+        for (int i = 0; i < wheel_len[b]; i++)
+            deliver(now, &wheel[b][i]);
+        wheel_len[b] = 0;
+
+        bool all = true;
+        for (int n = 0; n < NODES; n++) {
+            if (nodes[n].receiving)
+                step_writer(n, now);
+            if (nodes[n].serving)
+                step_parent(n, now);
+            all &= nodes[n].verified && !nodes[n].serving;
+        }
+        if (all)
+            break;
+    }
+
+    hop_sent[0] += nodes[0].tx.sent;
+    for (int n = 1; n <= 3; n++)
+        hop_sent[1] += nodes[n].tx.sent;
+    return now;
+}
+
+int main(void)
+{
+    static const double losses[] = { 0.0, 0.05, 0.30 };
+
+    printf("root -> 3 children -> 6 grandchildren, %d chunks, %d seeds\n", CHUNK_COUNT, SEEDS);
+    printf(" loss  completed  hop 1 sent/image  hop 2 sent/image  mean time s\n");
+    for (size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+        uint32_t hop_sent[2] = { 0, 0 };
+        int completed = 0;
+        double time_sum = 0;
+
+        loss = losses[l];
+        for (int seed = 1; seed <= SEEDS; seed++) {
+            host_seed((uint64_t)seed * 7919);
+            uint32_t t = run(hop_sent);
+            bool ok = true;
+            for (int n = 0; n < NODES; n++)
+                ok &= nodes[n].verified && nodes[n].order_ok;
+            completed += ok;
+            time_sum += t;
+        }
+
+        double hop1 = (double)hop_sent[0] / SEEDS / CHUNK_COUNT;
+        double hop2 = (double)hop_sent[1] / (3.0 * SEEDS) / CHUNK_COUNT;
+        printf("%4.0f%%  %6d/%d  %16.2fx  %16.2fx  %11.1f\n",
+               loss * 100, completed, SEEDS, hop1, hop2, time_sum / SEEDS / 1000);
+
+        HOST_CHECK(completed == SEEDS);
+        if (loss == 0)
+            HOST_CHECK(hop_sent[0] == SEEDS * CHUNK_COUNT && hop_sent[1] == 3 * SEEDS * CHUNK_COUNT);
+    }
+
+    return host_test_result();
+}
@@ -0,0 +1,215 @@
+/*
+ * Staged fleet activation (user-023).
+ *
+ * The root runs ota_rollout.c with the ota_mesh.h settings and sends a
+ * beacon every OTA_MESH_BEACON_PERIOD_MS listing the nodes to activate. The
+ * nodes answer like ota_rollout_to_child_raw_msg_process: STAGED once their
+ * image is verified (at a random time in the first minute), and a listed
+ * node reboots into the new build, silent for 45..85 s. Beacons and reports
+ * are each lost with probability LOSS.
+ *
+ * Nodes can be bad: rolled back (back on the old build, so WAITING), crashing
+ * (RUNNING, then silent), or never staging the image.
+ *
+ * Checks, per seed, that the rollout completes or halts as it should, that
+ * no more than `canary` nodes reboot before the soak is over and no more
+ * than `concurrent` at any time, and that no node boots once it halted.
+ */
+#include "ota_rollout.h"
+#include "host_test.h"
+
+#include <string.h>
+
+#define NODES           20
+#define SEEDS           50
+#define LOSS            0.10
+#define STEP_MS         1000        // OTA_MESH_BEACON_PERIOD_MS
+#define STAGE_MAX_MS    60000
+#define REBOOT_MIN_MS   45000
+#define REBOOT_MAX_MS   85000
+#define CRASH_AFTER_MS  20000       // a crashing build stops answering after
+#define MAX_MS          (4 * 3600 * 1000u)
+#define NEVER           UINT32_MAX
+
+typedef enum { NODE_GOOD, NODE_ROLLBACK, NODE_CRASH, NODE_NO_IMAGE } node_kind_t;
+
+typedef struct {
+    node_kind_t kind;
+    uint32_t staged_at;
+    uint32_t boot_at, back_at;      // NEVER until activated
+} node_t;
+
+typedef struct {
+    const char *name;
+    node_kind_t kind;
+    int bad_node;                   // -1: all good; node 0 is staged first, so it is the canary
+    ota_rollout_phase_t expect;
+} scenario_t;
+
+typedef struct {
+    ota_rollout_phase_t phase;
+    uint32_t end_ms;
+    int max_rebooting, max_rebooting_canary;
+    int booted_after_halt;
+    int updated, booted;
+} outcome_t;
+
+static node_t nodes[NODES];
+
+static void mac_of(int i, uint8_t *mac)
+{
+    static const uint8_t base[6] = { 0x02, 0xBB, 0, 0, 0, 0 };
+    memcpy(mac, base, 6);
+    mac[5] = (uint8_t)i;
+}
+
+/* Answer of node i to a beacon (false: it says nothing) */
+static bool node_beacon(int i, const uint8_t (*activate)[6], uint8_t count, uint32_t now,
+                        ota_rollout_report_t *report)
+{
+    node_t *n = &nodes[i];
+
+    if (n->boot_at != NEVER) {
+        if (now < n->back_at)
+            return false;                       // rebooting
+        if (n->kind == NODE_ROLLBACK) {
+            *report = OTA_ROLLOUT_REPORT_WAITING;   // the bootloader went back, image gone
+            return true;
+        }
+        if (n->kind == NODE_CRASH && now >= n->back_at + CRASH_AFTER_MS)
+            return false;
+        *report = OTA_ROLLOUT_REPORT_RUNNING;
+        return true;
+    }
+    if (now < n->staged_at) {
+        *report = OTA_ROLLOUT_REPORT_WAITING;
+        return true;
+    }
+
+    uint8_t mac[6];
+    mac_of(i, mac);
+    for (uint8_t k = 0; k < count; k++) {
+        if (memcmp(activate[k], mac, 6) == 0) {
+            n->boot_at = now;
+            n->back_at = now + REBOOT_MIN_MS + host_rand() % (REBOOT_MAX_MS - REBOOT_MIN_MS);
+            break;
+        }
+    }
+    *report = OTA_ROLLOUT_REPORT_STAGED;
+    return true;
+}
+
+static outcome_t run(const ota_rollout_config_t *config, const scenario_t *s)
+{
+    ota_rollout_t r;
+    outcome_t o = { 0 };
+    uint32_t halted_at = NEVER;
+
+    // the first node staged is the canary: node 0 when the canary is the bad one
+    for (int i = 0; i < NODES; i++) {
+        nodes[i].kind = i == s->bad_node ? s->kind : NODE_GOOD;
+        nodes[i].staged_at = nodes[i].kind == NODE_NO_IMAGE ? NEVER : host_rand() % STAGE_MAX_MS;
+        if (s->bad_node == 0)
+            nodes[i].staged_at = i == 0 ? 0 : 10000 + nodes[i].staged_at % (STAGE_MAX_MS - 10000);
+        nodes[i].boot_at = nodes[i].back_at = NEVER;
+    }
+
+    ota_rollout_init(&r, config, 0);
+    uint32_t now;
+    for (now = 0; now < MAX_MS && !ota_rollout_finished(&r); now += STEP_MS) {
+        ota_rollout_phase_t phase = ota_rollout_step(&r, now);
+        if (phase == OTA_ROLLOUT_HALTED && halted_at == NEVER)
+            halted_at = now;
+
+        uint8_t activate[OTA_ROLLOUT_MAX_ACTIVE][6];
+        uint8_t count = ota_rollout_activating(&r, activate, OTA_ROLLOUT_MAX_ACTIVE);
+        if (ota_rollout_finished(&r))
+            count = 0;                          // no more beacons
+
+        int rebooting = 0;
+        for (int i = 0; i < NODES; i++) {
+            ota_rollout_report_t report;
+            if (host_rand_unit() >= LOSS && node_beacon(i, activate, count, now, &report) &&
+                host_rand_unit() >= LOSS) {
+                uint8_t mac[6];
+                mac_of(i, mac);
+                HOST_CHECK(ota_rollout_report(&r, mac, report, now));
+            }
+            rebooting += nodes[i].boot_at != NEVER && now < nodes[i].back_at;
+        }
+
+        if (rebooting > o.max_rebooting)
+            o.max_rebooting = rebooting;
+        if ((phase == OTA_ROLLOUT_CANARY || phase == OTA_ROLLOUT_SOAK) && rebooting > o.max_rebooting_canary)
+            o.max_rebooting_canary = rebooting;
+    }
+
+    o.phase = r.phase;
+    o.end_ms = now;
+    if (r.phase == OTA_ROLLOUT_HALTED && halted_at == NEVER)
+        halted_at = now;
+    for (int i = 0; i < NODES; i++) {
+        o.booted += nodes[i].boot_at != NEVER;
+        o.booted_after_halt += nodes[i].boot_at != NEVER && nodes[i].boot_at >= halted_at;
+    }
+    uint8_t counts[OTA_ROLLOUT_NODE_STATES];
+    ota_rollout_count(&r, counts);
+    o.updated = counts[OTA_ROLLOUT_NODE_UPDATED];
+    return o;
+}
+
+int main(void)
+{
+    static const scenario_t scenarios[] = {
+        { "all good",               NODE_GOOD,     -1, OTA_ROLLOUT_COMPLETE },
+        { "one node never staged",  NODE_NO_IMAGE,  7, OTA_ROLLOUT_COMPLETE },
+        { "one node rolls back",    NODE_ROLLBACK,  7, OTA_ROLLOUT_HALTED },
+        { "canary rolls back",      NODE_ROLLBACK,  0, OTA_ROLLOUT_HALTED },
+        { "canary crashes",         NODE_CRASH,     0, OTA_ROLLOUT_HALTED },
+    };
+    static const uint8_t concurrents[] = { 2, 4 };
+
+    printf("%d nodes, %d seeds, %.0f%% of beacons and reports lost, reboots %d..%d s, 1 canary\n",
+           NODES, SEEDS, LOSS * 100, REBOOT_MIN_MS / 1000, REBOOT_MAX_MS / 1000);
+    printf("scenario                conc | as expected  mean min  updated  booted  max rebooting\n");
+    for (size_t c = 0; c < sizeof(concurrents) / sizeof(concurrents[0]); c++) {
+        // ota_mesh.c defaults apart from `concurrent`
+        const ota_rollout_config_t config = {
+            .canary = 1, .concurrent = concurrents[c], .max_failures = 0,
+            .canary_soak_ms = 60000, .confirm_timeout_ms = 120000, .silence_ms = 30000,
+            .stage_timeout_ms = 300000, .discovery_ms = 10000,
+        };
+
+        for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+            const scenario_t *sc = &scenarios[s];
+            int expected = 0, max_rebooting = 0;
+            double minutes = 0, updated = 0, booted = 0;
+
+            for (int seed = 1; seed <= SEEDS; seed++) {
+                host_seed((uint64_t)seed * 104729 + c);
+                outcome_t o = run(&config, sc);
+
+                expected += o.phase == sc->expect;
+                minutes += o.end_ms / 60000.0;
+                updated += o.updated;
+                booted += o.booted;
+                if (o.max_rebooting > max_rebooting)
+                    max_rebooting = o.max_rebooting;
+
+                HOST_CHECK(o.phase == sc->expect);
+                HOST_CHECK(o.max_rebooting <= config.concurrent);
+                HOST_CHECK(o.max_rebooting_canary <= config.canary);
+                HOST_CHECK(o.booted_after_halt == 0);
+                if (sc->expect == OTA_ROLLOUT_COMPLETE)
+                    HOST_CHECK(o.updated == NODES - (sc->bad_node >= 0));
+                if (sc->bad_node == 0)
+                    HOST_CHECK(o.booted == 1);      // nobody follows a bad canary
+            }
+
+            printf("%-22s %4u | %8d/%d  %8.1f  %7.1f  %6.1f  %13d\n", sc->name, config.concurrent,
+                   expected, SEEDS, minutes / SEEDS, updated / SEEDS, booted / SEEDS, max_rebooting);
+        }
+    }
+
+    return host_test_result();
+}
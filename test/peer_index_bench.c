@@ -0,0 +1,142 @@
+/*
+ * peer_index vs the SLIST walk it replaced (user-001).
+ *
+ * Checks the index against a reference list over random insert/remove churn,
+ * then times MAC lookups (hits and misses) at 10/50/200 peers. The list nodes
+ * carry a payload of the size of a TX_peer so the walk touches one cache line
+ * per peer, like the firmware did.
+ */
+#include "peer_index.h"
+#include "host_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+
+#define MAX_PEERS       200
+#define LOOKUPS         2000000
+#define CHURN_OPS       200000
+
+struct peer {
+    SLIST_ENTRY(peer) next;
+    uint8_t mac[PEER_INDEX_MAC_LEN];
+    bool indexed;
+    uint8_t payload[360];           // ~sizeof(struct TX_peer) before user-002
+};
+
+SLIST_HEAD(peer_list, peer);
+
+static struct peer peers[MAX_PEERS];
+static peer_index_entry_t slots[512];
+
+static void random_mac(uint8_t *mac)
+{
+    // same OUI for every peer, like a fleet of one board type
+    mac[0] = 0x24; mac[1] = 0x6F; mac[2] = 0x28;
+    for (int i = 3; i < PEER_INDEX_MAC_LEN; i++)
+        mac[i] = (uint8_t)host_rand();
+}
+
+static struct peer *list_find(struct peer_list *list, const uint8_t *mac)
+{
+    struct peer *p;
+    SLIST_FOREACH(p, list, next) {
+        if (memcmp(p->mac, mac, PEER_INDEX_MAC_LEN) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+static uint32_t index_size(uint32_t n)
+{
+    uint32_t size = 16;
+    while (size < 2 * n)
+        size <<= 1;
+    return size;
+}
+
+/* Random insert/remove against the reference list */
+static void check_churn(void)
+{
+    peer_index_t index;
+    struct peer_list list = SLIST_HEAD_INITIALIZER(list);
+
+    peer_index_init(&index, slots, index_size(MAX_PEERS));
+    for (int i = 0; i < MAX_PEERS; i++) {
+        random_mac(peers[i].mac);
+        peers[i].indexed = false;
+    }
+
+    for (int op = 0; op < CHURN_OPS; op++) {
+        struct peer *p = &peers[host_rand() % MAX_PEERS];
+
+        if (!p->indexed) {
+            HOST_CHECK(peer_index_insert(&index, p->mac, p));
+            SLIST_INSERT_HEAD(&list, p, next);
+            p->indexed = true;
+        } else if (host_rand() % 2) {
+            peer_index_remove(&index, p->mac);
+            SLIST_REMOVE(&list, p, peer, next);
+            p->indexed = false;
+            // a leaving peer usually comes back with another MAC
+            random_mac(p->mac);
+        }
+
+        const uint8_t *key = peers[host_rand() % MAX_PEERS].mac;
+        HOST_CHECK(peer_index_find(&index, key) == list_find(&list, key));
+    }
+}
+
+static void bench(uint32_t n)
+{
+    peer_index_t index;
+    struct peer_list list = SLIST_HEAD_INITIALIZER(list);
+    uint8_t misses[64][PEER_INDEX_MAC_LEN];
+    uint32_t *order = malloc(LOOKUPS * sizeof(*order));
+    volatile uintptr_t sink = 0;
+
+    peer_index_init(&index, slots, index_size(n));
+    for (uint32_t i = 0; i < n; i++) {
+        random_mac(peers[i].mac);
+        SLIST_INSERT_HEAD(&list, &peers[i], next);
+        HOST_CHECK(peer_index_insert(&index, peers[i].mac, &peers[i]));
+    }
+    for (int i = 0; i < 64; i++)
+        random_mac(misses[i]);
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        order[i] = host_rand() % n;
+
+    uint64_t t0 = host_now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        sink += (uintptr_t)list_find(&list, peers[order[i]].mac);
+    uint64_t t1 = host_now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        sink += (uintptr_t)peer_index_find(&index, peers[order[i]].mac);
+    uint64_t t2 = host_now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        sink += (uintptr_t)list_find(&list, misses[i & 63]);
+    uint64_t t3 = host_now_ns();
+    for (uint32_t i = 0; i < LOOKUPS; i++)
+        sink += (uintptr_t)peer_index_find(&index, misses[i & 63]);
+    uint64_t t4 = host_now_ns();
+
+    printf("%5u  %9.1f  %9.1f  %9.1f  %9.1f  %6.1fx\n", n,
+           (double)(t1 - t0) / LOOKUPS, (double)(t2 - t1) / LOOKUPS,
+           (double)(t3 - t2) / LOOKUPS, (double)(t4 - t3) / LOOKUPS,
+           (double)(t1 - t0) / (double)(t2 - t1));
+    free(order);
+}
+
+int main(void)
+{
+    check_churn();
+
+    printf("ns per lookup\n");
+    printf("peers  list hit  index hit  list miss  index miss  speedup(hit)\n");
+    bench(10);
+    bench(50);
+    bench(200);
+
+    return host_test_result();
+}
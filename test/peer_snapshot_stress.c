@@ -0,0 +1,266 @@
+/*
+ * TX peer table under concurrent writers and a publishing reader (user-003).
+ *
+ * Runs the real peer.c (through test/idf_shim) with:
+ *   - two "mesh handler" threads writing payloads through the peer.c entry
+ *     points the handlers use: one stores whole payloads like
+ *     dynamic_to_root_raw_msg_process, the other applies binary frames like
+ *     dynamic_v2_to_root_raw_msg_process; each call is timed;
+ *   - one "join/leave" thread deleting and re-adding children;
+ *   - one "mqtt_publish_task" thread publishing every peer, where a publish
+ *     costs PUBLISH_US of busy time like a QoS1 esp_mqtt_client_publish.
+ * The reader runs either the snapshot path (TX_peers_snapshot / commit, lock
+ * held for the copy only) or the old path (whole loop under TX_peers_mutex).
+ * Reports the lock hold and the handler wait of both. The checks use the
+ * median hold and the p99 wait: a preemption on a loaded host can stretch
+ * any single hold, so the maxima are only reported. Every payload written
+ * has all its values equal, so a snapshot must never see two different
+ * values in one peer (a torn copy).
+ */
+#include "peer.h"
+#include "mesh_codec.h"
+#include "host_test.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define CHILDREN        15
+#define PUBLISH_US      500
+#define RUN_MS          1500
+
+/* Firmware globals peer.c links against */
+uint8_t UNIT_ID = 1;
+uint8_t self_mac[ETH_HWADDR_LEN] = { 0x24, 0x6F, 0x28, 0x00, 0x00, 0x01 };
+float OVER_CURRENT, OVER_TEMPERATURE, OVER_VOLTAGE;
+bool FOD, FULLY_CHARGED;
+bool strip_enable, strip_charging, strip_misalignment;
+void TX_init_hw(void) {}
+void RX_init_hw(void) {}
+
+static atomic_bool running;
+static atomic_uint lookups;
+static atomic_uint handler_max_wait_us;
+static uint32_t handler_waits[1 << 20];
+static atomic_uint handler_wait_count;
+static atomic_uint torn;
+
+static void child_mac(int i, uint8_t *mac)
+{
+    memcpy(mac, self_mac, ETH_HWADDR_LEN);
+    mac[5] = (uint8_t)(0x10 + i);
+}
+
+static void busy_us(uint32_t us)
+{
+    int64_t end = esp_timer_get_time() + us;
+    while (esp_timer_get_time() < end)
+        ;
+}
+
+static void record_wait(uint32_t us)
+{
+    unsigned prev = atomic_load(&handler_max_wait_us);
+    while (us > prev && !atomic_compare_exchange_weak(&handler_max_wait_us, &prev, us))
+        ;
+    unsigned n = atomic_fetch_add(&handler_wait_count, 1);
+    if (n < sizeof(handler_waits) / sizeof(handler_waits[0]))
+        handler_waits[n] = us;
+}
+
+/* A payload with all its values equal to v (an integer below 32: exact in every FIX16 field of the codec) */
+static void uniform_payload(mesh_dynamic_payload_t *d, const uint8_t *mac, float v)
+{
+    memset(d, 0, sizeof(*d));
+    memcpy(d->TX.macAddr, mac, ETH_HWADDR_LEN);
+    d->TX.voltage = d->TX.current = d->TX.temp1 = d->TX.temp2 = v;
+    d->RX.voltage = d->RX.current = d->RX.temp1 = d->RX.temp2 = v;
+}
+
+static bool uniform(const mesh_dynamic_payload_t *d)
+{
+    float v = d->TX.voltage;
+    return d->TX.current == v && d->TX.temp1 == v && d->TX.temp2 == v &&
+           d->RX.voltage == v && d->RX.current == v && d->RX.temp1 == v && d->RX.temp2 == v;
+}
+
+static void *handler_thread(void *arg)
+{
+    uint64_t seed = (uintptr_t)arg;
+    bool binary = (uintptr_t)arg == 2;
+    uint8_t seq = 0;
+
+    while (atomic_load(&running)) {
+        uint8_t mac[ETH_HWADDR_LEN];
+        uint8_t frame[MESH_CODEC_DYNAMIC_MAX_LEN];
+        mesh_dynamic_payload_t d;
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        child_mac((int)((seed >> 33) % CHILDREN), mac);
+        uniform_payload(&d, mac, (float)((seed >> 20) % 32));
+
+        int64_t t0 = esp_timer_get_time();
+        if (binary) {
+            size_t len = mesh_codec_encode_dynamic(&d, NULL, seq++, frame, sizeof(frame));
+            esp_err_t err = TX_peer_decode_dynamic(mac, frame, (uint32_t)len);
+            HOST_CHECK(err == ESP_OK || err == ESP_ERR_NOT_FOUND);
+        } else {
+            TX_peer_store_dynamic(mac, &d);
+        }
+        record_wait((uint32_t)(esp_timer_get_time() - t0));
+
+        atomic_fetch_add(&lookups, 1);
+        usleep(200);
+    }
+    return NULL;
+}
+
+static void *churn_thread(void *arg)
+{
+    (void)arg;
+    int i = 0;
+
+    while (atomic_load(&running)) {
+        uint8_t mac[ETH_HWADDR_LEN];
+        child_mac(i, mac);
+        peer_delete(mac);
+        usleep(1000);
+        HOST_CHECK(TX_peer_add(mac, (uint8_t)(2 + i)) != NULL);
+        i = (i + 1) % CHILDREN;
+        usleep(2000);
+    }
+    return NULL;
+}
+
+static TX_peers_snapshot_t snap;
+static uint32_t old_max_hold_us;
+static uint32_t reader_holds[1 << 14];      // one per reader pass (snapshot: the TX_peers_snapshot call)
+static unsigned reader_hold_count;
+
+static void record_hold(uint32_t us)
+{
+    if (reader_hold_count < sizeof(reader_holds) / sizeof(reader_holds[0]))
+        reader_holds[reader_hold_count++] = us;
+}
+
+static void *reader_thread(void *arg)
+{
+    bool use_snapshot = (bool)(uintptr_t)arg;
+
+    while (atomic_load(&running)) {
+        if (use_snapshot) {
+            int64_t t0 = esp_timer_get_time();
+            uint16_t n = TX_peers_snapshot(&snap);
+            record_hold((uint32_t)(esp_timer_get_time() - t0));
+            HOST_CHECK(n >= 1 && n <= MESH_LITE_MAXIMUM_NODE_NUMBER);
+            for (uint16_t i = 0; i < n; i++) {
+                if (!uniform(&snap.peers[i].dynamic_payload))
+                    atomic_fetch_add(&torn, 1);
+                busy_us(PUBLISH_US);
+                TX_peer_commit_published(&snap.peers[i], true, false);
+            }
+        } else {
+            // the loop before the snapshot: JSON and publish under the lock
+            WITH_TX_PEERS_LOCKED {
+                int64_t t0 = esp_timer_get_time();
+                struct TX_peer *p;
+                SLIST_FOREACH(p, &TX_peers, next) {
+                    update_status(p);
+                    busy_us(PUBLISH_US);
+                    p->lastDynamicPublished = xTaskGetTickCount();
+                }
+                uint32_t held = (uint32_t)(esp_timer_get_time() - t0);
+                if (held > old_max_hold_us)
+                    old_max_hold_us = held;
+                record_hold(held);
+            }
+        }
+        usleep(5000);
+    }
+    return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    uint32_t hold_p50_us;
+    uint32_t wait_p99_us;
+} run_result_t;
+
+static run_result_t run(bool use_snapshot)
+{
+    pthread_t readers, churn, handlers[2];
+
+    atomic_store(&running, true);
+    atomic_store(&lookups, 0);
+    atomic_store(&handler_max_wait_us, 0);
+    atomic_store(&handler_wait_count, 0);
+    reader_hold_count = 0;
+
+    pthread_create(&readers, NULL, reader_thread, (void *)(uintptr_t)use_snapshot);
+    pthread_create(&churn, NULL, churn_thread, NULL);
+    for (int i = 0; i < 2; i++)
+        pthread_create(&handlers[i], NULL, handler_thread, (void *)(uintptr_t)(i + 1));
+
+    usleep(RUN_MS * 1000);
+    atomic_store(&running, false);
+
+    pthread_join(readers, NULL);
+    pthread_join(churn, NULL);
+    for (int i = 0; i < 2; i++)
+        pthread_join(handlers[i], NULL);
+
+    unsigned n = atomic_load(&handler_wait_count);
+    if (n > sizeof(handler_waits) / sizeof(handler_waits[0]))
+        n = sizeof(handler_waits) / sizeof(handler_waits[0]);
+    qsort(handler_waits, n, sizeof(handler_waits[0]), cmp_u32);
+
+    qsort(reader_holds, reader_hold_count, sizeof(reader_holds[0]), cmp_u32);
+
+    run_result_t r = {
+        reader_hold_count ? reader_holds[reader_hold_count / 2] : 0,
+        n ? handler_waits[n * 99 / 100] : 0,
+    };
+    uint32_t hold = use_snapshot ? TX_peers_snapshot_max_hold_us() : old_max_hold_us;
+    uint32_t max_wait = atomic_load(&handler_max_wait_us);
+    printf("%-16s  %8u  %11" PRIu32 "  %12" PRIu32 "  %11" PRIu32 "  %12" PRIu32 "\n",
+           use_snapshot ? "snapshot" : "lock held", atomic_load(&lookups), r.hold_p50_us, hold,
+           r.wait_p99_us, max_wait);
+    return r;
+}
+
+int main(void)
+{
+    peer_init();
+    for (int i = 0; i < CHILDREN; i++) {
+        uint8_t mac[ETH_HWADDR_LEN];
+        child_mac(i, mac);
+        HOST_CHECK(TX_peer_add(mac, (uint8_t)(2 + i)) != NULL);
+    }
+
+    // the root's own peer aliases self_dynamic_payload, the snapshot must not end a probe pulse
+    self_dynamic_payload.TX.tx_status = TX_PROBE;
+    TX_peers_snapshot(&snap);
+    HOST_CHECK(self_dynamic_payload.TX.tx_status == TX_PROBE);
+    self_dynamic_payload.TX.tx_status = TX_OFF;
+
+    printf("%d children + self, publish %d us per peer, %d ms per run\n", CHILDREN, PUBLISH_US, RUN_MS);
+    printf("%-16s  %8s  %11s  %12s  %11s  %12s\n", "reader", "writes", "p50 hold us", "max hold us",
+           "p99 wait us", "max wait us");
+    run_result_t old = run(false);
+    run_result_t new = run(true);
+
+    // the old loop holds the lock for every publish, the snapshot only for a copy
+    HOST_CHECK(new.hold_p50_us * 10 < old.hold_p50_us);
+    HOST_CHECK(new.wait_p99_us < old.wait_p99_us);
+    HOST_CHECK(atomic_load(&torn) == 0);
+
+    peer_pool_stats_t stats;
+    peer_pool_get_stats(TX, &stats);
+    HOST_CHECK(stats.in_use == CHILDREN + 1);
+    HOST_CHECK(stats.alloc_failures == 0);
+
+    return host_test_result();
+}
@@ -0,0 +1,130 @@
+/*
+ * Dead battery probing: duty per pad vs detection latency (user-018).
+ *
+ * Pads sit in a row (positions 1..N, neighbours adjacent), all idle. Every
+ * period the root probes the next group from loc_next_group (localization.c)
+ * with group_max pads, like probe_idle_pads. A scooter with a dead RX parks
+ * on a random pad at a random time. The STM32 measures every MEAS_MS with a
+ * random phase; the scooter is found by the first measurement that falls in
+ * a pulse of its pad, like apply_STM_measurement.
+ *
+ * Reports the share of time each pad spends pulsing and the mean / p99 time
+ * from parking to detection.
+ */
+#include "localization.h"
+#include "host_test.h"
+
+#include <stdlib.h>
+
+#define MEAS_MS         50          // STM32 measurement interval
+#define TRIALS          5000
+
+typedef struct {
+    int pads;
+    uint8_t group_max;
+    int period_ms;
+    int pulse_ms;
+} probe_case_t;
+
+static int cmp_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/* First measurement at or after `from` (measurements at phase + k * MEAS_MS) */
+static int next_measurement(int from, int phase)
+{
+    int k = (from - phase + MEAS_MS - 1) / MEAS_MS;
+    return phase + (k < 0 ? 0 : k) * MEAS_MS;
+}
+
+/* Groups in one sweep of all the pads */
+static int sweep_groups(loc_scheduler_t *s, const int8_t *cand, uint8_t count)
+{
+    int8_t group[LOCALIZATION_MAX_PADS];
+    int seen = 0, groups = 0;
+
+    while (seen < count) {
+        seen += loc_next_group(s, cand, count, group);
+        groups++;
+    }
+    return groups;
+}
+
+static double scenario(const probe_case_t *c, double *duty, int *p99_ms)
+{
+    static int times[TRIALS];
+    const loc_config_t config = { 1, NULL, 0, c->group_max, 0 };
+    int8_t cand[LOCALIZATION_MAX_PADS], group[LOCALIZATION_MAX_PADS];
+    loc_scheduler_t sched;
+    double sum = 0;
+
+    for (int8_t p = 0; p < c->pads; p++)
+        cand[p] = (int8_t)(p + 1);
+
+    loc_scheduler_init(&sched, &config);
+    const int groups = sweep_groups(&sched, cand, (uint8_t)c->pads);
+    *duty = (double)c->pulse_ms / ((double)c->period_ms * groups);
+
+    for (int t = 0; t < TRIALS; t++) {
+        // the sweep is somewhere in its cycle when the scooter parks
+        loc_scheduler_init(&sched, &config);
+        for (uint32_t k = host_rand() % groups; k; k--)
+            loc_next_group(&sched, cand, (uint8_t)c->pads, group);
+
+        const int8_t pad = (int8_t)(1 + host_rand() % c->pads);
+        const int parked = (int)(host_rand() % c->period_ms);
+        const int phase = (int)(host_rand() % MEAS_MS);
+        int found = -1;
+
+        for (int tick = 1; found < 0; tick++) {
+            uint8_t len = loc_next_group(&sched, cand, (uint8_t)c->pads, group);
+            bool probed = false;
+            for (int g = 0; g < len; g++)
+                probed |= group[g] == pad;
+            if (!probed)
+                continue;
+
+            const int start = tick * c->period_ms;
+            const int meas = next_measurement(start, phase);
+            if (meas < start + c->pulse_ms)
+                found = meas;
+            HOST_CHECK(tick <= 4 * groups);
+            if (tick > 4 * groups)
+                break;
+        }
+        times[t] = found - parked;
+        sum += times[t];
+    }
+
+    qsort(times, TRIALS, sizeof(times[0]), cmp_int);
+    *p99_ms = times[TRIALS * 99 / 100];
+    return sum / TRIALS / 1000.0;
+}
+
+int main(void)
+{
+    static const probe_case_t cases[] = {
+        { 20, 1, 1000, 100 },
+        { 20, 4, 1000, 100 },       // defaults
+        { 20, 8,  500, 100 },
+        { 40, 4, 1000, 100 },
+        { 40, 8,  500,  50 },
+    };
+
+    printf("dead RX detection, %d trials, STM32 measurement every %d ms\n", TRIALS, MEAS_MS);
+    printf("pads  group  period  pulse | duty/pad   mean s   p99 s\n");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        double duty;
+        int p99;
+        double mean = scenario(&cases[c], &duty, &p99);
+        printf("%4d  %5u  %6d  %5d | %7.2f%%  %7.1f  %6.1f\n",
+               cases[c].pads, cases[c].group_max, cases[c].period_ms, cases[c].pulse_ms,
+               duty * 100, mean, p99 / 1000.0);
+
+        // a pulse of at least one measurement interval never misses a coupled scooter
+        HOST_CHECK(cases[c].pulse_ms < MEAS_MS || p99 <= (int)(1.0 / duty * cases[c].pulse_ms) + cases[c].period_ms);
+    }
+
+    return host_test_result();
+}
@@ -0,0 +1,351 @@
+/*
+ * STM32 UART framing, robustness and throughput (user-011).
+ *
+ *   - a stray 0xA5 in front of a frame or a JSON object: both must still come
+ *     through (the bytes of the false frame are parsed again);
+ *   - fuzz: intact frames (payloads may contain 0xA5) interleaved with JSON
+ *     objects, stray 0xA5 bytes, and frames with a corrupted length, CRC or
+ *     payload byte, or cut short. Every intact frame must come out, in order,
+ *     and every other byte except 0xA5 must go to the JSON fallback;
+ *   - throughput on a recorded stream (100 Hz measurements, acks, a JSON
+ *     object per second, rare line noise), replayed in UART_RX_CHUNK_SIZE
+ *     reads the way rx_task does.
+ *
+ * A false frame passes its CRC once in 65536: the fuzz reports such
+ * collisions instead of failing on them.
+ */
+#include "stm_frame.h"
+#include "host_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SEEDS           200
+#define ITEMS           400         // frames, JSON objects and noise per fuzz run
+#define PADDING         (STM_FRAME_REPLAY_SIZE + 2)     // completes a false frame left open at the end
+#define CHUNK_SIZE      128         // UART_RX_CHUNK_SIZE
+#define RATE_HZ         100         // measurements per second
+#define RECORD_S        60
+#define BENCH_PASSES    50
+#define LINE_BYTES_S    11520       // 115200 baud, 8N1
+
+typedef struct {
+    uint8_t type, len;
+    uint8_t payload[STM_FRAME_MAX_PAYLOAD];
+} frame_t;
+
+typedef struct {
+    uint8_t *bytes;
+    size_t len, cap;
+} buffer_t;
+
+typedef struct {
+    frame_t *frames;
+    size_t count, cap;
+} frames_t;
+
+static void buffer_add(buffer_t *b, const void *data, size_t len)
+{
+    if (b->len + len > b->cap) {
+        b->cap = (b->len + len) * 2;
+        b->bytes = realloc(b->bytes, b->cap);
+    }
+    memcpy(&b->bytes[b->len], data, len);
+    b->len += len;
+}
+
+static void frames_add(frames_t *f, const frame_t *frame)
+{
+    if (f->count == f->cap) {
+        f->cap = f->cap ? f->cap * 2 : 64;
+        f->frames = realloc(f->frames, f->cap * sizeof(frame_t));
+    }
+    f->frames[f->count++] = *frame;
+}
+
+static bool same_frame(const frame_t *a, const frame_t *b)
+{
+    return a->type == b->type && a->len == b->len && memcmp(a->payload, b->payload, a->len) == 0;
+}
+
+/* The inverse of stm_frame_decode_measurement */
+static uint8_t encode_measurement(const stm_measurement_t *m, uint8_t *p)
+{
+    const int16_t fixed[4] = {
+        (int16_t)(m->temperature1 * 100), (int16_t)(m->temperature2 * 100),
+        (int16_t)(m->voltage * 100), (int16_t)(m->current * 1000),
+    };
+    for (int i = 0; i < 4; i++) {
+        p[2 * i] = (uint8_t)fixed[i];
+        p[2 * i + 1] = (uint8_t)((uint16_t)fixed[i] >> 8);
+    }
+    uint16_t duty = (uint16_t)(m->duty * 10000);
+    p[8] = m->alert;
+    p[9] = (uint8_t)duty;
+    p[10] = (uint8_t)(duty >> 8);
+    p[11] = m->tuning;
+    p[12] = m->low_vds_threshold;
+    p[13] = m->low_vds;
+    return STM_MEASUREMENT_PAYLOAD_LEN;
+}
+
+static size_t json_measurement(char *out, size_t size, int n)
+{
+    return (size_t)snprintf(out, size,
+        "{\"temperature1\":%d.%d,\"temperature2\":26.1,\"voltage\":12.0,\"current\":0.5,"
+        "\"alert\":0,\"duty\":0.3,\"tuning\":1,\"low_vds_threshold\":2,\"low_vds\":0}\r\n",
+        20 + n % 10, n % 10);
+}
+
+/* rx_task's loop, chunk by chunk: frames and JSON fallback bytes out */
+static void parse(stm_frame_parser_t *parser, const buffer_t *in, frames_t *frames, buffer_t *unclaimed)
+{
+    for (size_t off = 0; off < in->len; off += CHUNK_SIZE) {
+        size_t n = in->len - off < CHUNK_SIZE ? in->len - off : CHUNK_SIZE;
+        for (size_t i = 0; i < n; i++) {
+            stm_feed_result_t result = stm_frame_feed(parser, in->bytes[off + i]);
+            for (; result != STM_FEED_CONSUMED; result = stm_frame_poll(parser)) {
+                if (result == STM_FEED_FRAME) {
+                    frame_t f = { parser->type, parser->len, { 0 } };
+                    memcpy(f.payload, parser->payload, parser->len);
+                    frames_add(frames, &f);
+                } else if (result == STM_FEED_UNCLAIMED) {
+                    buffer_add(unclaimed, &parser->byte, 1);
+                }
+            }
+        }
+    }
+}
+
+/* Bytes that are not part of an intact frame: all but 0xA5 go to the JSON fallback */
+static void noise_add(buffer_t *stream, buffer_t *unclaimed, const uint8_t *bytes, size_t len)
+{
+    buffer_add(stream, bytes, len);
+    for (size_t i = 0; i < len; i++)
+        if (bytes[i] != STM_FRAME_SOF)
+            buffer_add(unclaimed, &bytes[i], 1);
+}
+
+static void check_stray_sof(void)
+{
+    stm_frame_parser_t parser;
+    buffer_t in = { 0 }, json = { 0 }, unclaimed = { 0 };
+    frames_t out = { 0 };
+    const uint8_t sof = STM_FRAME_SOF;
+    const stm_measurement_t m = { 25.5f, 26.25f, 12.0f, 0.5f, 0, 0.3f, 1, 2, 0 };
+    frame_t f = { STM_FRAME_MEASUREMENT, 0, { 0 } };
+    uint8_t frame[STM_FRAME_MAX_PAYLOAD + STM_FRAME_OVERHEAD];
+    char text[256];
+
+    f.len = encode_measurement(&m, f.payload);
+    size_t frame_len = stm_frame_encode(f.type, f.payload, f.len, frame, sizeof(frame));
+    size_t text_len = json_measurement(text, sizeof(text), 0);
+
+    // SOF + frame, SOF + JSON + frame, JSON, SOF + SOF + frame
+    buffer_add(&in, &sof, 1);
+    buffer_add(&in, frame, frame_len);
+    buffer_add(&in, &sof, 1);
+    buffer_add(&in, text, text_len);
+    buffer_add(&in, frame, frame_len);
+    buffer_add(&in, text, text_len);
+    buffer_add(&in, &sof, 1);
+    buffer_add(&in, &sof, 1);
+    buffer_add(&in, frame, frame_len);
+    buffer_add(&json, text, text_len);
+    buffer_add(&json, text, text_len);
+
+    stm_frame_parser_init(&parser);
+    parse(&parser, &in, &out, &unclaimed);
+    HOST_CHECK(out.count == 3);
+    for (size_t i = 0; i < out.count; i++)
+        HOST_CHECK(same_frame(&out.frames[i], &f));
+    HOST_CHECK(unclaimed.len == json.len && memcmp(unclaimed.bytes, json.bytes, json.len) == 0);
+    HOST_CHECK(parser.frames == 3 && parser.crc_errors + parser.length_errors == 4);
+
+    stm_measurement_t d;
+    HOST_CHECK(out.count && stm_frame_decode_measurement(out.frames[0].payload, out.frames[0].len, &d));
+    HOST_CHECK(d.temperature1 == m.temperature1 && d.temperature2 == m.temperature2 &&
+               d.voltage == m.voltage && d.current == m.current && d.tuning == m.tuning &&
+               d.low_vds_threshold == m.low_vds_threshold);
+
+    free(in.bytes);
+    free(json.bytes);
+    free(unclaimed.bytes);
+    free(out.frames);
+}
+
+typedef struct {
+    uint32_t frames, dropped, collisions, collision_runs;
+} fuzz_stats_t;
+
+static void fuzz_run(fuzz_stats_t *st)
+{
+    stm_frame_parser_t parser;
+    buffer_t in = { 0 }, expected_unclaimed = { 0 }, unclaimed = { 0 };
+    frames_t expected = { 0 }, out = { 0 };
+    uint8_t bytes[STM_FRAME_MAX_PAYLOAD + STM_FRAME_OVERHEAD];
+    char text[256];
+
+    for (int item = 0; item < ITEMS; item++) {
+        frame_t f = { 0 };
+        f.type = (uint8_t)(host_rand() % 3 ? STM_FRAME_MEASUREMENT : host_rand());
+        f.len = (uint8_t)(host_rand() % (STM_FRAME_MAX_PAYLOAD + 1));
+        for (int i = 0; i < f.len; i++)
+            f.payload[i] = host_rand() % 8 ? (uint8_t)host_rand() : STM_FRAME_SOF;
+        if (f.len >= 2) {
+            // tells the frames apart
+            f.payload[0] = (uint8_t)item;
+            f.payload[1] = (uint8_t)(item >> 8);
+        }
+        size_t len = stm_frame_encode(f.type, f.payload, f.len, bytes, sizeof(bytes));
+
+        switch (host_rand() % 10) {
+            case 0: case 1: case 2: case 3:
+                buffer_add(&in, bytes, len);
+                frames_add(&expected, &f);
+                break;
+            case 4: case 5:
+                noise_add(&in, &expected_unclaimed, (const uint8_t *)text,
+                          json_measurement(text, sizeof(text), item));
+                break;
+            case 6:
+                noise_add(&in, &expected_unclaimed, &bytes[0], 1);      // stray SOF
+                break;
+            case 7:
+                bytes[2] = (uint8_t)(bytes[2] + 1 + host_rand() % 255); // length
+                noise_add(&in, &expected_unclaimed, bytes, len);
+                break;
+            case 8:
+                bytes[1 + host_rand() % (len - 1)] ^= (uint8_t)(1 + host_rand() % 255);   // CRC or payload
+                noise_add(&in, &expected_unclaimed, bytes, len);
+                break;
+            default:
+                noise_add(&in, &expected_unclaimed, bytes, 1 + host_rand() % (len - 1));   // cut short
+                break;
+        }
+    }
+    uint8_t padding[PADDING];
+    memset(padding, ' ', PADDING);
+    noise_add(&in, &expected_unclaimed, padding, PADDING);
+
+    stm_frame_parser_init(&parser);
+    parse(&parser, &in, &out, &unclaimed);
+
+    // intact frames in order; anything else is a false frame whose CRC happened to match
+    size_t next = 0;
+    uint32_t collisions = 0;
+    for (size_t i = 0; i < out.count; i++) {
+        if (next < expected.count && same_frame(&out.frames[i], &expected.frames[next]))
+            next++;
+        else
+            collisions++;
+    }
+    if (collisions == 0) {
+        HOST_CHECK(next == expected.count);
+        HOST_CHECK(unclaimed.len == expected_unclaimed.len &&
+                   memcmp(unclaimed.bytes, expected_unclaimed.bytes, unclaimed.len) == 0);
+    } else {
+        st->collision_runs++;
+    }
+    HOST_CHECK(parser.replay_len == 0 && parser.state == 0);
+    st->frames += (uint32_t)next;
+    st->dropped += parser.crc_errors + parser.length_errors;
+    st->collisions += collisions;
+
+    free(in.bytes);
+    free(expected_unclaimed.bytes);
+    free(unclaimed.bytes);
+    free(expected.frames);
+    free(out.frames);
+}
+
+/* 100 Hz measurements, an ack every 50 frames, a JSON object per second, a stray SOF in 1000 frames */
+static void record(buffer_t *rec, uint32_t *frames, uint32_t *json_bytes)
+{
+    uint8_t payload[STM_FRAME_MAX_PAYLOAD], bytes[STM_FRAME_MAX_PAYLOAD + STM_FRAME_OVERHEAD];
+    char text[256];
+
+    for (int n = 0; n < RECORD_S * RATE_HZ; n++) {
+        stm_measurement_t m = {
+            25.0f + (float)host_rand_unit(), 26.0f + (float)host_rand_unit(),
+            48.0f + (float)host_rand_unit(), 1.5f + (float)host_rand_unit() * 0.1f,
+            0, 0.3f, 1, 2, 0,
+        };
+        uint8_t len = encode_measurement(&m, payload);
+        buffer_add(rec, bytes, stm_frame_encode(STM_FRAME_MEASUREMENT, payload, len, bytes, sizeof(bytes)));
+        (*frames)++;
+        if (n % 50 == 0) {
+            payload[0] = (uint8_t)n;
+            payload[1] = (uint8_t)(n >> 8);
+            buffer_add(rec, bytes, stm_frame_encode(STM_FRAME_ACK, payload, 2, bytes, sizeof(bytes)));
+            (*frames)++;
+        }
+        if (n % RATE_HZ == 0) {
+            size_t text_len = json_measurement(text, sizeof(text), n);
+            buffer_add(rec, text, text_len);
+            *json_bytes += (uint32_t)text_len;
+        }
+        if (host_rand() % 1000 == 0) {
+            const uint8_t sof = STM_FRAME_SOF;
+            buffer_add(rec, &sof, 1);
+        }
+    }
+}
+
+static void bench(void)
+{
+    stm_frame_parser_t parser;
+    buffer_t rec = { 0 };
+    uint32_t recorded = 0, json_bytes = 0, frames = 0, unclaimed = 0;
+
+    host_seed(4242);
+    record(&rec, &recorded, &json_bytes);
+
+    stm_frame_parser_init(&parser);
+    uint64_t t0 = host_now_ns();
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        for (size_t off = 0; off < rec.len; off += CHUNK_SIZE) {
+            size_t n = rec.len - off < CHUNK_SIZE ? rec.len - off : CHUNK_SIZE;
+            for (size_t i = 0; i < n; i++) {
+                stm_feed_result_t result = stm_frame_feed(&parser, rec.bytes[off + i]);
+                for (; result != STM_FEED_CONSUMED; result = stm_frame_poll(&parser)) {
+                    frames += result == STM_FEED_FRAME;
+                    unclaimed += result == STM_FEED_UNCLAIMED;
+                }
+            }
+        }
+    }
+    double s = (double)(host_now_ns() - t0) / 1e9;
+
+    HOST_CHECK(frames == recorded * BENCH_PASSES);
+    HOST_CHECK(unclaimed == json_bytes * BENCH_PASSES);
+    double bytes_s = (double)rec.len * BENCH_PASSES / s;
+    printf("recorded stream: %d s at %d Hz, %zu bytes, %u frames, %u JSON bytes\n",
+           RECORD_S, RATE_HZ, rec.len, recorded, json_bytes);
+    printf("parse %.1f MB/s (%.1f ns/byte), %.2f M frames/s, %.0fx the 115200 baud line\n",
+           bytes_s / 1e6, 1e9 / bytes_s, frames / s / 1e6, bytes_s / LINE_BYTES_S);
+    HOST_CHECK(bytes_s > 100.0 * LINE_BYTES_S);
+
+    free(rec.bytes);
+}
+
+int main(void)
+{
+    fuzz_stats_t st = { 0 };
+
+    check_stray_sof();
+
+    for (int seed = 1; seed <= SEEDS; seed++) {
+        host_seed((uint64_t)seed * 7919);
+        fuzz_run(&st);
+    }
+    printf("fuzz: %d seeds x %d items, %u intact frames recovered, %u false or corrupted frames dropped, "
+           "%u CRC collisions (%u runs)\n",
+           SEEDS, ITEMS, st.frames, st.dropped, st.collisions, st.collision_runs);
+    HOST_CHECK(st.dropped > 0);
+    HOST_CHECK(st.collision_runs * 20 <= SEEDS);
+
+    bench();
+
+    return host_test_result();
+}
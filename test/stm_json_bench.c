@@ -0,0 +1,421 @@
+/*
+ * STM32 JSON readings, stm_json tokenizer vs cJSON (user-012).
+ *
+ * Replays a recorded STM32 stream (100 Hz measurement objects, acks, objects
+ * with keys the ESP32 does not know, lines cut short by an STM32 reset)
+ * through the UART driver's ring and rx_task's path: chunks of up to
+ * UART_RX_CHUNK_SIZE bytes, the binary frame parser, then the tokenizer.
+ * Every complete object must come out with the values that were printed,
+ * and every cut one must be counted as malformed. A line cut right after a
+ * ':' reads the next object as a nested value, so that object may be lost.
+ * Reports bytes/s, objects/s and heap allocations per object.
+ *
+ * When libcjson is installed (HAVE_CJSON) a stream without nested values
+ * also goes through the path the firmware had before stm_json (text between
+ * '{' and '}' collected into a UART_BUFFER_SIZE buffer, cJSON_Parse,
+ * cJSON_GetObjectItem per key, cJSON_Delete), which must extract the same
+ * values. That collector stops at the first '}', so it never handled nested
+ * values.
+ */
+#include "stm_json.h"
+#include "host_test.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_CJSON
+#include <cjson/cJSON.h>
+#endif
+
+#define RECORD_S        60
+#define RATE_HZ         100         // objects per second
+#define PASSES          20
+#define RING_SIZE       2048        // UART_BUFFER_SIZE * 2, the driver's RX ring
+#define BUFFER_SIZE     1024        // UART_BUFFER_SIZE, the old JSON collector
+#define CHUNK_SIZE      128         // UART_RX_CHUNK_SIZE
+#define BURST_MAX       120         // bytes the UART ISR moves into the ring at once
+#define ACK_ODDS        30
+#define EXTRA_ODDS      20          // an object with keys the ESP32 ignores
+#define CUT_ODDS        200         // a line cut short
+
+typedef struct {
+    stm_measurement_t m;
+    uint16_t ack;
+    uint16_t present;
+} object_t;
+
+typedef struct {
+    char *text;
+    size_t len, cap;
+    object_t *objects;
+    size_t count, cap_objects;
+    uint32_t cut;
+} recording_t;
+
+typedef struct {
+    uint8_t bytes[RING_SIZE];
+    size_t head, tail, used;
+} ring_t;
+
+/* Decoded objects of one pass, compared to the recording */
+typedef struct {
+    const recording_t *rec;
+    size_t next;
+    uint32_t lost;
+    uint32_t mismatches;
+} checker_t;
+
+// volatile: the compiler assumes malloc leaves the program's globals alone
+static volatile unsigned long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    allocations++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+    allocations++;
+    return __real_realloc(p, size);
+}
+
+static void text_add(recording_t *r, const char *text, size_t len)
+{
+    if (r->len + len > r->cap) {
+        r->cap = (r->len + len) * 2;
+        r->text = realloc(r->text, r->cap);
+    }
+    memcpy(&r->text[r->len], text, len);
+    r->len += len;
+}
+
+static void object_add(recording_t *r, const object_t *o)
+{
+    if (r->count == r->cap_objects) {
+        r->cap_objects = r->cap_objects ? r->cap_objects * 2 : 256;
+        r->objects = realloc(r->objects, r->cap_objects * sizeof(object_t));
+    }
+    r->objects[r->count++] = *o;
+}
+
+/* What the STM32 prints: two decimals, three for the current, four for the duty */
+static void record(recording_t *r, bool nested)
+{
+    char line[256];
+
+    for (int n = 0; n < RECORD_S * RATE_HZ; n++) {
+        object_t o = { .present = STM_JSON_ALL };
+        char t1[16], t2[16], v[16], c[16], d[16];
+        int len;
+
+        if (host_rand() % ACK_ODDS == 0) {
+            o.ack = (uint16_t)host_rand();
+            o.present = STM_JSON_ACK;
+            len = snprintf(line, sizeof(line), "{\"ack\":%u}\r\n", o.ack);
+            text_add(r, line, (size_t)len);
+            object_add(r, &o);
+            continue;
+        }
+
+        snprintf(t1, sizeof(t1), "%.2f", 20 + host_rand_unit() * 40);
+        snprintf(t2, sizeof(t2), "%.2f", 20 + host_rand_unit() * 40);
+        snprintf(v, sizeof(v), "%.2f", 46 + host_rand_unit() * 4);
+        snprintf(c, sizeof(c), "%.3f", host_rand_unit() * 3 - 0.5);
+        snprintf(d, sizeof(d), "%.4f", host_rand_unit());
+        o.m.temperature1 = strtof(t1, NULL);
+        o.m.temperature2 = strtof(t2, NULL);
+        o.m.voltage = strtof(v, NULL);
+        o.m.current = strtof(c, NULL);
+        o.m.duty = strtof(d, NULL);
+        o.m.alert = (uint8_t)(host_rand() % 50 == 0 ? 1 + host_rand() % 4 : 0);
+        o.m.tuning = (uint8_t)(host_rand() % 2);
+        o.m.low_vds_threshold = (uint8_t)(host_rand() % 8);
+        o.m.low_vds = (uint8_t)(host_rand() % 2);
+
+        bool extra = nested && host_rand() % EXTRA_ODDS == 0;
+        len = snprintf(line, sizeof(line),
+            "{\"temperature1\":%s,\"temperature2\":%s,\"voltage\":%s,\"current\":%s,\"alert\":%u,"
+            "%s\"duty\":%s,\"tuning\":%u,\"low_vds_threshold\":%u,\"low_vds\":%u}\r\n",
+            t1, t2, v, c, o.m.alert, extra ? "\"fw\":\"2.1.0-rc{1}\",\"dbg\":{\"adc\":[512,498],\"ok\":true}," : "",
+            d, o.m.tuning, o.m.low_vds_threshold, o.m.low_vds);
+
+        if (host_rand() % CUT_ODDS == 0 && !extra) {
+            // reset mid-line: no closing brace, the next object follows
+            text_add(r, line, 1 + host_rand() % (size_t)(len - 4));
+            r->cut++;
+            continue;
+        }
+        text_add(r, line, (size_t)len);
+        object_add(r, &o);
+    }
+}
+
+static bool close_to(float a, float b)
+{
+    return fabsf(a - b) <= 1e-6f * fmaxf(1.0f, fabsf(b));
+}
+
+static bool same_object(const object_t *o, const stm_measurement_t *m, uint16_t ack, uint16_t present)
+{
+    if (present != o->present || ((present & STM_JSON_ACK) && ack != o->ack))
+        return false;
+    return !(present & STM_JSON_ALL) ||
+           (close_to(m->temperature1, o->m.temperature1) && close_to(m->temperature2, o->m.temperature2) &&
+            close_to(m->voltage, o->m.voltage) && close_to(m->current, o->m.current) &&
+            close_to(m->duty, o->m.duty) && m->alert == o->m.alert && m->tuning == o->m.tuning &&
+            m->low_vds_threshold == o->m.low_vds_threshold && m->low_vds == o->m.low_vds);
+}
+
+/* A line cut after a ':' reads the next object as its nested value: that one is lost */
+static void check_object(checker_t *c, const stm_measurement_t *m, uint16_t ack, uint16_t present)
+{
+    const recording_t *rec = c->rec;
+
+    if (c->next < rec->count && same_object(&rec->objects[c->next], m, ack, present)) {
+        c->next++;
+    } else if (c->next + 1 < rec->count && same_object(&rec->objects[c->next + 1], m, ack, present)) {
+        c->next += 2;
+        c->lost++;
+    } else {
+        c->next++;
+        c->mismatches++;
+    }
+}
+
+/* The UART ISR moves bursts into the ring, rx_task reads what it holds */
+static size_t ring_write(ring_t *ring, const uint8_t *data, size_t len)
+{
+    size_t n = len < RING_SIZE - ring->used ? len : RING_SIZE - ring->used;
+    for (size_t i = 0; i < n; i++) {
+        ring->bytes[ring->head] = data[i];
+        ring->head = (ring->head + 1) % RING_SIZE;
+    }
+    ring->used += n;
+    return n;
+}
+
+static size_t ring_read(ring_t *ring, uint8_t *out, size_t max)
+{
+    size_t n = ring->used < max ? ring->used : max;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = ring->bytes[ring->tail];
+        ring->tail = (ring->tail + 1) % RING_SIZE;
+    }
+    ring->used -= n;
+    return n;
+}
+
+typedef void (*json_byte_fn)(void *ctx, uint8_t c);
+
+/* rx_task: ring -> chunk -> binary frame parser -> JSON fallback */
+static void replay(const recording_t *rec, json_byte_fn json_byte, void *ctx)
+{
+    static ring_t ring;
+    static stm_frame_parser_t frames;
+    uint8_t chunk[CHUNK_SIZE];
+    size_t off = 0;
+
+    memset(&ring, 0, sizeof(ring));
+    stm_frame_parser_init(&frames);
+    while (off < rec->len || ring.used) {
+        if (off < rec->len) {
+            size_t burst = 1 + host_rand() % BURST_MAX;
+            if (burst > rec->len - off)
+                burst = rec->len - off;
+            off += ring_write(&ring, (const uint8_t *)&rec->text[off], burst);
+        }
+        size_t n = ring_read(&ring, chunk, 1 + host_rand() % CHUNK_SIZE);
+        for (size_t i = 0; i < n; i++) {
+            stm_feed_result_t result = stm_frame_feed(&frames, chunk[i]);
+            for (; result != STM_FEED_CONSUMED; result = stm_frame_poll(&frames)) {
+                if (result == STM_FEED_UNCLAIMED)
+                    json_byte(ctx, frames.byte);
+            }
+        }
+    }
+}
+
+typedef struct {
+    stm_json_parser_t parser;
+    checker_t check;
+} tokenizer_ctx_t;
+
+static void tokenizer_byte(void *ctx, uint8_t c)
+{
+    tokenizer_ctx_t *t = ctx;
+    if (stm_json_feed(&t->parser, c) == STM_JSON_OBJECT)
+        check_object(&t->check, &t->parser.m, t->parser.ack, t->parser.present);
+}
+
+#ifdef HAVE_CJSON
+typedef struct {
+    char buffer[BUFFER_SIZE];
+    uint16_t index;
+    bool json;
+    uint32_t objects, errors;
+    checker_t check;
+} cjson_ctx_t;
+
+static float get_number(const cJSON *root, const char *key, uint16_t bit, uint16_t *present)
+{
+    const cJSON *item = cJSON_GetObjectItem(root, key);
+    if (item == NULL || !cJSON_IsNumber(item))
+        return 0.0f;
+    *present |= bit;
+    return (float)item->valuedouble;
+}
+
+/* The removed parse_received_UART, with the ack key */
+static void cjson_parse(cjson_ctx_t *x)
+{
+    cJSON *root = cJSON_Parse(x->buffer);
+    stm_measurement_t m;
+    uint16_t present = 0;
+
+    if (root == NULL) {
+        x->errors++;
+        return;
+    }
+    m.temperature1 = get_number(root, "temperature1", STM_JSON_TEMPERATURE1, &present);
+    m.temperature2 = get_number(root, "temperature2", STM_JSON_TEMPERATURE2, &present);
+    m.voltage = get_number(root, "voltage", STM_JSON_VOLTAGE, &present);
+    m.current = get_number(root, "current", STM_JSON_CURRENT, &present);
+    m.alert = (uint8_t)get_number(root, "alert", STM_JSON_ALERT, &present);
+    m.duty = get_number(root, "duty", STM_JSON_DUTY, &present);
+    m.tuning = (uint8_t)get_number(root, "tuning", STM_JSON_TUNING, &present);
+    m.low_vds_threshold = (uint8_t)get_number(root, "low_vds_threshold", STM_JSON_LOW_VDS_THRESHOLD, &present);
+    m.low_vds = (uint8_t)get_number(root, "low_vds", STM_JSON_LOW_VDS, &present);
+    uint16_t ack = (uint16_t)get_number(root, "ack", STM_JSON_ACK, &present);
+    cJSON_Delete(root);
+
+    x->objects++;
+    check_object(&x->check, &m, ack, present);
+}
+
+/* The removed rx_json_byte: text between '{' and '}' */
+static void cjson_byte(void *ctx, uint8_t c)
+{
+    cjson_ctx_t *x = ctx;
+
+    if (c == '{') {
+        x->json = true;
+        x->index = 0;
+        x->buffer[x->index++] = (char)c;
+    } else if (c == '}') {
+        if (x->json && x->index < BUFFER_SIZE - 1) {
+            x->buffer[x->index++] = (char)c;
+            x->buffer[x->index] = '\0';
+            cjson_parse(x);
+        }
+        x->index = 0;
+        x->json = false;
+    } else if (x->json) {
+        if (x->index < BUFFER_SIZE - 1) {
+            x->buffer[x->index++] = (char)c;
+        } else {
+            x->index = 0;
+            x->json = false;
+        }
+    }
+}
+
+static void *counted_malloc(size_t size)
+{
+    return malloc(size);            // wrapped, so counted
+}
+
+static void counted_free(void *p)
+{
+    free(p);
+}
+#endif
+
+static void report(const char *path, double s, const recording_t *rec, unsigned long allocs, uint32_t lost)
+{
+    double objects = (double)rec->count * PASSES;
+    printf("%-14s  %8.1f  %10.0f  %10.0f  %14.2f  %9u\n", path, rec->len * PASSES / s / 1e6, objects / s,
+           s * 1e9 / objects, (double)allocs / objects, lost);
+}
+
+/* Every pass must give back the recorded objects, with no allocation */
+static void bench_tokenizer(const char *name, const recording_t *rec)
+{
+    static tokenizer_ctx_t t;
+
+    stm_json_parser_init(&t.parser);
+    allocations = 0;
+    uint64_t t0 = host_now_ns();
+    for (int pass = 0; pass < PASSES; pass++) {
+        t.check = (checker_t){ rec, 0, 0, 0 };
+        replay(rec, tokenizer_byte, &t);
+        HOST_CHECK(t.check.next == rec->count && t.check.mismatches == 0);
+        HOST_CHECK(t.check.lost <= rec->cut);
+    }
+    report(name, (double)(host_now_ns() - t0) / 1e9, rec, allocations, t.check.lost);
+    HOST_CHECK(allocations == 0);
+    HOST_CHECK(t.parser.objects == (rec->count - t.check.lost) * PASSES);
+    HOST_CHECK(t.parser.errors == rec->cut * PASSES);
+}
+
+int main(void)
+{
+    static recording_t rec;
+
+    host_seed(1234);
+    record(&rec, true);
+    printf("recorded stream: %d s at %d Hz, %zu bytes, %zu objects, %u lines cut short\n",
+           RECORD_S, RATE_HZ, rec.len, rec.count, rec.cut);
+    printf("%-14s  %8s  %10s  %10s  %14s  %9s\n", "path", "MB/s", "objects/s", "ns/object", "allocs/object",
+           "lost/pass");
+
+    // the wrap is in place: an allocation of this file is counted
+    allocations = 0;
+    void *volatile probe = malloc(16);
+    free(probe);
+    HOST_CHECK(allocations == 1);
+
+    bench_tokenizer("stm_json", &rec);
+
+#ifdef HAVE_CJSON
+    static recording_t flat;
+    static cjson_ctx_t x;
+
+    host_seed(1234);
+    record(&flat, false);
+    bench_tokenizer("stm_json flat", &flat);
+
+    cJSON_Hooks hooks = { counted_malloc, counted_free };
+    cJSON_InitHooks(&hooks);
+    allocations = 0;
+    uint64_t t0 = host_now_ns();
+    for (int pass = 0; pass < PASSES; pass++) {
+        x.check = (checker_t){ &flat, 0, 0, 0 };
+        replay(&flat, cjson_byte, &x);
+        HOST_CHECK(x.check.next == flat.count && x.check.mismatches == 0);
+    }
+    report("cJSON flat", (double)(host_now_ns() - t0) / 1e9, &flat, allocations, x.check.lost);
+    // every '{' restarts its collector, so a cut line never takes the next object
+    HOST_CHECK(x.check.lost == 0);
+    HOST_CHECK(x.objects == flat.count * PASSES && x.errors == 0);
+    HOST_CHECK(allocations > 0);
+    free(flat.text);
+    free(flat.objects);
+#else
+    printf("cJSON           not found, install libcjson-dev to compare\n");
+#endif
+
+    free(rec.text);
+    free(rec.objects);
+    return host_test_result();
+}
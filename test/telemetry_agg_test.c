@@ -0,0 +1,197 @@
+/*
+ * Per-peer summary windows (user-025).
+ *
+ * telemetry_agg.c with the peer.h settings: 30 s windows, silences longer
+ * than 30 s not integrated. Samples arrive on a change or at the heartbeat,
+ * at random intervals with random power, occasional NaN values and radio
+ * silences; the uplink goes down for a while, so closed windows are not
+ * released and merge.
+ *
+ * A double-precision reference integrates the same samples. Checks that
+ * every interval is counted once, in the window of its end, so the energy
+ * of all published windows adds up to the reference; that merging keeps the
+ * energy, the sample count and min / max / mean / last; and that a constant
+ * power gives the exact Wh of each window.
+ */
+#include "telemetry_agg.h"
+#include "host_test.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+#define WINDOW_MS       30000       // PEER_SUMMARY_WINDOW_MS
+#define MAX_GAP_MS      30000       // PEER_SUMMARY_MAX_GAP_MS
+#define SEEDS           50
+#define SAMPLES         5000
+#define NAN_ODDS        50          // one value in NAN_ODDS is missing
+#define OUTAGE_ODDS     200         // one close in OUTAGE_ODDS starts an outage
+
+typedef struct {
+    double wh;
+    uint32_t samples, count;
+    float min, max, last;
+    double sum;
+} reference_t;
+
+static bool close_to(double a, double b, double rel)
+{
+    return fabs(a - b) <= rel * fmax(fabs(a), fabs(b)) + 1e-6;
+}
+
+static void constant_power(void)
+{
+    telemetry_agg_t a;
+    int windows = 0;
+    uint32_t covered = 0;           // end of the last interval integrated
+
+    // 48 V x 2.5 A = 120 W, one sample per second
+    telemetry_agg_init(&a, WINDOW_MS, MAX_GAP_MS);
+    for (uint32_t t = 0; t <= 300000; t += 1000) {
+        telemetry_agg_sample_t s = { { 48.0f, 2.5f, 35.0f, 36.0f }, { 46.0f, 2.5f, 38.0f, 39.0f } };
+        telemetry_agg_add(&a, &s, t);
+        if (telemetry_agg_close(&a, t)) {
+            // from the end of the previous window, the first sample has no predecessor
+            double hours = (a.closed.end_ms - covered) / 3600000.0;
+            HOST_CHECK(close_to(a.closed.tx_wh, 120.0 * hours, 1e-5));
+            HOST_CHECK(close_to(a.closed.rx_wh, 115.0 * hours, 1e-5));
+            HOST_CHECK(a.closed.end_ms - a.closed.start_ms == WINDOW_MS);
+            covered = a.closed.end_ms;
+            telemetry_agg_release(&a);
+            windows++;
+        }
+    }
+    HOST_CHECK(windows == 300000 / (WINDOW_MS + 1000));
+
+    // a silence longer than the gap is a hole, a shorter one is integrated
+    telemetry_agg_init(&a, 1000000, MAX_GAP_MS);
+    telemetry_agg_sample_t s = { { 10.0f, 1.0f, 0, 0 }, { 0 } };
+    telemetry_agg_add(&a, &s, 0);
+    telemetry_agg_add(&a, &s, MAX_GAP_MS);
+    telemetry_agg_add(&a, &s, 2 * MAX_GAP_MS + 1);
+    HOST_CHECK(close_to(a.current.tx_wh, 10.0 * MAX_GAP_MS / 3600000, 1e-6));
+}
+
+static float random_value(float lo, float hi)
+{
+    if (host_rand() % NAN_ODDS == 0)
+        return NAN;
+    return lo + (hi - lo) * (float)host_rand_unit();
+}
+
+static void reference_add(reference_t *r, float v)
+{
+    if (isnan(v))
+        return;
+    if (r->count == 0 || v < r->min)
+        r->min = v;
+    if (r->count == 0 || v > r->max)
+        r->max = v;
+    r->sum += v;
+    r->last = v;
+    r->count++;
+}
+
+static bool check_window(const telemetry_agg_window_t *w, const reference_t *r)
+{
+    const telemetry_agg_stat_t *st = &w->tx[TELEMETRY_AGG_TEMP1];
+
+    return w->samples == r->samples && st->count == r->count && (r->count == 0 ||
+           (st->min == r->min && st->max == r->max && st->last == r->last &&
+            close_to(telemetry_agg_mean(st), r->sum / r->count, 1e-4))) &&
+           close_to(w->tx_wh, r->wh, 1e-3);
+}
+
+/* Returns the windows merged while the uplink was down */
+static uint32_t random_run(double *total_error)
+{
+    telemetry_agg_t a;
+    reference_t window = { 0 }, closed = { 0 };
+    bool closed_ready = false, online = true, has_last = false;
+    double published_wh = 0, reference_wh = 0;
+    uint32_t t = 0, last_t = 0, window_start = 0;
+    float last_w = 0;
+
+    telemetry_agg_init(&a, WINDOW_MS, MAX_GAP_MS);
+    for (int i = 0; i < SAMPLES; i++) {
+        // heartbeat of 15 s at most (PEER_DYNAMIC_TIMER), sometimes a silence of up to 90 s
+        t += host_rand() % 100 == 0 ? host_rand() % 90000 : 1 + host_rand() % 15000;
+
+        telemetry_agg_sample_t s;
+        for (int f = 0; f < TELEMETRY_AGG_FIELDS; f++) {
+            s.tx[f] = random_value(0, 60);
+            s.rx[f] = random_value(0, 60);
+        }
+        telemetry_agg_add(&a, &s, t);
+
+        // reference, in double precision
+        float w = s.tx[TELEMETRY_AGG_VOLTAGE] * s.tx[TELEMETRY_AGG_CURRENT];
+        if (window.samples == 0)
+            window_start = t;
+        if (has_last && t - last_t <= MAX_GAP_MS && !isnan(w) && !isnan(last_w)) {
+            double wh = ((double)last_w + w) * 0.5 * (t - last_t) / 3600000.0;
+            window.wh += wh;
+            reference_wh += wh;
+        }
+        has_last = true;
+        last_t = t;
+        last_w = w;
+        window.samples++;
+        reference_add(&window, s.tx[TELEMETRY_AGG_TEMP1]);
+
+        // close; an unreleased closed window absorbs the new one
+        bool ready = telemetry_agg_close(&a, t);
+        if (t - window_start >= WINDOW_MS) {
+            if (!closed_ready) {
+                closed = window;
+            } else {
+                closed.wh += window.wh;
+                closed.samples += window.samples;
+                closed.sum += window.sum;
+                if (window.count) {
+                    closed.min = closed.count && closed.min < window.min ? closed.min : window.min;
+                    closed.max = closed.count && closed.max > window.max ? closed.max : window.max;
+                    closed.last = window.last;
+                }
+                closed.count += window.count;
+            }
+            closed_ready = true;
+            memset(&window, 0, sizeof(window));
+        }
+        HOST_CHECK(ready == closed_ready);
+
+        if (host_rand() % OUTAGE_ODDS == 0)
+            online = !online;
+        if (ready && online) {
+            HOST_CHECK(check_window(&a.closed, &closed));
+            published_wh += a.closed.tx_wh;
+            telemetry_agg_release(&a);
+            closed_ready = false;
+        }
+    }
+
+    // what is still open or unreleased is published later
+    published_wh += a.current.tx_wh + (a.closed_ready ? a.closed.tx_wh : 0);
+    HOST_CHECK(close_to(published_wh, reference_wh, 1e-4));
+    *total_error += fabs(published_wh - reference_wh) / reference_wh;
+    return a.merged;
+}
+
+int main(void)
+{
+    uint32_t merged = 0;
+    double error = 0;
+
+    constant_power();
+
+    for (int seed = 1; seed <= SEEDS; seed++) {
+        host_seed((uint64_t)seed * 3571);
+        merged += random_run(&error);
+    }
+    HOST_CHECK(merged > 0);
+    printf("%d seeds x %d samples, %d s windows: %" PRIu32 " windows merged during outages, "
+           "energy error %.2e (float vs double)\n",
+           SEEDS, SAMPLES, WINDOW_MS / 1000, merged, error / SEEDS);
+
+    return host_test_result();
+}
@@ -0,0 +1,243 @@
+/*
+ * Store-and-forward telemetry log (user-024).
+ *
+ * telemetry_log.c on a RAM flash that behaves like NOR: a write can only
+ * clear bits, an erase sets a whole sector back to 0xFF. A power loss tears
+ * the record being written (only its first bytes reach the flash) and is
+ * followed by a remount.
+ *
+ * Random appends, replays and remounts are checked against a queue of the
+ * sequences that should still be pending: a replay returns exactly them,
+ * oldest first, a remount resumes with the first one not replayed, and a
+ * torn record is skipped. The uplink goes down for long enough to fill the
+ * log, so the oldest records get dropped. At the end every sector must have
+ * been erased the same number of times (within one lap), apart from a sector
+ * erased again because the power failed while its first record was written.
+ *
+ * Also checks how telemetry_log_age dates the records of the current boot,
+ * of an earlier boot, and with or without the wall clock.
+ */
+#include "telemetry_log.h"
+#include "host_test.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#define SECTORS         8
+#define FLASH_SIZE      (SECTORS * TELEMETRY_LOG_SECTOR_SIZE)
+#define SEEDS           20
+#define OPS             20000
+#define TEAR_ODDS       500         // one append in TEAR_ODDS loses power
+#define OUTAGE_OPS      2000        // the uplink is down every other OUTAGE_OPS operations
+#define TORN            UINT32_MAX  // reference entry of a torn record
+#define EPOCH_MS        1760000000000ull
+#define PEEK_MAX        12          // MQTT_REPLAY_RECORDS_PER_TICK
+
+static uint8_t flash[FLASH_SIZE];
+static uint32_t erases[SECTORS];
+static bool tear;                   // the next write is cut short
+static bool straddled;              // a write crossed a sector boundary
+
+static bool flash_read(void *ctx, uint32_t offset, void *data, uint32_t len)
+{
+    (void)ctx;
+    memcpy(data, &flash[offset], len);
+    return true;
+}
+
+static bool flash_write(void *ctx, uint32_t offset, const void *data, uint32_t len)
+{
+    const uint8_t *src = data;
+    uint32_t n = len;
+
+    (void)ctx;
+    if (offset / TELEMETRY_LOG_SECTOR_SIZE != (offset + len - 1) / TELEMETRY_LOG_SECTOR_SIZE)
+        straddled = true;
+    if (tear) {
+        n = host_rand() % len;
+        tear = false;
+    }
+    for (uint32_t i = 0; i < n; i++)
+        flash[offset + i] &= src[i];
+    return n == len;
+}
+
+static bool flash_erase(void *ctx, uint32_t offset, uint32_t len)
+{
+    (void)ctx;
+    memset(&flash[offset], 0xFF, len);
+    for (uint32_t s = offset / TELEMETRY_LOG_SECTOR_SIZE; s < (offset + len) / TELEMETRY_LOG_SECTOR_SIZE; s++)
+        erases[s]++;
+    return true;
+}
+
+static const telemetry_log_io_t flash_io = { flash_read, flash_write, flash_erase };
+
+/* Sequences not replayed yet, oldest first */
+static uint32_t ref[OPS + 1];
+static uint32_t ref_head, ref_tail;
+
+/* Forget what the log dropped (full log, or torn records skipped by a remount) */
+static void ref_trim(const telemetry_log_t *log)
+{
+    while (ref_head - ref_tail > telemetry_log_backlog(log))
+        ref_tail++;
+}
+
+static bool check_peek(telemetry_log_t *log, bool consume)
+{
+    telemetry_record_t records[PEEK_MAX];
+    uint32_t slots, k = 0;
+    uint32_t n = telemetry_log_peek(log, records, PEEK_MAX, &slots);
+
+    for (uint32_t i = 0; i < slots; i++) {
+        uint32_t seq = ref[ref_tail + i];
+        if (seq == TORN)
+            continue;
+        if (k >= n || records[k].seq != seq || records[k].uptime_ms != seq * 1000u ||
+            records[k].epoch_ms != EPOCH_MS + seq)
+            return false;
+        k++;
+    }
+    if (k != n)
+        return false;
+    if (consume) {
+        telemetry_log_consume(log, slots, n);
+        ref_tail += slots;
+    }
+    return true;
+}
+
+/* Power cycle; the stats start over with each mount */
+static bool remount(telemetry_log_t *log, uint32_t *drops)
+{
+    *drops += log->stats.dropped;
+    return telemetry_log_mount(log, &flash_io, NULL, FLASH_SIZE);
+}
+
+/* Returns the spread of the sector erase counts, less the sectors erased again */
+static uint32_t run(uint32_t *drops, uint32_t *torn)
+{
+    uint32_t erased_again = 0;
+    telemetry_log_t log;
+    bool appended = false;          // since the last mount
+
+    memset(flash, 0xFF, sizeof(flash));
+    memset(erases, 0, sizeof(erases));
+    ref_head = ref_tail = 0;
+    HOST_CHECK(telemetry_log_mount(&log, &flash_io, NULL, FLASH_SIZE));
+    HOST_CHECK(log.slots == SECTORS * TELEMETRY_LOG_SLOTS);
+
+    for (int op = 0; op < OPS; op++) {
+        uint32_t r = host_rand() % 100;
+        bool online = (op / OUTAGE_OPS) % 2 == 0;
+
+        if (r < 60) {
+            uint32_t seq = log.next_seq, head = log.head;
+            telemetry_record_t rec = { .uptime_ms = seq * 1000u, .epoch_ms = EPOCH_MS + seq, .tx_id = 1 };
+
+            tear = host_rand() % TEAR_ODDS == 0;
+            bool lost_power = tear;
+            bool ok = telemetry_log_append(&log, &rec);
+            HOST_CHECK(ok != lost_power);
+            ref[ref_head++] = ok ? seq : TORN;
+            appended |= ok;
+            ref_trim(&log);
+
+            if (lost_power) {
+                uint32_t pending = telemetry_log_backlog(&log);
+                (*torn)++;
+                erased_again += head % TELEMETRY_LOG_SLOTS == 0;
+                HOST_CHECK(remount(&log, drops));
+                appended = false;
+                if (log.head == head) {
+                    ref_head--;             // nothing reached the flash, the slot is reused
+                    pending--;
+                }
+                HOST_CHECK(telemetry_log_backlog(&log) <= pending);
+                ref_trim(&log);
+            }
+        } else if (r < 95) {
+            HOST_CHECK(check_peek(&log, online && host_rand() % 2));
+        } else {
+            uint32_t pending = telemetry_log_backlog(&log), next_seq = log.next_seq;
+            uint8_t boot = log.boot;
+
+            HOST_CHECK(remount(&log, drops));
+            HOST_CHECK(telemetry_log_backlog(&log) <= pending);
+            HOST_CHECK(log.next_seq == next_seq);
+            // a new boot number only once the last boot stored a record
+            HOST_CHECK(log.boot == (uint8_t)(boot + appended));
+            appended = false;
+            ref_trim(&log);
+            HOST_CHECK(check_peek(&log, false));
+        }
+        HOST_CHECK(telemetry_log_backlog(&log) <= log.slots);
+    }
+
+    // drain: every pending record comes back exactly once
+    while (telemetry_log_backlog(&log) > 0)
+        HOST_CHECK(check_peek(&log, true));
+    HOST_CHECK(ref_head == ref_tail);
+
+    *drops += log.stats.dropped;
+    uint32_t min = erases[0], max = erases[0];
+    for (int s = 1; s < SECTORS; s++) {
+        min = erases[s] < min ? erases[s] : min;
+        max = erases[s] > max ? erases[s] : max;
+    }
+    return max - min > erased_again ? max - min - erased_again : 0;
+}
+
+static void check_age(void)
+{
+    telemetry_log_t log;
+    telemetry_record_t rec = { 0 };
+    uint32_t age = 0;
+
+    memset(flash, 0xFF, sizeof(flash));
+    HOST_CHECK(telemetry_log_mount(&log, &flash_io, NULL, FLASH_SIZE));
+    log.boot = 5;
+
+    // current boot: the uptime, whatever the clock says
+    rec.boot = 5;
+    rec.uptime_ms = 1000;
+    HOST_CHECK(telemetry_log_age(&log, &rec, 61000, 0, &age) == TELEMETRY_AGE_KNOWN && age == 60000);
+    rec.epoch_ms = EPOCH_MS;
+    HOST_CHECK(telemetry_log_age(&log, &rec, 61000, EPOCH_MS + 999999, &age) == TELEMETRY_AGE_KNOWN &&
+               age == 60000);
+
+    // earlier boot: the wall clock, once it is set again
+    rec.boot = 4;
+    HOST_CHECK(telemetry_log_age(&log, &rec, 500, 0, &age) == TELEMETRY_AGE_NO_CLOCK);
+    HOST_CHECK(telemetry_log_age(&log, &rec, 500, EPOCH_MS + 3600000, &age) == TELEMETRY_AGE_KNOWN &&
+               age == 3600000);
+    HOST_CHECK(telemetry_log_age(&log, &rec, 500, EPOCH_MS - 5000, &age) == TELEMETRY_AGE_KNOWN && age == 0);
+    HOST_CHECK(telemetry_log_age(&log, &rec, 500, EPOCH_MS + 100ull * 86400000 * 365, &age) ==
+               TELEMETRY_AGE_KNOWN && age == UINT32_MAX);
+
+    // earlier boot, taken before the clock was set: never
+    rec.epoch_ms = 0;
+    HOST_CHECK(telemetry_log_age(&log, &rec, 500, EPOCH_MS, &age) == TELEMETRY_AGE_UNKNOWN);
+}
+
+int main(void)
+{
+    uint32_t drops = 0, torn = 0, spread = 0;
+
+    printf("%d sectors of %d records, %d seeds x %d operations, 1 append in %d torn\n",
+           SECTORS, TELEMETRY_LOG_SLOTS, SEEDS, OPS, TEAR_ODDS);
+    for (int seed = 1; seed <= SEEDS; seed++) {
+        host_seed((uint64_t)seed * 6151);
+        uint32_t s = run(&drops, &torn);
+        spread = s > spread ? s : spread;
+    }
+    HOST_CHECK(!straddled);
+    HOST_CHECK(spread <= 1);
+    HOST_CHECK(torn > 0 && drops > 0);
+    printf("torn records %" PRIu32 ", dropped when full %" PRIu32 ", erase count spread %" PRIu32 "\n",
+           torn, drops, spread);
+
+    check_age();
+    return host_test_result();
+}